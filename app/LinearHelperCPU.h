@@ -0,0 +1,2075 @@
+#pragma once
+
+#include "../src/troy_cpu.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace LinearHelperCPU {
+
+    template <typename T>
+    inline void savet(std::ostream& stream, const T* obj) {
+        stream.write(reinterpret_cast<const char*>(obj), sizeof(T));
+    }
+
+    template <typename T>
+    inline void loadt(std::istream& stream, T* obj) {
+        stream.read(reinterpret_cast<char*>(obj), sizeof(T));
+    }
+
+    inline size_t defaultThreadCount() {
+        size_t n = std::thread::hardware_concurrency();
+        return n == 0 ? 1 : n;
+    }
+
+    // Runs task(k) for every k in [0, count) on at most `threads` threads.
+    // The first exception thrown by a task is rethrown to the caller.
+    template <typename F>
+    inline void parallelFor(size_t count, size_t threads, F&& task) {
+        if (threads > count) threads = count;
+        if (threads <= 1) {
+            for (size_t k = 0; k < count; k++) task(k);
+            return;
+        }
+        std::atomic<size_t> next(0);
+        std::exception_ptr error = nullptr;
+        std::mutex errorMutex;
+        auto worker = [&]() {
+            while (true) {
+                size_t k = next.fetch_add(1);
+                if (k >= count) return;
+                try {
+                    task(k);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error) error = std::current_exception();
+                    next.store(count);
+                }
+            }
+        };
+        std::vector<std::thread> pool; pool.reserve(threads - 1);
+        for (size_t t = 1; t < threads; t++) pool.emplace_back(worker);
+        worker();
+        for (auto& th: pool) th.join();
+        if (error) std::rethrow_exception(error);
+    }
+
+    class Cipher2d;
+
+    class Plain2d {
+
+        using Plaintext = troy::Plaintext;
+        using Ciphertext = troy::Ciphertext;
+
+    public:
+
+        std::vector<std::vector<Plaintext>> data;
+        std::vector<Plaintext>& operator[] (size_t id) {
+            return data[id];
+        }
+        const std::vector<Plaintext>& operator[] (size_t id) const {
+            return data[id];
+        }
+        Plain2d() {}
+
+        template <typename F>
+        void forEach(size_t threads, F&& f) {
+            std::vector<std::pair<size_t, size_t>> ids;
+            for (size_t i = 0; i < data.size(); i++)
+                for (size_t j = 0; j < data[i].size(); j++) ids.emplace_back(i, j);
+            parallelFor(ids.size(), threads, [&](size_t k) {
+                f(data[ids[k].first][ids[k].second]);
+            });
+        }
+
+        Cipher2d encrypt(const troy::Encryptor& encryptor, size_t threads = defaultThreadCount()) const;
+
+        // Lifts every plaintext into the NTT domain at the given level, so that
+        // it can be reused by any number of fused multiply-accumulates.
+        void transformToNttInplace(const troy::Evaluator& evaluator, troy::ParmsID parmsID, size_t threads = defaultThreadCount()) {
+            forEach(threads, [&](Plaintext& p) {
+                if (!p.isNttForm()) evaluator.transformToNttInplace(p, parmsID);
+            });
+        }
+
+    };
+
+    class Cipher2d {
+
+        using Plaintext = troy::Plaintext;
+        using Ciphertext = troy::Ciphertext;
+
+    public:
+
+        std::vector<std::vector<Ciphertext>> data;
+        std::vector<Ciphertext>& operator[] (size_t id) {
+            return data[id];
+        }
+        const std::vector<Ciphertext>& operator[] (size_t id) const {
+            return data[id];
+        }
+        Cipher2d() {}
+
+        template <typename F>
+        void forEach(size_t threads, F&& f) {
+            std::vector<std::pair<size_t, size_t>> ids;
+            for (size_t i = 0; i < data.size(); i++)
+                for (size_t j = 0; j < data[i].size(); j++) ids.emplace_back(i, j);
+            parallelFor(ids.size(), threads, [&](size_t k) {
+                f(data[ids[k].first][ids[k].second], ids[k].first, ids[k].second);
+            });
+        }
+
+        void save(std::ostream& stream) const {
+            size_t n = data.size();
+            if (n == 0) return;
+            size_t m = data[0].size();
+            for (size_t i = 1; i < n; i++) {
+                if (data[i].size() != m) {
+                    throw std::invalid_argument("Not a rectangle Conv2d.");
+                }
+            }
+            savet(stream, &n);
+            savet(stream, &m);
+            for (size_t i = 0; i < n; i++) {
+                for (size_t j = 0; j < m; j++) {
+                    data[i][j].save(stream);
+                }
+            }
+        }
+
+        void load(std::istream& stream) {
+            size_t n, m;
+            loadt(stream, &n);
+            loadt(stream, &m);
+            data.clear(); data.reserve(n);
+            for (size_t i = 0; i < n; i++) {
+                std::vector<Ciphertext> k(m);
+                for (size_t j = 0; j < m; j++) {
+                    k[j].load(stream);
+                }
+                data.push_back(std::move(k));
+            }
+        }
+
+        void load(std::istream& stream, const troy::SEALContext& context) {
+            size_t n, m;
+            loadt(stream, &n);
+            loadt(stream, &m);
+            data.clear(); data.reserve(n);
+            for (size_t i = 0; i < n; i++) {
+                std::vector<Ciphertext> k(m);
+                for (size_t j = 0; j < m; j++) {
+                    k[j].load(stream, context);
+                }
+                data.push_back(std::move(k));
+            }
+        }
+
+        void modSwitchToNext(const troy::Evaluator& evaluator, size_t threads = defaultThreadCount()) {
+            forEach(threads, [&](Ciphertext& c, size_t, size_t) {
+                evaluator.modSwitchToNextInplace(c);
+            });
+        }
+
+        void relinearize(const troy::Evaluator& evaluator, const troy::RelinKeys& rlk, size_t threads = defaultThreadCount()) {
+            forEach(threads, [&](Ciphertext& c, size_t, size_t) {
+                evaluator.relinearizeInplace(c, rlk);
+            });
+        }
+
+        void multiplyScalarInplace(const troy::BatchEncoder& encoder, const troy::Evaluator& evaluator, uint64_t scalar, size_t threads = defaultThreadCount()) {
+            Plaintext p; encoder.encodePolynomial(std::vector<uint64_t>{scalar}, p);
+            forEach(threads, [&](Ciphertext& c, size_t, size_t) {
+                evaluator.multiplyPlainInplace(c, p);
+            });
+        }
+
+        void addInplace(
+            const troy::Evaluator& evaluator,
+            const Cipher2d& x,
+            size_t threads = defaultThreadCount()
+        ) {
+            if (data.size() != x.data.size()) {
+                throw std::invalid_argument("Size incorrect.");
+            }
+            size_t n = data.size();
+            for (size_t i = 0; i < n; i++) {
+                if (data[i].size() != x[i].size()) {
+                    throw std::invalid_argument("Size incorrect.");
+                }
+            }
+            forEach(threads, [&](Ciphertext& c, size_t i, size_t j) {
+                evaluator.addInplace(c, x[i][j]);
+            });
+        }
+
+        void addPlainInplace(
+            const troy::Evaluator& evaluator,
+            const Plain2d& x,
+            size_t threads = defaultThreadCount()
+        ) {
+            if (data.size() != x.data.size()) {
+                throw std::invalid_argument("Size incorrect.");
+            }
+            size_t n = data.size();
+            for (size_t i = 0; i < n; i++) {
+                if (data[i].size() != x[i].size()) {
+                    throw std::invalid_argument("Size incorrect.");
+                }
+            }
+            forEach(threads, [&](Ciphertext& c, size_t i, size_t j) {
+                evaluator.addPlainInplace(c, x[i][j]);
+            });
+        }
+
+        Cipher2d addPlain(
+            const troy::Evaluator& evaluator,
+            const Plain2d& x,
+            size_t threads = defaultThreadCount()
+        ) const {
+            Cipher2d ret = *this;
+            ret.addPlainInplace(evaluator, x, threads);
+            return ret;
+        }
+
+        // Returns a copy whose ciphertexts are all in NTT form.
+        Cipher2d toNtt(const troy::Evaluator& evaluator, size_t threads = defaultThreadCount()) const {
+            Cipher2d ret = *this;
+            ret.forEach(threads, [&](Ciphertext& c, size_t, size_t) {
+                if (!c.isNttForm()) evaluator.transformToNttInplace(c);
+            });
+            return ret;
+        }
+
+    };
+
+    inline Cipher2d Plain2d::encrypt(const troy::Encryptor& encryptor, size_t threads) const {
+        Cipher2d ret; ret.data.resize(data.size());
+        size_t n = data.size();
+        for (size_t i = 0; i < n; i++) {
+            ret.data[i].resize(data[i].size());
+        }
+        ret.forEach(threads, [&](Ciphertext& c, size_t i, size_t j) {
+            encryptor.encryptSymmetric(data[i][j], c);
+        });
+        return ret;
+    }
+
+    // Chunked streaming format for Cipher2d and Plain2d. Unlike Cipher2d::save, which needs
+    // the whole matrix up front, a StreamWriter emits any run of consecutive elements of a
+    // row as soon as it is ready (in any order, from any thread), and a StreamReader hands
+    // each chunk over as soon as it has arrived.
+    //
+    //   header: magic, version, kind, encoding, rows, cols
+    //   chunk:  row, col, count, count payload sizes, count payloads
+    //   end:    a chunk with count = 0
+    //
+    // With StreamEncoding::terms every ciphertext is written with Ciphertext::saveTerms,
+    // using the term list registered for its position (row * cols + col). The payloads of
+    // a chunk are (de)serialized in parallel.
+    enum class StreamKind : uint8_t { cipher = 0, plain = 1 };
+    enum class StreamEncoding : uint8_t { full = 0, terms = 1 };
+
+    struct StreamHeader {
+
+        static const uint64_t magicNumber = 0x54534432594f5254ULL; // "TROY2DST"
+        static const uint32_t currentVersion = 1;
+
+        StreamKind kind = StreamKind::cipher;
+        StreamEncoding encoding = StreamEncoding::full;
+        uint64_t rows = 0, cols = 0;
+
+        void save(std::ostream& stream) const {
+            uint64_t magic = magicNumber; uint32_t version = currentVersion;
+            savet(stream, &magic); savet(stream, &version);
+            savet(stream, &kind); savet(stream, &encoding);
+            savet(stream, &rows); savet(stream, &cols);
+        }
+
+        void load(std::istream& stream) {
+            uint64_t magic = 0; uint32_t version = 0;
+            loadt(stream, &magic); loadt(stream, &version);
+            if (!stream || magic != magicNumber) {
+                throw std::invalid_argument("Not a Cipher2d/Plain2d stream.");
+            }
+            if (version != currentVersion) {
+                throw std::invalid_argument("Unsupported stream version.");
+            }
+            loadt(stream, &kind); loadt(stream, &encoding);
+            loadt(stream, &rows); loadt(stream, &cols);
+            if (!stream) throw std::invalid_argument("Truncated stream header.");
+        }
+
+    };
+
+    class StreamWriter {
+
+        using Plaintext = troy::Plaintext;
+        using Ciphertext = troy::Ciphertext;
+
+        std::ostream& stream;
+        StreamHeader header;
+        const troy::Evaluator* evaluator;
+        std::vector<std::vector<size_t>> terms;
+        size_t threads;
+        std::mutex mutex;
+        bool finished;
+
+        template <typename T, typename Save>
+        void writeChunk(StreamKind kind, size_t row, size_t col, const std::vector<const T*>& items, Save save) {
+            if (kind != header.kind) throw std::invalid_argument("Element type does not match the stream.");
+            if (items.empty()) return;
+            if (row >= header.rows || col + items.size() > header.cols) {
+                throw std::invalid_argument("Chunk out of range.");
+            }
+            // Serialize outside the lock so that concurrent producers only contend on the write.
+            std::vector<std::string> payloads(items.size());
+            parallelFor(items.size(), threads, [&](size_t k) {
+                std::ostringstream s;
+                save(*items[k], row * header.cols + col + k, s);
+                payloads[k] = s.str();
+            });
+            std::lock_guard<std::mutex> lock(mutex);
+            if (finished) throw std::logic_error("Stream already finished.");
+            uint64_t r = row, c = col, count = items.size();
+            savet(stream, &r); savet(stream, &c); savet(stream, &count);
+            for (auto& p: payloads) {
+                uint64_t size = p.size();
+                savet(stream, &size);
+            }
+            for (auto& p: payloads) stream.write(p.data(), p.size());
+        }
+
+    public:
+
+        // Full encoding of a rows x cols matrix of ciphertexts or plaintexts.
+        StreamWriter(std::ostream& stream, StreamKind kind, size_t rows, size_t cols, size_t threads = defaultThreadCount()):
+            stream(stream), evaluator(nullptr), threads(threads), finished(false)
+        {
+            header.kind = kind; header.rows = rows; header.cols = cols;
+            header.save(stream);
+        }
+
+        // Compact encoding of a rows x cols matrix of ciphertexts: only terms[row * cols + col]
+        // of c0 are kept for the ciphertext at (row, col).
+        StreamWriter(std::ostream& stream, const troy::Evaluator& evaluator, size_t rows, size_t cols,
+            std::vector<std::vector<size_t>> terms, size_t threads = defaultThreadCount()
+        ):
+            stream(stream), evaluator(&evaluator), terms(std::move(terms)), threads(threads), finished(false)
+        {
+            if (this->terms.size() != rows * cols) {
+                throw std::invalid_argument("Term lists do not match the matrix shape.");
+            }
+            header.encoding = StreamEncoding::terms; header.rows = rows; header.cols = cols;
+            header.save(stream);
+        }
+
+        const StreamHeader& getHeader() const {return header;}
+
+        void write(size_t row, size_t col, const std::vector<const Ciphertext*>& ciphers) {
+            writeChunk(StreamKind::cipher, row, col, ciphers, [&](const Ciphertext& c, size_t id, std::ostream& s) {
+                if (evaluator) c.saveTerms(s, *evaluator, terms[id]);
+                else c.save(s);
+            });
+        }
+
+        void write(size_t row, size_t col, const std::vector<const Plaintext*>& plains) {
+            writeChunk(StreamKind::plain, row, col, plains, [](const Plaintext& p, size_t, std::ostream& s) {
+                p.save(s);
+            });
+        }
+
+        void write(size_t row, size_t col, const std::vector<Ciphertext>& ciphers) {
+            std::vector<const Ciphertext*> ptrs;
+            for (auto& c: ciphers) ptrs.push_back(&c);
+            write(row, col, ptrs);
+        }
+
+        void write(size_t row, size_t col, const std::vector<Plaintext>& plains) {
+            std::vector<const Plaintext*> ptrs;
+            for (auto& p: plains) ptrs.push_back(&p);
+            write(row, col, ptrs);
+        }
+
+        // Writes a whole matrix, at most chunkSize elements per chunk.
+        template <typename T>
+        void writeAll(const std::vector<std::vector<T>>& data, size_t chunkSize) {
+            if (chunkSize == 0) throw std::invalid_argument("Chunk size must be positive.");
+            for (size_t i = 0; i < data.size(); i++) {
+                for (size_t j = 0; j < data[i].size(); j += chunkSize) {
+                    std::vector<const T*> ptrs;
+                    for (size_t k = j; k < std::min(data[i].size(), j + chunkSize); k++) ptrs.push_back(&data[i][k]);
+                    write(i, j, ptrs);
+                }
+            }
+        }
+
+        // Writes the end marker. No more chunks may follow.
+        void finish() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (finished) return;
+            uint64_t zero = 0;
+            savet(stream, &zero); savet(stream, &zero); savet(stream, &zero);
+            stream.flush();
+            finished = true;
+        }
+
+    };
+
+    class StreamReader {
+
+        using Plaintext = troy::Plaintext;
+        using Ciphertext = troy::Ciphertext;
+
+        std::istream& stream;
+        StreamHeader header;
+        const troy::SEALContext* context;
+        const troy::Evaluator* evaluator;
+        std::vector<std::vector<size_t>> terms;
+        size_t threads;
+        bool ended;
+
+        void checkHeader() {
+            header.load(stream);
+            if (header.encoding == StreamEncoding::terms && !evaluator) {
+                throw std::invalid_argument("Compact stream needs an evaluator and term lists.");
+            }
+            if (evaluator && (header.encoding != StreamEncoding::terms || terms.size() != header.rows * header.cols)) {
+                throw std::invalid_argument("Term lists do not match the stream.");
+            }
+        }
+
+        template <typename T, typename Load>
+        bool readChunk(StreamKind kind, size_t& row, size_t& col, std::vector<T>& out, Load load) {
+            if (kind != header.kind) throw std::invalid_argument("Element type does not match the stream.");
+            out.clear();
+            if (ended) return false;
+            uint64_t r, c, count;
+            loadt(stream, &r); loadt(stream, &c); loadt(stream, &count);
+            if (!stream) throw std::invalid_argument("Truncated stream.");
+            if (count == 0) {ended = true; return false;}
+            if (r >= header.rows || c + count > header.cols) {
+                throw std::invalid_argument("Chunk out of range.");
+            }
+            std::vector<uint64_t> sizes(count);
+            for (auto& s: sizes) loadt(stream, &s);
+            std::vector<std::string> payloads(count);
+            for (size_t k = 0; k < count; k++) {
+                payloads[k].resize(sizes[k]);
+                stream.read(&payloads[k][0], sizes[k]);
+            }
+            if (!stream) throw std::invalid_argument("Truncated stream.");
+            row = r; col = c; out.resize(count);
+            parallelFor(count, threads, [&](size_t k) {
+                std::istringstream s(payloads[k]);
+                load(out[k], r * header.cols + c + k, s);
+            });
+            return true;
+        }
+
+    public:
+
+        // Reads a fully encoded stream; ciphertexts are validated against context if given.
+        StreamReader(std::istream& stream, const troy::SEALContext* context = nullptr, size_t threads = defaultThreadCount()):
+            stream(stream), context(context), evaluator(nullptr), threads(threads), ended(false)
+        {
+            checkHeader();
+        }
+
+        // Reads a compact stream written with the same term lists.
+        StreamReader(std::istream& stream, const troy::Evaluator& evaluator,
+            std::vector<std::vector<size_t>> terms, size_t threads = defaultThreadCount()
+        ):
+            stream(stream), context(nullptr), evaluator(&evaluator), terms(std::move(terms)), threads(threads), ended(false)
+        {
+            checkHeader();
+        }
+
+        const StreamHeader& getHeader() const {return header;}
+
+        // Reads the next chunk into out, which then holds the elements (row, col), ...,
+        // (row, col + out.size() - 1). Returns false at the end marker.
+        bool next(size_t& row, size_t& col, std::vector<Ciphertext>& out) {
+            return readChunk(StreamKind::cipher, row, col, out, [&](Ciphertext& c, size_t id, std::istream& s) {
+                if (evaluator) c.loadTerms(s, *evaluator, terms[id]);
+                else if (context) c.load(s, *context);
+                else c.load(s);
+            });
+        }
+
+        bool next(size_t& row, size_t& col, std::vector<Plaintext>& out) {
+            return readChunk(StreamKind::plain, row, col, out, [](Plaintext& p, size_t, std::istream& s) {
+                p.load(s);
+            });
+        }
+
+        // Reads every remaining chunk into a rows x cols matrix, calling onChunk(row, col, count)
+        // after each one so that the caller can start working on it.
+        template <typename T, typename F>
+        void readAll(std::vector<std::vector<T>>& data, F&& onChunk) {
+            data.assign(header.rows, std::vector<T>(header.cols));
+            std::vector<T> chunk; size_t row, col;
+            while (next(row, col, chunk)) {
+                for (size_t k = 0; k < chunk.size(); k++) data[row][col + k] = std::move(chunk[k]);
+                onChunk(row, col, chunk.size());
+            }
+        }
+
+        template <typename T>
+        void readAll(std::vector<std::vector<T>>& data) {
+            readAll(data, [](size_t, size_t, size_t) {});
+        }
+
+    };
+
+
+    // On-disk cache of multiplication-ready weights: a Plain2d whose plaintexts are already
+    // lifted into the NTT domain at one level, stored as raw coefficient blocks aligned to
+    // cache lines behind an offset table. Loading maps the file and copies the blocks out
+    // in parallel, so a server skips encoding and NTT at startup. The file is keyed by a
+    // caller-supplied 64-bit key (the helpers combine the hash of the weights with the
+    // layer key and their blocking) and by the parms id.
+    class WeightCache {
+
+        static const uint64_t magicNumber = 0x4548434154484757ULL; // "WGHTACHE"
+        static const uint64_t currentVersion = 1;
+        static const size_t alignment = 64;
+
+        struct Header {
+            uint64_t magic, version, key;
+            troy::ParmsID parmsID;
+            uint64_t rows, cols;
+        };
+
+        struct Entry {
+            uint64_t offset, coeffCount;
+            double scale;
+        };
+
+        static size_t alignUp(size_t x) {
+            return (x + alignment - 1) / alignment * alignment;
+        }
+
+    public:
+
+        // FNV-1a over a byte range; chain calls through `seed` to combine several fields.
+        static uint64_t hash(const void* data, size_t bytes, uint64_t seed = 0xcbf29ce484222325ULL) {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+            uint64_t h = seed;
+            for (size_t i = 0; i < bytes; i++) {
+                h ^= p[i];
+                h *= 0x100000001b3ULL;
+            }
+            return h;
+        }
+
+        static uint64_t hash(const std::vector<uint64_t>& values, uint64_t seed = 0xcbf29ce484222325ULL) {
+            return hash(values.data(), values.size() * sizeof(uint64_t), seed);
+        }
+
+        // Writes w, whose plaintexts must all be in NTT form at parmsID.
+        static void save(const std::string& path, uint64_t key, troy::ParmsID parmsID, const Plain2d& w) {
+            Header header{magicNumber, currentVersion, key, parmsID, w.data.size(), w.data.empty() ? 0 : w[0].size()};
+            std::vector<Entry> entries;
+            size_t offset = alignUp(sizeof(Header) + header.rows * header.cols * sizeof(Entry));
+            for (auto& row: w.data) {
+                if (row.size() != header.cols) throw std::invalid_argument("Weight matrix is not rectangular.");
+                for (auto& p: row) {
+                    if (!p.isNttForm() || p.parmsID() != parmsID) {
+                        throw std::invalid_argument("Cached weights must be in NTT form at the given level.");
+                    }
+                    entries.push_back(Entry{offset, p.coeffCount(), p.scale()});
+                    offset = alignUp(offset + p.coeffCount() * sizeof(uint64_t));
+                }
+            }
+            // Write to a temporary file and rename, so a concurrently starting server never
+            // maps a half-written cache. The name is unique, so concurrent writers of the same
+            // cache each publish a complete file.
+            std::vector<char> pattern(path.begin(), path.end());
+            const char suffix[] = ".XXXXXX";
+            pattern.insert(pattern.end(), suffix, suffix + sizeof(suffix));
+            int fd = ::mkstemp(pattern.data());
+            if (fd < 0) throw std::runtime_error("Cannot open weight cache for writing.");
+            ::fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+            ::close(fd);
+            std::string temp(pattern.data());
+            {
+                std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+                if (!out) throw std::runtime_error("Cannot open weight cache for writing.");
+                out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+                out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+                size_t position = sizeof(Header) + entries.size() * sizeof(Entry);
+                std::vector<char> padding(alignment, 0);
+                size_t id = 0;
+                for (auto& row: w.data) {
+                    for (auto& p: row) {
+                        out.write(padding.data(), entries[id].offset - position);
+                        out.write(reinterpret_cast<const char*>(p.data()), p.coeffCount() * sizeof(uint64_t));
+                        position = entries[id].offset + p.coeffCount() * sizeof(uint64_t);
+                        id++;
+                    }
+                }
+                if (!out) {
+                    std::remove(temp.c_str());
+                    throw std::runtime_error("Failed writing weight cache.");
+                }
+            }
+            if (std::rename(temp.c_str(), path.c_str()) != 0) {
+                std::remove(temp.c_str());
+                throw std::runtime_error("Cannot move weight cache into place.");
+            }
+        }
+
+        // Loads the cache at path into w, which must have rows x cols plaintexts. Returns false,
+        // leaving w untouched, if the file does not exist, is malformed, or was written for
+        // another key, level or shape.
+        static bool load(
+            const std::string& path, uint64_t key, troy::ParmsID parmsID, size_t rows, size_t cols,
+            Plain2d& w, size_t threads = defaultThreadCount()
+        ) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+            struct stat st;
+            if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+                ::close(fd);
+                return false;
+            }
+            size_t size = st.st_size;
+            void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (mapped == MAP_FAILED) return false;
+            const char* base = reinterpret_cast<const char*>(mapped);
+            Header header; std::memcpy(&header, base, sizeof(Header));
+            // Bound every term separately, so that a corrupt header cannot wrap the checks around.
+            bool valid = header.magic == magicNumber && header.version == currentVersion
+                && header.key == key && header.parmsID == parmsID
+                && header.rows == rows && header.cols == cols
+                && (rows == 0 || cols <= (size - sizeof(Header)) / sizeof(Entry) / rows);
+            const Entry* entries = reinterpret_cast<const Entry*>(base + sizeof(Header));
+            for (size_t k = 0; valid && k < rows * cols; k++) {
+                valid = entries[k].offset <= size
+                    && entries[k].coeffCount <= (size - entries[k].offset) / sizeof(uint64_t);
+            }
+            if (!valid) {
+                ::munmap(mapped, size);
+                return false;
+            }
+            Plain2d ret; ret.data.assign(header.rows, std::vector<troy::Plaintext>(header.cols));
+            ::madvise(mapped, size, MADV_WILLNEED);
+            parallelFor(header.rows * header.cols, threads, [&](size_t k) {
+                troy::Plaintext& p = ret[k / header.cols][k % header.cols];
+                p.resize(entries[k].coeffCount);
+                std::memcpy(p.data(), base + entries[k].offset, entries[k].coeffCount * sizeof(uint64_t));
+                p.parmsID() = parmsID;
+                p.scale() = entries[k].scale;
+            });
+            ::munmap(mapped, size);
+            w = std::move(ret);
+            return true;
+        }
+
+    };
+
+
+    inline static size_t ceilDiv(size_t a, size_t b) {
+        if (a%b==0) return a/b;
+        return a/b+1;
+    }
+
+    // Computes ret[b][j] = sum_i a[b][i] * weight(i, j) for every b < a.data.size() and
+    // j < outputCount, one fused multiply-accumulate per output. `a` must be in NTT
+    // form and every weight must be an NTT-form plaintext at the level of `a`.
+    template <typename WeightAt>
+    inline Cipher2d multiplyAccumulateNtt(
+        const troy::Evaluator& evaluator,
+        const Cipher2d& a, size_t outputCount,
+        WeightAt weightAt, size_t threads
+    ) {
+        size_t batchCount = a.data.size();
+        Cipher2d ret; ret.data.resize(batchCount);
+        for (size_t b = 0; b < batchCount; b++) ret.data[b].resize(outputCount);
+        parallelFor(batchCount * outputCount, threads, [&](size_t k) {
+            size_t b = k / outputCount, j = k % outputCount;
+            size_t inputCount = a[b].size();
+            std::vector<const troy::Ciphertext*> encrypteds(inputCount);
+            std::vector<const troy::Plaintext*> plains(inputCount);
+            for (size_t i = 0; i < inputCount; i++) {
+                encrypteds[i] = &a[b][i];
+                plains[i] = &weightAt(i, j);
+            }
+            evaluator.multiplyPlainAccumulate(encrypteds, plains, ret[b][j]);
+        });
+        return ret;
+    }
+
+    // Lifts every ciphertext of `a` to the extended BEHZ base in NTT form, once, so that it
+    // can take part in any number of ciphertext-ciphertext products.
+    inline std::vector<std::vector<troy::BehzCiphertext>> extendToBehzNtt(
+        const troy::Evaluator& evaluator, const Cipher2d& a, size_t threads
+    ) {
+        std::vector<std::vector<troy::BehzCiphertext>> ret(a.data.size());
+        std::vector<std::pair<size_t, size_t>> ids;
+        for (size_t i = 0; i < a.data.size(); i++) {
+            ret[i].resize(a[i].size());
+            for (size_t j = 0; j < a[i].size(); j++) ids.emplace_back(i, j);
+        }
+        parallelFor(ids.size(), threads, [&](size_t k) {
+            evaluator.extendToBehzNtt(a[ids[k].first][ids[k].second], ret[ids[k].first][ids[k].second]);
+        });
+        return ret;
+    }
+
+    // Ciphertext-ciphertext counterpart of multiplyAccumulateNtt: ret[b][j] = sum_i a[b][i] * weight(i, j)
+    // over extended ciphertexts, with a single scale-down per output and, if rlk is given, a
+    // single relinearization.
+    template <typename WeightAt>
+    inline Cipher2d multiplyAccumulateBehz(
+        const troy::Evaluator& evaluator,
+        const std::vector<std::vector<troy::BehzCiphertext>>& a, size_t outputCount,
+        WeightAt weightAt, const troy::RelinKeys* rlk, size_t threads
+    ) {
+        size_t batchCount = a.size();
+        Cipher2d ret; ret.data.resize(batchCount);
+        for (size_t b = 0; b < batchCount; b++) ret.data[b].resize(outputCount);
+        parallelFor(batchCount * outputCount, threads, [&](size_t k) {
+            size_t b = k / outputCount, j = k % outputCount;
+            size_t inputCount = a[b].size();
+            std::vector<const troy::BehzCiphertext*> encrypteds1(inputCount), encrypteds2(inputCount);
+            for (size_t i = 0; i < inputCount; i++) {
+                encrypteds1[i] = &a[b][i];
+                encrypteds2[i] = &weightAt(i, j);
+            }
+            evaluator.multiplyAccumulate(encrypteds1, encrypteds2, ret[b][j]);
+            if (rlk) evaluator.relinearizeInplace(ret[b][j], *rlk);
+        });
+        return ret;
+    }
+
+    // Prepares plaintexts for multiplyAccumulateNtt: returns `w` itself when it is already
+    // lifted to `parmsID`, otherwise a lifted copy in `buffer`.
+    inline const Plain2d& preparePlain2d(
+        const troy::Evaluator& evaluator, const Plain2d& w,
+        troy::ParmsID parmsID, Plain2d& buffer, size_t threads
+    ) {
+        bool prepared = true;
+        for (auto& row: w.data) {
+            for (auto& p: row) {
+                if (!p.isNttForm()) prepared = false;
+                else if (p.parmsID() != parmsID) {
+                    throw std::invalid_argument("Plaintexts are prepared for a different level.");
+                }
+            }
+        }
+        if (prepared) return w;
+        buffer = w;
+        buffer.transformToNttInplace(evaluator, parmsID, threads);
+        return buffer;
+    }
+
+    inline troy::ParmsID firstParmsID(const Cipher2d& a) {
+        for (auto& row: a.data) {
+            for (auto& c: row) return c.parmsID();
+        }
+        throw std::invalid_argument("Empty ciphertext matrix.");
+    }
+
+    // Packs groups of `packSlots` ciphertexts into one. The useful coefficients of every
+    // input must sit at indices congruent to packSlots - 1 modulo packSlots; in the k-th
+    // ciphertext of a group they end up at indices congruent to k. Each group is merged
+    // by Evaluator::packCiphertextGroupsInplace with a tree of packSlots - 1 automorphisms
+    // instead of a separate field trace per ciphertext, which would cost log2(packSlots)
+    // automorphisms each; the automorphisms run on the evaluator's threadCount() threads.
+    // Needs the keys from KeyGenerator::createAutomorphismKeys.
+    inline std::vector<troy::Ciphertext> packCiphertexts(
+        const troy::Evaluator& evaluator, const troy::GaloisKeys& autoKey,
+        const std::vector<const troy::Ciphertext*>& ciphers, size_t packSlots, size_t threads
+    ) {
+        using troy::Ciphertext;
+        size_t count = ciphers.size();
+        if (count == 0) return std::vector<Ciphertext>();
+        size_t n = ciphers[0]->polyModulusDegree();
+        if (packSlots == 0 || (packSlots & (packSlots - 1)) != 0 || packSlots > n) {
+            throw std::invalid_argument("Pack slots must be a power of two not larger than the degree.");
+        }
+        bool nttForm = ciphers[0]->isNttForm();
+        std::vector<Ciphertext> slots(count);
+        // Move the useful coefficients to multiples of packSlots, where the merge keeps them.
+        parallelFor(count, threads, [&](size_t k) {
+            slots[k] = *ciphers[k];
+            if (nttForm) evaluator.transformFromNttInplace(slots[k]);
+            if (packSlots > 1) evaluator.negacyclicShiftInplace(slots[k], 2 * n - (packSlots - 1));
+        });
+        evaluator.packCiphertextGroupsInplace(slots, packSlots, 1, autoKey);
+        if (nttForm) {
+            parallelFor(slots.size(), threads, [&](size_t g) {
+                evaluator.transformToNttInplace(slots[g]);
+            });
+        }
+        return slots;
+    }
+
+    // Per-operation costs used to choose the blocking of the linear helpers. Times are
+    // milliseconds for one ciphertext (or one accumulated term) at polyModulusDegree with
+    // inputModuli primes; outputs are assumed to be switched down to outputModuli primes.
+    // coeffModulusBits is the total bit count of the coefficient modulus, special prime included.
+    struct CostModel {
+        size_t polyModulusDegree = 8192;
+        size_t inputModuli = 2, outputModuli = 1;
+        int coeffModulusBits = 180;
+        double encrypt = 1.4;
+        double decrypt = 0.2;
+        double nttCiphertext = 0.75;
+        double inttCiphertext = 0.75;
+        double multiplyAccumulateTerm = 0.11;
+        double automorphism = 3.4;
+        double bandwidth = 1e5; // bytes per ms
+        size_t threads = defaultThreadCount();
+
+        // Measures the operations above on this machine with the given parameters.
+        static CostModel calibrate(const troy::SEALContext& context, size_t threads = defaultThreadCount(), size_t repeat = 5) {
+            using namespace troy;
+            auto first = context.firstContextData();
+            size_t n = first->parms().polyModulusDegree();
+            uint64_t t = first->parms().plainModulus().value();
+            CostModel ret;
+            ret.polyModulusDegree = n;
+            ret.inputModuli = first->parms().coeffModulus().size();
+            ret.outputModuli = context.lastContextData()->parms().coeffModulus().size();
+            ret.coeffModulusBits = 0;
+            for (auto& q: context.keyContextData()->parms().coeffModulus()) ret.coeffModulusBits += q.bitCount();
+            ret.threads = threads;
+
+            KeyGenerator keygen(context);
+            GaloisKeys autoKey;
+            keygen.createGaloisKeys(std::vector<uint32_t>{static_cast<uint32_t>(n + 1)}, autoKey);
+            Encryptor encryptor(context, keygen.secretKey());
+            Decryptor decryptor(context, keygen.secretKey());
+            Evaluator evaluator(context);
+
+            const size_t terms = 8;
+            std::vector<Plaintext> plains(terms);
+            for (size_t k = 0; k < terms; k++) {
+                plains[k].resize(n);
+                for (size_t i = 0; i < n; i++) plains[k][i] = (i * 7 + k) % t;
+            }
+            std::vector<Ciphertext> ciphers(terms);
+            auto best = [&](auto&& op) {
+                double ms = 1e100;
+                for (size_t r = 0; r < repeat; r++) {
+                    auto start = std::chrono::steady_clock::now();
+                    op();
+                    auto end = std::chrono::steady_clock::now();
+                    ms = std::min(ms, std::chrono::duration<double, std::milli>(end - start).count());
+                }
+                return ms;
+            };
+            ret.encrypt = best([&]() {
+                for (size_t k = 0; k < terms; k++) encryptor.encryptSymmetric(plains[k], ciphers[k]);
+            }) / terms;
+            Ciphertext c = ciphers[0];
+            ret.nttCiphertext = best([&]() {
+                c = ciphers[0]; evaluator.transformToNttInplace(c);
+            });
+            ret.inttCiphertext = best([&]() {
+                Ciphertext d = c; evaluator.transformFromNttInplace(d);
+            });
+            std::vector<const Ciphertext*> encrypteds(terms);
+            std::vector<const Plaintext*> plainPtrs(terms);
+            for (size_t k = 0; k < terms; k++) {
+                evaluator.transformToNttInplace(ciphers[k]);
+                evaluator.transformToNttInplace(plains[k], first->parmsID());
+                encrypteds[k] = &ciphers[k];
+                plainPtrs[k] = &plains[k];
+            }
+            Ciphertext sum;
+            ret.multiplyAccumulateTerm = best([&]() {
+                evaluator.multiplyPlainAccumulate(encrypteds, plainPtrs, sum);
+            }) / terms;
+            evaluator.transformFromNttInplace(sum);
+            // Results are packed and decrypted after switching to the last level.
+            if (context.lastParmsID() != first->parmsID()) {
+                evaluator.modSwitchToInplace(sum, context.lastParmsID());
+            }
+            ret.automorphism = best([&]() {
+                Ciphertext d; evaluator.applyGalois(sum, static_cast<uint32_t>(n + 1), autoKey, d);
+            });
+            Plaintext decrypted;
+            ret.decrypt = best([&]() {
+                decryptor.decrypt(sum, decrypted);
+            });
+            return ret;
+        }
+
+        // Whether the same coefficient modulus can be used at `degree` with the given security.
+        bool supportsDegree(size_t degree, troy::SecurityLevel securityLevel) const {
+            if (degree < 2 || (degree & (degree - 1)) != 0) return false;
+            return coeffModulusBits <= troy::CoeffModulus::MaxBitCount(degree, securityLevel);
+        }
+
+        // Extrapolates the costs to another degree (NTT-like N log N scaling). The coefficient
+        // modulus, and so inputModuli and outputModuli, stay the same; check supportsDegree first.
+        CostModel scaledTo(size_t degree) const {
+            CostModel ret = *this;
+            double factor = (degree * std::log2(double(degree))) / (polyModulusDegree * std::log2(double(polyModulusDegree)));
+            ret.polyModulusDegree = degree;
+            ret.encrypt *= factor; ret.decrypt *= factor;
+            ret.nttCiphertext *= factor; ret.inttCiphertext *= factor;
+            ret.multiplyAccumulateTerm *= double(degree) / polyModulusDegree;
+            ret.automorphism *= factor;
+            return ret;
+        }
+
+        double inputBytes(size_t count) const {
+            return double(count) * 2 * polyModulusDegree * inputModuli * sizeof(uint64_t);
+        }
+
+        // Outputs are serialized with saveTerms: the selected terms of c0 plus all of c1.
+        double outputBytes(size_t count, size_t terms) const {
+            return (double(count) * polyModulusDegree + terms) * outputModuli * sizeof(uint64_t);
+        }
+
+        // Wall time of `count` independent tasks of `each` ms on the modelled threads.
+        double parallel(size_t count, double each) const {
+            size_t t = std::max<size_t>(1, std::min(threads, count));
+            return ceilDiv(count, t) * each;
+        }
+    };
+
+    enum class TuneTarget { latency, bytes };
+
+    // Largest packing factor the helpers choose. Packing P ciphertexts multiplies the
+    // key-switching noise by about P, so larger factors need a larger noise budget than
+    // the default parameters (N = 8192, q = 60 + 60 + 60) leave.
+    constexpr size_t defaultMaxPackFactor = 16;
+
+    struct TuneOptions {
+        TuneTarget target = TuneTarget::latency;
+        // Candidate polynomial degrees; empty means only the cost model's degree. Degrees
+        // that cannot hold the model's coefficient modulus at securityLevel are skipped.
+        std::vector<size_t> slotCounts;
+        troy::SecurityLevel securityLevel = troy::SecurityLevel::tc128;
+        bool allowPackLwe = true;
+        // See defaultMaxPackFactor.
+        size_t maxPackFactor = defaultMaxPackFactor;
+        // Upper bound on the ciphertexts and prepared weights held by the server, 0 for none.
+        double memoryLimit = 0;
+    };
+
+    // Estimated cost of one evaluation of a linear layer, including the client side.
+    struct LinearCost {
+        double clientTime = 0, serverTime = 0;
+        double bytesSent = 0, bytesReceived = 0;
+        double memory = 0;
+        double latency(const CostModel& model) const {
+            return clientTime + serverTime + (bytesSent + bytesReceived) / model.bandwidth;
+        }
+        double score(const CostModel& model, TuneTarget target) const {
+            return target == TuneTarget::bytes ? bytesSent + bytesReceived : latency(model);
+        }
+    };
+
+    // Cost of a helper that encrypts `sent` operand ciphertexts, multiplies them into
+    // `outputs` results with `terms` accumulated products, and optionally packs the
+    // results by `packFactor` before returning `usefulTerms` coefficients.
+    inline LinearCost linearCost(
+        const CostModel& model, size_t sent, size_t nttCount, size_t outputs, size_t terms,
+        size_t packFactor, size_t usefulTerms, size_t preparedPlains
+    ) {
+        LinearCost cost;
+        size_t returned = outputs;
+        cost.clientTime = sent * model.encrypt;
+        cost.serverTime = model.parallel(nttCount, model.nttCiphertext)
+            + model.parallel(outputs, model.multiplyAccumulateTerm * terms / std::max<size_t>(outputs, 1) + model.inttCiphertext);
+        if (packFactor > 1) {
+            // packCiphertexts spends packFactor - 1 automorphisms on a full group, and
+            // min(r, h) at the level with shift h on a group of r < packFactor.
+            returned = ceilDiv(outputs, packFactor);
+            size_t automorphisms = (outputs / packFactor) * (packFactor - 1);
+            size_t rest = outputs % packFactor;
+            if (rest > 0) {
+                for (size_t h = packFactor / 2; h >= 1; h /= 2) automorphisms += std::min(rest, h);
+            }
+            cost.serverTime += model.parallel(automorphisms, model.automorphism);
+        }
+        cost.clientTime += returned * model.decrypt;
+        cost.bytesSent = model.inputBytes(sent);
+        cost.bytesReceived = model.outputBytes(returned, usefulTerms);
+        cost.memory = model.inputBytes(nttCount + outputs) + double(preparedPlains) * model.polyModulusDegree * model.inputModuli * sizeof(uint64_t);
+        return cost;
+    }
+
+    class MatmulHelper {
+
+        using Plaintext = troy::Plaintext;
+        using Ciphertext = troy::Ciphertext;
+        using GaloisKeys = troy::GaloisKeys;
+
+        size_t batchSize, inputDims, outputDims;
+        size_t slotCount;
+        size_t batchBlock, inputBlock, outputBlock;
+        int objective;
+        bool packLwe;
+        size_t threads;
+        // 0: encrypt inputs; 1: encrypt weights
+        // 2: for calculating weight gradient
+
+        void determineBlock() {
+            size_t bBest = 0, iBest = 0, oBest = 0;
+            size_t cBest = 2147483647;
+            if (!packLwe) {
+                for (size_t b = batchSize; b >= 1; b--) {
+                    size_t bc = ceilDiv(batchSize, b);
+                    if (b >= slotCount) continue;
+                    if (bc * 2 > cBest) continue;
+                    for (size_t i = 1; i < slotCount / b; i++) {
+                        size_t o = slotCount / b / i;
+                        if (o > outputDims) o = outputDims;
+                        if (i > inputDims) continue;
+                        if (o < 1) continue;
+                        size_t c = 0;
+                        if (objective == 0) {
+                            c = bc * (ceilDiv(inputDims, i) + ceilDiv(outputDims, o));
+                        } else if (objective == 1) {
+                            c = (bc + ceilDiv(inputDims, i)) * ceilDiv(outputDims, o);
+                        } else if (objective == 2) {
+                            c = bc * inputDims + (bc + ceilDiv(inputDims, i)) * ceilDiv(outputDims, o);
+                        } else {
+                            throw std::runtime_error("MatmulHelper: invalid objective");
+                        }
+                        if (c >= cBest) continue;
+                        bBest = b; iBest = i; oBest = o; cBest = c;
+                    }
+                }
+            } else {
+                // The input block doubles as the packing factor, so it must be a power of two.
+                double sqrtn = std::pow(slotCount, 0.33);
+                size_t i = 1; while (i * 2 < sqrtn && i * 2 <= defaultMaxPackFactor) {i *= 2;}
+                if (i > inputDims) {
+                    i = 1; while (i < inputDims) i *= 2;
+                }
+                for (size_t b = 1; b <= batchSize; b++) {
+                    size_t bc = ceilDiv(batchSize, b);
+                    if (b > slotCount) continue;
+                    size_t o = slotCount / b / i;
+                    if (o > outputDims) o = outputDims;
+                    if (o < 1) continue;
+                    size_t c = 0;
+                    if (objective == 0) {
+                        c = bc * ceilDiv(inputDims, i);
+                        c += ceilDiv(bc * ceilDiv(outputDims, o), i);
+                    } else if (objective == 1) {
+                        c = ceilDiv(outputDims, o) * ceilDiv(inputDims, i);
+                        c += ceilDiv(bc * ceilDiv(outputDims, o), i);
+                    } else if (objective == 2) {
+                        c = bc * ceilDiv(inputDims, i);
+                        c += ceilDiv(outputDims, o) * ceilDiv(inputDims, i);
+                        c += ceilDiv(bc * ceilDiv(outputDims, o), i);
+                    } else {
+                        throw std::runtime_error("MatmulHelper: invalid objective");
+                    }
+                    if (c >= cBest) continue;
+                    bBest = b; iBest = i; oBest = o; cBest = c;
+                }
+            }
+            batchBlock = bBest;
+            inputBlock = iBest;
+            outputBlock = oBest;
+        }
+
+        LinearCost blockCost(const CostModel& model, size_t b, size_t i, size_t o, bool pack) const {
+            size_t bc = ceilDiv(batchSize, b), ic = ceilDiv(inputDims, i), oc = ceilDiv(outputDims, o);
+            size_t inputs = bc * ic, weights = ic * oc, outputs = bc * oc;
+            size_t sent = (objective == 0) ? inputs : (objective == 1) ? weights : inputs + weights;
+            size_t prepared = (objective == 1) ? inputs : weights;
+            return linearCost(model, sent, sent, outputs, outputs * ic,
+                pack ? i : 1, batchSize * outputDims, prepared);
+        }
+
+        // Searches every degree in options.slotCounts, with and without packing, for the
+        // blocking with the best modelled score. Blocks satisfy b * i * o <= N, and i is a
+        // power of two when packing.
+        void tune(const CostModel& model, const TuneOptions& options) {
+            if (objective < 0 || objective > 2) {
+                throw std::runtime_error("MatmulHelper: invalid objective");
+            }
+            std::vector<size_t> degrees = options.slotCounts;
+            if (degrees.empty()) degrees.push_back(model.polyModulusDegree);
+            double best = 0; bool found = false;
+            for (size_t n: degrees) {
+                if (!model.supportsDegree(n, options.securityLevel)) continue;
+                CostModel scaled = model.scaledTo(n);
+                for (int pack = 0; pack <= (options.allowPackLwe ? 1 : 0); pack++) {
+                    for (size_t b = 1; b <= std::min(batchSize, n); b++) {
+                        for (size_t i = pack ? 2 : 1; i <= n / b; i = pack ? i * 2 : i + 1) {
+                            if (!pack && i > inputDims) break;
+                            if (pack && (i / 2 >= inputDims || i > options.maxPackFactor)) break;
+                            size_t o = std::min(outputDims, n / b / i);
+                            if (o < 1) break;
+                            LinearCost cost = blockCost(scaled, b, i, o, pack);
+                            if (options.memoryLimit > 0 && cost.memory > options.memoryLimit) continue;
+                            double score = cost.score(scaled, options.target);
+                            if (found && score >= best) continue;
+                            found = true; best = score;
+                            slotCount = n; packLwe = pack;
+                            batchBlock = b; inputBlock = i; outputBlock = o;
+                        }
+                    }
+                }
+            }
+            if (!found) {
+                throw std::invalid_argument("MatmulHelper: no blocking satisfies the tuning constraints.");
+            }
+        }
+
+        Plaintext encodeWeightSmall(
+            const troy::BatchEncoder& encoder,
+            const uint64_t* weights,
+            size_t li, size_t ui, size_t lj, size_t uj
+        ) {
+            std::vector<uint64_t> vec(inputBlock * outputBlock, 0);
+            for (size_t j = lj; j < uj; j++) {
+                for (size_t i = li; i < ui; i++) {
+                    size_t r = (j-lj) * inputBlock + inputBlock - (i-li) - 1;
+                    assert(r < slotCount);
+                    vec[r] = weights[i * outputDims + j];
+                }
+            }
+            Plaintext ret;
+            encoder.encodePolynomial(vec, ret);
+            return ret;
+        }
+
+        // Calls f(i, j, index, packedId) for every output element, where `index` is its
+        // coefficient in output ciphertext packedId (packed layout if packLwe is set).
+        template <typename F>
+        void forEachOutputTerm(F&& f) const {
+            size_t outputBlockCount = ceilDiv(outputDims, outputBlock);
+            size_t di = 0;
+            for (size_t li = 0; li < batchSize; li += batchBlock, di++) {
+                size_t ui = std::min(batchSize, li + batchBlock);
+                size_t dj = 0;
+                for (size_t lj = 0; lj < outputDims; lj += outputBlock, dj++) {
+                    size_t uj = std::min(outputDims, lj + outputBlock);
+                    size_t cipherId = di * outputBlockCount + dj;
+                    size_t packedId = packLwe ? cipherId / inputBlock : cipherId;
+                    size_t offset = packLwe ? cipherId % inputBlock : inputBlock - 1;
+                    for (size_t i = li; i < ui; i++)
+                        for (size_t j = lj; j < uj; j++)
+                            f(i, j, (i - li) * inputBlock * outputBlock + (j - lj) * inputBlock + offset, packedId);
+                }
+            }
+        }
+
+        size_t outputCipherCount() const {
+            size_t count = ceilDiv(batchSize, batchBlock) * ceilDiv(outputDims, outputBlock);
+            return packLwe ? ceilDiv(count, inputBlock) : count;
+        }
+
+        // Output ciphertexts are laid out (batch block, output block) unless packed,
+        // in which case they form a single row.
+        const Ciphertext& outputAt(const Cipher2d& x, size_t id) const {
+            if (packLwe) return x[0][id];
+            size_t cols = ceilDiv(outputDims, outputBlock);
+            return x[id / cols][id % cols];
+        }
+
+        std::vector<std::vector<size_t>> outputTerms() const {
+            std::vector<std::vector<size_t>> terms(outputCipherCount());
+            forEachOutputTerm([&](size_t, size_t, size_t index, size_t id) {
+                terms[id].push_back(index);
+            });
+            return terms;
+        }
+
+        Cipher2d outputShape() const {
+            Cipher2d ret;
+            if (packLwe) {
+                ret.data.resize(1);
+                ret[0].resize(outputCipherCount());
+            } else {
+                ret.data.resize(ceilDiv(batchSize, batchBlock));
+                for (auto& row: ret.data) row.resize(ceilDiv(outputDims, outputBlock));
+            }
+            return ret;
+        }
+
+        void checkShapes(size_t aRows, size_t wRows) {
+            if (aRows != ceilDiv(batchSize, batchBlock)) {
+                throw std::invalid_argument("Input batchsize incorrect.");
+            }
+            if (wRows != ceilDiv(inputDims, inputBlock)) {
+                throw std::invalid_argument("Weight input dimension incorrect.");
+            }
+        }
+
+        Cipher2d matmulCipherInternal(const troy::Evaluator& evaluator, const Cipher2d& a, const Cipher2d& w, const troy::RelinKeys* rlk) {
+            checkShapes(a.data.size(), w.data.size());
+            size_t outputVectorCount = ceilDiv(outputDims, outputBlock);
+            auto aExtended = extendToBehzNtt(evaluator, a, threads);
+            auto wExtended = extendToBehzNtt(evaluator, w, threads);
+            return multiplyAccumulateBehz(evaluator, aExtended, outputVectorCount,
+                [&](size_t i, size_t j) -> const troy::BehzCiphertext& {return wExtended[i][j];}, rlk, threads);
+        }
+
+    public:
+
+        // With packLwe set, results must go through packOutputs before they are
+        // post-processed with encodeOutputs, decryptOutputs or serializeOutputs.
+        MatmulHelper(size_t batchSize, size_t inputDims, size_t outputDims, size_t slotCount, int objective = 0, bool packLwe = false, size_t threads = defaultThreadCount()):
+            batchSize(batchSize), inputDims(inputDims), outputDims(outputDims),
+            slotCount(slotCount), objective(objective), packLwe(packLwe), threads(threads)
+        {
+            determineBlock();
+        }
+
+        // Chooses the polynomial degree, packing and blocking that minimize the modelled
+        // latency or bytes sent (see CostModel). The encryption parameters must then use
+        // getSlotCount() as the degree, and results must be packed if getPackLwe() is set.
+        // If getSlotCount() differs from the degree the model was calibrated at, the context
+        // and keys have to be rebuilt at that degree, with a coefficient modulus of the same
+        // bit sizes, before the helper is used.
+        MatmulHelper(size_t batchSize, size_t inputDims, size_t outputDims, const CostModel& model, const TuneOptions& options = TuneOptions(), int objective = 0):
+            batchSize(batchSize), inputDims(inputDims), outputDims(outputDims),
+            slotCount(0), objective(objective), packLwe(false), threads(model.threads)
+        {
+            tune(model, options);
+        }
+
+        void setThreadCount(size_t count) {threads = count == 0 ? 1 : count;}
+        size_t threadCount() const {return threads;}
+        size_t getSlotCount() const {return slotCount;}
+        bool getPackLwe() const {return packLwe;}
+
+        // Modelled cost of one evaluation with the current blocking.
+        LinearCost estimate(const CostModel& model) const {
+            return blockCost(model.scaledTo(slotCount), batchBlock, inputBlock, outputBlock, packLwe);
+        }
+
+        Plain2d encodeWeights(
+            const troy::BatchEncoder& encoder,
+            const uint64_t* weights
+        ) {
+            size_t height = inputDims, width = outputDims;
+            size_t h = inputBlock, w = outputBlock;
+            size_t rows = ceilDiv(height, h), cols = ceilDiv(width, w);
+            Plain2d encodedWeights;
+            encodedWeights.data.assign(rows, std::vector<Plaintext>(cols));
+            parallelFor(rows * cols, threads, [&](size_t k) {
+                size_t li = k / cols * h, lj = k % cols * w;
+                size_t ui = (li + h > height) ? height : (li + h);
+                size_t uj = (lj + w > width) ? width : (lj + w);
+                encodedWeights[k / cols][k % cols] = encodeWeightSmall(encoder, weights, li, ui, lj, uj);
+            });
+            return encodedWeights;
+        }
+
+        // Encodes the weights and lifts them into the NTT domain at `parmsID`,
+        // which is what matmul consumes directly.
+        Plain2d encodeWeights(
+            const troy::BatchEncoder& encoder,
+            const troy::Evaluator& evaluator,
+            const uint64_t* weights,
+            troy::ParmsID parmsID
+        ) {
+            Plain2d ret = encodeWeights(encoder, weights);
+            ret.transformToNttInplace(evaluator, parmsID, threads);
+            return ret;
+        }
+
+        // Cache key of the encoded weights: layerKey combined with everything that
+        // determines their encoding.
+        uint64_t weightCacheKey(uint64_t layerKey) const {
+            return WeightCache::hash(std::vector<uint64_t>{
+                layerKey, slotCount, inputDims, outputDims, inputBlock, outputBlock
+            });
+        }
+
+        // Same as above, but reuses the weight cache at cachePath if it was written for the
+        // same weights, layerKey, blocking and level, and (re)writes it otherwise. The weight
+        // values are hashed into the key, so changed weights are re-encoded even if layerKey
+        // stays the same; layerKey only has to tell apart layers sharing a cache path.
+        Plain2d encodeWeights(
+            const troy::BatchEncoder& encoder,
+            const troy::Evaluator& evaluator,
+            const uint64_t* weights,
+            troy::ParmsID parmsID,
+            const std::string& cachePath,
+            uint64_t layerKey
+        ) {
+            Plain2d ret;
+            uint64_t key = weightCacheKey(WeightCache::hash(weights, inputDims * outputDims * sizeof(uint64_t), layerKey));
+            size_t rows = ceilDiv(inputDims, inputBlock), cols = ceilDiv(outputDims, outputBlock);
+            if (WeightCache::load(cachePath, key, parmsID, rows, cols, ret, threads)) return ret;
+            ret = encodeWeights(encoder, evaluator, weights, parmsID);
+            WeightCache::save(cachePath, key, parmsID, ret);
+            return ret;
+        }
+
+        Plain2d encodeInputs(
+            const troy::BatchEncoder& encoder,
+            const uint64_t* inputs
+        ) {
+            size_t vecsize = inputBlock;
+            size_t rows = ceilDiv(batchSize, batchBlock), cols = ceilDiv(inputDims, vecsize);
+            Plain2d ret;
+            ret.data.assign(rows, std::vector<Plaintext>(cols));
+            parallelFor(rows * cols, threads, [&](size_t k) {
+                size_t li = k / cols * batchBlock, lj = k % cols * vecsize;
+                size_t ui = (li + batchBlock > batchSize) ? batchSize : li + batchBlock;
+                size_t uj = (lj + vecsize > inputDims) ? inputDims : lj + vecsize;
+                std::vector<uint64_t> vec(slotCount, 0);
+                for (size_t i = li; i < ui; i++)
+                    for (size_t j = lj; j < uj; j++)
+                        vec[(i - li) * inputBlock * outputBlock + (j - lj)] = inputs[i * inputDims + j];
+                encoder.encodePolynomial(vec, ret[k / cols][k % cols]);
+            });
+            return ret;
+        }
+
+        Cipher2d encryptInputs(
+            const troy::Encryptor& encryptor,
+            const troy::BatchEncoder& encoder,
+            const uint64_t* inputs
+        ) {
+            Plain2d plain = encodeInputs(encoder, inputs);
+            return plain.encrypt(encryptor, threads);
+        }
+
+        // Each input ciphertext is transformed to NTT once and each output is one fused
+        // multiply-accumulate over the input blocks; the (batch, output) blocks run in parallel.
+        Cipher2d matmul(const troy::Evaluator& evaluator, const Cipher2d& a, const Plain2d& w) {
+            checkShapes(a.data.size(), w.data.size());
+            size_t outputVectorCount = ceilDiv(outputDims, outputBlock);
+            Cipher2d aNtt = a.toNtt(evaluator, threads);
+            Plain2d buffer;
+            const Plain2d& wNtt = preparePlain2d(evaluator, w, firstParmsID(aNtt), buffer, threads);
+            Cipher2d ret = multiplyAccumulateNtt(evaluator, aNtt, outputVectorCount,
+                [&](size_t i, size_t j) -> const Plaintext& {return wNtt[i][j];}, threads);
+            if (!a[0][0].isNttForm()) {
+                ret.forEach(threads, [&](Ciphertext& c, size_t, size_t) {
+                    evaluator.transformFromNttInplace(c);
+                });
+            }
+            return ret;
+        }
+
+        // Every input and weight ciphertext is base-extended and transformed to NTT once; each
+        // output accumulates its tensor products in that domain and is scaled down once.
+        // The outputs have size 3 unless relinearized with matmulCipher(..., rlk).
+        Cipher2d matmulCipher(const troy::Evaluator& evaluator, const Cipher2d& a, const Cipher2d& w) {
+            return matmulCipherInternal(evaluator, a, w, nullptr);
+        }
+
+        Cipher2d matmulCipher(const troy::Evaluator& evaluator, const Cipher2d& a, const Cipher2d& w, const troy::RelinKeys& rlk) {
+            return matmulCipherInternal(evaluator, a, w, &rlk);
+        }
+
+        Cipher2d matmulReverse(const troy::Evaluator& evaluator, const Plain2d& a, const Cipher2d& w) {
+            checkShapes(a.data.size(), w.data.size());
+            size_t outputVectorCount = ceilDiv(outputDims, outputBlock);
+            size_t inputVectorCount = w.data.size();
+            Cipher2d wNtt = w.toNtt(evaluator, threads);
+            Plain2d buffer;
+            const Plain2d& aNtt = preparePlain2d(evaluator, a, firstParmsID(wNtt), buffer, threads);
+            // Transpose the roles: iterate over the input blocks of the plaintext batch
+            // while the encrypted weights are shared across the batch.
+            size_t batchCount = a.data.size();
+            Cipher2d ret; ret.data.resize(batchCount);
+            for (size_t b = 0; b < batchCount; b++) ret.data[b].resize(outputVectorCount);
+            ret.forEach(threads, [&](Ciphertext& out, size_t b, size_t j) {
+                std::vector<const Ciphertext*> encrypteds(inputVectorCount);
+                std::vector<const Plaintext*> plains(inputVectorCount);
+                for (size_t i = 0; i < inputVectorCount; i++) {
+                    encrypteds[i] = &wNtt[i][j];
+                    plains[i] = &aNtt[b][i];
+                }
+                evaluator.multiplyPlainAccumulate(encrypteds, plains, out);
+                if (!w[0][0].isNttForm()) evaluator.transformFromNttInplace(out);
+            });
+            return ret;
+        }
+
+        Plain2d encodeOutputs(
+            const troy::BatchEncoder& encoder,
+            const uint64_t* outputs
+        ) {
+            std::vector<std::vector<uint64_t>> buffers(outputCipherCount(), std::vector<uint64_t>(slotCount, 0));
+            forEachOutputTerm([&](size_t i, size_t j, size_t index, size_t id) {
+                buffers[id][index] = outputs[i * outputDims + j];
+            });
+            Cipher2d shape = outputShape();
+            Plain2d ret; ret.data.resize(shape.data.size());
+            size_t id = 0;
+            for (size_t r = 0; r < shape.data.size(); r++) {
+                ret[r].resize(shape[r].size());
+                for (size_t c = 0; c < shape[r].size(); c++) {
+                    encoder.encodePolynomial(buffers[id++], ret[r][c]);
+                }
+            }
+            return ret;
+        }
+
+        std::vector<uint64_t> decryptOutputs(
+            const troy::BatchEncoder& encoder,
+            troy::Decryptor& decryptor,
+            const Cipher2d& outputs
+        ) {
+            std::vector<uint64_t> dec(batchSize * outputDims);
+            std::vector<std::vector<uint64_t>> buffers(outputCipherCount());
+            Plaintext pt;
+            for (size_t id = 0; id < buffers.size(); id++) {
+                decryptor.decrypt(outputAt(outputs, id), pt);
+                encoder.decodePolynomial(pt, buffers[id]);
+                buffers[id].resize(slotCount, 0);
+            }
+            forEachOutputTerm([&](size_t i, size_t j, size_t index, size_t id) {
+                dec[i * outputDims + j] = buffers[id][index];
+            });
+            return dec;
+        }
+
+        // Merges every inputBlock result ciphertexts into one (see packCiphertexts), which
+        // divides the response size and the client's decryption work by inputBlock.
+        Cipher2d packOutputs(const troy::Evaluator& evaluator, const GaloisKeys& autoKey, const Cipher2d& cipher) {
+            if (!this->packLwe) {
+                throw std::invalid_argument("PackLWE not enabled");
+            }
+            std::vector<const Ciphertext*> ciphers;
+            for (auto& row: cipher.data)
+                for (auto& c: row) ciphers.push_back(&c);
+            if (ciphers.size() != ceilDiv(batchSize, batchBlock) * ceilDiv(outputDims, outputBlock)) {
+                throw std::invalid_argument("Output ciphertext count incorrect");
+            }
+            Cipher2d ret; ret.data.push_back(packCiphertexts(evaluator, autoKey, ciphers, inputBlock, threads));
+            return ret;
+        }
+
+        void serializeEncodedWeights(const Plain2d& w, std::ostream& stream) {
+            size_t rows = w.data.size();
+            if (rows == 0) throw std::invalid_argument("No rows in weight matrix.");
+            size_t cols = w[0].size();
+            if (cols == 0) throw std::invalid_argument("No columns in weight matrix.");
+            for (size_t i=0; i<rows; i++) {
+                if (w[i].size() != cols) throw std::invalid_argument("Weight matrix is not rectangular.");
+            }
+            savet(stream, &rows);
+            savet(stream, &cols);
+            for (size_t i = 0; i < rows; i++) {
+                for (size_t j = 0; j < cols; j++) {
+                    w[i][j].save(stream);
+                }
+            }
+        }
+
+        Plain2d deserializeEncodedWeights(std::istream& stream) {
+            size_t rows, cols;
+            loadt(stream, &rows);
+            loadt(stream, &cols);
+            Plain2d ret; ret.data.reserve(rows);
+            for (size_t i = 0; i < rows; i++) {
+                std::vector<Plaintext> row; row.reserve(cols);
+                for (size_t j = 0; j < cols; j++) {
+                    Plaintext pt;
+                    pt.load(stream);
+                    row.push_back(std::move(pt));
+                }
+                ret.data.push_back(std::move(row));
+            }
+            return ret;
+        }
+
+        void serializeOutputs(const troy::Evaluator& evaluator, const Cipher2d& x, std::ostream& stream) {
+            auto terms = outputTerms();
+            if (packLwe && (x.data.size() != 1 || x[0].size() != terms.size())) {
+                throw std::invalid_argument("Output ciphertext count incorrect");
+            }
+            for (size_t id = 0; id < terms.size(); id++) {
+                outputAt(x, id).saveTerms(stream, evaluator, terms[id]);
+            }
+        }
+
+        Cipher2d deserializeOutputs(const troy::Evaluator& evaluator, std::istream& stream) {
+            auto terms = outputTerms();
+            Cipher2d ret = outputShape();
+            size_t id = 0;
+            for (auto& row: ret.data) {
+                for (auto& c: row) {
+                    c.loadTerms(stream, evaluator, terms[id++]);
+                }
+            }
+            return ret;
+        }
+
+        // Streaming counterparts of serializeOutputs/deserializeOutputs with the same compact
+        // encoding: output ciphertexts may be written as soon as they are finished, and the
+        // client can decrypt each chunk as it arrives. Positions follow outputShape().
+        StreamWriter outputStreamWriter(const troy::Evaluator& evaluator, std::ostream& stream) const {
+            Cipher2d shape = outputShape();
+            return StreamWriter(stream, evaluator, shape.data.size(), shape[0].size(), outputTerms(), threads);
+        }
+
+        StreamReader outputStreamReader(const troy::Evaluator& evaluator, std::istream& stream) const {
+            return StreamReader(stream, evaluator, outputTerms(), threads);
+        }
+
+    };
+
+    class Conv2dHelper {
+
+        using Plaintext = troy::Plaintext;
+        using Ciphertext = troy::Ciphertext;
+
+        size_t batchSize;
+        size_t blockHeight, blockWidth, kernelHeight, kernelWidth;
+        size_t imageHeight, imageWidth;
+        size_t inputChannels, outputChannels;
+        size_t blockBatch, blockInputChannels, blockOutputChannels;
+        size_t slotCount;
+        int objective;
+        bool packLwe;
+        size_t threads;
+
+        // Coefficient of (batch b, output channel c, spatial offset s, input channel slot k)
+        // in a block polynomial. Packing interleaves the input channel slots innermost, so
+        // that all outputs (slot blockInputChannels - 1) share one residue modulo
+        // blockInputChannels; cross-channel products still never land on an output slot.
+        size_t slotIndex(size_t b, size_t c, size_t s, size_t k) const {
+            size_t blockSize = blockHeight * blockWidth;
+            if (packLwe) return ((b * blockOutputChannels + c) * blockSize + s) * blockInputChannels + k;
+            return (b * blockInputChannels * blockOutputChannels + c * blockInputChannels + k) * blockSize + s;
+        }
+
+        // Calls f(originalIndex, index, cipherId) for every output element, where `index` is
+        // its coefficient in output ciphertext cipherId (packed layout if packLwe is set).
+        template <typename F>
+        void forEachOutputTerm(F&& f) const {
+            size_t totalBatchSize = getTotalBatchSize();
+            size_t groupLen = ceilDiv(outputChannels, blockOutputChannels);
+            size_t yh = blockHeight - kernelHeight + 1;
+            size_t yw = blockWidth  - kernelWidth  + 1;
+            size_t oyh = imageHeight - kernelHeight + 1;
+            size_t oyw = imageWidth - kernelWidth + 1;
+            size_t kh = kernelHeight - 1, kw = kernelWidth - 1;
+            size_t sh = ceilDiv(imageHeight - kh, blockHeight - kh);
+            size_t sw = ceilDiv(imageWidth - kw, blockWidth - kw);
+            for (size_t eb = 0; eb < totalBatchSize; eb++) {
+                size_t ob = eb / (sh * sw);
+                size_t si = (eb % (sh * sw)) / sw;
+                size_t sj = eb % sw;
+                size_t lb = ob * blockBatch, ub = std::min(lb + blockBatch, batchSize);
+                for (size_t lc = 0; lc < outputChannels; lc += blockOutputChannels) {
+                    size_t uc = std::min(lc + blockOutputChannels, outputChannels);
+                    size_t cipherId = eb * groupLen + lc / blockOutputChannels;
+                    size_t packedId = packLwe ? cipherId / blockInputChannels : cipherId;
+                    size_t offset = packLwe ? cipherId % blockInputChannels : blockInputChannels - 1;
+                    for (size_t b = lb; b < ub; b++) {
+                        for (size_t c = lc; c < uc; c++) {
+                            for (size_t i = 0; i < yh; i++) {
+                                for (size_t j = 0; j < yw; j++) {
+                                    if (si * yh + i >= oyh || sj * yw + j >= oyw) continue;
+                                    size_t maskIndex = slotIndex(b - lb, c - lc, (blockHeight - yh + i) * blockWidth + (blockWidth - yw + j), offset);
+                                    size_t originalIndex = b * outputChannels * oyh * oyw + c * oyh * oyw + (si * yh + i) * oyw + (sj * yw + j);
+                                    f(originalIndex, maskIndex, packedId);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        size_t outputCipherCount() const {
+            size_t count = getTotalBatchSize() * ceilDiv(outputChannels, blockOutputChannels);
+            return packLwe ? ceilDiv(count, blockInputChannels) : count;
+        }
+
+        const Ciphertext& outputAt(const Cipher2d& x, size_t id) const {
+            if (packLwe) return x[0][id];
+            size_t cols = ceilDiv(outputChannels, blockOutputChannels);
+            return x[id / cols][id % cols];
+        }
+
+        std::vector<std::vector<size_t>> outputTerms() const {
+            std::vector<std::vector<size_t>> terms(outputCipherCount());
+            forEachOutputTerm([&](size_t, size_t index, size_t id) {
+                terms[id].push_back(index);
+            });
+            return terms;
+        }
+
+        Cipher2d outputShape() const {
+            Cipher2d ret;
+            if (packLwe) {
+                ret.data.resize(1);
+                ret[0].resize(outputCipherCount());
+            } else {
+                ret.data.resize(getTotalBatchSize());
+                for (auto& row: ret.data) row.resize(ceilDiv(outputChannels, blockOutputChannels));
+            }
+            return ret;
+        }
+
+        // Calls f(b, h, w, ci, co) for every candidate block shape with b * h * w * ci * co <= n,
+        // taking the largest input channel block that fits (when packing, the largest power
+        // of two up to maxPack).
+        template <typename F>
+        void forEachBlocking(size_t n, bool pack, size_t maxPack, F&& f) const {
+            for (size_t b = std::min(batchSize, n); b >= 1; b--) {
+                for (size_t h = std::min(imageHeight, n / b); h >= kernelHeight; h--) {
+                    for (size_t w = std::min(imageWidth, n / b / h); w >= kernelWidth; w--) {
+                        for (size_t co = std::min(outputChannels, n / b / h / w); co >= 1; co--) {
+                            size_t available = n / b / h / w / co;
+                            size_t ci = std::min(available, inputChannels);
+                            if (pack && ci > 0) {
+                                // The input channel block doubles as the packing factor.
+                                ci = 1; while (ci * 2 <= std::min(available, maxPack) && ci < inputChannels) ci *= 2;
+                            }
+                            if (ci == 0) continue;
+                            f(b, h, w, ci, co);
+                        }
+                    }
+                }
+            }
+        }
+
+        size_t blockCount(size_t b, size_t h, size_t w) const {
+            return ceilDiv(batchSize, b) *
+                ceilDiv(imageHeight - kernelHeight + 1, h - kernelHeight + 1) *
+                ceilDiv(imageWidth - kernelWidth + 1, w - kernelWidth + 1);
+        }
+
+        void setBlocking(size_t b, size_t h, size_t w, size_t ci, size_t co) {
+            blockBatch = b;
+            blockHeight = h;
+            blockWidth = w;
+            blockInputChannels = ci;
+            blockOutputChannels = co;
+        }
+
+        // Minimizes the ciphertext count selected by the objective.
+        void determineBlock() {
+            if (objective < 0 || objective > 2) {
+                throw std::runtime_error("Conv2dHelper: invalid objective");
+            }
+            size_t best = 2147483647;
+            // find b, h, w, ci, co, such that minimizes (ceil(B/b)*ceil((H-kh+1)/(h-kh+1))*ceil((W-kh+1)/(h-kh+1))*(ceil(Ci/ci)+ceil(Co/co)))
+            forEachBlocking(slotCount, packLwe, defaultMaxPackFactor, [&](size_t b, size_t h, size_t w, size_t ci, size_t co) {
+                size_t blocks = blockCount(b, h, w);
+                size_t inputCipherSize = blocks * ceilDiv(inputChannels, ci);
+                size_t outputCipherSize = blocks * ceilDiv(outputChannels, co);
+                if (packLwe) outputCipherSize = ceilDiv(outputCipherSize, ci);
+                size_t weightCipherSize = ceilDiv(inputChannels, ci) * ceilDiv(outputChannels, co);
+                size_t current = 0;
+                if (objective == 0) {
+                    current = inputCipherSize + outputCipherSize;
+                } else if (objective == 1) {
+                    current = weightCipherSize + outputCipherSize;
+                } else {
+                    current = outputCipherSize + inputCipherSize + weightCipherSize;
+                }
+                if (current < best) {
+                    best = current;
+                    setBlocking(b, h, w, ci, co);
+                }
+            });
+        }
+
+        LinearCost blockCost(const CostModel& model, size_t b, size_t h, size_t w, size_t ci, size_t co, bool pack) const {
+            size_t blocks = blockCount(b, h, w);
+            size_t cic = ceilDiv(inputChannels, ci), coc = ceilDiv(outputChannels, co);
+            size_t inputs = blocks * cic, weights = cic * coc, outputs = blocks * coc;
+            size_t sent = (objective == 0) ? inputs : (objective == 1) ? weights : inputs + weights;
+            size_t prepared = (objective == 1) ? inputs : weights;
+            size_t useful = batchSize * outputChannels * (imageHeight - kernelHeight + 1) * (imageWidth - kernelWidth + 1);
+            return linearCost(model, sent, sent, outputs, outputs * cic, pack ? ci : 1, useful, prepared);
+        }
+
+        void tune(const CostModel& model, const TuneOptions& options) {
+            if (objective < 0 || objective > 2) {
+                throw std::runtime_error("Conv2dHelper: invalid objective");
+            }
+            std::vector<size_t> degrees = options.slotCounts;
+            if (degrees.empty()) degrees.push_back(model.polyModulusDegree);
+            double best = 0; bool found = false;
+            for (size_t n: degrees) {
+                if (!model.supportsDegree(n, options.securityLevel)) continue;
+                CostModel scaled = model.scaledTo(n);
+                for (int pack = 0; pack <= (options.allowPackLwe ? 1 : 0); pack++) {
+                    forEachBlocking(n, pack, options.maxPackFactor, [&](size_t b, size_t h, size_t w, size_t ci, size_t co) {
+                        if (pack && ci == 1) return;
+                        LinearCost cost = blockCost(scaled, b, h, w, ci, co, pack);
+                        if (options.memoryLimit > 0 && cost.memory > options.memoryLimit) return;
+                        double score = cost.score(scaled, options.target);
+                        if (found && score >= best) return;
+                        found = true; best = score;
+                        slotCount = n; packLwe = pack;
+                        setBlocking(b, h, w, ci, co);
+                    });
+                }
+            }
+            if (!found) {
+                throw std::invalid_argument("Conv2dHelper: no blocking satisfies the tuning constraints.");
+            }
+        }
+
+        Cipher2d conv2dCipherInternal(const troy::Evaluator& evaluator, const Cipher2d& a, const Cipher2d& encodedWeights, const troy::RelinKeys* rlk) {
+            size_t groupLen = ceilDiv(outputChannels, blockOutputChannels);
+            auto aExtended = extendToBehzNtt(evaluator, a, threads);
+            auto wExtended = extendToBehzNtt(evaluator, encodedWeights, threads);
+            return multiplyAccumulateBehz(evaluator, aExtended, groupLen,
+                [&](size_t i, size_t oc) -> const troy::BehzCiphertext& {return wExtended[oc][i];}, rlk, threads);
+        }
+
+    public:
+
+        Conv2dHelper(
+            size_t batchSize,
+            size_t imageHeight, size_t imageWidth,
+            size_t kernelHeight, size_t kernelWidth,
+            size_t inputChannels, size_t outputChannels,
+            size_t slotCount, int objective = 0,
+            bool packLwe = false,
+            size_t threads = defaultThreadCount()
+        ):
+            batchSize(batchSize),
+            kernelHeight(kernelHeight),
+            kernelWidth(kernelWidth),
+            imageHeight(imageHeight),
+            imageWidth(imageWidth),
+            inputChannels(inputChannels),
+            outputChannels(outputChannels),
+            slotCount(slotCount),
+            objective(objective),
+            packLwe(packLwe),
+            threads(threads)
+        {
+            determineBlock();
+        }
+
+        // Chooses the polynomial degree, packing and blocking that minimize the modelled
+        // latency or bytes sent; see MatmulHelper's tuning constructor.
+        Conv2dHelper(
+            size_t batchSize,
+            size_t imageHeight, size_t imageWidth,
+            size_t kernelHeight, size_t kernelWidth,
+            size_t inputChannels, size_t outputChannels,
+            const CostModel& model, const TuneOptions& options = TuneOptions(),
+            int objective = 0
+        ):
+            batchSize(batchSize),
+            kernelHeight(kernelHeight),
+            kernelWidth(kernelWidth),
+            imageHeight(imageHeight),
+            imageWidth(imageWidth),
+            inputChannels(inputChannels),
+            outputChannels(outputChannels),
+            slotCount(0),
+            objective(objective),
+            packLwe(false),
+            threads(model.threads)
+        {
+            tune(model, options);
+        }
+
+        void setThreadCount(size_t count) {threads = count == 0 ? 1 : count;}
+        size_t threadCount() const {return threads;}
+        size_t getSlotCount() const {return slotCount;}
+        bool getPackLwe() const {return packLwe;}
+
+        // Modelled cost of one evaluation with the current blocking.
+        LinearCost estimate(const CostModel& model) const {
+            return blockCost(model.scaledTo(slotCount), blockBatch, blockHeight, blockWidth,
+                blockInputChannels, blockOutputChannels, packLwe);
+        }
+
+        Plain2d encodeWeights(
+            const troy::BatchEncoder& encoder,
+            const std::vector<uint64_t>& weights
+        ) {
+            if (weights.size() != inputChannels * outputChannels * kernelHeight * kernelWidth) {
+                throw std::invalid_argument("Weights shape incorrect.");
+            }
+            size_t rows = ceilDiv(outputChannels, blockOutputChannels);
+            size_t cols = ceilDiv(inputChannels, blockInputChannels);
+            Plain2d encodedWeights;
+            encodedWeights.data.assign(rows, std::vector<Plaintext>(cols));
+            parallelFor(rows * cols, threads, [&](size_t k) {
+                size_t loc = k / cols * blockOutputChannels, lic = k % cols * blockInputChannels;
+                size_t uoc = std::min(loc + blockOutputChannels, outputChannels);
+                size_t uic = std::min(lic + blockInputChannels, inputChannels);
+                std::vector<uint64_t> spread(slotIndex(0, blockOutputChannels, 0, 0), 0);
+                for (size_t oc = loc; oc < uoc; oc++) {
+                    for (size_t ic = lic; ic < uic; ic++) {
+                        for (size_t ki = 0; ki < kernelHeight; ki++) {
+                            for (size_t kj = 0; kj < kernelWidth; kj++) {
+                                // spread[channel_slots - 1 - (j - lic), :k_h, :k_w] = np.flip(weight[oc, j])
+                                size_t spreadIndex = slotIndex(0, oc - loc, ki * blockWidth + kj, blockInputChannels - 1 - (ic - lic));
+                                size_t weightIndex = ((oc * inputChannels) + ic) * (kernelHeight * kernelWidth) + (kernelHeight - ki - 1) * kernelWidth + (kernelWidth - kj - 1);
+                                spread[spreadIndex] = weights[weightIndex];
+                            }
+                        }
+                    }
+                }
+                encoder.encodePolynomial(spread, encodedWeights[k / cols][k % cols]);
+            });
+            return encodedWeights;
+        }
+
+        // Encodes the weights and lifts them into the NTT domain at `parmsID`,
+        // which is what conv2d consumes directly.
+        Plain2d encodeWeights(
+            const troy::BatchEncoder& encoder,
+            const troy::Evaluator& evaluator,
+            const std::vector<uint64_t>& weights,
+            troy::ParmsID parmsID
+        ) {
+            Plain2d ret = encodeWeights(encoder, weights);
+            ret.transformToNttInplace(evaluator, parmsID, threads);
+            return ret;
+        }
+
+        // See MatmulHelper::weightCacheKey.
+        uint64_t weightCacheKey(uint64_t layerKey) const {
+            return WeightCache::hash(std::vector<uint64_t>{
+                layerKey, slotCount, inputChannels, outputChannels, kernelHeight, kernelWidth,
+                blockHeight, blockWidth, blockInputChannels, blockOutputChannels, packLwe
+            });
+        }
+
+        // See MatmulHelper::encodeWeights with a cache path.
+        Plain2d encodeWeights(
+            const troy::BatchEncoder& encoder,
+            const troy::Evaluator& evaluator,
+            const std::vector<uint64_t>& weights,
+            troy::ParmsID parmsID,
+            const std::string& cachePath,
+            uint64_t layerKey
+        ) {
+            Plain2d ret;
+            uint64_t key = weightCacheKey(WeightCache::hash(weights, layerKey));
+            size_t rows = ceilDiv(outputChannels, blockOutputChannels), cols = ceilDiv(inputChannels, blockInputChannels);
+            if (WeightCache::load(cachePath, key, parmsID, rows, cols, ret, threads)) return ret;
+            ret = encodeWeights(encoder, evaluator, weights, parmsID);
+            WeightCache::save(cachePath, key, parmsID, ret);
+            return ret;
+        }
+
+        size_t getTotalBatchSize() const {
+            size_t kh = kernelHeight - 1, kw = kernelWidth - 1;
+            size_t sh = ceilDiv(imageHeight - kh, blockHeight - kh);
+            size_t sw = ceilDiv(imageWidth - kw, blockWidth - kw);
+            return ceilDiv(batchSize, blockBatch) * sh * sw;
+        }
+
+        Plain2d encodeInputs(
+            const troy::BatchEncoder& encoder,
+            const std::vector<uint64_t>& inputs
+        ) {
+            if (inputs.size() != batchSize * inputChannels * imageHeight * imageWidth) {
+                throw std::invalid_argument("Inputs shape incorrect.");
+            }
+            size_t kh = kernelHeight - 1, kw = kernelWidth - 1;
+            size_t sh = ceilDiv(imageHeight - kh, blockHeight - kh);
+            size_t sw = ceilDiv(imageWidth - kw, blockWidth - kw);
+            size_t imageSize = imageHeight * imageWidth;
+            size_t totalBatchSize = ceilDiv(batchSize, blockBatch) * sh * sw;
+            size_t cols = ceilDiv(inputChannels, blockInputChannels);
+            Plain2d ret; ret.data.assign(totalBatchSize, std::vector<Plaintext>(cols));
+            // Rows are ordered (batch block, block row, block column).
+            parallelFor(totalBatchSize * cols, threads, [&](size_t k) {
+                size_t row = k / cols, lci = k % cols * blockInputChannels;
+                size_t lb = row / (sh * sw) * blockBatch, ih = row / sw % sh, iw = row % sw;
+                size_t ub = std::min(lb + blockBatch, batchSize);
+                size_t uci = std::min(lci + blockInputChannels, inputChannels);
+                size_t si = ih * (blockHeight - kh);
+                size_t sj = iw * (blockWidth - kw);
+                size_t ui = std::min(si + blockHeight, imageHeight);
+                size_t uj = std::min(sj + blockWidth, imageWidth);
+                std::vector<uint64_t> vec(slotCount, 0);
+                for (size_t b = 0; b < ub-lb; b++) {
+                    for (size_t tci = 0; tci < uci-lci; tci++) {
+                        for (size_t ti = si; ti < ui; ti++) {
+                            for (size_t tj = sj; tj < uj; tj++) {
+                                size_t inputIndex = (lb + b) * inputChannels * imageSize + (lci + tci) * imageSize + ti * imageWidth + tj;
+                                size_t vecIndex = slotIndex(b, 0, (ti - si) * blockWidth + (tj - sj), tci);
+                                vec[vecIndex] = inputs[inputIndex];
+                            }
+                        }
+                    }
+                }
+                encoder.encodePolynomial(vec, ret[row][k % cols]);
+            });
+            return ret;
+        }
+
+        Cipher2d encryptInputs(
+            const troy::Encryptor& encryptor,
+            const troy::BatchEncoder& encoder,
+            const std::vector<uint64_t>& inputs
+        ) {
+            Plain2d plain = encodeInputs(encoder, inputs);
+            return plain.encrypt(encryptor, threads);
+        }
+
+        // See MatmulHelper::matmul; parallel over (image block, output channel block).
+        Cipher2d conv2d(const troy::Evaluator& evaluator, const Cipher2d& a, const Plain2d& encodedWeights) {
+            size_t groupLen = ceilDiv(outputChannels, blockOutputChannels);
+            if (a.data.size() != getTotalBatchSize()) {
+                throw std::invalid_argument("Input batchsize incorrect.");
+            }
+            Cipher2d aNtt = a.toNtt(evaluator, threads);
+            Plain2d buffer;
+            const Plain2d& wNtt = preparePlain2d(evaluator, encodedWeights, firstParmsID(aNtt), buffer, threads);
+            Cipher2d ret = multiplyAccumulateNtt(evaluator, aNtt, groupLen,
+                [&](size_t i, size_t oc) -> const Plaintext& {return wNtt[oc][i];}, threads);
+            if (!a[0][0].isNttForm()) {
+                ret.forEach(threads, [&](Ciphertext& c, size_t, size_t) {
+                    evaluator.transformFromNttInplace(c);
+                });
+            }
+            return ret;
+        }
+
+        // See MatmulHelper::matmulCipher.
+        Cipher2d conv2dCipher(const troy::Evaluator& evaluator, const Cipher2d& a, const Cipher2d& encodedWeights) {
+            return conv2dCipherInternal(evaluator, a, encodedWeights, nullptr);
+        }
+
+        Cipher2d conv2dCipher(const troy::Evaluator& evaluator, const Cipher2d& a, const Cipher2d& encodedWeights, const troy::RelinKeys& rlk) {
+            return conv2dCipherInternal(evaluator, a, encodedWeights, &rlk);
+        }
+
+        Cipher2d conv2dReverse(const troy::Evaluator& evaluator, const Plain2d& a, const Cipher2d& encodedWeights) {
+            size_t totalBatchSize = getTotalBatchSize();
+            size_t groupLen = ceilDiv(outputChannels, blockOutputChannels);
+            Cipher2d wNtt = encodedWeights.toNtt(evaluator, threads);
+            Plain2d buffer;
+            const Plain2d& aNtt = preparePlain2d(evaluator, a, firstParmsID(wNtt), buffer, threads);
+            Cipher2d ret; ret.data.resize(totalBatchSize);
+            for (size_t b = 0; b < totalBatchSize; b++) ret.data[b].resize(groupLen);
+            ret.forEach(threads, [&](Ciphertext& out, size_t b, size_t oc) {
+                size_t inputCount = aNtt[b].size();
+                std::vector<const Ciphertext*> encrypteds(inputCount);
+                std::vector<const Plaintext*> plains(inputCount);
+                for (size_t i = 0; i < inputCount; i++) {
+                    encrypteds[i] = &wNtt[oc][i];
+                    plains[i] = &aNtt[b][i];
+                }
+                evaluator.multiplyPlainAccumulate(encrypteds, plains, out);
+                if (!encodedWeights[0][0].isNttForm()) evaluator.transformFromNttInplace(out);
+            });
+            return ret;
+        }
+
+        Plain2d encodeOutputs(
+            const troy::BatchEncoder& encoder,
+            const std::vector<uint64_t>& outputs
+        ) {
+            size_t oyh = imageHeight - kernelHeight + 1;
+            size_t oyw = imageWidth - kernelWidth + 1;
+            if (outputs.size() != batchSize * outputChannels * oyh * oyw) {
+                throw std::invalid_argument("Outputs shape incorrect.");
+            }
+            std::vector<std::vector<uint64_t>> masks(outputCipherCount(), std::vector<uint64_t>(slotCount, 0));
+            forEachOutputTerm([&](size_t originalIndex, size_t index, size_t id) {
+                masks[id][index] = outputs[originalIndex];
+            });
+            Cipher2d shape = outputShape();
+            Plain2d ret; ret.data.resize(shape.data.size());
+            size_t id = 0;
+            for (size_t r = 0; r < shape.data.size(); r++) {
+                ret[r].resize(shape[r].size());
+                for (size_t c = 0; c < shape[r].size(); c++) {
+                    encoder.encodePolynomial(masks[id++], ret[r][c]);
+                }
+            }
+            return ret;
+        }
+
+        std::vector<uint64_t> decryptOutputs(
+            const troy::BatchEncoder& encoder,
+            troy::Decryptor& decryptor,
+            const Cipher2d& outputs
+        ) {
+            size_t oyh = imageHeight - kernelHeight + 1;
+            size_t oyw = imageWidth - kernelWidth + 1;
+            std::vector<uint64_t> ret(batchSize * outputChannels * oyh * oyw, 0);
+            std::vector<std::vector<uint64_t>> buffers(outputCipherCount());
+            Plaintext encoded;
+            for (size_t id = 0; id < buffers.size(); id++) {
+                decryptor.decrypt(outputAt(outputs, id), encoded);
+                encoder.decodePolynomial(encoded, buffers[id]);
+                buffers[id].resize(slotCount, 0);
+            }
+            forEachOutputTerm([&](size_t originalIndex, size_t index, size_t id) {
+                ret[originalIndex] = buffers[id][index];
+            });
+            return ret;
+        }
+
+        // See MatmulHelper::packOutputs; merges every blockInputChannels results into one.
+        Cipher2d packOutputs(const troy::Evaluator& evaluator, const troy::GaloisKeys& autoKey, const Cipher2d& cipher) {
+            if (!this->packLwe) {
+                throw std::invalid_argument("PackLWE not enabled");
+            }
+            std::vector<const Ciphertext*> ciphers;
+            for (auto& row: cipher.data)
+                for (auto& c: row) ciphers.push_back(&c);
+            if (ciphers.size() != getTotalBatchSize() * ceilDiv(outputChannels, blockOutputChannels)) {
+                throw std::invalid_argument("Output ciphertext count incorrect");
+            }
+            Cipher2d ret; ret.data.push_back(packCiphertexts(evaluator, autoKey, ciphers, blockInputChannels, threads));
+            return ret;
+        }
+
+        void serializeOutputs(const troy::Evaluator& evaluator, const Cipher2d& x, std::ostream& stream) {
+            auto terms = outputTerms();
+            if (packLwe && (x.data.size() != 1 || x[0].size() != terms.size())) {
+                throw std::invalid_argument("Output ciphertext count incorrect");
+            }
+            for (size_t id = 0; id < terms.size(); id++) {
+                outputAt(x, id).saveTerms(stream, evaluator, terms[id]);
+            }
+        }
+
+        Cipher2d deserializeOutputs(const troy::Evaluator& evaluator, std::istream& stream) {
+            auto terms = outputTerms();
+            Cipher2d ret = outputShape();
+            size_t id = 0;
+            for (auto& row: ret.data) {
+                for (auto& c: row) {
+                    c.loadTerms(stream, evaluator, terms[id++]);
+                }
+            }
+            return ret;
+        }
+
+        // See MatmulHelper::outputStreamWriter.
+        StreamWriter outputStreamWriter(const troy::Evaluator& evaluator, std::ostream& stream) const {
+            Cipher2d shape = outputShape();
+            return StreamWriter(stream, evaluator, shape.data.size(), shape[0].size(), outputTerms(), threads);
+        }
+
+        StreamReader outputStreamReader(const troy::Evaluator& evaluator, std::istream& stream) const {
+            return StreamReader(stream, evaluator, outputTerms(), threads);
+        }
+
+    };
+
+}
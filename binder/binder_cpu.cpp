@@ -0,0 +1,848 @@
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <pybind11/complex.h>
+#include <pybind11/numpy.h>
+
+#include "../src/troy_cpu.h"
+#include "../app/LinearHelperCPU.h"
+#include <iostream>
+#include <sstream>
+
+// CPU counterpart of binder.cu: the same Python surface for the troy namespace, without
+// CUDA. Coefficient buffers are exposed to NumPy without copying, encoders take NumPy
+// arrays directly, and the GIL is released around Evaluator calls so that Python thread
+// pools can run them concurrently (Evaluator and Encryptor are thread-safe; Decryptor is
+// not, so it keeps the GIL).
+
+namespace py = pybind11;
+
+using namespace troy;
+using std::vector;
+using std::complex;
+using std::istringstream;
+using std::ostringstream;
+using std::string;
+
+using namespace LinearHelperCPU;
+
+#define SAVE_MACRO ostringstream stream; p.save(stream); return py::bytes(stream.str());
+#define LOAD_MACRO istringstream stream(str); self.load(stream);
+#define RELEASE_GIL py::call_guard<py::gil_scoped_release>()
+
+template <typename T>
+using NumpyIn = py::array_t<T, py::array::c_style | py::array::forcecast>;
+
+template <typename T>
+std::vector<T> getVectorFromBuffer(const NumpyIn<T>& values) {
+    return std::vector<T>(values.data(), values.data() + values.size());
+}
+
+// Hands the vector's storage over to NumPy; the array owns it through a capsule.
+template <typename T>
+py::array_t<T> getBufferFromVector(std::vector<T>&& vec) {
+    auto owned = new std::vector<T>(std::move(vec));
+    py::capsule owner(owned, [](void* p) {
+        delete reinterpret_cast<std::vector<T>*>(p);
+    });
+    return py::array_t<T>(owned->size(), owned->data(), owner);
+}
+
+// A writable row-major view of a buffer owned by `owner`, which the array keeps alive.
+// Resizing the owner (or moving into it) invalidates the view.
+inline py::array_t<uint64_t> viewOf(uint64_t* data, std::vector<py::ssize_t> shape, py::handle owner) {
+    std::vector<py::ssize_t> strides(shape.size());
+    py::ssize_t stride = sizeof(uint64_t);
+    for (size_t i = shape.size(); i-- > 0;) {
+        strides[i] = stride;
+        stride *= shape[i];
+    }
+    return py::array_t<uint64_t>(shape, strides, data, owner);
+}
+
+inline py::buffer_info bufferOf(uint64_t* data, std::vector<py::ssize_t> shape) {
+    std::vector<py::ssize_t> strides(shape.size());
+    py::ssize_t stride = sizeof(uint64_t);
+    for (size_t i = shape.size(); i-- > 0;) {
+        strides[i] = stride;
+        stride *= shape[i];
+    }
+    return py::buffer_info(data, sizeof(uint64_t), py::format_descriptor<uint64_t>::format(),
+        shape.size(), shape, strides);
+}
+
+inline std::vector<py::ssize_t> shapeOf(const Ciphertext& c) {
+    return {
+        static_cast<py::ssize_t>(c.size()),
+        static_cast<py::ssize_t>(c.coeffModulusSize()),
+        static_cast<py::ssize_t>(c.polyModulusDegree())
+    };
+}
+
+using ContextData = SEALContext::ContextData;
+
+// SEALContext hands out shared_ptr<const ContextData>, which pybind11 cannot use as a holder.
+inline std::shared_ptr<ContextData> holderOf(std::shared_ptr<const ContextData> p) {
+    return std::const_pointer_cast<ContextData>(p);
+}
+
+PYBIND11_MODULE(pytroy_cpu, m) {
+
+    py::enum_<SchemeType>(m, "SchemeType")
+        .value("none", SchemeType::none)
+        .value("bfv", SchemeType::bfv)
+        .value("bgv", SchemeType::bgv)
+        .value("ckks", SchemeType::ckks);
+
+    py::enum_<SecurityLevel>(m, "SecurityLevel")
+        .value("none", SecurityLevel::none)
+        .value("tc128", SecurityLevel::tc128)
+        .value("tc192", SecurityLevel::tc192)
+        .value("tc256", SecurityLevel::tc256)
+        ;
+
+    py::class_<Modulus>(m, "Modulus")
+        .def(py::init<uint64_t>())
+        .def("is_prime", &Modulus::isPrime)
+        .def("value", &Modulus::value)
+        ;
+
+    py::class_<CoeffModulus>(m, "CoeffModulus")
+        .def_static("max_bit_count", &CoeffModulus::MaxBitCount,
+            py::arg("poly_modulus_degree"), py::arg("sec_level") = SecurityLevel::tc128)
+        .def_static("bfv_default", &CoeffModulus::BFVDefault,
+            py::arg("poly_modulus_degree"), py::arg("sec_level") = SecurityLevel::tc128)
+        .def_static("create", py::overload_cast<size_t, std::vector<int>>(&CoeffModulus::Create))
+        .def_static("create", py::overload_cast<size_t, const Modulus&, std::vector<int>>(&CoeffModulus::Create))
+        ;
+
+    py::class_<PlainModulus>(m, "PlainModulus")
+        .def_static("batching", py::overload_cast<size_t, int>(&PlainModulus::Batching))
+        .def_static("batching", py::overload_cast<size_t, std::vector<int>>(&PlainModulus::Batching))
+        ;
+
+    py::class_<ParmsID>(m, "ParmsID")
+        .def("vec", [](const ParmsID& p) {
+            return std::vector<uint64_t>(p.begin(), p.end());
+        })
+        .def("__eq__", [](const ParmsID& a, const ParmsID& b) {return a == b;})
+        ;
+
+    py::class_<EncryptionParameters>(m, "EncryptionParameters")
+        .def(py::init<SchemeType>())
+        .def("set_poly_modulus_degree", &EncryptionParameters::setPolyModulusDegree)
+        .def("set_coeff_modulus", &EncryptionParameters::setCoeffModulus)
+        .def("set_plain_modulus", py::overload_cast<uint64_t>(&EncryptionParameters::setPlainModulus))
+        .def("set_plain_modulus", py::overload_cast<const Modulus&>(&EncryptionParameters::setPlainModulus))
+        .def("scheme", &EncryptionParameters::scheme)
+        .def("poly_modulus_degree", &EncryptionParameters::polyModulusDegree)
+        .def("coeff_modulus", &EncryptionParameters::coeffModulus)
+        .def("plain_modulus", &EncryptionParameters::plainModulus)
+        .def("parms_id", &EncryptionParameters::parmsID)
+        ;
+
+    py::class_<ContextData, std::shared_ptr<ContextData>>(m, "ContextData")
+        .def("parms", &ContextData::parms, py::return_value_policy::reference_internal)
+        .def("parms_id", &ContextData::parmsID)
+        .def("chain_index", &ContextData::chainIndex)
+        .def("prev_context_data", [](const ContextData& self) {return holderOf(self.prevContextData());})
+        .def("next_context_data", [](const ContextData& self) {return holderOf(self.nextContextData());})
+        ;
+
+    py::class_<SEALContext>(m, "SEALContext")
+        .def(py::init<EncryptionParameters, bool, SecurityLevel>(),
+            py::arg("parms"),
+            py::arg("expand_mod_chain") = true, py::arg("sec_level") = SecurityLevel::tc128)
+        .def("get_context_data", [](const SEALContext& self, ParmsID p) {return holderOf(self.getContextData(p));})
+        .def("first_context_data", [](const SEALContext& self) {return holderOf(self.firstContextData());})
+        .def("last_context_data", [](const SEALContext& self) {return holderOf(self.lastContextData());})
+        .def("key_context_data", [](const SEALContext& self) {return holderOf(self.keyContextData());})
+        .def("first_parms_id", &SEALContext::firstParmsID)
+        .def("last_parms_id", &SEALContext::lastParmsID)
+        .def("key_parms_id", &SEALContext::keyParmsID)
+        .def("using_keyswitching", &SEALContext::using_keyswitching)
+        ;
+
+    // Plaintext and Ciphertext support the buffer protocol (numpy.asarray(p) shares memory),
+    // and data() returns the same view explicitly.
+    py::class_<Plaintext>(m, "Plaintext", py::buffer_protocol())
+        .def(py::init<>())
+        .def_buffer([](Plaintext& self) {
+            return bufferOf(self.data(), {static_cast<py::ssize_t>(self.coeffCount())});
+        })
+        .def("data", [](py::object self) {
+            Plaintext& p = self.cast<Plaintext&>();
+            return viewOf(p.data(), {static_cast<py::ssize_t>(p.coeffCount())}, self);
+        })
+        .def("resize", &Plaintext::resize)
+        .def("set_zero", py::overload_cast<>(&Plaintext::setZero))
+        .def("coeff_count", &Plaintext::coeffCount)
+        .def("is_ntt_form", &Plaintext::isNttForm)
+        .def("parms_id", py::overload_cast<>(&Plaintext::parmsID, py::const_))
+        .def("set_parms_id", [](Plaintext& self, const ParmsID& p) {
+            self.parmsID() = p;
+        })
+        .def("scale", py::overload_cast<>(&Plaintext::scale, py::const_))
+        .def("set_scale", [](Plaintext& self, double s) {
+            self.scale() = s;
+        })
+        .def("copy", [](const Plaintext& p) {
+            return Plaintext(p);
+        })
+        .def("save", [](const Plaintext& p) {
+            SAVE_MACRO
+        })
+        .def("load", [](Plaintext& self, const py::bytes& str) {
+            LOAD_MACRO
+        })
+        ;
+
+    py::class_<ScaledPlaintext>(m, "ScaledPlaintext")
+        .def(py::init<>())
+        .def("parms_id", &ScaledPlaintext::parmsID)
+        .def("coeff_count", &ScaledPlaintext::coeffCount)
+        ;
+
+    py::class_<Ciphertext>(m, "Ciphertext", py::buffer_protocol())
+        .def(py::init<>())
+        .def(py::init<const SEALContext&>())
+        .def(py::init<const SEALContext&, ParmsID>())
+        .def(py::init<const SEALContext&, ParmsID, size_t>())
+        .def_buffer([](Ciphertext& self) {
+            return bufferOf(self.data(), shapeOf(self));
+        })
+        .def("data", [](py::object self) {
+            Ciphertext& c = self.cast<Ciphertext&>();
+            return viewOf(c.data(), shapeOf(c), self);
+        })
+        .def("correction_factor", py::overload_cast<>(&Ciphertext::correctionFactor, py::const_))
+        .def("set_correction_factor", [](Ciphertext& self, uint64_t c) {
+            self.correctionFactor() = c;
+        })
+        .def("resize", py::overload_cast<size_t>(&Ciphertext::resize))
+        .def("reserve", py::overload_cast<size_t>(&Ciphertext::reserve))
+        .def("size", &Ciphertext::size)
+        .def("parms_id", py::overload_cast<>(&Ciphertext::parmsID, py::const_))
+        .def("set_parms_id", [](Ciphertext& self, const ParmsID& p) {
+            self.parmsID() = p;
+        })
+        .def("scale", py::overload_cast<>(&Ciphertext::scale, py::const_))
+        .def("set_scale", [](Ciphertext& self, double s) {
+            self.scale() = s;
+        })
+        .def("is_ntt_form", py::overload_cast<>(&Ciphertext::isNttForm, py::const_))
+        .def("coeff_modulus_size", &Ciphertext::coeffModulusSize)
+        .def("poly_modulus_degree", &Ciphertext::polyModulusDegree)
+        .def("copy", [](const Ciphertext& p) {
+            return Ciphertext(p);
+        })
+        .def("save", [](const Ciphertext& p) {
+            SAVE_MACRO
+        })
+        .def("save_terms", [](const Ciphertext& p, const Evaluator& evaluator, NumpyIn<size_t> terms) {
+            ostringstream stream; p.saveTerms(stream, evaluator, getVectorFromBuffer(terms)); return py::bytes(stream.str());
+        })
+        .def("load", [](Ciphertext& self, const py::bytes& str) {
+            LOAD_MACRO
+        })
+        .def("load", [](Ciphertext& self, const py::bytes& str, const SEALContext& context) {
+            istringstream stream(str); self.load(stream, context);
+        })
+        .def("load_terms", [](Ciphertext& self, const py::bytes& str, const Evaluator& evaluator, NumpyIn<size_t> terms) {
+            istringstream stream(str); self.loadTerms(stream, evaluator, getVectorFromBuffer(terms));
+        })
+        ;
+
+    py::class_<SecretKey>(m, "SecretKey")
+        .def(py::init<>())
+        .def("parms_id", [](const SecretKey& self) {return ParmsID(self.parmsID());})
+        ;
+
+    py::class_<PublicKey>(m, "PublicKey")
+        .def(py::init<>())
+        .def("parms_id", [](const PublicKey& self) {return ParmsID(self.parmsID());})
+        ;
+
+    py::class_<KSwitchKeys>(m, "KSwitchKeys")
+        .def(py::init<>())
+        .def("parms_id", [](const KSwitchKeys& self) {return ParmsID(self.parmsID());})
+        .def("pack", &KSwitchKeys::pack)
+        .def("is_packed", &KSwitchKeys::isPacked)
+        ;
+
+    py::class_<RelinKeys, KSwitchKeys>(m, "RelinKeys")
+        .def(py::init<>())
+        ;
+
+    py::class_<GaloisKeys, KSwitchKeys>(m, "GaloisKeys")
+        .def(py::init<>())
+        ;
+
+    py::class_<KeyGenerator>(m, "KeyGenerator")
+        .def(py::init<const SEALContext&>())
+        .def(py::init<const SEALContext&, const SecretKey&>())
+        .def("secret_key", &KeyGenerator::secretKey)
+        .def("create_public_key", py::overload_cast<PublicKey&>(
+            &KeyGenerator::createPublicKey, py::const_
+        ), RELEASE_GIL)
+        .def("create_public_key", py::overload_cast<>(
+            &KeyGenerator::createPublicKey, py::const_
+        ), RELEASE_GIL)
+        .def("create_relin_keys", py::overload_cast<RelinKeys&>(
+            &KeyGenerator::createRelinKeys
+        ), RELEASE_GIL)
+        .def("create_relin_keys", py::overload_cast<>(
+            &KeyGenerator::createRelinKeys
+        ), RELEASE_GIL)
+        .def("create_galois_keys", py::overload_cast<GaloisKeys&>(
+            &KeyGenerator::createGaloisKeys
+        ), RELEASE_GIL)
+        .def("create_galois_keys", py::overload_cast<>(
+            &KeyGenerator::createGaloisKeys
+        ), RELEASE_GIL)
+        .def("create_galois_keys", py::overload_cast<const vector<int>&, GaloisKeys&>(
+            &KeyGenerator::createGaloisKeys
+        ), RELEASE_GIL)
+        .def("create_galois_keys", py::overload_cast<const vector<int>&>(
+            &KeyGenerator::createGaloisKeys
+        ), RELEASE_GIL)
+        .def("create_automorphism_keys", &KeyGenerator::createAutomorphismKeys, RELEASE_GIL)
+        .def("create_keyswitching_keys", &KeyGenerator::createKeySwitchingKeys, RELEASE_GIL)
+        ;
+
+    py::class_<BatchEncoder>(m, "BatchEncoder")
+        .def(py::init<const SEALContext&>())
+        .def("encode_int64", [](const BatchEncoder& self, NumpyIn<int64_t> t, Plaintext& p) {
+            self.encode(getVectorFromBuffer(t), p);
+        })
+        .def("encode", [](const BatchEncoder& self, NumpyIn<uint64_t> t, Plaintext& p) {
+            self.encode(getVectorFromBuffer(t), p);
+        })
+        .def("encode_int64", [](const BatchEncoder& self, NumpyIn<int64_t> t) {
+            Plaintext p; self.encode(getVectorFromBuffer(t), p); return p;
+        })
+        .def("encode", [](const BatchEncoder& self, NumpyIn<uint64_t> t) {
+            Plaintext p; self.encode(getVectorFromBuffer(t), p); return p;
+        })
+        .def("encode_polynomial", [](const BatchEncoder& self, NumpyIn<uint64_t> t) {
+            Plaintext p; self.encodePolynomial(getVectorFromBuffer(t), p); return p;
+        })
+        .def("encode_polynomial_int64", [](const BatchEncoder& self, NumpyIn<int64_t> t) {
+            Plaintext p; self.encodePolynomial(getVectorFromBuffer(t), p); return p;
+        })
+        .def("decode_int64", [](const BatchEncoder& self, const Plaintext& plain) {
+            vector<int64_t> ret; self.decode(plain, ret); return getBufferFromVector(std::move(ret));
+        })
+        .def("decode", [](const BatchEncoder& self, const Plaintext& plain) {
+            vector<uint64_t> ret; self.decode(plain, ret); return getBufferFromVector(std::move(ret));
+        })
+        .def("decode_polynomial", [](const BatchEncoder& self, const Plaintext& plain) {
+            vector<uint64_t> ret; self.decodePolynomial(plain, ret); return getBufferFromVector(std::move(ret));
+        })
+        .def("decode_polynomial_int64", [](const BatchEncoder& self, const Plaintext& plain) {
+            vector<int64_t> ret; self.decodePolynomial(plain, ret); return getBufferFromVector(std::move(ret));
+        })
+        .def("slot_count", &BatchEncoder::slotCount)
+        ;
+
+    py::class_<CKKSEncoder>(m, "CKKSEncoder")
+        .def(py::init<const SEALContext&>())
+        .def("encode", [](CKKSEncoder& self, NumpyIn<complex<double>> v, double scale, Plaintext& p) {
+            self.encode(getVectorFromBuffer(v), scale, p);
+        })
+        .def("encode", [](CKKSEncoder& self, NumpyIn<complex<double>> v, ParmsID parms_id, double scale, Plaintext& p) {
+            self.encode(getVectorFromBuffer(v), parms_id, scale, p);
+        })
+        .def("encode", py::overload_cast<complex<double>, double, Plaintext&>(&CKKSEncoder::encode))
+        .def("encode", py::overload_cast<complex<double>, ParmsID, double, Plaintext&>(&CKKSEncoder::encode))
+        .def("encode", [](CKKSEncoder& self, NumpyIn<complex<double>> v, double scale) {
+            Plaintext p; self.encode(getVectorFromBuffer(v), scale, p); return p;
+        })
+        .def("encode", [](CKKSEncoder& self, NumpyIn<complex<double>> v, ParmsID parms_id, double scale) {
+            Plaintext p; self.encode(getVectorFromBuffer(v), parms_id, scale, p); return p;
+        })
+        .def("encode", [](CKKSEncoder& self, complex<double> v, double scale) {
+            Plaintext p; self.encode(v, scale, p); return p;
+        })
+        .def("encode", [](CKKSEncoder& self, complex<double> v, ParmsID parms_id, double scale) {
+            Plaintext p; self.encode(v, parms_id, scale, p); return p;
+        })
+        .def("decode", [](CKKSEncoder& self, const Plaintext& plain) {
+            vector<complex<double>> ret; self.decode(plain, ret); return getBufferFromVector(std::move(ret));
+        })
+        .def("slot_count", &CKKSEncoder::slotCount)
+        ;
+
+    py::class_<Encryptor>(m, "Encryptor")
+        .def(py::init<const SEALContext&, const PublicKey&>())
+        .def(py::init<const SEALContext&, const SecretKey&>())
+        .def(py::init<const SEALContext&, const PublicKey&, const SecretKey&>())
+        .def("set_public_key", &Encryptor::setPublicKey)
+        .def("set_secret_key", &Encryptor::setSecretKey)
+
+        .def("encrypt", py::overload_cast<const Plaintext&, Ciphertext&>(&Encryptor::encrypt, py::const_), RELEASE_GIL)
+        .def("encrypt", py::overload_cast<const ScaledPlaintext&, Ciphertext&>(&Encryptor::encrypt, py::const_), RELEASE_GIL)
+        .def("encrypt_zero", py::overload_cast<Ciphertext&>(&Encryptor::encryptZero, py::const_), RELEASE_GIL)
+        .def("encrypt_zero", py::overload_cast<ParmsID, Ciphertext&>(&Encryptor::encryptZero, py::const_), RELEASE_GIL)
+        .def("encrypt_symmetric", py::overload_cast<const Plaintext&, Ciphertext&>(&Encryptor::encryptSymmetric, py::const_), RELEASE_GIL)
+        .def("encrypt_symmetric", py::overload_cast<const ScaledPlaintext&, Ciphertext&>(&Encryptor::encryptSymmetric, py::const_), RELEASE_GIL)
+        .def("encrypt_zero_symmetric", py::overload_cast<Ciphertext&>(&Encryptor::encryptZeroSymmetric, py::const_), RELEASE_GIL)
+        .def("encrypt_zero_symmetric", py::overload_cast<ParmsID, Ciphertext&>(&Encryptor::encryptZeroSymmetric, py::const_), RELEASE_GIL)
+
+        .def("encrypt", [](const Encryptor& self, const Plaintext& plain) {
+            Ciphertext ret; self.encrypt(plain, ret); return ret;
+        }, RELEASE_GIL)
+        .def("encrypt_zero", [](const Encryptor& self) {
+            Ciphertext ret; self.encryptZero(ret); return ret;
+        }, RELEASE_GIL)
+        .def("encrypt_zero", [](const Encryptor& self, ParmsID parms_id) {
+            Ciphertext ret; self.encryptZero(parms_id, ret); return ret;
+        }, RELEASE_GIL)
+        .def("encrypt_symmetric", [](const Encryptor& self, const Plaintext& plain) {
+            Ciphertext ret; self.encryptSymmetric(plain, ret); return ret;
+        }, RELEASE_GIL)
+        .def("encrypt", [](const Encryptor& self, const ScaledPlaintext& plain) {
+            Ciphertext ret; self.encrypt(plain, ret); return ret;
+        }, RELEASE_GIL)
+        .def("encrypt_symmetric", [](const Encryptor& self, const ScaledPlaintext& plain) {
+            Ciphertext ret; self.encryptSymmetric(plain, ret); return ret;
+        }, RELEASE_GIL)
+        .def("encrypt_zero_symmetric", [](const Encryptor& self) {
+            Ciphertext ret; self.encryptZeroSymmetric(ret); return ret;
+        }, RELEASE_GIL)
+        .def("encrypt_zero_symmetric", [](const Encryptor& self, ParmsID parms_id) {
+            Ciphertext ret; self.encryptZeroSymmetric(parms_id, ret); return ret;
+        }, RELEASE_GIL)
+        ;
+
+    // Decryptor keeps the GIL: it is not thread-safe.
+    py::class_<Decryptor>(m, "Decryptor")
+        .def(py::init<const SEALContext&, const SecretKey&>())
+        .def("decrypt", &Decryptor::decrypt)
+        .def("decrypt", [](Decryptor& self, const Ciphertext& cipher) {
+            Plaintext p; self.decrypt(cipher, p); return p;
+        })
+        ;
+
+    py::class_<Instrumentation>(m, "Instrumentation")
+        .def_static("compiled_in", &Instrumentation::compiledIn)
+        .def_static("enabled", &Instrumentation::enabled)
+        .def_static("set_enabled", &Instrumentation::setEnabled)
+        .def_static("reset", &Instrumentation::reset)
+        .def_static("json", []() { return Instrumentation::snapshot().toJson(); })
+        .def_static("prometheus", []() { return Instrumentation::snapshot().toPrometheus(); })
+        ;
+
+    py::class_<Tracer>(m, "Tracer")
+        .def_static("start", &Tracer::start,
+            py::arg("max_events_per_thread") = size_t(1) << 20, py::arg("max_events") = size_t(1) << 22)
+        .def_static("stop", &Tracer::stop)
+        .def_static("enabled", &Tracer::enabled)
+        .def_static("clear", &Tracer::clear)
+        .def_static("event_count", &Tracer::eventCount)
+        .def_static("dropped_events", &Tracer::droppedEvents)
+        .def_static("buffer_count", &Tracer::bufferCount)
+        .def_static("chrome_trace", []() {
+            ostringstream stream; Tracer::writeChromeTrace(stream); return stream.str();
+        })
+        ;
+
+    py::class_<Evaluator>(m, "Evaluator")
+        .def(py::init<const SEALContext&>())
+        .def("set_thread_count",           &Evaluator::setThreadCount)
+        .def("thread_count",               &Evaluator::threadCount)
+        .def("set_batch_key_switching_threshold", &Evaluator::setBatchKeySwitchingThreshold)
+
+        .def("negate_inplace",             &Evaluator::negateInplace, RELEASE_GIL)
+        .def("negate", [](const Evaluator& self, const Ciphertext& c) {
+            Ciphertext ret; self.negate(c, ret); return ret;
+        }, RELEASE_GIL)
+        .def("negate",                     &Evaluator::negate, RELEASE_GIL)
+
+        .def("add_inplace",                &Evaluator::addInplace, RELEASE_GIL)
+        .def("add", [](const Evaluator& self, const Ciphertext& c1, const Ciphertext& c2) {
+            Ciphertext ret; self.add(c1, c2, ret); return ret;
+        }, RELEASE_GIL)
+        .def("add",                        &Evaluator::add, RELEASE_GIL)
+
+        .def("add_many", py::overload_cast<const vector<Ciphertext>&, Ciphertext&>(
+            &Evaluator::addMany, py::const_
+        ), RELEASE_GIL)
+        .def("add_many", [](const Evaluator& self, const vector<Ciphertext>& c) {
+            Ciphertext ret; self.addMany(c, ret); return ret;
+        }, RELEASE_GIL)
+
+        .def("sub_inplace",                &Evaluator::subInplace, RELEASE_GIL)
+        .def("sub", [](const Evaluator& self, const Ciphertext& c1, const Ciphertext& c2) {
+            Ciphertext ret; self.sub(c1, c2, ret); return ret;
+        }, RELEASE_GIL)
+        .def("sub",                        &Evaluator::sub, RELEASE_GIL)
+
+        .def("multiply_inplace",           &Evaluator::multiplyInplace, RELEASE_GIL)
+        .def("multiply", [](const Evaluator& self, const Ciphertext& c1, const Ciphertext& c2) {
+            Ciphertext ret; self.multiply(c1, c2, ret); return ret;
+        }, RELEASE_GIL)
+        .def("multiply",                   &Evaluator::multiply, RELEASE_GIL)
+
+        .def("square_inplace",             &Evaluator::squareInplace, RELEASE_GIL)
+        .def("square", [](const Evaluator& self, const Ciphertext& c) {
+            Ciphertext ret; self.square(c, ret); return ret;
+        }, RELEASE_GIL)
+        .def("square",                     &Evaluator::square, RELEASE_GIL)
+
+        .def("relinearize_inplace",        &Evaluator::relinearizeInplace, RELEASE_GIL)
+        .def("relinearize",                &Evaluator::relinearize, RELEASE_GIL)
+        .def("relinearize", [](const Evaluator& self, const Ciphertext& c, const RelinKeys& relin_keys) {
+            Ciphertext ret; self.relinearize(c, relin_keys, ret); return ret;
+        }, RELEASE_GIL)
+        // Lists are converted by value, so the batched forms return the results.
+        .def("relinearize_many", [](const Evaluator& self, std::vector<Ciphertext> c, const RelinKeys& relin_keys) {
+            self.relinearizeManyInplace(c, relin_keys); return c;
+        }, RELEASE_GIL)
+
+        .def("mod_switch_to_next_inplace", py::overload_cast<Ciphertext&>(
+            &Evaluator::modSwitchToNextInplace, py::const_
+        ), RELEASE_GIL)
+        .def("mod_switch_to_next_inplace", py::overload_cast<Plaintext&>(
+            &Evaluator::modSwitchToNextInplace, py::const_
+        ), RELEASE_GIL)
+        .def("mod_switch_to_next", py::overload_cast<const Ciphertext&, Ciphertext&>(
+            &Evaluator::modSwitchToNext, py::const_
+        ), RELEASE_GIL)
+        .def("mod_switch_to_next", [](const Evaluator& self, const Ciphertext& c) {
+            Ciphertext ret; self.modSwitchToNext(c, ret); return ret;
+        }, RELEASE_GIL)
+        .def("mod_switch_to_next", py::overload_cast<const Plaintext&, Plaintext&>(
+            &Evaluator::modSwitchToNext, py::const_
+        ), RELEASE_GIL)
+        .def("mod_switch_to_next", [](const Evaluator& self, const Plaintext& p) {
+            Plaintext ret; self.modSwitchToNext(p, ret); return ret;
+        }, RELEASE_GIL)
+
+        .def("mod_switch_to_inplace", py::overload_cast<Ciphertext&, ParmsID>(
+            &Evaluator::modSwitchToInplace, py::const_
+        ), RELEASE_GIL)
+        .def("mod_switch_to_inplace", py::overload_cast<Plaintext&, ParmsID>(
+            &Evaluator::modSwitchToInplace, py::const_
+        ), RELEASE_GIL)
+        .def("mod_switch_to", py::overload_cast<const Ciphertext&, ParmsID, Ciphertext&>(
+            &Evaluator::modSwitchTo, py::const_
+        ), RELEASE_GIL)
+        .def("mod_switch_to", [](const Evaluator& self, const Ciphertext& c, ParmsID parms_id) {
+            Ciphertext ret; self.modSwitchTo(c, parms_id, ret); return ret;
+        }, RELEASE_GIL)
+        .def("mod_switch_to", py::overload_cast<const Plaintext&, ParmsID, Plaintext&>(
+            &Evaluator::modSwitchTo, py::const_
+        ), RELEASE_GIL)
+        .def("mod_switch_to", [](const Evaluator& self, const Plaintext& p, ParmsID parms_id) {
+            Plaintext ret; self.modSwitchTo(p, parms_id, ret); return ret;
+        }, RELEASE_GIL)
+
+        .def("rescale_to_next_inplace", &Evaluator::rescaleToNextInplace, RELEASE_GIL)
+        .def("rescale_to_next", &Evaluator::rescaleToNext, RELEASE_GIL)
+        .def("rescale_to_next", [](const Evaluator& self, const Ciphertext& c) {
+            Ciphertext ret; self.rescaleToNext(c, ret); return ret;
+        }, RELEASE_GIL)
+
+        .def("rescale_to_inplace", &Evaluator::rescaleToInplace, RELEASE_GIL)
+        .def("rescale_to", &Evaluator::rescaleTo, RELEASE_GIL)
+        .def("rescale_to", [](const Evaluator& self, const Ciphertext& c, ParmsID parms_id) {
+            Ciphertext ret; self.rescaleTo(c, parms_id, ret); return ret;
+        }, RELEASE_GIL)
+
+        .def("multiply_many",          &Evaluator::multiplyMany, RELEASE_GIL)
+        .def("multiply_many", [](const Evaluator& self, const vector<Ciphertext>& c, const RelinKeys& relin_keys) {
+            Ciphertext ret; self.multiplyMany(c, relin_keys, ret); return ret;
+        }, RELEASE_GIL)
+        .def("exponentiate_inplace",   &Evaluator::exponentiateInplace, RELEASE_GIL)
+        .def("exponentiate",           &Evaluator::exponentiate, RELEASE_GIL)
+        .def("exponentiate", [](const Evaluator& self, const Ciphertext &encrypted, std::uint64_t exponent, const RelinKeys &relin_keys) {
+            Ciphertext ret; self.exponentiate(encrypted, exponent, relin_keys, ret); return ret;
+        }, RELEASE_GIL)
+
+        .def("scale_plain", [](const Evaluator& self, const Plaintext& p) {
+            ScaledPlaintext ret; self.scalePlain(p, ret); return ret;
+        }, RELEASE_GIL)
+        .def("scale_plain", [](const Evaluator& self, const Plaintext& p, ParmsID parms_id) {
+            ScaledPlaintext ret; self.scalePlain(p, parms_id, ret); return ret;
+        }, RELEASE_GIL)
+        .def("add_plain_inplace",      py::overload_cast<Ciphertext&, const ScaledPlaintext&>(&Evaluator::addPlainInplace, py::const_), RELEASE_GIL)
+        .def("add_plain_inplace",      py::overload_cast<Ciphertext&, const Plaintext&>(&Evaluator::addPlainInplace, py::const_), RELEASE_GIL)
+        .def("add_plain", [](const Evaluator& self, const Ciphertext& c1, const Plaintext& p2) {
+            Ciphertext ret; self.addPlain(c1, p2, ret); return ret;
+        }, RELEASE_GIL)
+        .def("add_plain", [](const Evaluator& self, const Ciphertext& c1, const ScaledPlaintext& p2) {
+            Ciphertext ret; self.addPlain(c1, p2, ret); return ret;
+        }, RELEASE_GIL)
+
+        .def("sub_plain_inplace",      py::overload_cast<Ciphertext&, const ScaledPlaintext&>(&Evaluator::subPlainInplace, py::const_), RELEASE_GIL)
+        .def("sub_plain_inplace",      py::overload_cast<Ciphertext&, const Plaintext&>(&Evaluator::subPlainInplace, py::const_), RELEASE_GIL)
+        .def("sub_plain", [](const Evaluator& self, const Ciphertext& c1, const Plaintext& p2) {
+            Ciphertext ret; self.subPlain(c1, p2, ret); return ret;
+        }, RELEASE_GIL)
+        .def("sub_plain", [](const Evaluator& self, const Ciphertext& c1, const ScaledPlaintext& p2) {
+            Ciphertext ret; self.subPlain(c1, p2, ret); return ret;
+        }, RELEASE_GIL)
+
+        .def("multiply_plain_inplace", &Evaluator::multiplyPlainInplace, RELEASE_GIL)
+        .def("multiply_plain", [](const Evaluator& self, const Ciphertext& c1, const Plaintext& p2) {
+            Ciphertext ret; self.multiplyPlain(c1, p2, ret); return ret;
+        }, RELEASE_GIL)
+        .def("multiply_plain",         &Evaluator::multiplyPlain, RELEASE_GIL)
+        .def("multiply_batch", [](const Evaluator& self, const vector<Ciphertext>& c1, const vector<Plaintext>& p2) {
+            vector<Ciphertext> ret(c1.size());
+            for (size_t i = 0; i < c1.size(); i++) self.multiplyPlain(c1[i], p2[i], ret[i]);
+            return ret;
+        }, RELEASE_GIL)
+        .def("multiply_plain_accumulate", [](const Evaluator& self, const vector<Ciphertext>& c, const vector<Plaintext>& p) {
+            vector<const Ciphertext*> cs; for (auto& x: c) cs.push_back(&x);
+            vector<const Plaintext*> ps; for (auto& x: p) ps.push_back(&x);
+            Ciphertext ret; self.multiplyPlainAccumulate(cs, ps, ret); return ret;
+        }, RELEASE_GIL)
+
+        .def("transform_to_ntt_inplace", py::overload_cast<Plaintext&, ParmsID>(
+            &Evaluator::transformToNttInplace, py::const_
+        ), RELEASE_GIL)
+        .def("transform_to_ntt_inplace", py::overload_cast<Ciphertext&>(
+            &Evaluator::transformToNttInplace, py::const_
+        ), RELEASE_GIL)
+
+        .def("transform_to_ntt", py::overload_cast<const Plaintext&, ParmsID, Plaintext&>(
+            &Evaluator::transformToNtt, py::const_
+        ), RELEASE_GIL)
+        .def("transform_to_ntt", [](const Evaluator& self, const Plaintext& plaintext, ParmsID parms_id) {
+            Plaintext ret; self.transformToNtt(plaintext, parms_id, ret); return ret;
+        }, RELEASE_GIL)
+        .def("transform_to_ntt", py::overload_cast<const Ciphertext&, Ciphertext&>(
+            &Evaluator::transformToNtt, py::const_
+        ), RELEASE_GIL)
+        .def("transform_to_ntt", [](const Evaluator& self, const Ciphertext& cipher) {
+            Ciphertext ret; self.transformToNtt(cipher, ret); return ret;
+        }, RELEASE_GIL)
+
+        .def("transform_from_ntt_inplace", py::overload_cast<Ciphertext&>(
+            &Evaluator::transformFromNttInplace, py::const_
+        ), RELEASE_GIL)
+        .def("transform_from_ntt", py::overload_cast<const Ciphertext&, Ciphertext&>(
+            &Evaluator::transformFromNtt, py::const_
+        ), RELEASE_GIL)
+        .def("transform_from_ntt", [](const Evaluator& self, const Ciphertext& cipher) {
+            Ciphertext ret; self.transformFromNtt(cipher, ret); return ret;
+        }, RELEASE_GIL)
+
+        .def("apply_galois_inplace", &Evaluator::applyGaloisInplace, RELEASE_GIL)
+        .def("apply_galois", &Evaluator::applyGalois, RELEASE_GIL)
+        .def("apply_galois", [](const Evaluator& self, const Ciphertext& cipher, std::uint32_t galois_elt, const GaloisKeys &galois_keys) {
+            Ciphertext ret; self.applyGalois(cipher, galois_elt, galois_keys, ret); return ret;
+        }, RELEASE_GIL)
+
+        .def("rotate_rows_inplace", &Evaluator::rotateRowsInplace, RELEASE_GIL)
+        .def("rotate_rows", &Evaluator::rotateRows, RELEASE_GIL)
+        .def("rotate_rows", [](const Evaluator& self, const Ciphertext& cipher, int steps, const GaloisKeys &galois_keys) {
+            Ciphertext ret; self.rotateRows(cipher, steps, galois_keys, ret); return ret;
+        }, RELEASE_GIL)
+        .def("rotate_rows_many", [](const Evaluator& self, std::vector<Ciphertext> c, int steps, const GaloisKeys &galois_keys) {
+            self.rotateRowsManyInplace(c, steps, galois_keys); return c;
+        }, RELEASE_GIL)
+
+        .def("rotate_columns_inplace", &Evaluator::rotateColumnsInplace, RELEASE_GIL)
+        .def("rotate_columns", &Evaluator::rotateColumns, RELEASE_GIL)
+        .def("rotate_columns", [](const Evaluator& self, const Ciphertext& cipher, const GaloisKeys &galois_keys) {
+            Ciphertext ret; self.rotateColumns(cipher, galois_keys, ret); return ret;
+        }, RELEASE_GIL)
+
+        .def("rotate_vector_inplace", &Evaluator::rotateVectorInplace, RELEASE_GIL)
+        .def("rotate_vector", &Evaluator::rotateVector, RELEASE_GIL)
+        .def("rotate_vector", [](const Evaluator& self, const Ciphertext& cipher, int steps, const GaloisKeys &galois_keys) {
+            Ciphertext ret; self.rotateVector(cipher, steps, galois_keys, ret); return ret;
+        }, RELEASE_GIL)
+        .def("rotate_vector_many", [](const Evaluator& self, std::vector<Ciphertext> c, int steps, const GaloisKeys &galois_keys) {
+            self.rotateVectorManyInplace(c, steps, galois_keys); return c;
+        }, RELEASE_GIL)
+
+        .def("complex_conjugate_inplace", &Evaluator::complexConjugateInplace, RELEASE_GIL)
+        .def("complex_conjugate", &Evaluator::complexConjugate, RELEASE_GIL)
+        .def("complex_conjugate", [](const Evaluator& self, const Ciphertext& cipher, const GaloisKeys &galois_keys) {
+            Ciphertext ret; self.complexConjugate(cipher, galois_keys, ret); return ret;
+        }, RELEASE_GIL)
+
+        .def("field_trace_inplace", &Evaluator::fieldTraceInplace, RELEASE_GIL)
+        .def("divide_by_poly_modulus_degree_inplace", &Evaluator::divideByPolyModulusDegreeInplace,
+            py::arg("encrypted"), py::arg("mul") = 1, RELEASE_GIL)
+
+        .def("negacyclic_shift", &Evaluator::negacyclicShift, RELEASE_GIL)
+        .def("negacyclic_shift", [](const Evaluator& self, const Ciphertext& c1, size_t shift) {
+            Ciphertext ret; self.negacyclicShift(c1, shift, ret); return ret;
+        }, RELEASE_GIL)
+        .def("negacyclic_shift_inplace", &Evaluator::negacyclicShiftInplace, RELEASE_GIL)
+        ;
+
+    py::class_<Cipher2d>(m, "Cipher2d")
+        .def(py::init<>())
+        .def("rows", [](const Cipher2d& self) {return self.data.size();})
+        .def("cols", [](const Cipher2d& self, size_t i) {return self[i].size();})
+        .def("at", [](Cipher2d& self, size_t i, size_t j) -> Ciphertext& {return self[i].at(j);},
+            py::return_value_policy::reference_internal)
+        .def("save", [](const Cipher2d& p) {
+            SAVE_MACRO
+        })
+        .def("load", [](Cipher2d& self, const py::bytes& str) {
+            LOAD_MACRO
+        })
+        .def("load", [](Cipher2d& self, const py::bytes& str, const SEALContext& context) {
+            istringstream stream(str); self.load(stream, context);
+        })
+        .def("add_inplace", [](Cipher2d& self, const Evaluator& evaluator, const Cipher2d& x) {
+            self.addInplace(evaluator, x);
+        }, RELEASE_GIL)
+        .def("add_plain_inplace", [](Cipher2d& self, const Evaluator& evaluator, const Plain2d& x) {
+            self.addPlainInplace(evaluator, x);
+        }, RELEASE_GIL)
+        .def("add_plain", [](const Cipher2d& self, const Evaluator& evaluator, const Plain2d& x) {
+            return self.addPlain(evaluator, x);
+        }, RELEASE_GIL)
+        .def("mod_switch_to_next", [](Cipher2d& self, const Evaluator& evaluator) {
+            self.modSwitchToNext(evaluator);
+        }, RELEASE_GIL)
+        .def("relinearize", [](Cipher2d& self, const Evaluator& evaluator, const RelinKeys& rlk) {
+            self.relinearize(evaluator, rlk);
+        }, RELEASE_GIL)
+        .def("multiply_scalar_inplace", [](Cipher2d& self, const BatchEncoder& encoder, const Evaluator& evaluator, uint64_t scalar) {
+            self.multiplyScalarInplace(encoder, evaluator, scalar);
+        }, RELEASE_GIL)
+        ;
+
+    py::class_<Plain2d>(m, "Plain2d")
+        .def(py::init<>())
+        .def("rows", [](const Plain2d& self) {return self.data.size();})
+        .def("cols", [](const Plain2d& self, size_t i) {return self[i].size();})
+        .def("at", [](Plain2d& self, size_t i, size_t j) -> Plaintext& {return self[i].at(j);},
+            py::return_value_policy::reference_internal)
+        .def("encrypt", [](const Plain2d& self, const Encryptor& encryptor) {
+            return self.encrypt(encryptor);
+        }, RELEASE_GIL)
+        ;
+
+    py::class_<MatmulHelper>(m, "MatmulHelper")
+        .def(py::init<size_t, size_t, size_t, size_t, int, bool>(),
+            py::arg("batch_size"), py::arg("input_dims"), py::arg("output_dims"), py::arg("slot_count"),
+            py::arg("objective") = 0, py::arg("pack_lwe") = false)
+        .def("encode_weights", [](MatmulHelper& self, const BatchEncoder& encoder, NumpyIn<uint64_t> weights) {
+            py::gil_scoped_release release;
+            return self.encodeWeights(encoder, weights.data());
+        })
+        .def("encode_weights", [](MatmulHelper& self, const BatchEncoder& encoder, const Evaluator& evaluator,
+            NumpyIn<uint64_t> weights, ParmsID parms_id, const string& cache_path, uint64_t layer_key
+        ) {
+            py::gil_scoped_release release;
+            return self.encodeWeights(encoder, evaluator, weights.data(), parms_id, cache_path, layer_key);
+        })
+        .def("encode_inputs", [](MatmulHelper& self, const BatchEncoder& encoder, NumpyIn<uint64_t> inputs) {
+            py::gil_scoped_release release;
+            return self.encodeInputs(encoder, inputs.data());
+        })
+        .def("encrypt_inputs", [](MatmulHelper& self, const Encryptor& encryptor, const BatchEncoder& encoder, NumpyIn<uint64_t> inputs) {
+            py::gil_scoped_release release;
+            return self.encryptInputs(encryptor, encoder, inputs.data());
+        })
+        .def("matmul", [](MatmulHelper& self, const Evaluator& evaluator, const Cipher2d& a, const Plain2d& weights) {
+            return self.matmul(evaluator, a, weights);
+        }, RELEASE_GIL)
+        .def("matmul", [](MatmulHelper& self, const Evaluator& evaluator, const Cipher2d& a, const Cipher2d& weights) {
+            return self.matmulCipher(evaluator, a, weights);
+        }, RELEASE_GIL)
+        .def("matmul", [](MatmulHelper& self, const Evaluator& evaluator, const Cipher2d& a, const Cipher2d& weights, const RelinKeys& rlk) {
+            return self.matmulCipher(evaluator, a, weights, rlk);
+        }, RELEASE_GIL)
+        .def("matmul", [](MatmulHelper& self, const Evaluator& evaluator, const Plain2d& a, const Cipher2d& weights) {
+            return self.matmulReverse(evaluator, a, weights);
+        }, RELEASE_GIL)
+        .def("pack_outputs", [](MatmulHelper& self, const Evaluator& evaluator, const GaloisKeys& autokey, const Cipher2d& x) {
+            return self.packOutputs(evaluator, autokey, x);
+        }, RELEASE_GIL)
+        .def("encode_outputs", [](MatmulHelper& self, const BatchEncoder& encoder, NumpyIn<uint64_t> outputs) {
+            py::gil_scoped_release release;
+            return self.encodeOutputs(encoder, outputs.data());
+        })
+        .def("decrypt_outputs", [](MatmulHelper& self, const BatchEncoder& encoder, Decryptor& decryptor, const Cipher2d& outputs) {
+            return getBufferFromVector(self.decryptOutputs(encoder, decryptor, outputs));
+        })
+        .def("serialize_outputs", [](MatmulHelper& self, const Evaluator& evaluator, const Cipher2d& x) {
+            ostringstream stream; self.serializeOutputs(evaluator, x, stream);
+            return py::bytes(stream.str());
+        })
+        .def("deserialize_outputs", [](MatmulHelper& self, const Evaluator& evaluator, const py::bytes& str) {
+            istringstream stream(str);
+            return self.deserializeOutputs(evaluator, stream);
+        })
+        .def("serialize_encoded_weights", [](MatmulHelper& self, const Plain2d& x) {
+            ostringstream stream; self.serializeEncodedWeights(x, stream);
+            return py::bytes(stream.str());
+        })
+        .def("deserialize_encoded_weights", [](MatmulHelper& self, const py::bytes& str) {
+            istringstream stream(str);
+            return self.deserializeEncodedWeights(stream);
+        })
+        ;
+
+    py::class_<Conv2dHelper>(m, "Conv2dHelper")
+        .def(py::init<size_t, size_t, size_t, size_t, size_t, size_t, size_t, size_t, int, bool>(),
+            py::arg("batch_size"), py::arg("image_height"), py::arg("image_width"),
+            py::arg("kernel_height"), py::arg("kernel_width"),
+            py::arg("input_channels"), py::arg("output_channels"), py::arg("slot_count"),
+            py::arg("objective") = 0, py::arg("pack_lwe") = false)
+        .def("encode_weights", [](Conv2dHelper& self, const BatchEncoder& encoder, NumpyIn<uint64_t> weights) {
+            auto w = getVectorFromBuffer(weights);
+            py::gil_scoped_release release;
+            return self.encodeWeights(encoder, w);
+        })
+        .def("encode_weights", [](Conv2dHelper& self, const BatchEncoder& encoder, const Evaluator& evaluator,
+            NumpyIn<uint64_t> weights, ParmsID parms_id, const string& cache_path, uint64_t layer_key
+        ) {
+            auto w = getVectorFromBuffer(weights);
+            py::gil_scoped_release release;
+            return self.encodeWeights(encoder, evaluator, w, parms_id, cache_path, layer_key);
+        })
+        .def("encode_inputs", [](Conv2dHelper& self, const BatchEncoder& encoder, NumpyIn<uint64_t> inputs) {
+            auto x = getVectorFromBuffer(inputs);
+            py::gil_scoped_release release;
+            return self.encodeInputs(encoder, x);
+        })
+        .def("encrypt_inputs", [](Conv2dHelper& self, const Encryptor& encryptor, const BatchEncoder& encoder, NumpyIn<uint64_t> inputs) {
+            auto x = getVectorFromBuffer(inputs);
+            py::gil_scoped_release release;
+            return self.encryptInputs(encryptor, encoder, x);
+        })
+        .def("conv2d", [](Conv2dHelper& self, const Evaluator& evaluator, const Cipher2d& a, const Plain2d& weights) {
+            return self.conv2d(evaluator, a, weights);
+        }, RELEASE_GIL)
+        .def("conv2d", [](Conv2dHelper& self, const Evaluator& evaluator, const Cipher2d& a, const Cipher2d& weights) {
+            return self.conv2dCipher(evaluator, a, weights);
+        }, RELEASE_GIL)
+        .def("conv2d", [](Conv2dHelper& self, const Evaluator& evaluator, const Cipher2d& a, const Cipher2d& weights, const RelinKeys& rlk) {
+            return self.conv2dCipher(evaluator, a, weights, rlk);
+        }, RELEASE_GIL)
+        .def("conv2d", [](Conv2dHelper& self, const Evaluator& evaluator, const Plain2d& a, const Cipher2d& weights) {
+            return self.conv2dReverse(evaluator, a, weights);
+        }, RELEASE_GIL)
+        .def("pack_outputs", [](Conv2dHelper& self, const Evaluator& evaluator, const GaloisKeys& autokey, const Cipher2d& x) {
+            return self.packOutputs(evaluator, autokey, x);
+        }, RELEASE_GIL)
+        .def("encode_outputs", [](Conv2dHelper& self, const BatchEncoder& encoder, NumpyIn<uint64_t> outputs) {
+            auto y = getVectorFromBuffer(outputs);
+            py::gil_scoped_release release;
+            return self.encodeOutputs(encoder, y);
+        })
+        .def("decrypt_outputs", [](Conv2dHelper& self, const BatchEncoder& encoder, Decryptor& decryptor, const Cipher2d& outputs) {
+            return getBufferFromVector(self.decryptOutputs(encoder, decryptor, outputs));
+        })
+        .def("serialize_outputs", [](Conv2dHelper& self, const Evaluator& evaluator, const Cipher2d& x) {
+            ostringstream stream; self.serializeOutputs(evaluator, x, stream);
+            return py::bytes(stream.str());
+        })
+        .def("deserialize_outputs", [](Conv2dHelper& self, const Evaluator& evaluator, const py::bytes& str) {
+            istringstream stream(str);
+            return self.deserializeOutputs(evaluator, stream);
+        })
+        ;
+
+}
@@ -0,0 +1,58 @@
+set -e
+
+echo "Making CPU-only python module"
+
+# obtain default python version
+PYVER=$(python3 -c "import sys; print('{}.{}'.format(sys.version_info.major, sys.version_info.minor))")
+
+# remove the dot in the version
+PYVER_COMPACT=${PYVER//.}
+
+echo Python version is $PYVER
+echo Python version compact is $PYVER_COMPACT
+
+# pybind11 is header-only: use the commit pinned by the extern/pybind11 submodule
+if [ ! -f extern/pybind11/include/pybind11/pybind11.h ]; then
+    echo "Checking out the pybind11 submodule"
+    if ! git submodule update --init extern/pybind11 || [ ! -f extern/pybind11/include/pybind11/pybind11.h ]; then
+        echo "error: extern/pybind11 is not checked out and 'git submodule update --init extern/pybind11' failed." >&2
+        echo "Run it by hand (it needs network access) or clone the repository with --recursive." >&2
+        exit 1
+    fi
+fi
+
+mkdir -p build_cpu
+
+for f in src/utils/*.c; do
+    gcc -O3 -fPIC -c $f -o build_cpu/$(basename $f .c).o
+done
+
+g++ -shared \
+    -std=c++17 -O3 -fPIC -pthread \
+    -I/usr/include/python${PYVER} \
+    -I./extern/pybind11/include/ \
+    -I./src \
+    src/*.cpp src/utils/*.cpp build_cpu/*.o \
+    binder/binder_cpu.cpp \
+    -o build_cpu/pytroy_cpu.cpython-${PYVER_COMPACT}-x86_64-linux-gnu.so
+
+echo "Shared lib generated"
+
+cp build_cpu/pytroy_cpu.cpython-${PYVER_COMPACT}-x86_64-linux-gnu.so ./binder/pytroy_cpu.cpython-${PYVER_COMPACT}-x86_64-linux-gnu.so
+
+echo "Copied to ./binder"
+
+# Smoke test: importing runs every binding's registration, and a context exercises the core types.
+cd binder
+python3 -c "
+import pytroy_cpu as troy
+parms = troy.EncryptionParameters(troy.SchemeType.bfv)
+parms.set_poly_modulus_degree(4096)
+parms.set_coeff_modulus(troy.CoeffModulus.bfv_default(4096))
+parms.set_plain_modulus(troy.PlainModulus.batching(4096, 20))
+context = troy.SEALContext(parms)
+troy.Evaluator(context)
+"
+cd ..
+
+echo "Import smoke test passed"
@@ -0,0 +1,146 @@
+#include "aggregator.h"
+#include "valcheck.h"
+#include "utils/common.h"
+#include "utils/polyarithsmallmod.h"
+#include "utils/polycore.h"
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+using namespace troy::util;
+
+namespace troy
+{
+    CiphertextAggregator::CiphertextAggregator(const SEALContext &context) : context_(context)
+    {
+        // Verify parameters
+        if (!context_.parametersSet())
+        {
+            throw invalid_argument("encryption parameters are not set correctly");
+        }
+    }
+
+    void CiphertextAggregator::clear() noexcept
+    {
+        sum_ = Ciphertext();
+        count_ = 0;
+        terms_.clear();
+        term_bounds_.clear();
+    }
+
+    void CiphertextAggregator::reduceLimb(Ciphertext &encrypted, size_t limb) const
+    {
+        auto &coeff_modulus = context_.getContextData(encrypted.parmsID())->parms().coeffModulus();
+        size_t coeff_count = encrypted.polyModulusDegree();
+        for (size_t i = 0; i < encrypted.size(); i++)
+        {
+            auto poly = encrypted.data(i) + limb * coeff_count;
+            moduloPolyCoeffs(poly, coeff_count, coeff_modulus[limb], poly);
+        }
+    }
+
+    void CiphertextAggregator::add(const Ciphertext &encrypted)
+    {
+        // Verify parameters.
+        if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
+        {
+            throw invalid_argument("encrypted is not valid for encryption parameters");
+        }
+
+        if (!count_)
+        {
+            sum_ = encrypted;
+            count_ = 1;
+            auto &coeff_modulus = context_.getContextData(encrypted.parmsID())->parms().coeffModulus();
+            terms_.assign(coeff_modulus.size(), 1);
+            term_bounds_.resize(coeff_modulus.size());
+            for (size_t j = 0; j < coeff_modulus.size(); j++)
+            {
+                // Every reduced addend is at most q - 1.
+                term_bounds_[j] = numeric_limits<uint64_t>::max() / (coeff_modulus[j].value() - 1);
+            }
+            return;
+        }
+
+        if (encrypted.parmsID() != sum_.parmsID())
+        {
+            throw invalid_argument("encrypted parameter mismatch");
+        }
+        if (encrypted.isNttForm() != sum_.isNttForm())
+        {
+            throw invalid_argument("NTT form mismatch");
+        }
+        if (!areClose<double>(encrypted.scale(), sum_.scale()))
+        {
+            throw invalid_argument("scale mismatch");
+        }
+        if (encrypted.correctionFactor() != sum_.correctionFactor())
+        {
+            throw invalid_argument("correction factor mismatch");
+        }
+
+        size_t coeff_count = sum_.polyModulusDegree();
+        size_t coeff_modulus_size = sum_.coeffModulusSize();
+        size_t sum_size = sum_.size();
+        size_t encrypted_size = encrypted.size();
+        size_t min_count = min(sum_size, encrypted_size);
+
+        // Make room for the part of encrypted that sum_ does not have yet; it is copied, not added.
+        if (encrypted_size > sum_size)
+        {
+            sum_.resize(context_, sum_.parmsID(), encrypted_size);
+            setPolyArray(
+                encrypted.data(sum_size), encrypted_size - sum_size, coeff_count, coeff_modulus_size,
+                sum_.data(sum_size));
+        }
+
+        for (size_t j = 0; j < coeff_modulus_size; j++)
+        {
+            if (terms_[j] == term_bounds_[j])
+            {
+                reduceLimb(sum_, j);
+                terms_[j] = 1;
+            }
+            terms_[j]++;
+            for (size_t i = 0; i < min_count; i++)
+            {
+                uint64_t *destination = sum_.data(i) + j * coeff_count;
+                const uint64_t *source = encrypted.data(i) + j * coeff_count;
+                for (size_t l = 0; l < coeff_count; l++)
+                {
+                    destination[l] += source[l];
+                }
+            }
+        }
+        count_++;
+    }
+
+    void CiphertextAggregator::merge(const CiphertextAggregator &other)
+    {
+        if (!other.count_)
+        {
+            return;
+        }
+        Ciphertext reduced;
+        other.result(reduced);
+        size_t count = count_;
+        add(reduced);
+        count_ = count + other.count_;
+    }
+
+    void CiphertextAggregator::result(Ciphertext &destination) const
+    {
+        if (!count_)
+        {
+            throw logic_error("nothing has been aggregated");
+        }
+        destination = sum_;
+        for (size_t j = 0; j < terms_.size(); j++)
+        {
+            if (terms_[j] > 1)
+            {
+                reduceLimb(destination, j);
+            }
+        }
+    }
+} // namespace troy
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "ciphertext.h"
+#include "context.h"
+#include <cstdint>
+#include <vector>
+
+namespace troy
+{
+    /**
+    Sums a stream of ciphertexts with lazy modular reduction. Each input is added to a running sum whose
+    coefficients are left unreduced as long as they cannot overflow 64 bits; an RNS limb is reduced only when
+    one more addition could overflow it. For a 60-bit prime that is once every 16 additions, and far less often
+    for smaller primes. The inputs need not be resident at the same time: add them one by one and call result()
+    at the end.
+
+    Aggregators built independently (e.g. one per thread) can be combined with merge(), which is how
+    Evaluator::addMany parallelizes large sums.
+
+    @par Thread Safety
+    A CiphertextAggregator must not be used by several threads at once.
+    */
+    class CiphertextAggregator
+    {
+    public:
+        /**
+        Creates an empty aggregator for the specified SEALContext.
+
+        @param[in] context The SEALContext
+        @throws std::invalid_argument if the encryption parameters are not valid
+        */
+        CiphertextAggregator(const SEALContext &context);
+
+        /**
+        Adds a ciphertext to the running sum. All ciphertexts added to one aggregator must have the same
+        parms_id, NTT form, scale and correction factor; they may have different sizes.
+
+        @param[in] encrypted The ciphertext to add
+        @throws std::invalid_argument if encrypted is not valid for the encryption parameters
+        @throws std::invalid_argument if encrypted does not match the ciphertexts added before
+        */
+        void add(const Ciphertext &encrypted);
+
+        /**
+        Adds the running sum of another aggregator to this one.
+
+        @param[in] other The aggregator to merge in
+        @throws std::invalid_argument if the sums do not match as described in add()
+        */
+        void merge(const CiphertextAggregator &other);
+
+        /**
+        Writes the fully reduced sum to destination. The aggregator keeps its state, so more ciphertexts can be
+        added afterwards.
+
+        @param[out] destination The ciphertext to overwrite with the sum
+        @throws std::logic_error if nothing has been added
+        */
+        void result(Ciphertext &destination) const;
+
+        /**
+        Returns the number of ciphertexts summed so far, including those of merged aggregators.
+        */
+        inline std::size_t count() const noexcept
+        {
+            return count_;
+        }
+
+        /**
+        Resets the aggregator to the empty state.
+        */
+        void clear() noexcept;
+
+    private:
+        void reduceLimb(Ciphertext &encrypted, std::size_t limb) const;
+
+        SEALContext context_;
+
+        Ciphertext sum_;
+
+        std::size_t count_ = 0;
+
+        // Number of addends folded into each RNS limb of sum_ since it was last reduced.
+        std::vector<std::uint64_t> terms_;
+
+        // Largest number of reduced addends an RNS limb can hold without overflowing 64 bits.
+        std::vector<std::uint64_t> term_bounds_;
+    };
+} // namespace troy
@@ -2,6 +2,7 @@
 // Licensed under the MIT license.
 
 #include "batchencoder.h"
+#include "instrumentation.h"
 #include "valcheck.h"
 #include "utils/common.h"
 #include <algorithm>
@@ -103,11 +104,10 @@ namespace troy
 
     void BatchEncoder::encode(const vector<uint64_t> &values_matrix, Plaintext &destination) const
     {
-        auto &context_data = *context_.firstContextData();
+        TROY_INSTRUMENT_OPERATION(encode, context_, parmsIDZero);
 
         // Validate input parameters
-        size_t values_matrix_size = values_matrix.size();
-        if (values_matrix_size > slots_)
+        if (values_matrix.size() > slots_)
         {
             throw invalid_argument("values_matrix size is too large");
         }
@@ -115,57 +115,74 @@ namespace troy
         destination.resize(slots_);
         destination.parmsID() = parmsIDZero;
 
+        encodeSlots(values_matrix, destination.data());
+    }
+
+    void BatchEncoder::encode(const vector<int64_t> &values_matrix, Plaintext &destination) const
+    {
+        TROY_INSTRUMENT_OPERATION(encode, context_, parmsIDZero);
+
+        // Validate input parameters
+        if (values_matrix.size() > slots_)
+        {
+            throw invalid_argument("values_matrix size is too large");
+        }
+        // Set destination to full size
+        destination.resize(slots_);
+        destination.parmsID() = parmsIDZero;
+
+        encodeSlots(values_matrix, destination.data());
+    }
+
+    void BatchEncoder::encodeSlots(const vector<uint64_t> &values_matrix, uint64_t *destination) const
+    {
+        auto &context_data = *context_.firstContextData();
+        size_t values_matrix_size = values_matrix.size();
+
         // First write the values to destination coefficients.
         // Read in top row, then bottom row.
         for (size_t i = 0; i < values_matrix_size; i++)
         {
-            *(destination.data() + matrix_reps_index_map_[i]) = values_matrix[i];
+            destination[matrix_reps_index_map_[i]] = values_matrix[i];
         }
         for (size_t i = values_matrix_size; i < slots_; i++)
         {
-            *(destination.data() + matrix_reps_index_map_[i]) = 0;
+            destination[matrix_reps_index_map_[i]] = 0;
         }
 
         // Transform destination using inverse of negacyclic NTT
         // Note: We already performed bit-reversal when reading in the matrix
-        inverseNttNegacyclicHarvey(destination.data(), *context_data.plainNTTTables());
+        inverseNttNegacyclicHarvey(destination, *context_data.plainNTTTables());
     }
 
-    void BatchEncoder::encode(const vector<int64_t> &values_matrix, Plaintext &destination) const
+    void BatchEncoder::encodeSlots(const vector<int64_t> &values_matrix, uint64_t *destination) const
     {
         auto &context_data = *context_.firstContextData();
         uint64_t modulus = context_data.parms().plainModulus().value();
-
-        // Validate input parameters
         size_t values_matrix_size = values_matrix.size();
-        if (values_matrix_size > slots_)
-        {
-            throw invalid_argument("values_matrix size is too large");
-        }
-        // Set destination to full size
-        destination.resize(slots_);
-        destination.parmsID() = parmsIDZero;
 
         // First write the values to destination coefficients.
         // Read in top row, then bottom row.
         for (size_t i = 0; i < values_matrix_size; i++)
         {
-            *(destination.data() + matrix_reps_index_map_[i]) =
+            destination[matrix_reps_index_map_[i]] =
                 (values_matrix[i] < 0) ? (modulus + static_cast<uint64_t>(values_matrix[i]))
                                        : static_cast<uint64_t>(values_matrix[i]);
         }
         for (size_t i = values_matrix_size; i < slots_; i++)
         {
-            *(destination.data() + matrix_reps_index_map_[i]) = 0;
+            destination[matrix_reps_index_map_[i]] = 0;
         }
 
         // Transform destination using inverse of negacyclic NTT
         // Note: We already performed bit-reversal when reading in the matrix
-        inverseNttNegacyclicHarvey(destination.data(), *context_data.plainNTTTables());
+        inverseNttNegacyclicHarvey(destination, *context_data.plainNTTTables());
     }
 
     void BatchEncoder::decode(const Plaintext &plain, vector<uint64_t> &destination) const
     {
+        TROY_INSTRUMENT_OPERATION(decode, context_, plain.parmsID());
+
         if (!isValidFor(plain, context_))
         {
             throw invalid_argument("plain is not valid for encryption parameters");
@@ -175,11 +192,6 @@ namespace troy
             throw invalid_argument("plain cannot be in NTT form");
         }
 
-        auto &context_data = *context_.firstContextData();
-
-        // Set destination size
-        destination.resize(slots_);
-
         // Never include the leading zero coefficient (if present)
         size_t plain_coeff_count = min(plain.coeffCount(), slots_);
 
@@ -189,18 +201,13 @@ namespace troy
         setUint(plain.data(), plain_coeff_count, temp_dest.get());
         setZeroUint(slots_ - plain_coeff_count, temp_dest.get() + plain_coeff_count);
 
-        // Transform destination using negacyclic NTT.
-        nttNegacyclicHarvey(temp_dest.get(), *context_data.plainNTTTables());
-
-        // Read top row, then bottom row
-        for (size_t i = 0; i < slots_; i++)
-        {
-            destination[i] = temp_dest[matrix_reps_index_map_[i]];
-        }
+        decodeSlots(temp_dest.get(), destination);
     }
 
     void BatchEncoder::decode(const Plaintext &plain, vector<int64_t> &destination) const
     {
+        TROY_INSTRUMENT_OPERATION(decode, context_, plain.parmsID());
+
         if (!isValidFor(plain, context_))
         {
             throw invalid_argument("plain is not valid for encryption parameters");
@@ -210,12 +217,6 @@ namespace troy
             throw invalid_argument("plain cannot be in NTT form");
         }
 
-        auto &context_data = *context_.firstContextData();
-        uint64_t modulus = context_data.parms().plainModulus().value();
-
-        // Set destination size
-        destination.resize(slots_);
-
         // Never include the leading zero coefficient (if present)
         size_t plain_coeff_count = min(plain.coeffCount(), slots_);
 
@@ -225,14 +226,120 @@ namespace troy
         setUint(plain.data(), plain_coeff_count, temp_dest.get());
         setZeroUint(slots_ - plain_coeff_count, temp_dest.get() + plain_coeff_count);
 
+        decodeSlots(temp_dest.get(), destination);
+    }
+
+    void BatchEncoder::decodeSlots(uint64_t *coefficients, vector<uint64_t> &destination) const
+    {
+        auto &context_data = *context_.firstContextData();
+
+        // Set destination size
+        destination.resize(slots_);
+
         // Transform destination using negacyclic NTT.
-        nttNegacyclicHarvey(temp_dest.get(), *context_data.plainNTTTables());
+        nttNegacyclicHarvey(coefficients, *context_data.plainNTTTables());
+
+        // Read top row, then bottom row
+        for (size_t i = 0; i < slots_; i++)
+        {
+            destination[i] = coefficients[matrix_reps_index_map_[i]];
+        }
+    }
+
+    void BatchEncoder::decodeSlots(uint64_t *coefficients, vector<int64_t> &destination) const
+    {
+        auto &context_data = *context_.firstContextData();
+        uint64_t modulus = context_data.parms().plainModulus().value();
+
+        // Set destination size
+        destination.resize(slots_);
+
+        // Transform destination using negacyclic NTT.
+        nttNegacyclicHarvey(coefficients, *context_data.plainNTTTables());
 
         // Read top row, then bottom row
         uint64_t plain_modulus_div_two = modulus >> 1;
         for (size_t i = 0; i < slots_; i++)
         {
-            uint64_t curr_value = temp_dest[matrix_reps_index_map_[i]];
+            uint64_t curr_value = coefficients[matrix_reps_index_map_[i]];
+            destination[i] = (curr_value > plain_modulus_div_two)
+                                 ? (static_cast<int64_t>(curr_value) - static_cast<int64_t>(modulus))
+                                 : static_cast<int64_t>(curr_value);
+        }
+    }
+
+    void BatchEncoder::encodePolynomial(const vector<uint64_t> &values, Plaintext &destination) const
+    {
+        auto &context_data = *context_.firstContextData();
+        uint64_t modulus = context_data.parms().plainModulus().value();
+
+        // Validate input parameters
+        size_t values_matrix_size = values.size();
+        if (values_matrix_size > slots_)
+        {
+            throw invalid_argument("values_matrix size is too large");
+        }
+
+        // Set destination to full size
+        destination.resize(values_matrix_size);
+        destination.parmsID() = parmsIDZero;
+
+        for (size_t i = 0; i < values_matrix_size; i++)
+        {
+            destination[i] = values[i] % modulus;
+        }
+    }
+
+    void BatchEncoder::encodePolynomial(const vector<int64_t> &values, Plaintext &destination) const
+    {
+        auto &context_data = *context_.firstContextData();
+        uint64_t modulus = context_data.parms().plainModulus().value();
+
+        // Validate input parameters
+        size_t values_matrix_size = values.size();
+        if (values_matrix_size > slots_)
+        {
+            throw invalid_argument("values_matrix size is too large");
+        }
+
+        // Set destination to full size
+        destination.resize(values_matrix_size);
+        destination.parmsID() = parmsIDZero;
+
+        for (size_t i = 0; i < values_matrix_size; i++)
+        {
+            int64_t value = values[i];
+            destination[i] = (value < 0) ? (modulus - (static_cast<uint64_t>(-value) % modulus)) % modulus
+                                         : static_cast<uint64_t>(value) % modulus;
+        }
+    }
+
+    void BatchEncoder::decodePolynomial(const Plaintext &plain, vector<uint64_t> &destination) const
+    {
+        if (plain.isNttForm())
+        {
+            throw invalid_argument("plain cannot be in NTT form");
+        }
+        size_t plain_coeff_count = min(plain.coeffCount(), slots_);
+        destination.resize(plain_coeff_count);
+        copy_n(plain.data(), plain_coeff_count, destination.data());
+    }
+
+    void BatchEncoder::decodePolynomial(const Plaintext &plain, vector<int64_t> &destination) const
+    {
+        if (plain.isNttForm())
+        {
+            throw invalid_argument("plain cannot be in NTT form");
+        }
+        auto &context_data = *context_.firstContextData();
+        uint64_t modulus = context_data.parms().plainModulus().value();
+        uint64_t plain_modulus_div_two = modulus >> 1;
+
+        size_t plain_coeff_count = min(plain.coeffCount(), slots_);
+        destination.resize(plain_coeff_count);
+        for (size_t i = 0; i < plain_coeff_count; i++)
+        {
+            uint64_t curr_value = plain[i];
             destination[i] = (curr_value > plain_modulus_div_two)
                                  ? (static_cast<int64_t>(curr_value) - static_cast<int64_t>(modulus))
                                  : static_cast<int64_t>(curr_value);
@@ -48,6 +48,8 @@ namespace troy
     class BatchEncoder
     {
         friend class BatchEncoderCuda;
+        friend class Encryptor;
+        friend class Decryptor;
     public:
         /**
         Creates a BatchEncoder. It is necessary that the encryption parameters
@@ -132,6 +134,35 @@ namespace troy
         void decode(
             const Plaintext &plain, std::vector<std::int64_t> &destination) const;
 
+        /**
+        Writes the given values directly as the coefficients of the destination
+        plaintext, without batching. Values are reduced modulo the plaintext modulus,
+        and the plaintext has exactly values.size() coefficients.
+
+        @param[in] values The polynomial coefficients, at most slotCount() of them
+        @param[out] destination The plaintext polynomial to overwrite
+        @throws std::invalid_argument if values is too large
+        */
+        void encodePolynomial(const std::vector<std::uint64_t> &values, Plaintext &destination) const;
+
+        /**
+        Signed variant of encodePolynomial. Negative values are mapped to their
+        representatives modulo the plaintext modulus.
+        */
+        void encodePolynomial(const std::vector<std::int64_t> &values, Plaintext &destination) const;
+
+        /**
+        Inverse of encodePolynomial. Reads the coefficients of the given plaintext,
+        at most slotCount() of them.
+        */
+        void decodePolynomial(const Plaintext &plain, std::vector<std::uint64_t> &destination) const;
+
+        /**
+        Inverse of the signed encodePolynomial. Coefficients greater than half of
+        the plaintext modulus are returned as negative values.
+        */
+        void decodePolynomial(const Plaintext &plain, std::vector<std::int64_t> &destination) const;
+
         /**
         Returns the number of slots.
         */
@@ -155,6 +186,17 @@ namespace troy
 
         void reverseBits(std::uint64_t *input);
 
+        // Batches values (at most slotCount() of them) into the slotCount() coefficients at destination. Used by
+        // encode and by the fused Encryptor::encryptValues, which has no Plaintext to write to.
+        void encodeSlots(const std::vector<std::uint64_t> &values, std::uint64_t *destination) const;
+
+        void encodeSlots(const std::vector<std::int64_t> &values, std::uint64_t *destination) const;
+
+        // Unbatches the slotCount() coefficients at coefficients, which are overwritten by their NTT.
+        void decodeSlots(std::uint64_t *coefficients, std::vector<std::uint64_t> &destination) const;
+
+        void decodeSlots(std::uint64_t *coefficients, std::vector<std::int64_t> &destination) const;
+
         SEALContext context_;
 
         std::size_t slots_;
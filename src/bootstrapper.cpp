@@ -0,0 +1,683 @@
+#include "bootstrapper.h"
+#include "utils/common.h"
+#include "utils/uintarithsmallmod.h"
+#include "valcheck.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <set>
+#include <stdexcept>
+
+using namespace std;
+using namespace troy::util;
+
+namespace troy
+{
+    namespace
+    {
+        using Diagonals = map<size_t, vector<complex<double>>>;
+
+        const double pi = 3.1415926535897932384626433832795028842;
+
+        // rot(x, r)[p] = x[(p + r) mod n], the slot rotation Evaluator::rotateVector performs for r steps.
+        vector<complex<double>> rotated(const vector<complex<double>> &values, size_t steps)
+        {
+            size_t n = values.size();
+            vector<complex<double>> result(n);
+            for (size_t p = 0; p < n; p++)
+            {
+                result[p] = values[(p + steps) % n];
+            }
+            return result;
+        }
+
+        // The map applying b first and then a: the diagonal a + b collects d^a_a * rot(d^b_b, a).
+        Diagonals compose(const Diagonals &a, const Diagonals &b, size_t n)
+        {
+            Diagonals result;
+            for (auto &[ra, da] : a)
+            {
+                for (auto &[rb, db] : b)
+                {
+                    auto &d = result[(ra + rb) % n];
+                    if (d.empty())
+                    {
+                        d.assign(n, 0);
+                    }
+                    auto shifted = rotated(db, ra);
+                    for (size_t p = 0; p < n; p++)
+                    {
+                        d[p] += da[p] * shifted[p];
+                    }
+                }
+            }
+            return result;
+        }
+
+        // Multiplies output slot p by factors[p].
+        void scaleRows(Diagonals &diagonals, const vector<complex<double>> &factors)
+        {
+            for (auto &[r, d] : diagonals)
+            {
+                for (size_t p = 0; p < d.size(); p++)
+                {
+                    d[p] *= factors[p];
+                }
+            }
+        }
+
+        // Multiplies input slot p by factors[p]; diagonal r reads input slot p + r into output slot p.
+        void scaleColumns(Diagonals &diagonals, const vector<complex<double>> &factors)
+        {
+            for (auto &[r, d] : diagonals)
+            {
+                auto shifted = rotated(factors, r);
+                for (size_t p = 0; p < d.size(); p++)
+                {
+                    d[p] *= shifted[p];
+                }
+            }
+        }
+
+        void conjugate(Diagonals &diagonals)
+        {
+            for (auto &[r, d] : diagonals)
+            {
+                for (auto &value : d)
+                {
+                    value = conj(value);
+                }
+            }
+        }
+
+        // Drops the diagonals that vanish up to rounding.
+        void prune(Diagonals &diagonals)
+        {
+            double largest = 0;
+            for (auto &[r, d] : diagonals)
+            {
+                for (auto &value : d)
+                {
+                    largest = max(largest, abs(value));
+                }
+            }
+            for (auto it = diagonals.begin(); it != diagonals.end();)
+            {
+                bool vanishes = all_of(it->second.begin(), it->second.end(), [&](const complex<double> &value) {
+                    return abs(value) <= 1e-12 * largest;
+                });
+                it = vanishes ? diagonals.erase(it) : next(it);
+            }
+        }
+
+        /*
+        Slot j of a CKKS plaintext holds t(zeta^(3^j)) for the primitive 2N-th root zeta. Conjugating the odd slots
+        turns the exponents into a_j = (-1)^j 3^j, which are 1 mod 4; then the slots are the FFT of c = t_lo + i t_hi
+        (the two halves of the coefficients) taken in bit-reversed order, factored as B_n ... B_4 B_2. B_m acts on
+        blocks of m slots: for j < m / 2 it sends (u_j, u_(j + m/2)) to (u_j + w_j u_(j + m/2), u_j - w_j u_(j +
+        m/2)), with w_j = exp(i pi a_j / (2m)) and a_j taken mod 4m.
+        */
+        Diagonals butterfly(size_t n, size_t m, bool inverse)
+        {
+            size_t h = m / 2;
+            Diagonals d;
+            d[0].assign(n, 0);
+            d[h].assign(n, 0);
+            d[(n - h) % n].assign(n, 0);
+
+            vector<complex<double>> twiddles(h);
+            uint64_t modulus = 4 * static_cast<uint64_t>(m);
+            uint64_t power = 1;
+            for (size_t j = 0; j < h; j++)
+            {
+                uint64_t exponent = (j & 1) ? modulus - power : power;
+                twiddles[j] = polar(1.0, pi * static_cast<double>(exponent) / static_cast<double>(2 * m));
+                power = power * 3 % modulus;
+            }
+
+            for (size_t p = 0; p < n; p++)
+            {
+                size_t j = p % m;
+                if (j < h)
+                {
+                    d[0][p] += inverse ? 0.5 : 1.0;
+                    d[h][p] += inverse ? complex<double>(0.5) : twiddles[j];
+                }
+                else
+                {
+                    auto w = twiddles[j - h];
+                    d[(n - h) % n][p] += inverse ? 0.5 / w : 1.0;
+                    d[0][p] -= inverse ? 0.5 / w : w;
+                }
+            }
+            return d;
+        }
+
+        // Splits the log2(n) butterflies into the given number of factors, as evenly as possible, and returns the
+        // factors in the order they are applied: B_2 first for the forward transform, B_n^-1 first for the inverse.
+        vector<Diagonals> dftFactors(size_t n, size_t factor_count, bool inverse)
+        {
+            size_t log_n = static_cast<size_t>(getPowerOfTwo(n));
+            vector<Diagonals> factors;
+            size_t layer = 0;
+            for (size_t i = 0; i < factor_count; i++)
+            {
+                size_t count = log_n / factor_count + (i < log_n % factor_count ? 1 : 0);
+                Diagonals factor;
+                for (size_t end = layer + count; layer < end; layer++)
+                {
+                    size_t m = inverse ? (n >> layer) : (size_t(2) << layer);
+                    auto b = butterfly(n, m, inverse);
+                    factor = factor.empty() ? move(b) : compose(b, factor, n);
+                }
+                prune(factor);
+                factors.push_back(move(factor));
+            }
+            return factors;
+        }
+
+        // The rotation r in [0, n) as a signed step in (-n/2, n/2].
+        int signedStep(size_t r, size_t n)
+        {
+            return r > n / 2 ? static_cast<int>(r) - static_cast<int>(n) : static_cast<int>(r);
+        }
+    } // namespace
+
+    CKKSBootstrapper::CKKSBootstrapper(const SEALContext &context, const CKKSBootstrapParameters &parms)
+        : context_(context), parms_(parms), encoder_(context), evaluator_(context)
+    {
+        slots_ = encoder_.slotCount();
+        size_t log_slots = static_cast<size_t>(getPowerOfTwo(slots_));
+        if (parms_.coeff_to_slot_levels == 0 || parms_.coeff_to_slot_levels > log_slots ||
+            parms_.slot_to_coeff_levels == 0 || parms_.slot_to_coeff_levels > log_slots)
+        {
+            throw invalid_argument("DFT levels are out of range");
+        }
+        if (parms_.eval_mod_degree == 0 || !(parms_.eval_mod_range > 0))
+        {
+            throw invalid_argument("EvalMod parameters are out of range");
+        }
+
+        // Data levels from the top of the chain down to q_0 alone.
+        vector<shared_ptr<const SEALContext::ContextData>> levels;
+        for (auto context_data = context_.firstContextData(); context_data;
+             context_data = context_data->nextContextData())
+        {
+            levels.push_back(context_data);
+        }
+        if (levels.size() <= depth())
+        {
+            throw invalid_argument("modulus chain is too short for bootstrapping");
+        }
+        auto last_prime = [&](size_t level) {
+            return static_cast<double>(levels[level]->parms().coeffModulus().back().value());
+        };
+        double q0 = static_cast<double>(levels.back()->parms().coeffModulus()[0].value());
+        size_t coeff_to_slot_levels = parms_.coeff_to_slot_levels;
+        size_t slot_to_coeff_start = coeff_to_slot_levels + evalModDepth();
+        eval_mod_scale_ = last_prime(coeff_to_slot_levels);
+        slot_to_coeff_scale_ = last_prime(slot_to_coeff_start);
+
+        // Chebyshev interpolation at the roots of T_(d+1).
+        size_t degree = parms_.eval_mod_degree;
+        double range = parms_.eval_mod_range;
+        double angle_scale = ldexp(1.0, -static_cast<int>(parms_.double_angle_count));
+        eval_mod_coefficients_.assign(degree + 1, 0);
+        for (size_t j = 0; j <= degree; j++)
+        {
+            double theta = pi * (static_cast<double>(j) + 0.5) / static_cast<double>(degree + 1);
+            double value = cos(2 * pi * (range * cos(theta) - 0.25) * angle_scale);
+            for (size_t k = 0; k <= degree; k++)
+            {
+                eval_mod_coefficients_[k] +=
+                    2 * value * cos(static_cast<double>(k) * theta) / static_cast<double>(degree + 1);
+            }
+        }
+        eval_mod_coefficients_[0] /= 2;
+
+        vector<complex<double>> sign(slots_), even(slots_), odd(slots_);
+        for (size_t p = 0; p < slots_; p++)
+        {
+            sign[p] = (p & 1) ? -1.0 : 1.0;
+            even[p] = (p & 1) ? 0.0 : 1.0;
+            odd[p] = (p & 1) ? 1.0 : 0.0;
+        }
+
+        // CoeffToSlot applies S F'^-1 / 2K, with S the alternating signs, to the slots with the odd ones conjugated;
+        // the first factor reads the even slots from the input and the odd ones from its conjugate. The scale goes
+        // from q_0 down to eval_mod_scale_ by the same ratio in every factor, which keeps all plaintexts equally
+        // precise.
+        auto coeff_to_slot = dftFactors(slots_, coeff_to_slot_levels, true);
+        vector<complex<double>> last_rows(slots_);
+        for (size_t p = 0; p < slots_; p++)
+        {
+            last_rows[p] = sign[p] / (2 * range);
+        }
+        scaleRows(coeff_to_slot.back(), last_rows);
+        Diagonals first_conjugate = coeff_to_slot.front();
+        scaleColumns(coeff_to_slot.front(), even);
+        scaleColumns(first_conjugate, odd);
+        prune(coeff_to_slot.front());
+        prune(first_conjugate);
+        double ratio = pow(eval_mod_scale_ / q0, 1.0 / static_cast<double>(coeff_to_slot_levels));
+        for (size_t i = 0; i < coeff_to_slot_levels; i++)
+        {
+            coeff_to_slot_.push_back(createStage(
+                coeff_to_slot[i], i == 0 ? &first_conjugate : nullptr, levels[i]->parmsID(), last_prime(i) * ratio));
+        }
+
+        // SlotToCoeff applies F' S q_0 / (2 pi slot_to_coeff_scale_) and undoes the conjugation of the odd slots in
+        // its last factor.
+        auto slot_to_coeff = dftFactors(slots_, parms_.slot_to_coeff_levels, false);
+        vector<complex<double>> first_columns(slots_);
+        for (size_t p = 0; p < slots_; p++)
+        {
+            first_columns[p] = sign[p] * q0 / (2 * pi * slot_to_coeff_scale_);
+        }
+        scaleColumns(slot_to_coeff.front(), first_columns);
+        Diagonals last_conjugate = slot_to_coeff.back();
+        conjugate(last_conjugate);
+        scaleRows(last_conjugate, odd);
+        scaleRows(slot_to_coeff.back(), even);
+        prune(slot_to_coeff.back());
+        prune(last_conjugate);
+        for (size_t i = 0; i < parms_.slot_to_coeff_levels; i++)
+        {
+            size_t level = slot_to_coeff_start + i;
+            slot_to_coeff_.push_back(createStage(
+                slot_to_coeff[i], i + 1 == parms_.slot_to_coeff_levels ? &last_conjugate : nullptr,
+                levels[level]->parmsID(), last_prime(level)));
+        }
+    }
+
+    auto CKKSBootstrapper::createStage(
+        const Diagonals &diagonals, const Diagonals *conjugate_diagonals, ParmsID parms_id, double scale)
+        -> LinearStage
+    {
+        // Baby steps are r mod g and giant steps the rest, for the power of two g that needs the fewest rotations.
+        set<int> steps;
+        for (auto &[r, d] : diagonals)
+        {
+            steps.insert(signedStep(r, slots_));
+        }
+        if (conjugate_diagonals)
+        {
+            for (auto &[r, d] : *conjugate_diagonals)
+            {
+                steps.insert(signedStep(r, slots_));
+            }
+        }
+        auto split = [&](size_t g, set<int> &babies, set<int> &giants) {
+            for (int step : steps)
+            {
+                int baby = ((step % static_cast<int>(g)) + static_cast<int>(g)) % static_cast<int>(g);
+                babies.insert(baby);
+                giants.insert(signedStep(static_cast<size_t>(step - baby + static_cast<int>(slots_)) % slots_, slots_));
+            }
+        };
+        size_t best_g = 1;
+        size_t best_cost = numeric_limits<size_t>::max();
+        for (size_t g = 1; g <= slots_; g <<= 1)
+        {
+            set<int> babies, giants;
+            split(g, babies, giants);
+            size_t cost = (babies.size() - babies.count(0)) * (conjugate_diagonals ? 2 : 1) + giants.size() -
+                          giants.count(0);
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_g = g;
+            }
+        }
+        set<int> babies, giants;
+        split(best_g, babies, giants);
+
+        LinearStage stage;
+        stage.baby_steps.assign(babies.begin(), babies.end());
+        stage.giant_steps.assign(giants.begin(), giants.end());
+        size_t count = babies.size() * giants.size();
+        auto encodeAll = [&](const Diagonals &source, vector<Plaintext> &destination) {
+            destination.resize(count);
+            for (size_t g = 0; g < stage.giant_steps.size(); g++)
+            {
+                size_t giant = static_cast<size_t>(stage.giant_steps[g] + static_cast<int>(slots_)) % slots_;
+                for (size_t b = 0; b < stage.baby_steps.size(); b++)
+                {
+                    auto it = source.find((giant + static_cast<size_t>(stage.baby_steps[b])) % slots_);
+                    if (it != source.end())
+                    {
+                        encoder_.encode(
+                            rotated(it->second, (slots_ - giant) % slots_), parms_id, scale,
+                            destination[g * stage.baby_steps.size() + b]);
+                    }
+                }
+            }
+        };
+        encodeAll(diagonals, stage.diagonals);
+        if (conjugate_diagonals)
+        {
+            encodeAll(*conjugate_diagonals, stage.conjugate_diagonals);
+        }
+        return stage;
+    }
+
+    vector<uint32_t> CKKSBootstrapper::galoisElements() const
+    {
+        set<int> steps{ 0 };
+        for (auto *stages : { &coeff_to_slot_, &slot_to_coeff_ })
+        {
+            for (auto &stage : *stages)
+            {
+                steps.insert(stage.baby_steps.begin(), stage.baby_steps.end());
+                steps.insert(stage.giant_steps.begin(), stage.giant_steps.end());
+            }
+        }
+        // Step 0 stands for the conjugation, which every bootstrapping needs.
+        auto galois_tool = context_.keyContextData()->galoisTool();
+        vector<uint32_t> elements;
+        for (int step : steps)
+        {
+            elements.push_back(galois_tool->getEltFromStep(step));
+        }
+        return elements;
+    }
+
+    void CKKSBootstrapper::modRaise(const Ciphertext &encrypted, Ciphertext &destination) const
+    {
+        if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
+        {
+            throw invalid_argument("encrypted is not valid for encryption parameters");
+        }
+        if (!encrypted.isNttForm())
+        {
+            throw invalid_argument("encrypted is not in NTT form");
+        }
+        if (encrypted.size() != 2)
+        {
+            throw invalid_argument("encrypted size must be 2");
+        }
+
+        Ciphertext lowest;
+        evaluator_.modSwitchTo(encrypted, context_.lastParmsID(), lowest);
+        evaluator_.transformFromNttInplace(lowest);
+        auto &q0 = context_.lastContextData()->parms().coeffModulus()[0];
+        uint64_t half_q0 = q0.value() >> 1;
+
+        // Lift each coefficient to (-q_0 / 2, q_0 / 2] and reduce it modulo every prime of the top level.
+        auto &top = *context_.firstContextData();
+        auto &coeff_modulus = top.parms().coeffModulus();
+        size_t coeff_count = top.parms().polyModulusDegree();
+        destination.resize(context_, top.parmsID(), 2);
+        for (size_t poly = 0; poly < 2; poly++)
+        {
+            const uint64_t *source = lowest.data(poly);
+            uint64_t *target = destination.data(poly);
+            for (size_t i = 0; i < coeff_modulus.size(); i++)
+            {
+                auto &modulus = coeff_modulus[i];
+                for (size_t j = 0; j < coeff_count; j++)
+                {
+                    uint64_t value = source[j];
+                    target[i * coeff_count + j] = value > half_q0
+                                                      ? negateUintMod(barrettReduce64(q0.value() - value, modulus), modulus)
+                                                      : barrettReduce64(value, modulus);
+                }
+            }
+        }
+        destination.isNttForm() = false;
+        evaluator_.transformToNttInplace(destination);
+        destination.scale() = static_cast<double>(q0.value());
+    }
+
+    void CKKSBootstrapper::bootstrap(
+        const Ciphertext &encrypted, const RelinKeys &relin_keys, const GaloisKeys &galois_keys,
+        Ciphertext &destination)
+    {
+        double scale = encrypted.scale();
+        Ciphertext raised;
+        modRaise(encrypted, raised);
+
+        // CoeffToSlot leaves S (t_lo + i t_hi) / (q_0 K) in the slots, with S the alternating signs.
+        for (auto &stage : coeff_to_slot_)
+        {
+            evaluateStage(stage, raised, galois_keys);
+        }
+        raised.scale() = eval_mod_scale_;
+
+        // Split it into 2 S t_lo / (q_0 K) and, after multiplying by X^(N/2), -2 t_hi / (q_0 K); both are real.
+        Ciphertext conjugated, real_part;
+        evaluator_.complexConjugate(raised, galois_keys, conjugated);
+        evaluator_.add(raised, conjugated, real_part);
+        evaluator_.subInplace(raised, conjugated);
+        multiplyHalfDegreeMonomial(raised);
+
+        evalMod(real_part, relin_keys);
+        evalMod(raised, relin_keys);
+
+        // Recombine into S (2 pi / q_0) (m_lo + i m_hi) and move back to the coefficients.
+        multiplyHalfDegreeMonomial(raised);
+        evaluator_.subInplace(real_part, raised);
+        for (auto &stage : slot_to_coeff_)
+        {
+            evaluateStage(stage, real_part, galois_keys);
+        }
+        real_part.scale() = scale;
+        destination = move(real_part);
+    }
+
+    void CKKSBootstrapper::evaluateStage(
+        const LinearStage &stage, Ciphertext &encrypted, const GaloisKeys &galois_keys) const
+    {
+        size_t baby_count = stage.baby_steps.size();
+        bool reads_conjugate = !stage.conjugate_diagonals.empty();
+        vector<Ciphertext> rotated_input(baby_count);
+        vector<Ciphertext> rotated_conjugate(reads_conjugate ? baby_count : 0);
+        Ciphertext conjugated;
+        if (reads_conjugate)
+        {
+            evaluator_.complexConjugate(encrypted, galois_keys, conjugated);
+        }
+        for (size_t b = 0; b < baby_count; b++)
+        {
+            int step = stage.baby_steps[b];
+            if (step == 0)
+            {
+                rotated_input[b] = encrypted;
+                if (reads_conjugate)
+                {
+                    rotated_conjugate[b] = conjugated;
+                }
+                continue;
+            }
+            evaluator_.rotateVector(encrypted, step, galois_keys, rotated_input[b]);
+            if (reads_conjugate)
+            {
+                evaluator_.rotateVector(conjugated, step, galois_keys, rotated_conjugate[b]);
+            }
+        }
+
+        Ciphertext result, temp;
+        bool has_result = false;
+        for (size_t g = 0; g < stage.giant_steps.size(); g++)
+        {
+            Ciphertext inner;
+            bool has_inner = false;
+            auto accumulate = [&](const Ciphertext &input, const Plaintext &plain) {
+                if (plain.coeffCount() == 0)
+                {
+                    return;
+                }
+                if (!has_inner)
+                {
+                    evaluator_.multiplyPlain(input, plain, inner);
+                    has_inner = true;
+                }
+                else
+                {
+                    evaluator_.multiplyPlain(input, plain, temp);
+                    evaluator_.addInplace(inner, temp);
+                }
+            };
+            for (size_t b = 0; b < baby_count; b++)
+            {
+                accumulate(rotated_input[b], stage.diagonals[g * baby_count + b]);
+                if (reads_conjugate)
+                {
+                    accumulate(rotated_conjugate[b], stage.conjugate_diagonals[g * baby_count + b]);
+                }
+            }
+            if (!has_inner)
+            {
+                continue;
+            }
+            if (stage.giant_steps[g] != 0)
+            {
+                evaluator_.rotateVectorInplace(inner, stage.giant_steps[g], galois_keys);
+            }
+            if (!has_result)
+            {
+                result = move(inner);
+                has_result = true;
+            }
+            else
+            {
+                evaluator_.addInplace(result, inner);
+            }
+        }
+        evaluator_.rescaleToNextInplace(result);
+        encrypted = move(result);
+    }
+
+    void CKKSBootstrapper::evalMod(Ciphertext &encrypted, const RelinKeys &relin_keys)
+    {
+        // T_1 .. T_d of the input, by T_(a+b) = 2 T_a T_b - T_(b-a) with b - a = 0 or 1.
+        size_t degree = parms_.eval_mod_degree;
+        vector<Ciphertext> chebyshev(degree + 1);
+        chebyshev[1] = encrypted;
+        for (size_t k = 2; k <= degree; k++)
+        {
+            size_t a = k / 2;
+            size_t b = k - a;
+            Ciphertext &t = chebyshev[k];
+            t = chebyshev[b];
+            multiplyRescale(t, chebyshev[a], relin_keys);
+            evaluator_.addInplace(t, t);
+            if (a == b)
+            {
+                addConstant(t, -1.0);
+            }
+            else
+            {
+                Ciphertext correction = chebyshev[1];
+                multiplyConstant(correction, 1.0, t.scale());
+                evaluator_.modSwitchToInplace(correction, t.parmsID());
+                evaluator_.subInplace(t, correction);
+            }
+        }
+
+        // The scale to sum the series at, so that the squarings of the double-angle steps end at the scale
+        // SlotToCoeff expects.
+        ParmsID parms_id = chebyshev[degree].parmsID();
+        auto context_data = context_.getContextData(parms_id);
+        vector<double> dropped;
+        for (auto next = context_data->nextContextData(); dropped.size() < parms_.double_angle_count;
+             next = next->nextContextData())
+        {
+            dropped.push_back(static_cast<double>(next->parms().coeffModulus().back().value()));
+        }
+        double target_scale = slot_to_coeff_scale_;
+        for (size_t i = dropped.size(); i-- > 0;)
+        {
+            target_scale = sqrt(target_scale * dropped[i]);
+        }
+
+        double q = static_cast<double>(context_data->parms().coeffModulus().back().value());
+        Ciphertext sum, term;
+        bool has_sum = false;
+        for (size_t k = 1; k <= degree; k++)
+        {
+            if (eval_mod_coefficients_[k] == 0)
+            {
+                continue;
+            }
+            evaluator_.modSwitchTo(chebyshev[k], parms_id, term);
+            Plaintext plain;
+            encoder_.encode(eval_mod_coefficients_[k], parms_id, target_scale * q / term.scale(), plain);
+            evaluator_.multiplyPlainInplace(term, plain);
+            term.scale() = target_scale * q;
+            if (!has_sum)
+            {
+                sum = move(term);
+                has_sum = true;
+            }
+            else
+            {
+                evaluator_.addInplace(sum, term);
+            }
+        }
+        evaluator_.rescaleToNextInplace(sum);
+        sum.scale() = target_scale;
+        addConstant(sum, eval_mod_coefficients_[0]);
+
+        // cos(2x) = 2 cos(x)^2 - 1
+        for (size_t i = 0; i < parms_.double_angle_count; i++)
+        {
+            evaluator_.squareInplace(sum);
+            evaluator_.relinearizeInplace(sum, relin_keys);
+            evaluator_.rescaleToNextInplace(sum);
+            evaluator_.addInplace(sum, sum);
+            addConstant(sum, -1.0);
+        }
+        sum.scale() = slot_to_coeff_scale_;
+        encrypted = move(sum);
+    }
+
+    void CKKSBootstrapper::multiplyRescale(
+        Ciphertext &encrypted1, const Ciphertext &encrypted2, const RelinKeys &relin_keys) const
+    {
+        size_t level1 = context_.getContextData(encrypted1.parmsID())->chainIndex();
+        size_t level2 = context_.getContextData(encrypted2.parmsID())->chainIndex();
+        if (level1 < level2)
+        {
+            Ciphertext lowered;
+            evaluator_.modSwitchTo(encrypted2, encrypted1.parmsID(), lowered);
+            evaluator_.multiplyInplace(encrypted1, lowered);
+        }
+        else
+        {
+            if (level1 > level2)
+            {
+                evaluator_.modSwitchToInplace(encrypted1, encrypted2.parmsID());
+            }
+            evaluator_.multiplyInplace(encrypted1, encrypted2);
+        }
+        evaluator_.relinearizeInplace(encrypted1, relin_keys);
+        evaluator_.rescaleToNextInplace(encrypted1);
+    }
+
+    void CKKSBootstrapper::multiplyConstant(Ciphertext &encrypted, double value, double target_scale)
+    {
+        double q = static_cast<double>(
+            context_.getContextData(encrypted.parmsID())->parms().coeffModulus().back().value());
+        Plaintext plain;
+        encoder_.encode(value, encrypted.parmsID(), target_scale * q / encrypted.scale(), plain);
+        evaluator_.multiplyPlainInplace(encrypted, plain);
+        evaluator_.rescaleToNextInplace(encrypted);
+        encrypted.scale() = target_scale;
+    }
+
+    void CKKSBootstrapper::addConstant(Ciphertext &encrypted, double value)
+    {
+        Plaintext plain;
+        encoder_.encode(value, encrypted.parmsID(), encrypted.scale(), plain);
+        evaluator_.addPlainInplace(encrypted, plain);
+    }
+
+    void CKKSBootstrapper::multiplyHalfDegreeMonomial(Ciphertext &encrypted) const
+    {
+        // X^(N/2) multiplies slot p by i (-1)^p.
+        evaluator_.transformFromNttInplace(encrypted);
+        evaluator_.negacyclicShiftInplace(encrypted, slots_);
+        evaluator_.transformToNttInplace(encrypted);
+    }
+} // namespace troy
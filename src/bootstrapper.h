@@ -0,0 +1,207 @@
+#pragma once
+
+#include "ciphertext.h"
+#include "ckks.h"
+#include "context.h"
+#include "evaluator.h"
+#include "galoiskeys.h"
+#include "plaintext.h"
+#include "relinkeys.h"
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace troy
+{
+    /**
+    Parameters of CKKSBootstrapper. The defaults suit secrets of Hamming weight up to about 64 (see the sparse
+    KeyGenerator constructor).
+    */
+    struct CKKSBootstrapParameters
+    {
+        /**
+        Number of levels consumed by CoeffToSlot. The homomorphic DFT is split into this many sparse factors; fewer
+        levels mean denser factors and more rotations. Between 1 and log2(N/2).
+        */
+        std::size_t coeff_to_slot_levels = 3;
+
+        /**
+        Number of levels consumed by SlotToCoeff, between 1 and log2(N/2).
+        */
+        std::size_t slot_to_coeff_levels = 3;
+
+        /**
+        Bound K on |m / q_0 + I|, where ModRaise turns the plaintext m into m + q_0 I; EvalMod is accurate up to it.
+        A secret of Hamming weight h gives I of standard deviation about sqrt((h + 1) / 12).
+        */
+        double eval_mod_range = 12;
+
+        /**
+        Degree of the Chebyshev interpolant of the scaled cosine in EvalMod.
+        */
+        std::size_t eval_mod_degree = 31;
+
+        /**
+        Number of double-angle iterations after the Chebyshev interpolant; each consumes one level and halves the
+        range the interpolant has to cover.
+        */
+        std::size_t double_angle_count = 3;
+    };
+
+    /**
+    Refreshes CKKS ciphertexts on the server. A ciphertext at any level is switched to the lowest one, raised to the
+    top of the modulus chain (ModRaise), moved from coefficients to slots by a homomorphic DFT evaluated with
+    baby-step giant-step rotations (CoeffToSlot), reduced modulo q_0 by a Chebyshev approximation of a sine
+    (EvalMod), and moved back to coefficients (SlotToCoeff). The result encrypts the same values with the same scale,
+    depth() levels below the top, so that a short modulus chain can be refreshed instead of covering the whole
+    computation.
+
+    The modulus chain must therefore end with depth() primes for bootstrapping, which should all be close to one
+    another; the primes in between are left for the computation. q_0 must leave room for the messages: the error of
+    the sine approximation grows like (2 pi |m| / q_0)^2 relative to m. The secret key should be sparse (see the
+    KeyGenerator constructor taking a Hamming weight), since EvalMod only covers |I| up to eval_mod_range.
+
+    Full packing is used: all N/2 slots are refreshed. The DFT matrices are precomputed as plaintexts at
+    construction, which takes about (number of diagonals) * N * (level size) words per DFT factor.
+
+    @par Thread Safety
+    A CKKSBootstrapper must not be used by several threads at once.
+    */
+    class CKKSBootstrapper
+    {
+    public:
+        /**
+        Creates a bootstrapper for the specified SEALContext and precomputes the DFT matrices.
+
+        @param[in] context The SEALContext
+        @param[in] parms The bootstrapping parameters
+        @throws std::invalid_argument if the encryption parameters are not valid or not for CKKS
+        @throws std::invalid_argument if parms are out of range
+        @throws std::invalid_argument if the modulus chain has fewer than depth() levels above the lowest one
+        */
+        CKKSBootstrapper(const SEALContext &context, const CKKSBootstrapParameters &parms = CKKSBootstrapParameters());
+
+        /**
+        Returns the Galois elements whose keys bootstrap() needs: the rotations of the DFT factors and the complex
+        conjugation. Create the keys with KeyGenerator::createGaloisKeys.
+        */
+        std::vector<std::uint32_t> galoisElements() const;
+
+        /**
+        Returns the number of levels bootstrapping consumes from the top of the modulus chain.
+        */
+        inline std::size_t depth() const noexcept
+        {
+            return parms_.coeff_to_slot_levels + evalModDepth() + parms_.slot_to_coeff_levels;
+        }
+
+        /**
+        Switches a ciphertext to the lowest level and lifts it to the highest one. With t = m + q_0 I the result
+        decrypts to, the result has scale q_0, so that its slots hold the embedding of t / q_0.
+
+        @param[in] encrypted The ciphertext to raise
+        @param[out] destination The ciphertext to overwrite with the raised ciphertext
+        @throws std::invalid_argument if encrypted is not valid for the encryption parameters
+        @throws std::invalid_argument if encrypted is not in NTT form or has size other than 2
+        */
+        void modRaise(const Ciphertext &encrypted, Ciphertext &destination) const;
+
+        /**
+        Bootstraps a ciphertext. The result encrypts the same slot values with the same scale, depth() levels below
+        the top of the modulus chain.
+
+        @param[in] encrypted The ciphertext to bootstrap
+        @param[in] relin_keys The relinearization keys
+        @param[in] galois_keys Galois keys containing at least galoisElements()
+        @param[out] destination The ciphertext to overwrite with the bootstrapped ciphertext
+        @throws std::invalid_argument if encrypted is not valid for the encryption parameters
+        @throws std::invalid_argument if encrypted is not in NTT form or has size other than 2
+        @throws std::invalid_argument if necessary Galois keys are not present
+        */
+        void bootstrap(
+            const Ciphertext &encrypted, const RelinKeys &relin_keys, const GaloisKeys &galois_keys,
+            Ciphertext &destination);
+
+        /**
+        Bootstraps a ciphertext in place. See bootstrap().
+        */
+        inline void bootstrapInplace(Ciphertext &encrypted, const RelinKeys &relin_keys, const GaloisKeys &galois_keys)
+        {
+            Ciphertext input = encrypted;
+            bootstrap(input, relin_keys, galois_keys, encrypted);
+        }
+
+    private:
+        CKKSBootstrapper(const CKKSBootstrapper &copy) = delete;
+
+        CKKSBootstrapper &operator=(const CKKSBootstrapper &assign) = delete;
+
+        // One factor of a homomorphic DFT, evaluated as sum_g rot(sum_b diag_(g+b) * rot(x, b), g) plus the same
+        // with the conjugate of x if the factor reads it.
+        struct LinearStage
+        {
+            std::vector<int> baby_steps;
+
+            std::vector<int> giant_steps;
+
+            // Indexed giant * baby_steps.size() + baby; each diagonal is encoded rotated by -giant, and a plaintext
+            // without coefficients stands for a zero diagonal.
+            std::vector<Plaintext> diagonals;
+
+            // As diagonals, for the conjugate of the input; empty if the stage does not read it.
+            std::vector<Plaintext> conjugate_diagonals;
+        };
+
+        // A slot-wise linear map y = sum_r d_r * rot(x, r), keyed by the rotation r in [0, N/2).
+        using Diagonals = std::map<std::size_t, std::vector<std::complex<double>>>;
+
+        LinearStage createStage(
+            const Diagonals &diagonals, const Diagonals *conjugate_diagonals, ParmsID parms_id, double scale);
+
+        inline std::size_t evalModDepth() const noexcept
+        {
+            std::size_t chebyshev_depth = 0;
+            while ((std::size_t(1) << chebyshev_depth) < parms_.eval_mod_degree)
+            {
+                chebyshev_depth++;
+            }
+            return chebyshev_depth + 1 + parms_.double_angle_count;
+        }
+
+        void evaluateStage(const LinearStage &stage, Ciphertext &encrypted, const GaloisKeys &galois_keys) const;
+
+        void evalMod(Ciphertext &encrypted, const RelinKeys &relin_keys);
+
+        void multiplyRescale(Ciphertext &encrypted1, const Ciphertext &encrypted2, const RelinKeys &relin_keys) const;
+
+        void multiplyConstant(Ciphertext &encrypted, double value, double target_scale);
+
+        void addConstant(Ciphertext &encrypted, double value);
+
+        void multiplyHalfDegreeMonomial(Ciphertext &encrypted) const;
+
+        SEALContext context_;
+
+        CKKSBootstrapParameters parms_;
+
+        CKKSEncoder encoder_;
+
+        Evaluator evaluator_;
+
+        std::size_t slots_;
+
+        // Scale of the ciphertexts EvalMod starts from and SlotToCoeff starts from.
+        double eval_mod_scale_;
+
+        double slot_to_coeff_scale_;
+
+        // Chebyshev coefficients of cos(2 pi (K x - 1/4) / 2^r) on [-1, 1].
+        std::vector<double> eval_mod_coefficients_;
+
+        std::vector<LinearStage> coeff_to_slot_;
+
+        std::vector<LinearStage> slot_to_coeff_;
+    };
+} // namespace troy
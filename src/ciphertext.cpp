@@ -2,6 +2,8 @@
 // Licensed under the MIT license.
 
 #include "ciphertext.h"
+#include "evaluator.h"
+#include "serialize.h"
 #include "utils/defines.h"
 #include "utils/polyarithsmallmod.h"
 #include "utils/rlwe.h"
@@ -129,6 +131,125 @@ namespace troy
         samplePolyUniform(prng, context_data_ptr->parms(), data(1));
     }
 
+    void Ciphertext::save(std::ostream& stream) const {
+        savet(stream, &parms_id_);
+        savet(stream, &is_ntt_form_);
+        savet(stream, &size_);
+        savet(stream, &poly_modulus_degree_);
+        savet(stream, &coeff_modulus_size_);
+        savet(stream, &scale_);
+        savet(stream, &correction_factor_);
+        // Host ciphertexts never carry a seed; keep the field so that the
+        // format is interchangeable with CiphertextCuda.
+        uint64_t seed = 0;
+        savet(stream, &seed);
+        bool terms = false;
+        savet(stream, &terms);
+        size_t dataSize = data_.size();
+        savet(stream, &dataSize);
+        stream.write(reinterpret_cast<const char*>(data_.cbegin()), sizeof(ct_coeff_type) * dataSize);
+    }
+
+    void Ciphertext::saveTerms(std::ostream& stream, const Evaluator& evaluator, const std::vector<size_t>& termIds) const {
+        savet(stream, &parms_id_);
+        savet(stream, &is_ntt_form_);
+
+        Ciphertext copy;
+        const Ciphertext* source = this;
+        if (is_ntt_form_) {
+            evaluator.transformFromNtt(*this, copy);
+            source = &copy;
+        }
+        const ct_coeff_type* r = source->data_.cbegin();
+
+        savet(stream, &size_);
+        savet(stream, &poly_modulus_degree_);
+        savet(stream, &coeff_modulus_size_);
+        savet(stream, &scale_);
+        savet(stream, &correction_factor_);
+        uint64_t seed = 0;
+        savet(stream, &seed);
+        bool terms = true;
+        savet(stream, &terms);
+        // save degree 0 terms
+        for (size_t id: termIds) {
+            if (id >= poly_modulus_degree_) {
+                throw std::invalid_argument("Term index out of range.");
+            }
+            for (size_t j = 0; j < coeff_modulus_size_; j++) {
+                savet(stream, &r[j * poly_modulus_degree_ + id]);
+            }
+        }
+        size_t offset = poly_modulus_degree_ * coeff_modulus_size_;
+        size_t dataSize = source->data_.size() - offset;
+        savet(stream, &dataSize);
+        stream.write(reinterpret_cast<const char*>(r + offset), sizeof(ct_coeff_type) * dataSize);
+    }
+
+    void Ciphertext::load(std::istream& stream) {
+        loadt(stream, &parms_id_);
+        loadt(stream, &is_ntt_form_);
+        loadt(stream, &size_);
+        loadt(stream, &poly_modulus_degree_);
+        loadt(stream, &coeff_modulus_size_);
+        loadt(stream, &scale_);
+        loadt(stream, &correction_factor_);
+        uint64_t seed; loadt(stream, &seed);
+        bool terms; loadt(stream, &terms);
+        if (terms) throw std::invalid_argument("Trying to load a termed ciphertext, but indices is not specified");
+        if (seed != 0) throw std::invalid_argument("Seeded ciphertexts are not supported on host.");
+        size_t dataSize;
+        loadt(stream, &dataSize);
+        data_.resize(dataSize);
+        stream.read(reinterpret_cast<char*>(data_.begin()), sizeof(ct_coeff_type) * dataSize);
+    }
+
+    void Ciphertext::load(std::istream& stream, const SEALContext& context) {
+        load(stream);
+        if (!isValidFor(*this, context)) {
+            throw std::logic_error("ciphertext data is invalid");
+        }
+    }
+
+    void Ciphertext::loadTerms(std::istream& stream, const Evaluator& evaluator, const std::vector<size_t>& termIds) {
+        loadt(stream, &parms_id_);
+        loadt(stream, &is_ntt_form_);
+        loadt(stream, &size_);
+        loadt(stream, &poly_modulus_degree_);
+        loadt(stream, &coeff_modulus_size_);
+        loadt(stream, &scale_);
+        loadt(stream, &correction_factor_);
+        uint64_t seed; loadt(stream, &seed);
+        bool terms; loadt(stream, &terms);
+        if (!terms) throw std::invalid_argument("Trying to load a normal ciphertext, but term indices is specified");
+        if (seed != 0) throw std::invalid_argument("Seeded ciphertexts are not supported on host.");
+
+        size_t offset = poly_modulus_degree_ * coeff_modulus_size_;
+        data_.resize(offset * size_);
+        std::fill_n(data_.begin(), offset, 0);
+        // load degree 0 terms
+        for (size_t id: termIds) {
+            if (id >= poly_modulus_degree_) {
+                throw std::invalid_argument("Term index out of range.");
+            }
+            for (size_t j = 0; j < coeff_modulus_size_; j++) {
+                loadt(stream, &data_[j * poly_modulus_degree_ + id]);
+            }
+        }
+        // load terms degree greater than 0
+        size_t dataSize;
+        loadt(stream, &dataSize);
+        if (dataSize != data_.size() - offset) {
+            throw std::invalid_argument("Ciphertext data size mismatch.");
+        }
+        stream.read(reinterpret_cast<char*>(data_.begin() + offset), sizeof(ct_coeff_type) * dataSize);
+
+        if (is_ntt_form_) {
+            is_ntt_form_ = false;
+            evaluator.transformToNttInplace(*this);
+        }
+    }
+
     // streamoff Ciphertext::save_size(compr_mode_type compr_mode) const
     // {
     //     // We need to consider two cases: seeded and unseeded; these have very
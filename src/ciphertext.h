@@ -15,9 +15,12 @@
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace troy
 {
+    class Evaluator;
+
     /**
     Class to store a ciphertext element. The data for a ciphertext consists
     of two or more polynomials, which are in Microsoft SEAL stored in a CRT
@@ -660,6 +663,12 @@ namespace troy
         */
         struct CiphertextPrivateHelper;
 
+        void save(std::ostream& stream) const;
+        void saveTerms(std::ostream& stream, const Evaluator& evaluator, const std::vector<std::size_t>& termIds) const;
+        void load(std::istream& stream);
+        void load(std::istream& stream, const SEALContext& context);
+        void loadTerms(std::istream& stream, const Evaluator& evaluator, const std::vector<std::size_t>& termIds);
+
     private:
         void reserveInternal(
             std::size_t size_capacity, std::size_t poly_modulus_degree, std::size_t coeff_modulus_size);
@@ -2,6 +2,7 @@
 // Licensed under the MIT license.
 
 #include "ckks.h"
+#include "instrumentation.h"
 #include <random>
 #include <stdexcept>
 
@@ -98,12 +99,38 @@ namespace troy
     void CKKSEncoder::encodeInternal(
         const std::complex<double> *values, std::size_t values_size, ParmsID parms_id, double scale, Plaintext &destination)
     {
+        TROY_INSTRUMENT_OPERATION(encode, context_, parms_id);
+
         // Verify parameters.
         auto context_data_ptr = context_.getContextData(parms_id);
         if (!context_data_ptr)
         {
             throw std::invalid_argument("parms_id is not valid for encryption parameters");
         }
+        auto &context_data = *context_data_ptr;
+        auto &parms = context_data.parms();
+        std::size_t coeff_modulus_size = parms.coeffModulus().size();
+        std::size_t coeff_count = parms.polyModulusDegree();
+
+        util::HostArray<std::complex<double>> coefficients;
+        int max_coeff_bit_count = encodeSlots(values, values_size, context_data, scale, coefficients);
+
+        // Resize destination to appropriate size
+        // Need to first set parms_id to zero, otherwise resize
+        // will throw an exception.
+        destination.parmsID() = parmsIDZero;
+        destination.resize(util::mul_safe(coeff_count, coeff_modulus_size));
+
+        encodeCoefficients(coefficients.get(), max_coeff_bit_count, context_data, destination.data());
+
+        destination.parmsID() = parms_id;
+        destination.scale() = scale;
+    }
+
+    int CKKSEncoder::encodeSlots(
+        const std::complex<double> *values, std::size_t values_size, const SEALContext::ContextData &context_data,
+        double scale, util::HostArray<std::complex<double>> &coefficients) const
+    {
         if (!values && values_size > 0)
         {
             throw std::invalid_argument("values cannot be null");
@@ -113,10 +140,8 @@ namespace troy
             throw std::invalid_argument("values_size is too large");
         }
 
-        auto &context_data = *context_data_ptr;
         auto &parms = context_data.parms();
-        auto &coeff_modulus = parms.coeffModulus();
-        std::size_t coeff_modulus_size = coeff_modulus.size();
+        std::size_t coeff_modulus_size = parms.coeffModulus().size();
         std::size_t coeff_count = parms.polyModulusDegree();
 
         // Quick sanity check
@@ -131,25 +156,23 @@ namespace troy
             throw std::invalid_argument("scale out of bounds");
         }
 
-        auto ntt_tables = context_data.smallNTTTables();
-
         // values_size is guaranteed to be no bigger than slots_
         std::size_t n = util::mul_safe(slots_, std::size_t(2));
 
-        auto conj_values = util::HostArray<std::complex<double>>(n);
+        coefficients = util::HostArray<std::complex<double>>(n);
         for (std::size_t i = 0; i < values_size; i++)
         {
-            conj_values[matrix_reps_index_map_[i]] = values[i];
+            coefficients[matrix_reps_index_map_[i]] = values[i];
             // TODO: if values are real, the following values should be set to zero, and multiply results by 2.
-            conj_values[matrix_reps_index_map_[i + slots_]] = std::conj(values[i]);
+            coefficients[matrix_reps_index_map_[i + slots_]] = std::conj(values[i]);
         }
         double fix = scale / static_cast<double>(n);
-        fft_handler_.transformFromRev(conj_values.get(), util::getPowerOfTwo(n), inv_root_powers_.get(), &fix);
+        fft_handler_.transformFromRev(coefficients.get(), util::getPowerOfTwo(n), inv_root_powers_.get(), &fix);
 
         double max_coeff = 0;
         for (std::size_t i = 0; i < n; i++)
         {
-            max_coeff = std::max<>(max_coeff, std::fabs(conj_values[i].real()));
+            max_coeff = std::max<>(max_coeff, std::fabs(coefficients[i].real()));
         }
         // Verify that the values are not too large to fit in coeff_modulus
         // Note that we have an extra + 1 for the sign bit
@@ -160,66 +183,65 @@ namespace troy
             throw std::invalid_argument("encoded values are too large");
         }
 
-        double two_pow_64 = std::pow(2.0, 64);
+        return max_coeff_bit_count;
+    }
 
-        // Resize destination to appropriate size
-        // Need to first set parms_id to zero, otherwise resize
-        // will throw an exception.
-        destination.parmsID() = parmsIDZero;
-        destination.resize(util::mul_safe(coeff_count, coeff_modulus_size));
+    void CKKSEncoder::encodeCoefficients(
+        const std::complex<double> *coefficients, int max_coeff_bit_count, const SEALContext::ContextData &context_data,
+        std::uint64_t *destination) const
+    {
+        auto &parms = context_data.parms();
+        auto &coeff_modulus = parms.coeffModulus();
+        std::size_t coeff_modulus_size = coeff_modulus.size();
+        std::size_t coeff_count = parms.polyModulusDegree();
+        std::size_t n = coeff_count;
+        auto ntt_tables = context_data.smallNTTTables();
 
-        // Use faster decomposition methods when possible
-        if (max_coeff_bit_count <= 64)
-        {
+        double two_pow_64 = std::pow(2.0, 64);
+
+        // Up to 128 bits, round every coefficient once and split its magnitude into two 64-bit words, then fill the
+        // limbs one at a time from these arrays. The inner loops have no branches and stream through contiguous
+        // memory, so the compiler can vectorize the splitting and pipeline the Barrett reductions. Every coefficient
+        // is an integer, and at 2^64 or more it is a multiple of its ulp, so both words are exact.
+        if (max_coeff_bit_count <= 128)
+        {
+            bool wide = max_coeff_bit_count > 64;
+            double inv_two_pow_64 = 1.0 / two_pow_64;
+            auto low = util::HostArray<std::uint64_t>(n);
+            auto high = util::HostArray<std::uint64_t>(wide ? n : 0);
+            auto negative = util::HostArray<bool>(n);
             for (std::size_t i = 0; i < n; i++)
             {
-                double coeffd = std::round(conj_values[i].real());
-                bool is_negative = std::signbit(coeffd);
-
-                std::uint64_t coeffu = static_cast<std::uint64_t>(std::fabs(coeffd));
-
-                if (is_negative)
-                {
-                    for (std::size_t j = 0; j < coeff_modulus_size; j++)
-                    {
-                        destination[i + (j * coeff_count)] = util::negateUintMod(
-                            util::barrettReduce64(coeffu, coeff_modulus[j]), coeff_modulus[j]);
-                    }
-                }
-                else
+                double coeffd = std::round(coefficients[i].real());
+                negative[i] = std::signbit(coeffd);
+                coeffd = std::fabs(coeffd);
+                if (wide)
                 {
-                    for (std::size_t j = 0; j < coeff_modulus_size; j++)
-                    {
-                        destination[i + (j * coeff_count)] = util::barrettReduce64(coeffu, coeff_modulus[j]);
-                    }
+                    double hi = std::floor(coeffd * inv_two_pow_64);
+                    high[i] = static_cast<std::uint64_t>(hi);
+                    coeffd -= hi * two_pow_64;
                 }
+                low[i] = static_cast<std::uint64_t>(coeffd);
             }
-        }
-        else if (max_coeff_bit_count <= 128)
-        {
-            for (std::size_t i = 0; i < n; i++)
-            {
-                double coeffd = std::round(conj_values[i].real());
-                bool is_negative = std::signbit(coeffd);
-                coeffd = std::fabs(coeffd);
-
-                std::uint64_t coeffu[2]{ static_cast<std::uint64_t>(std::fmod(coeffd, two_pow_64)),
-                                            static_cast<std::uint64_t>(coeffd / two_pow_64) };
 
-                if (is_negative)
+            for (std::size_t j = 0; j < coeff_modulus_size; j++)
+            {
+                const Modulus &modulus = coeff_modulus[j];
+                std::uint64_t modulus_value = modulus.value();
+                std::uint64_t *limb = destination + j * coeff_count;
+                for (std::size_t i = 0; i < n; i++)
                 {
-                    for (std::size_t j = 0; j < coeff_modulus_size; j++)
+                    std::uint64_t r;
+                    if (wide)
                     {
-                        destination[i + (j * coeff_count)] = util::negateUintMod(
-                            util::barrettReduce128(coeffu, coeff_modulus[j]), coeff_modulus[j]);
+                        std::uint64_t words[2]{ low[i], high[i] };
+                        r = util::barrettReduce128(words, modulus);
                     }
-                }
-                else
-                {
-                    for (std::size_t j = 0; j < coeff_modulus_size; j++)
+                    else
                     {
-                        destination[i + (j * coeff_count)] = util::barrettReduce128(coeffu, coeff_modulus[j]);
+                        r = util::barrettReduce64(low[i], modulus);
                     }
+                    limb[i] = (negative[i] && r) ? modulus_value - r : r;
                 }
             }
         }
@@ -229,7 +251,7 @@ namespace troy
             auto coeffu = util::HostArray<uint64_t>(coeff_modulus_size);
             for (std::size_t i = 0; i < n; i++)
             {
-                double coeffd = std::round(conj_values[i].real());
+                double coeffd = std::round(coefficients[i].real());
                 bool is_negative = std::signbit(coeffd);
                 coeffd = std::fabs(coeffd);
 
@@ -265,11 +287,8 @@ namespace troy
         // Transform to NTT domain
         for (std::size_t i = 0; i < coeff_modulus_size; i++)
         {
-            util::nttNegacyclicHarvey(destination.data(i * coeff_count), ntt_tables[i]);
+            util::nttNegacyclicHarvey(destination + i * coeff_count, ntt_tables[i]);
         }
-
-        destination.parmsID() = parms_id;
-        destination.scale() = scale;
     }
 
 
@@ -279,6 +298,8 @@ namespace troy
     void CKKSEncoder::encodeInternal(
         double value, ParmsID parms_id, double scale, Plaintext &destination)
     {
+        TROY_INSTRUMENT_OPERATION(encode, context_, parms_id);
+
         // Verify parameters.
         auto context_data_ptr = context_.getContextData(parms_id);
         if (!context_data_ptr)
@@ -415,6 +436,8 @@ namespace troy
 
     void CKKSEncoder::encodeInternal(int64_t value, ParmsID parms_id, Plaintext &destination)
     {
+        TROY_INSTRUMENT_OPERATION(encode, context_, parms_id);
+
         // Verify parameters.
         auto context_data_ptr = context_.getContextData(parms_id);
         if (!context_data_ptr)
@@ -473,6 +496,8 @@ namespace troy
 
     void CKKSEncoder::decodeInternal(const Plaintext &plain, std::complex<double> *destination)
     {
+        TROY_INSTRUMENT_OPERATION(decode, context_, plain.parmsID());
+
         // Verify parameters.
         if (!isValidFor(plain, context_))
         {
@@ -488,16 +513,29 @@ namespace troy
         }
 
         auto &context_data = *context_.getContextData(plain.parmsID());
+        auto &parms = context_data.parms();
+        std::size_t rns_poly_uint64_count = util::mul_safe(parms.polyModulusDegree(), parms.coeffModulus().size());
+
+        // Create mutable copy of input
+        auto plain_copy = util::allocateUint(rns_poly_uint64_count);
+        util::setUint(plain.data(), rns_poly_uint64_count, plain_copy.get());
+
+        decodeCoefficients(plain_copy.get(), context_data, plain.scale(), destination);
+    }
+
+    void CKKSEncoder::decodeCoefficients(
+        std::uint64_t *plain_copy, const SEALContext::ContextData &context_data, double scale,
+        std::complex<double> *destination) const
+    {
         auto &parms = context_data.parms();
         std::size_t coeff_modulus_size = parms.coeffModulus().size();
         std::size_t coeff_count = parms.polyModulusDegree();
-        std::size_t rns_poly_uint64_count = util::mul_safe(coeff_count, coeff_modulus_size);
 
         auto ntt_tables = context_data.smallNTTTables();
 
         // Check that scale is positive and not too large
-        if (plain.scale() <= 0 ||
-            (static_cast<int>(log2(plain.scale())) >= context_data.totalCoeffModulusBitCount()))
+        if (scale <= 0 ||
+            (static_cast<int>(log2(scale)) >= context_data.totalCoeffModulusBitCount()))
         {
             throw std::invalid_argument("scale out of bounds");
         }
@@ -512,43 +550,108 @@ namespace troy
             throw std::logic_error("invalid parameters");
         }
 
-        double inv_scale = double(1.0) / plain.scale();
-
-        // Create mutable copy of input
-        auto plain_copy = util::allocateUint(rns_poly_uint64_count);
-        util::setUint(plain.data(), rns_poly_uint64_count, plain_copy.get());
+        double inv_scale = double(1.0) / scale;
 
         // Transform each polynomial from NTT domain
         for (std::size_t i = 0; i < coeff_modulus_size; i++)
         {
-            util::inverseNttNegacyclicHarvey(plain_copy.get() + (i * coeff_count), ntt_tables[i]);
+            util::inverseNttNegacyclicHarvey(plain_copy + (i * coeff_count), ntt_tables[i]);
         }
 
-        // printArray(plain_copy);
+        // A plaintext at scale Delta has coefficients of about log2(Delta) + log2|m| bits, far below log2(Q), so
+        // composing every coefficient modulo all of Q is mostly wasted work that grows as L^2. Instead, lift the
+        // residues modulo q_0 q_1 (or q_0 alone) to a centered integer and check the lift against the remaining
+        // residues: if it agrees with all of them it is the coefficient, since its magnitude is below Q / 2. The
+        // passes run over whole limbs, one residue array at a time. Only coefficients that fail the check, those
+        // of nearly log2(q_0 q_1) bits or more, are composed in multiprecision as before.
+        auto &coeff_modulus = parms.coeffModulus();
+        auto res = util::HostArray<std::complex<double>>(coeff_count);
+        auto magnitude = util::HostArray<uint128_t>(coeff_count);
+        auto negative = util::HostArray<bool>(coeff_count);
+        auto consistent = util::HostArray<bool>(coeff_count);
+        const std::uint64_t *r0 = plain_copy;
+        const std::uint64_t q0 = coeff_modulus[0].value();
+        std::size_t checked_from = 1;
+        if (coeff_modulus_size == 1)
+        {
+            for (std::size_t i = 0; i < coeff_count; i++)
+            {
+                negative[i] = r0[i] > (q0 >> 1);
+                magnitude[i] = negative[i] ? q0 - r0[i] : r0[i];
+            }
+        }
+        else
+        {
+            // x = r_0 + q_0 * ((r_1 - r_0) * q_0^-1 mod q_1) lies in [0, q_0 q_1).
+            const Modulus &modulus1 = coeff_modulus[1];
+            const std::uint64_t *r1 = plain_copy + coeff_count;
+            std::uint64_t inv_q0 = 0;
+            util::tryInvertUintMod(util::barrettReduce64(q0, modulus1), modulus1, inv_q0);
+            util::MultiplyUIntModOperand inv_q0_mod_q1;
+            inv_q0_mod_q1.set(inv_q0, modulus1);
+            const uint128_t q01 = static_cast<uint128_t>(q0) * modulus1.value();
+            const uint128_t q01_half = q01 >> 1;
+            for (std::size_t i = 0; i < coeff_count; i++)
+            {
+                std::uint64_t t = util::multiplyUintMod(
+                    util::subUintMod(r1[i], util::barrettReduce64(r0[i], modulus1), modulus1), inv_q0_mod_q1,
+                    modulus1);
+                uint128_t x = static_cast<uint128_t>(q0) * t + r0[i];
+                negative[i] = x > q01_half;
+                magnitude[i] = negative[i] ? q01 - x : x;
+            }
+            checked_from = 2;
+        }
 
-        // CRT-compose the polynomial
-        context_data.rnsTool()->baseq()->composeArray(plain_copy.get(), coeff_count);
+        for (std::size_t i = 0; i < coeff_count; i++)
+        {
+            consistent[i] = true;
+        }
+        for (std::size_t j = checked_from; j < coeff_modulus_size; j++)
+        {
+            const Modulus &modulus = coeff_modulus[j];
+            const std::uint64_t *rj = plain_copy + j * coeff_count;
+            for (std::size_t i = 0; i < coeff_count; i++)
+            {
+                std::uint64_t m = util::barrettReduce128(magnitude[i], modulus);
+                std::uint64_t expected = (negative[i] && m) ? modulus.value() - m : m;
+                consistent[i] = consistent[i] && (expected == rj[i]);
+            }
+        }
 
-        // Create floating-point representations of the multi-precision integer coefficients
         double two_pow_64 = std::pow(2.0, 64);
-        auto res = util::HostArray<std::complex<double>>(coeff_count);
+        auto composed = util::HostArray<std::uint64_t>(coeff_modulus_size);
         for (std::size_t i = 0; i < coeff_count; i++)
         {
+            if (consistent[i])
+            {
+                double value = static_cast<double>(magnitude[i]) * inv_scale;
+                res[i] = negative[i] ? -value : value;
+                continue;
+            }
+
+            // CRT-compose this coefficient
+            for (std::size_t j = 0; j < coeff_modulus_size; j++)
+            {
+                composed[j] = plain_copy[j * coeff_count + i];
+            }
+            context_data.rnsTool()->baseq()->compose(composed.get());
+
+            // Create floating-point representations of the multi-precision integer coefficients
             res[i] = 0.0;
-            if (util::isGreaterThanOrEqualUint(
-                    plain_copy.get() + (i * coeff_modulus_size), upper_half_threshold, coeff_modulus_size))
+            if (util::isGreaterThanOrEqualUint(composed.get(), upper_half_threshold, coeff_modulus_size))
             {
                 double scaled_two_pow_64 = inv_scale;
                 for (std::size_t j = 0; j < coeff_modulus_size; j++, scaled_two_pow_64 *= two_pow_64)
                 {
-                    if (plain_copy[i * coeff_modulus_size + j] > decryption_modulus[j])
+                    if (composed[j] > decryption_modulus[j])
                     {
-                        auto diff = plain_copy[i * coeff_modulus_size + j] - decryption_modulus[j];
+                        auto diff = composed[j] - decryption_modulus[j];
                         res[i] += diff ? static_cast<double>(diff) * scaled_two_pow_64 : 0.0;
                     }
                     else
                     {
-                        auto diff = decryption_modulus[j] - plain_copy[i * coeff_modulus_size + j];
+                        auto diff = decryption_modulus[j] - composed[j];
                         res[i] -= diff ? static_cast<double>(diff) * scaled_two_pow_64 : 0.0;
                     }
                 }
@@ -558,7 +661,7 @@ namespace troy
                 double scaled_two_pow_64 = inv_scale;
                 for (std::size_t j = 0; j < coeff_modulus_size; j++, scaled_two_pow_64 *= two_pow_64)
                 {
-                    auto curr_coeff = plain_copy[i * coeff_modulus_size + j];
+                    auto curr_coeff = composed[j];
                     res[i] += curr_coeff ? static_cast<double>(curr_coeff) * scaled_two_pow_64 : 0.0;
                 }
             }
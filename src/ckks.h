@@ -100,6 +100,8 @@ namespace troy
         using FFTHandler = util::DWTHandler<std::complex<double>, std::complex<double>, double>;
 
         friend class CKKSEncoderCuda;
+        friend class Encryptor;
+        friend class Decryptor;
     public:
         /**
         Creates a CKKSEncoder instance initialized with the specified SEALContext.
@@ -326,6 +328,22 @@ namespace troy
 
         void decodeInternal(const Plaintext &plain, std::complex<double> *destination);
 
+        // The two halves of encoding: encodeSlots embeds the values and applies the inverse FFT, returning the bit
+        // count of the largest coefficient, and encodeCoefficients writes the rounded coefficients to destination
+        // in RNS and NTT form. Split so that the fused Encryptor::encryptValues can encode without a Plaintext.
+        int encodeSlots(
+            const std::complex<double> *values, std::size_t values_size, const SEALContext::ContextData &context_data,
+            double scale, util::HostArray<std::complex<double>> &coefficients) const;
+
+        void encodeCoefficients(
+            const std::complex<double> *coefficients, int max_coeff_bit_count,
+            const SEALContext::ContextData &context_data, std::uint64_t *destination) const;
+
+        // Decodes a polynomial in RNS and NTT form at the level of context_data; plain_copy is used as scratch.
+        void decodeCoefficients(
+            std::uint64_t *plain_copy, const SEALContext::ContextData &context_data, double scale,
+            std::complex<double> *destination) const;
+
         void encodeInternal(
             double value, ParmsID parms_id, double scale, Plaintext &destination);
 
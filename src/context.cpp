@@ -3,12 +3,15 @@
 
 
 #include "context.h"
+#include "serialize.h"
+#include "utils/hash.h"
 #include "utils/numth.h"
 // #include "utils/pointer.h"
 // #include "seal/util/polycore.h"
 #include "utils/uintarith.h"
 #include "utils/uintarithsmallmod.h"
 #include <algorithm>
+#include <sstream>
 #include <stdexcept>
 #include <utility>
 
@@ -135,7 +138,7 @@ namespace troy
         }
     }
 
-    SEALContext::ContextData SEALContext::validate(EncryptionParameters parms)
+    SEALContext::ContextData SEALContext::validate(EncryptionParameters parms, NTTTablesStore &ntt_store)
     {
         ContextData context_data(parms);
         context_data.qualifiers_.parameter_error = ErrorType::success;
@@ -244,7 +247,7 @@ namespace troy
         context_data.qualifiers_.using_ntt = true;
         try
         {
-            context_data.small_ntt_tables_ = CreateNTTTables(coeff_count_power, coeff_modulus);
+            context_data.small_ntt_tables_ = CreateNTTTables(coeff_count_power, coeff_modulus, &ntt_store);
         }
         catch (const invalid_argument &)
         {
@@ -288,7 +291,7 @@ namespace troy
             context_data.qualifiers_.using_batching = true;
             try
             {
-                context_data.plain_ntt_tables_ = CreateNTTTables(coeff_count_power, { plain_modulus });
+                context_data.plain_ntt_tables_ = CreateNTTTables(coeff_count_power, { plain_modulus }, &ntt_store);
             }
             catch (const invalid_argument &)
             {
@@ -399,7 +402,7 @@ namespace troy
         //   (2) cannot find inverse of punctured products in auxiliary base
         try
         {
-            context_data.rns_tool_ = HostObject(new RNSTool(poly_modulus_degree, *coeff_modulus_base, plain_modulus));
+            context_data.rns_tool_ = HostObject(new RNSTool(poly_modulus_degree, *coeff_modulus_base, plain_modulus, &ntt_store));
         }
         catch (const std::exception &)
         {
@@ -423,7 +426,7 @@ namespace troy
         return context_data;
     }
 
-    ParmsID SEALContext::createNextContextData(const ParmsID &prev_parms_id)
+    ParmsID SEALContext::createNextContextData(const ParmsID &prev_parms_id, NTTTablesStore &ntt_store)
     {
         // Create the next set of parameters by removing last modulus
         auto next_parms = context_data_map_.at(prev_parms_id)->parms_;
@@ -433,7 +436,7 @@ namespace troy
         auto next_parms_id = next_parms.parmsID();
 
         // Validate next parameters and create next context_data
-        auto next_context_data = validate(next_parms);
+        auto next_context_data = validate(next_parms, ntt_store);
         if (next_context_data.qualifiers_.parameter_error != ErrorType::success) {
             std::cout << "next_context_data.qualifiers_.parameter_error: "
                 << next_context_data.qualifiers_.parameterErrorName() << std::endl;
@@ -462,6 +465,96 @@ namespace troy
     SEALContext::SEALContext(
         EncryptionParameters parms, bool expand_mod_chain, SecurityLevel sec_level)
         : sec_level_(sec_level)
+    {
+        // Levels share most of their primes, so their NTT tables are computed once.
+        NTTTablesStore ntt_store;
+        initialize(std::move(parms), expand_mod_chain, ntt_store);
+    }
+
+    // "TROYPCTX"
+    static constexpr uint64_t precomputation_magic = 0x58544350594f5254;
+    static constexpr uint64_t precomputation_version = 2;
+
+    // Hash of the serialized NTT tables of a snapshot, so that a damaged body is rejected even if its header is
+    // intact.
+    static HashFunction::HashBlock precomputationChecksum(const NTTTablesStore &ntt_store)
+    {
+        std::ostringstream payload;
+        ntt_store.save(payload);
+        std::string bytes = payload.str();
+        std::vector<uint64_t> words((bytes.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+        std::copy(bytes.begin(), bytes.end(), reinterpret_cast<char *>(words.data()));
+        HashFunction::HashBlock checksum;
+        HashFunction::hash(words.data(), words.size(), checksum);
+        return checksum;
+    }
+
+    SEALContext::SEALContext(
+        EncryptionParameters parms, std::istream &precomputation, bool expand_mod_chain, SecurityLevel sec_level)
+        : sec_level_(sec_level)
+    {
+        uint64_t magic = 0, version = 0;
+        ParmsID parms_id;
+        loadt(precomputation, &magic);
+        loadt(precomputation, &version);
+        loadt(precomputation, &parms_id);
+        if (!precomputation || magic != precomputation_magic || version != precomputation_version)
+        {
+            throw invalid_argument("invalid precomputation");
+        }
+        if (parms_id != parms.parmsID())
+        {
+            throw invalid_argument("precomputation does not match the encryption parameters");
+        }
+        NTTTablesStore ntt_store;
+        ntt_store.load(precomputation);
+        // The loaded tables serialize back to the bytes they were read from only if none of them was damaged.
+        HashFunction::HashBlock checksum;
+        loadt(precomputation, &checksum);
+        if (!precomputation || checksum != precomputationChecksum(ntt_store))
+        {
+            throw invalid_argument("precomputation is corrupted");
+        }
+        initialize(std::move(parms), expand_mod_chain, ntt_store);
+    }
+
+    void SEALContext::savePrecomputation(std::ostream &stream) const
+    {
+        NTTTablesStore ntt_store;
+        for (auto &entry : context_data_map_)
+        {
+            auto &context_data = *entry.second;
+            if (!context_data.qualifiers_.using_ntt)
+            {
+                continue;
+            }
+            for (size_t i = 0; i < context_data.parms_.coeffModulus().size(); i++)
+            {
+                ntt_store.add(context_data.small_ntt_tables_[i]);
+            }
+            if (context_data.qualifiers_.using_batching)
+            {
+                ntt_store.add(context_data.plain_ntt_tables_[0]);
+            }
+            if (!context_data.rns_tool_.isNull())
+            {
+                auto &rns_tool = *context_data.rns_tool_;
+                for (size_t i = 0; i < rns_tool.baseBsk()->size(); i++)
+                {
+                    ntt_store.add(rns_tool.baseBskNttTables()[i]);
+                }
+            }
+        }
+        ParmsID parms_id = key_parms_id_;
+        savet(stream, &precomputation_magic);
+        savet(stream, &precomputation_version);
+        savet(stream, &parms_id);
+        ntt_store.save(stream);
+        HashFunction::HashBlock checksum = precomputationChecksum(ntt_store);
+        savet(stream, &checksum);
+    }
+
+    void SEALContext::initialize(EncryptionParameters parms, bool expand_mod_chain, NTTTablesStore &ntt_store)
     {
 
         // Set random generator
@@ -474,7 +567,7 @@ namespace troy
         // Note that this happens even if parameters are not valid
 
         // First create key_parms_id_.
-        auto first_context_data = validate(parms);
+        auto first_context_data = validate(parms, ntt_store);
         if (first_context_data.qualifiers_.parameter_error != ErrorType::success) {
             std::cout << "first_context_data.qualifiers_.parameter_error: "
                 << first_context_data.qualifiers_.parameterErrorName() << std::endl;
@@ -492,7 +585,7 @@ namespace troy
         }
         else
         {
-            auto next_parms_id = createNextContextData(key_parms_id_);
+            auto next_parms_id = createNextContextData(key_parms_id_, ntt_store);
             first_parms_id_ = (next_parms_id == parmsIDZero) ? key_parms_id_ : next_parms_id;
         }
 
@@ -509,7 +602,7 @@ namespace troy
             auto prev_parms_id = first_parms_id_;
             while (context_data_map_.at(prev_parms_id)->parms().coeffModulus().size() > 1)
             {
-                auto next_parms_id = createNextContextData(prev_parms_id);
+                auto next_parms_id = createNextContextData(prev_parms_id, ntt_store);
                 if (next_parms_id == parmsIDZero)
                 {
                     break;
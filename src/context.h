@@ -488,6 +488,34 @@ namespace troy {
             EncryptionParameters parms, bool expand_mod_chain = true,
             SecurityLevel sec_level = SecurityLevel::tc128);
 
+        /**
+        Creates an instance of SEALContext from a precomputation snapshot written by savePrecomputation, so that the
+        NTT tables of every level (the bulk of the setup cost) are read instead of recomputed. The parameter hash (the
+        key level parms_id) must match parms and the tables must match the checksum stored after them; any table
+        missing from the snapshot is computed as usual. The result is identical to a context constructed from parms
+        alone.
+
+        @param[in] parms The encryption parameters
+        @param[in] precomputation The stream written by savePrecomputation
+        @param[in] expand_mod_chain Determines whether the modulus switching chain
+        should be created
+        @param[in] sec_level Determines whether a specific security level should be
+        enforced according to HomomorphicEncryption.org security standard
+        @throws std::invalid_argument if the stream is not a snapshot for parms or is corrupted
+        */
+        SEALContext(
+            EncryptionParameters parms, std::istream &precomputation, bool expand_mod_chain = true,
+            SecurityLevel sec_level = SecurityLevel::tc128);
+
+        /**
+        Writes the precomputed NTT tables of every level, including the plain modulus and BEHZ base tables, preceded
+        by the parameter hash and followed by a checksum of the tables. See the constructor taking a precomputation
+        stream.
+
+        @param[out] stream The stream to write to
+        */
+        void savePrecomputation(std::ostream &stream) const;
+
         /**
         Creates a new SEALContext by copying a given one.
 
@@ -639,7 +667,9 @@ namespace troy {
         // */
         // SEALContext(EncryptionParameters parms, bool expand_mod_chain, SecurityLevel sec_level);
 
-        ContextData validate(EncryptionParameters parms);
+        void initialize(EncryptionParameters parms, bool expand_mod_chain, util::NTTTablesStore &ntt_store);
+
+        ContextData validate(EncryptionParameters parms, util::NTTTablesStore &ntt_store);
 
         /**
         Create the next context_data by dropping the last element from coeff_modulus.
@@ -647,7 +677,7 @@ namespace troy {
         Otherwise, returns the parms_id of the next parameter and appends the next
         context_data to the chain.
         */
-        ParmsID createNextContextData(const ParmsID &prev_parms);
+        ParmsID createNextContextData(const ParmsID &prev_parms, util::NTTTablesStore &ntt_store);
 
         ParmsID key_parms_id_;
 
@@ -2,6 +2,7 @@
 // Licensed under the MIT license.
 
 #include "decryptor.h"
+#include "instrumentation.h"
 #include "valcheck.h"
 #include "utils/common.h"
 #include "utils/polyarithsmallmod.h"
@@ -78,17 +79,9 @@ namespace troy
 
     void Decryptor::decrypt(const Ciphertext &encrypted, Plaintext &destination)
     {
-        // Verify that encrypted is valid.
-        if (!isValidFor(encrypted, context_))
-        {
-            throw invalid_argument("encrypted is not valid for encryption parameters");
-        }
+        TROY_INSTRUMENT_CIPHERTEXT(decrypt, context_, encrypted);
 
-        // Additionally check that ciphertext doesn't have trivial size
-        if (encrypted.size() < SEAL_CIPHERTEXT_SIZE_MIN)
-        {
-            throw invalid_argument("encrypted is empty");
-        }
+        verifyCiphertext(encrypted);
 
         auto &context_data = *context_.firstContextData();
         auto &parms = context_data.parms();
@@ -96,55 +89,52 @@ namespace troy
         switch (parms.scheme())
         {
         case SchemeType::bfv:
-            bfvDecrypt(encrypted, destination);
+        case SchemeType::bgv:
+            bfvBgvDecrypt(encrypted, destination);
             return;
 
         case SchemeType::ckks:
             ckksDecrypt(encrypted, destination);
             return;
 
-        case SchemeType::bgv:
-            bgvDecrypt(encrypted, destination);
-            return;
-
         default:
             throw invalid_argument("unsupported scheme");
         }
     }
 
-    void Decryptor::bfvDecrypt(const Ciphertext &encrypted, Plaintext &destination)
+    void Decryptor::verifyCiphertext(const Ciphertext &encrypted) const
     {
-        if (encrypted.isNttForm())
+        // Verify that encrypted is valid.
+        if (!isValidFor(encrypted, context_))
         {
-            throw invalid_argument("encrypted cannot be in NTT form");
+            throw invalid_argument("encrypted is not valid for encryption parameters");
         }
 
-        auto &context_data = *context_.getContextData(encrypted.parmsID());
-        auto &parms = context_data.parms();
-        auto &coeff_modulus = parms.coeffModulus();
-        size_t coeff_count = parms.polyModulusDegree();
-        size_t coeff_modulus_size = coeff_modulus.size();
-
-        // Firstly find c_0 + c_1 *s + ... + c_{count-1} * s^{count-1} mod q
-        // This is equal to Delta m + v where ||v|| < Delta/2.
-        // Add Delta / 2 and now we have something which is Delta * (m + epsilon) where epsilon < 1
-        // Therefore, we can (integer) divide by Delta and the answer will round down to m.
+        // Additionally check that ciphertext doesn't have trivial size
+        if (encrypted.size() < SEAL_CIPHERTEXT_SIZE_MIN)
+        {
+            throw invalid_argument("encrypted is empty");
+        }
+    }
 
-        // Make a temp destination for all the arithmetic mod qi before calling FastBConverse
-        auto tmp_dest_modq = allocateZeroPoly(coeff_count, coeff_modulus_size);
-        // SEAL_ALLOCATE_ZERO_GET_RNS_ITER(tmp_dest_modq, coeff_count, coeff_modulus_size, pool);
+    uint64_t *Decryptor::scratch(size_t size)
+    {
+        if (scratch_.size() < size)
+        {
+            scratch_ = HostArray<uint64_t>(size);
+        }
+        return scratch_.get();
+    }
 
-        // put < (c_1 , c_2, ... , c_{count-1}) , (s,s^2,...,s^{count-1}) > mod q in destination
-        // Now do the dot product of encrypted_copy and the secret key array using NTT.
-        // The secret key powers are already NTT transformed.
-        dotProductCtSkArray(encrypted, tmp_dest_modq.asPointer());
+    void Decryptor::bfvBgvDecrypt(const Ciphertext &encrypted, Plaintext &destination)
+    {
+        size_t coeff_count = context_.getContextData(encrypted.parmsID())->parms().polyModulusDegree();
 
         // Allocate a full size destination to write to
         destination.parmsID() = parmsIDZero;
         destination.resize(coeff_count);
 
-        // Divide scaling variant using BEHZ FullRNS techniques
-        context_data.rnsTool()->decryptScaleAndRound(tmp_dest_modq.asPointer(), destination.data());
+        decryptCoefficients(encrypted, destination.data());
 
         // How many non-zero coefficients do we really have in the result?
         size_t plain_coeff_count = getSignificantUint64CountUint(destination.data(), coeff_count);
@@ -188,7 +178,7 @@ namespace troy
         destination.scale() = encrypted.scale();
     }
 
-    void Decryptor::bgvDecrypt(const Ciphertext &encrypted, Plaintext &destination)
+    void Decryptor::decryptCoefficients(const Ciphertext &encrypted, HostPointer<uint64_t> destination)
     {
         if (encrypted.isNttForm())
         {
@@ -202,32 +192,33 @@ namespace troy
         size_t coeff_count = parms.polyModulusDegree();
         size_t coeff_modulus_size = coeff_modulus.size();
 
-        auto tmp_dest_modq = HostArray<uint64_t>(coeff_count * coeff_modulus_size);
-        // SEAL_ALLOCATE_ZERO_GET_RNS_ITER(tmp_dest_modq, coeff_count, coeff_modulus_size, pool);
-
-        dotProductCtSkArray(encrypted, tmp_dest_modq.asPointer());
-
-        destination.parmsID() = parmsIDZero;
-        destination.resize(coeff_count);
-
-        context_data.rnsTool()->decryptModt(tmp_dest_modq.asPointer(), destination.data());
+        // Firstly find c_0 + c_1 *s + ... + c_{count-1} * s^{count-1} mod q
+        // This is equal to Delta m + v where ||v|| < Delta/2.
+        // Add Delta / 2 and now we have something which is Delta * (m + epsilon) where epsilon < 1
+        // Therefore, we can (integer) divide by Delta and the answer will round down to m.
+        // The dot product overwrites all of its destination, so the scratch buffer needs no clearing.
+        HostPointer<uint64_t> tmp_dest_modq(scratch(mul_safe(coeff_count, coeff_modulus_size)));
+        dotProductCtSkArray(encrypted, tmp_dest_modq);
 
-        if (encrypted.correctionFactor() != 1)
+        if (parms.scheme() == SchemeType::bfv)
+        {
+            // Divide scaling variant using BEHZ FullRNS techniques
+            context_data.rnsTool()->decryptScaleAndRound(tmp_dest_modq, destination);
+        }
+        else
         {
-            uint64_t fix = 1;
-            if (!tryInvertUintMod(encrypted.correctionFactor(), plain_modulus, fix))
+            context_data.rnsTool()->decryptModt(tmp_dest_modq, destination);
+
+            if (encrypted.correctionFactor() != 1)
             {
-                throw logic_error("invalid correction factor");
+                uint64_t fix = 1;
+                if (!tryInvertUintMod(encrypted.correctionFactor(), plain_modulus, fix))
+                {
+                    throw logic_error("invalid correction factor");
+                }
+                multiplyPolyScalarCoeffmod(ConstHostPointer(destination), coeff_count, fix, plain_modulus, destination);
             }
-            multiplyPolyScalarCoeffmod(
-                ConstHostPointer(destination.data()), coeff_count, fix, plain_modulus, HostPointer(destination.data()));
         }
-
-        // How many non-zero coefficients do we really have in the result?
-        size_t plain_coeff_count = getSignificantUint64CountUint(destination.data(), coeff_count);
-
-        // Resize destination to appropriate size
-        destination.resize(max(plain_coeff_count, size_t(1)));
     }
 
     void Decryptor::computeSecretKeyArray(size_t max_power)
@@ -439,4 +430,68 @@ namespace troy
                              getSignificantBitCountUint(norm.get(), coeff_modulus_size) - 1;
         return max(0, bit_count_diff);
     }
+
+    template <typename T>
+    void Decryptor::decryptValuesInternal(
+        const BatchEncoder &encoder, const Ciphertext &encrypted, vector<T> &destination)
+    {
+        TROY_INSTRUMENT_CIPHERTEXT(decrypt, context_, encrypted);
+
+        verifyCiphertext(encrypted);
+        if (encoder.context_.keyParmsID() != context_.keyParmsID())
+        {
+            throw invalid_argument("encoder is not valid for encryption parameters");
+        }
+        auto scheme = context_.firstContextData()->parms().scheme();
+        if (scheme != SchemeType::bfv && scheme != SchemeType::bgv)
+        {
+            throw invalid_argument("unsupported scheme");
+        }
+
+        // The plaintext coefficients go to a buffer that the encoder transforms in place; it is kept next to
+        // the dot product scratch and reused by the following calls.
+        size_t coeff_count = encoder.slotCount();
+        if (plain_scratch_.size() < coeff_count)
+        {
+            plain_scratch_ = HostArray<uint64_t>(coeff_count);
+        }
+        decryptCoefficients(encrypted, plain_scratch_.asPointer());
+        encoder.decodeSlots(plain_scratch_.get(), destination);
+    }
+
+    template void Decryptor::decryptValuesInternal<uint64_t>(
+        const BatchEncoder &, const Ciphertext &, vector<uint64_t> &);
+
+    template void Decryptor::decryptValuesInternal<int64_t>(
+        const BatchEncoder &, const Ciphertext &, vector<int64_t> &);
+
+    void Decryptor::decryptValues(
+        const CKKSEncoder &encoder, const Ciphertext &encrypted, vector<complex<double>> &destination)
+    {
+        TROY_INSTRUMENT_CIPHERTEXT(decrypt, context_, encrypted);
+
+        verifyCiphertext(encrypted);
+        if (encoder.context_.keyParmsID() != context_.keyParmsID())
+        {
+            throw invalid_argument("encoder is not valid for encryption parameters");
+        }
+        if (context_.firstContextData()->parms().scheme() != SchemeType::ckks)
+        {
+            throw invalid_argument("unsupported scheme");
+        }
+        if (!encrypted.isNttForm())
+        {
+            throw invalid_argument("encrypted must be in NTT form");
+        }
+
+        // Decrypt into the scratch buffer and decode it in place, where decrypt followed by decode would fill
+        // a Plaintext, validate it and copy it once more.
+        auto &context_data = *context_.getContextData(encrypted.parmsID());
+        auto &parms = context_data.parms();
+        HostPointer<uint64_t> phase(scratch(mul_safe(parms.polyModulusDegree(), parms.coeffModulus().size())));
+        dotProductCtSkArray(encrypted, phase);
+
+        destination.resize(encoder.slotCount());
+        encoder.decodeCoefficients(phase.get(), context_data, encrypted.scale(), destination.data());
+    }
 } // namespace seal
@@ -3,7 +3,9 @@
 
 #pragma once
 
+#include "batchencoder.h"
 #include "ciphertext.h"
+#include "ckks.h"
 #include "context.h"
 #include "encryptionparams.h"
 #include "modulus.h"
@@ -13,6 +15,8 @@
 #include "utils/defines.h"
 #include "utils/ntt.h"
 #include "utils/rns.h"
+#include <complex>
+#include <vector>
 
 namespace troy
 {
@@ -70,6 +74,48 @@ namespace troy
         */
         void decrypt(const Ciphertext &encrypted, Plaintext &destination);
 
+        /*
+        Decrypts a BFV or BGV ciphertext and unbatches it with the given encoder.
+        The result is the same as decrypt followed by encoder.decode, but the
+        plaintext coefficients stay in scratch buffers owned by the Decryptor,
+        which are reused by later calls, instead of a Plaintext that decode
+        would validate and copy again.
+
+        @param[in] encoder The BatchEncoder, built on the same SEALContext
+        @param[in] encrypted The ciphertext to decrypt
+        @param[out] destination The matrix to be overwritten with the values in
+        the slots
+        @throws std::invalid_argument if encrypted or encoder is not valid for the
+        encryption parameters
+        @throws std::invalid_argument if encrypted is in NTT form
+        */
+        inline void decryptValues(
+            const BatchEncoder &encoder, const Ciphertext &encrypted, std::vector<std::uint64_t> &destination)
+        {
+            decryptValuesInternal(encoder, encrypted, destination);
+        }
+
+        inline void decryptValues(
+            const BatchEncoder &encoder, const Ciphertext &encrypted, std::vector<std::int64_t> &destination)
+        {
+            decryptValuesInternal(encoder, encrypted, destination);
+        }
+
+        /*
+        Decrypts a CKKS ciphertext and decodes it with the given encoder, the
+        fused equivalent of decrypt followed by encoder.decode.
+
+        @param[in] encoder The CKKSEncoder, built on the same SEALContext
+        @param[in] encrypted The ciphertext to decrypt
+        @param[out] destination The vector to be overwritten with the values in
+        the slots
+        @throws std::invalid_argument if encrypted or encoder is not valid for the
+        encryption parameters
+        @throws std::invalid_argument if encrypted is not in NTT form
+        */
+        void decryptValues(
+            const CKKSEncoder &encoder, const Ciphertext &encrypted, std::vector<std::complex<double>> &destination);
+
         /*
         Computes the invariant noise budget (in bits) of a ciphertext. The
         invariant noise budget measures the amount of room there is for the noise
@@ -97,11 +143,21 @@ namespace troy
         int invariantNoiseBudget(const Ciphertext &encrypted);
 
     private:
-        void bfvDecrypt(const Ciphertext &encrypted, Plaintext &destination);
+        void bfvBgvDecrypt(const Ciphertext &encrypted, Plaintext &destination);
 
         void ckksDecrypt(const Ciphertext &encrypted, Plaintext &destination);
 
-        void bgvDecrypt(const Ciphertext &encrypted, Plaintext &destination);
+        void verifyCiphertext(const Ciphertext &encrypted) const;
+
+        // Writes the coefficients of the BFV/BGV plaintext of encrypted, modulo the plain modulus, to destination.
+        void decryptCoefficients(const Ciphertext &encrypted, util::HostPointer<uint64_t> destination);
+
+        template <typename T>
+        void decryptValuesInternal(
+            const BatchEncoder &encoder, const Ciphertext &encrypted, std::vector<T> &destination);
+
+        // Returns scratch_, grown to at least size words.
+        std::uint64_t *scratch(std::size_t size);
 
         Decryptor(const Decryptor &copy) = delete;
 
@@ -124,5 +180,10 @@ namespace troy
 
         util::HostArray<std::uint64_t> secret_key_array_;
 
+        // Reused by decrypt and decryptValues for the RNS phase and the plaintext coefficients.
+        util::HostArray<std::uint64_t> scratch_;
+
+        util::HostArray<std::uint64_t> plain_scratch_;
+
     };
 } // namespace seal
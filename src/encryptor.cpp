@@ -2,6 +2,7 @@
 // Licensed under the MIT license.
 
 #include "encryptor.h"
+#include "instrumentation.h"
 #include "modulus.h"
 #include "randomtostd.h"
 #include "utils/common.h"
@@ -169,8 +170,7 @@ namespace troy
         }
     }
 
-    void Encryptor::encryptInternal(
-        const Plaintext &plain, bool is_asymmetric, Ciphertext &destination) const
+    void Encryptor::checkKeySet(bool is_asymmetric) const
     {
         // Minimal verification that the keys are set
         if (is_asymmetric)
@@ -187,6 +187,15 @@ namespace troy
                 throw logic_error("secret key is not set");
             }
         }
+    }
+
+    void Encryptor::encryptInternal(
+        const Plaintext &plain, bool is_asymmetric, Ciphertext &destination) const
+    {
+        TROY_INSTRUMENT_OPERATION(
+            encrypt, context_, plain.parmsID() == parmsIDZero ? context_.firstParmsID() : plain.parmsID());
+
+        checkKeySet(is_asymmetric);
 
         // Verify that plain is valid
         if (!isValidFor(plain, context_))
@@ -252,4 +261,114 @@ namespace troy
             throw invalid_argument("unsupported scheme");
         }
     }
+
+    void Encryptor::encryptScaledInternal(
+        const ScaledPlaintext &plain, bool is_asymmetric, Ciphertext &destination) const
+    {
+        TROY_INSTRUMENT_OPERATION(encrypt, context_, plain.parmsID());
+
+        auto context_data_ptr = context_.getContextData(plain.parmsID());
+        if (!context_data_ptr || context_data_ptr->parms().scheme() != SchemeType::bfv)
+        {
+            throw invalid_argument("plain is not valid for encryption parameters");
+        }
+        auto &parms = context_data_ptr->parms();
+        auto &coeff_modulus = parms.coeffModulus();
+        size_t coeff_count = parms.polyModulusDegree();
+        size_t plain_coeff_count = plain.coeffCount();
+        if (plain.data_.size() != plain_coeff_count * coeff_modulus.size() || plain_coeff_count > coeff_count)
+        {
+            throw invalid_argument("plain is not valid for encryption parameters");
+        }
+
+        encryptZeroInternal(plain.parmsID(), is_asymmetric, destination);
+
+        // The scaled plaintext gets added into the c_0 term of ciphertext (c_0,c_1).
+        for (size_t j = 0; j < coeff_modulus.size(); j++)
+        {
+            HostPointer<uint64_t> d = destination.data(0) + j * coeff_count;
+            addPolyCoeffmod(d, plain.data_.cbegin() + j * plain_coeff_count, plain_coeff_count, coeff_modulus[j], d);
+        }
+    }
+
+    template <typename T>
+    void Encryptor::encryptValuesInternal(
+        const BatchEncoder &encoder, const vector<T> &values, bool is_asymmetric, Ciphertext &destination) const
+    {
+        TROY_INSTRUMENT_OPERATION(encrypt, context_, context_.firstParmsID());
+
+        checkKeySet(is_asymmetric);
+        if (encoder.context_.keyParmsID() != context_.keyParmsID())
+        {
+            throw invalid_argument("encoder is not valid for encryption parameters");
+        }
+        if (values.size() > encoder.slotCount())
+        {
+            throw invalid_argument("values_matrix size is too large");
+        }
+
+        auto scheme = context_.keyContextData()->parms().scheme();
+        if (scheme != SchemeType::bfv && scheme != SchemeType::bgv)
+        {
+            throw invalid_argument("unsupported scheme");
+        }
+
+        // The encoded polynomial only lives in this buffer; it is valid by construction, so the scan that
+        // encrypt does over a user supplied Plaintext is skipped.
+        auto &context_data = *context_.firstContextData();
+        size_t coeff_count = context_data.parms().polyModulusDegree();
+        auto plain = allocateUint(coeff_count);
+        encoder.encodeSlots(values, plain.get());
+
+        encryptZeroInternal(context_.firstParmsID(), is_asymmetric, destination);
+        if (scheme == SchemeType::bfv)
+        {
+            multiplyAddPlainWithScalingVariant(plain.get(), coeff_count, context_data, destination.data(0));
+        }
+        else
+        {
+            addPlainWithoutScalingVariant(plain.get(), coeff_count, context_data, destination.data(0));
+        }
+    }
+
+    template void Encryptor::encryptValuesInternal<uint64_t>(
+        const BatchEncoder &, const vector<uint64_t> &, bool, Ciphertext &) const;
+
+    template void Encryptor::encryptValuesInternal<int64_t>(
+        const BatchEncoder &, const vector<int64_t> &, bool, Ciphertext &) const;
+
+    void Encryptor::encryptValuesInternal(
+        const CKKSEncoder &encoder, const vector<complex<double>> &values, ParmsID parms_id, double scale,
+        bool is_asymmetric, Ciphertext &destination) const
+    {
+        TROY_INSTRUMENT_OPERATION(encrypt, context_, parms_id);
+
+        checkKeySet(is_asymmetric);
+        if (encoder.context_.keyParmsID() != context_.keyParmsID())
+        {
+            throw invalid_argument("encoder is not valid for encryption parameters");
+        }
+        auto context_data_ptr = context_.getContextData(parms_id);
+        if (!context_data_ptr || context_data_ptr->parms().scheme() != SchemeType::ckks)
+        {
+            throw invalid_argument("parms_id is not valid for encryption parameters");
+        }
+        auto &context_data = *context_data_ptr;
+        auto &coeff_modulus = context_data.parms().coeffModulus();
+        size_t coeff_modulus_size = coeff_modulus.size();
+        size_t coeff_count = context_data.parms().polyModulusDegree();
+
+        // Encode first, so that a failure leaves destination untouched, then add the NTT form polynomial into
+        // c_0 of the encryption of zero.
+        HostArray<complex<double>> coefficients;
+        int max_coeff_bit_count = encoder.encodeSlots(values.data(), values.size(), context_data, scale, coefficients);
+        auto plain = allocateUint(mul_safe(coeff_count, coeff_modulus_size));
+        encoder.encodeCoefficients(coefficients.get(), max_coeff_bit_count, context_data, plain.get());
+
+        encryptZeroInternal(parms_id, is_asymmetric, destination);
+        HostPointer<uint64_t> destination_iter(destination.data(0));
+        addPolyCoeffmod(
+            destination_iter, plain.asPointer(), coeff_modulus_size, coeff_count, &coeff_modulus[0], destination_iter);
+        destination.scale() = scale;
+    }
 } // namespace seal
@@ -3,7 +3,9 @@
 
 #pragma once
 
+#include "batchencoder.h"
 #include "ciphertext.h"
+#include "ckks.h"
 #include "context.h"
 #include "encryptionparams.h"
 #include "plaintext.h"
@@ -11,6 +13,7 @@
 #include "secretkey.h"
 #include "utils/defines.h"
 #include "utils/ntt.h"
+#include <complex>
 #include <vector>
 
 namespace troy
@@ -301,6 +304,42 @@ namespace troy
             return destination;
         }
 
+        /**
+        Encrypts a BFV plaintext already scaled by Evaluator::scalePlain with the
+        public key. The resulting ciphertext is at the parms_id of the scaled
+        plaintext.
+
+        @param[in] plain The scaled plaintext to encrypt
+        @param[out] destination The ciphertext to overwrite with the encrypted
+        plaintext
+        @throws std::logic_error if a public key is not set
+        @throws std::invalid_argument if plain is not valid for the encryption
+        parameters
+        */
+        inline void encrypt(
+            const ScaledPlaintext &plain, Ciphertext &destination) const
+        {
+            encryptScaledInternal(plain, true, destination);
+        }
+
+        /**
+        Encrypts a BFV plaintext already scaled by Evaluator::scalePlain with the
+        secret key. The resulting ciphertext is at the parms_id of the scaled
+        plaintext.
+
+        @param[in] plain The scaled plaintext to encrypt
+        @param[out] destination The ciphertext to overwrite with the encrypted
+        plaintext
+        @throws std::logic_error if a secret key is not set
+        @throws std::invalid_argument if plain is not valid for the encryption
+        parameters
+        */
+        inline void encryptSymmetric(
+            const ScaledPlaintext &plain, Ciphertext &destination) const
+        {
+            encryptScaledInternal(plain, false, destination);
+        }
+
         /**
         Encrypts a zero plaintext with the secret key and stores the result in
         destination.
@@ -396,6 +435,91 @@ namespace troy
             return encryptZeroSymmetric(context_.firstParmsID());
         }
 
+        /**
+        Batches values with the given encoder and encrypts them with the public
+        key. The result is the same as encoder.encode followed by encrypt, but
+        the values are encoded into a scratch buffer and added into the
+        encryption of zero directly, without an intermediate Plaintext and
+        without re-validating it.
+
+        @param[in] encoder The BatchEncoder, built on the same SEALContext
+        @param[in] values The matrix of integers modulo the plaintext modulus
+        @param[out] destination The ciphertext to overwrite
+        @throws std::logic_error if a public key is not set
+        @throws std::invalid_argument if encoder is not valid for the encryption
+        parameters or values is too large
+        */
+        inline void encryptValues(
+            const BatchEncoder &encoder, const std::vector<std::uint64_t> &values, Ciphertext &destination) const
+        {
+            encryptValuesInternal(encoder, values, true, destination);
+        }
+
+        inline void encryptValues(
+            const BatchEncoder &encoder, const std::vector<std::int64_t> &values, Ciphertext &destination) const
+        {
+            encryptValuesInternal(encoder, values, true, destination);
+        }
+
+        /**
+        Encodes values with the given CKKS encoder and encrypts them with the
+        public key at the given parms_id, the fused equivalent of
+        encoder.encode(values, parms_id, scale, plain) followed by encrypt.
+
+        @param[in] encoder The CKKSEncoder, built on the same SEALContext
+        @param[in] values The values to encode, at most encoder.slotCount()
+        @param[in] parms_id The parms_id of the resulting ciphertext
+        @param[in] scale Scaling parameter defining encoding precision
+        @param[out] destination The ciphertext to overwrite
+        @throws std::logic_error if a public key is not set
+        @throws std::invalid_argument if encoder or parms_id is not valid for the
+        encryption parameters, or the values cannot be encoded at this scale
+        */
+        inline void encryptValues(
+            const CKKSEncoder &encoder, const std::vector<std::complex<double>> &values, ParmsID parms_id,
+            double scale, Ciphertext &destination) const
+        {
+            encryptValuesInternal(encoder, values, parms_id, scale, true, destination);
+        }
+
+        inline void encryptValues(
+            const CKKSEncoder &encoder, const std::vector<std::complex<double>> &values, double scale,
+            Ciphertext &destination) const
+        {
+            encryptValuesInternal(encoder, values, context_.firstParmsID(), scale, true, destination);
+        }
+
+        /**
+        Symmetric-key counterparts of encryptValues.
+
+        @throws std::logic_error if a secret key is not set
+        */
+        inline void encryptValuesSymmetric(
+            const BatchEncoder &encoder, const std::vector<std::uint64_t> &values, Ciphertext &destination) const
+        {
+            encryptValuesInternal(encoder, values, false, destination);
+        }
+
+        inline void encryptValuesSymmetric(
+            const BatchEncoder &encoder, const std::vector<std::int64_t> &values, Ciphertext &destination) const
+        {
+            encryptValuesInternal(encoder, values, false, destination);
+        }
+
+        inline void encryptValuesSymmetric(
+            const CKKSEncoder &encoder, const std::vector<std::complex<double>> &values, ParmsID parms_id,
+            double scale, Ciphertext &destination) const
+        {
+            encryptValuesInternal(encoder, values, parms_id, scale, false, destination);
+        }
+
+        inline void encryptValuesSymmetric(
+            const CKKSEncoder &encoder, const std::vector<std::complex<double>> &values, double scale,
+            Ciphertext &destination) const
+        {
+            encryptValuesInternal(encoder, values, context_.firstParmsID(), scale, false, destination);
+        }
+
         /**
         Enables access to private members of seal::Encryptor for SEAL_C.
         */
@@ -416,6 +540,20 @@ namespace troy
         void encryptInternal(
             const Plaintext &plain, bool is_asymmetric, Ciphertext &destination) const;
 
+        void encryptScaledInternal(
+            const ScaledPlaintext &plain, bool is_asymmetric, Ciphertext &destination) const;
+
+        void checkKeySet(bool is_asymmetric) const;
+
+        template <typename T>
+        void encryptValuesInternal(
+            const BatchEncoder &encoder, const std::vector<T> &values, bool is_asymmetric,
+            Ciphertext &destination) const;
+
+        void encryptValuesInternal(
+            const CKKSEncoder &encoder, const std::vector<std::complex<double>> &values, ParmsID parms_id,
+            double scale, bool is_asymmetric, Ciphertext &destination) const;
+
         SEALContext context_;
 
         PublicKey public_key_;
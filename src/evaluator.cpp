@@ -2,9 +2,11 @@
 // Licensed under the MIT license.
 
 #include "evaluator.h"
+#include "aggregator.h"
 #include "utils/common.h"
 #include "utils/galois.h"
 #include "utils/numth.h"
+#include "utils/parallel.h"
 #include "utils/polyarithsmallmod.h"
 #include "utils/polycore.h"
 #include "utils/scalingvariant.h"
@@ -14,6 +16,9 @@
 #include <algorithm>
 #include <cmath>
 #include <functional>
+#include <limits>
+#include <mutex>
+#include <unistd.h>
 
 using namespace std;
 using namespace troy::util;
@@ -39,6 +44,122 @@ namespace troy
             printArray(s.get(), s.size(), dont_compress);
         } 
 
+        /**
+        accumulator[l] += operand[l] * key[l] over 128-bit integers, without any modular reduction.
+        Written over native uint128_t so the compiler emits one widening multiply and an add/adc pair
+        per coefficient; the caller reduces before the accumulator can overflow.
+        */
+        inline void multiplyAccumulateLazy(
+            const uint64_t *operand, const uint64_t *key, size_t coeff_count, uint128_t *accumulator)
+        {
+            for (size_t l = 0; l < coeff_count; l++)
+            {
+                accumulator[l] += static_cast<uint128_t>(operand[l]) * key[l];
+            }
+        }
+
+        // Coefficients per tile of the key switching inner product; sized so that the key tile of one limb
+        // stays in L2 and the accumulators of one tile stay in L1.
+        constexpr size_t switch_key_tile_size = 512;
+
+        // Largest number of ciphertexts that share one pass over a keyswitching key.
+        constexpr size_t switch_key_batch_size = 8;
+
+        // Bytes of NTT operands kept live per key limb in batched key switching; about a quarter of a typical L2.
+        constexpr size_t switch_key_operand_budget = size_t(512) << 10;
+
+        /**
+        Returns the size of the last-level cache, or 32 MiB where it cannot be queried. Batching key switching
+        only pays off once the keyswitching key no longer fits there: a key that stays cache resident is read
+        from cache by every ciphertext anyway, and the batch only adds live intermediates.
+        */
+        inline size_t lastLevelCacheSize()
+        {
+            static const size_t size = []() {
+                long bytes = -1;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+                bytes = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+                return bytes > 0 ? static_cast<size_t>(bytes) : (size_t(32) << 20);
+            }();
+            return size;
+        }
+
+        /**
+        Groups ciphertexts that can go through one batched key switching, i.e., those with the same parms_id
+        and size, into batches of at most switch_key_batch_size.
+        */
+        inline vector<vector<Ciphertext *>> keySwitchingBatches(vector<Ciphertext> &encrypted)
+        {
+            vector<vector<Ciphertext *>> batches;
+            for (auto &each : encrypted)
+            {
+                auto batch = find_if(batches.begin(), batches.end(), [&](const vector<Ciphertext *> &b) {
+                    return b.size() < switch_key_batch_size && b[0]->parmsID() == each.parmsID() &&
+                           b[0]->size() == each.size();
+                });
+                if (batch == batches.end())
+                {
+                    batches.emplace_back();
+                    batch = batches.end() - 1;
+                }
+                batch->push_back(&each);
+            }
+            return batches;
+        }
+
+        /**
+        Returns how many products of BFV ciphertexts of the given sizes multiplyAccumulate can sum before BEHZ steps
+        (6)-(8). Step (7) floors t x / q exactly in base Bsk only while |t x / q| stays below M_Bsk / 2. With
+        operands below q in absolute value, each product adds up to t N q min(size1, size2) to it. RNSTool grows
+        base B until M_Bsk exceeds t q by more than 32 bits, which leaves room for about 2^(30 - log2(N)) products.
+        */
+        inline size_t behzAccumulateBound(
+            const SEALContext::ContextData &context_data, size_t encrypted1_size, size_t encrypted2_size)
+        {
+            auto &parms = context_data.parms();
+            auto &base_Bsk = *context_data.rnsTool()->baseBsk();
+            double headroom = -1 - log2(static_cast<double>(parms.plainModulus().value())) -
+                              log2(static_cast<double>(parms.polyModulusDegree())) -
+                              log2(static_cast<double>(min(encrypted1_size, encrypted2_size)));
+            for (auto &modulus : parms.coeffModulus())
+            {
+                headroom -= log2(static_cast<double>(modulus.value()));
+            }
+            for (size_t j = 0; j < base_Bsk.size(); j++)
+            {
+                headroom += log2(static_cast<double>(base_Bsk[j].value()));
+            }
+            if (headroom >= 63)
+            {
+                return numeric_limits<size_t>::max();
+            }
+            return max<size_t>(1, static_cast<size_t>(exp2(headroom)));
+        }
+
+        /**
+        Merges partial sums pairwise, halving their number in each parallel round, and writes the total.
+        */
+        inline void mergeAggregators(vector<CiphertextAggregator> &partials, size_t threads, Ciphertext &destination)
+        {
+            while (partials.size() > 1)
+            {
+                size_t upper = (partials.size() + 1) / 2;
+                parallelForRange(partials.size() / 2, threads, [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        partials[i].merge(partials[upper + i]);
+                    }
+                });
+                partials.erase(partials.begin() + upper, partials.end());
+            }
+            if (partials.empty() || !partials[0].count())
+            {
+                throw invalid_argument("encrypteds cannot be empty");
+            }
+            partials[0].result(destination);
+        }
+
         template <typename T, typename S>
         inline bool areSameScale(const T &value1, const S &value2) noexcept
         {
@@ -148,6 +269,8 @@ namespace troy
 
     void Evaluator::negateInplace(Ciphertext &encrypted) const
     {
+        TROY_INSTRUMENT_CIPHERTEXT(negate, context_, encrypted);
+
         // Verify parameters.
         if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
         {
@@ -166,6 +289,8 @@ namespace troy
 
     void Evaluator::addInplace(Ciphertext &encrypted1, const Ciphertext &encrypted2) const
     {
+        TROY_INSTRUMENT_CIPHERTEXT(add, context_, encrypted1);
+
         // Verify parameters.
         if (!isMetadataValidFor(encrypted1, context_) || !isBufferValid(encrypted1))
         {
@@ -250,6 +375,7 @@ namespace troy
         {
             throw invalid_argument("encrypteds cannot be empty");
         }
+        TROY_INSTRUMENT_CIPHERTEXT(add_many, context_, encrypteds[0]);
         for (size_t i = 0; i < encrypteds.size(); i++)
         {
             if (&encrypteds[i] == &destination)
@@ -258,15 +384,78 @@ namespace troy
             }
         }
 
-        destination = encrypteds[0];
-        for (size_t i = 1; i < encrypteds.size(); i++)
+        // BGV ciphertexts with different correction factors need balancing on every addition.
+        bool same_correction_factor = all_of(encrypteds.begin(), encrypteds.end(), [&](const Ciphertext &encrypted) {
+            return encrypted.correctionFactor() == encrypteds[0].correctionFactor();
+        });
+        if (!same_correction_factor)
         {
-            addInplace(destination, encrypteds[i]);
+            destination = encrypteds[0];
+            for (size_t i = 1; i < encrypteds.size(); i++)
+            {
+                addInplace(destination, encrypteds[i]);
+            }
+            return;
         }
+
+        // Every worker sums a contiguous share of encrypteds into its own aggregator.
+        vector<CiphertextAggregator> partials;
+        mutex partials_mutex;
+        parallelForRange(encrypteds.size(), threads_, [&](size_t begin, size_t end) {
+            CiphertextAggregator partial(context_);
+            for (size_t i = begin; i < end; i++)
+            {
+                partial.add(encrypteds[i]);
+            }
+            lock_guard<mutex> lock(partials_mutex);
+            partials.push_back(std::move(partial));
+        });
+        mergeAggregators(partials, threads_, destination);
+    }
+
+    void Evaluator::addMany(const function<bool(Ciphertext &)> &next, Ciphertext &destination) const
+    {
+        // Every worker pulls ciphertexts from the stream and sums them into its own aggregator. Once one worker
+        // fails, the others stop pulling, so a bad input does not drain the rest of the stream.
+        vector<CiphertextAggregator> partials;
+        mutex next_mutex;
+        bool failed = false;
+        parallelForRange(threads_, threads_, [&](size_t, size_t) {
+            CiphertextAggregator partial(context_);
+            Ciphertext encrypted;
+            try
+            {
+                while (true)
+                {
+                    {
+                        lock_guard<mutex> lock(next_mutex);
+                        if (failed)
+                        {
+                            return;
+                        }
+                        if (!next(encrypted))
+                        {
+                            partials.push_back(std::move(partial));
+                            return;
+                        }
+                    }
+                    partial.add(encrypted);
+                }
+            }
+            catch (...)
+            {
+                lock_guard<mutex> lock(next_mutex);
+                failed = true;
+                throw;
+            }
+        });
+        mergeAggregators(partials, threads_, destination);
     }
 
     void Evaluator::subInplace(Ciphertext &encrypted1, const Ciphertext &encrypted2) const
     {
+        TROY_INSTRUMENT_CIPHERTEXT(sub, context_, encrypted1);
+
         // Verify parameters.
         if (!isMetadataValidFor(encrypted1, context_) || !isBufferValid(encrypted1))
         {
@@ -348,6 +537,8 @@ namespace troy
 
     void Evaluator::multiplyInplace(Ciphertext &encrypted1, const Ciphertext &encrypted2) const
     {
+        TROY_INSTRUMENT_CIPHERTEXT(multiply, context_, encrypted1);
+
         // Verify parameters.
         if (!isMetadataValidFor(encrypted1, context_) || !isBufferValid(encrypted1))
         {
@@ -795,6 +986,8 @@ namespace troy
 
     void Evaluator::squareInplace(Ciphertext &encrypted) const
     {
+        TROY_INSTRUMENT_CIPHERTEXT(square, context_, encrypted);
+
         // Verify parameters.
         if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
         {
@@ -1111,10 +1304,15 @@ namespace troy
     }
 
     void Evaluator::relinearizeInternal(
-        Ciphertext &encrypted, const RelinKeys &relin_keys, size_t destination_size) const
+        const vector<Ciphertext *> &encrypted_batch, const RelinKeys &relin_keys, size_t destination_size) const
     {
+        if (encrypted_batch.empty())
+        {
+            return;
+        }
+
         // Verify parameters.
-        auto context_data_ptr = context_.getContextData(encrypted.parmsID());
+        auto context_data_ptr = context_.getContextData(encrypted_batch[0]->parmsID());
         if (!context_data_ptr)
         {
             throw invalid_argument("encrypted is not valid for encryption parameters");
@@ -1124,7 +1322,14 @@ namespace troy
             throw invalid_argument("relin_keys is not valid for encryption parameters");
         }
 
-        size_t encrypted_size = encrypted.size();
+        size_t encrypted_size = encrypted_batch[0]->size();
+        for (auto encrypted : encrypted_batch)
+        {
+            if (encrypted->parmsID() != encrypted_batch[0]->parmsID() || encrypted->size() != encrypted_size)
+            {
+                throw invalid_argument("encrypted_batch must share parms_id and size");
+            }
+        }
 
         // Verify parameters.
         if (destination_size < 2 || destination_size > encrypted_size)
@@ -1145,21 +1350,37 @@ namespace troy
         // Calculate number of relinearize_one_step calls needed
         size_t relins_needed = encrypted_size - destination_size;
 
-        // Iterator pointing to the last component of encrypted
-        auto encrypted_iter = encrypted.data(encrypted_size - 1);
+        // Iterators pointing to the last component of each encrypted
+        vector<const uint64_t *> encrypted_iters(encrypted_batch.size());
+        for (size_t b = 0; b < encrypted_batch.size(); b++)
+        {
+            encrypted_iters[b] = encrypted_batch[b]->data(encrypted_size - 1);
+        }
 
         for (size_t i = 0; i < relins_needed; i++) {
-            // std::cout << "encrypted_iter diff = " << std::dec << encrypted_iter - encrypted.data() << std::endl;
             this->switchKeyInplace(
-                encrypted, encrypted_iter, static_cast<const KSwitchKeys &>(relin_keys),
+                encrypted_batch, encrypted_iters, static_cast<const KSwitchKeys &>(relin_keys),
                 RelinKeys::getIndex(encrypted_size - 1 - i));
-            // std::cout << "relinearization " << i << ":";
-            // printArray(encrypted.data(), encrypted.dynArray().size());
         }
 
         // Put the output of final relinearization into destination.
         // Prepare destination only at this point because we are resizing down
-        encrypted.resize(context_, context_data_ptr->parmsID(), destination_size);
+        for (auto encrypted : encrypted_batch)
+        {
+            encrypted->resize(context_, context_data_ptr->parmsID(), destination_size);
+        }
+    }
+
+    void Evaluator::relinearizeManyInplace(vector<Ciphertext> &encrypted, const RelinKeys &relin_keys) const
+    {
+        TROY_INSTRUMENT_SCOPE(
+            relinearize, context_, encrypted.empty() ? parmsIDZero : encrypted[0].parmsID(), encrypted.size(),
+            encrypted.empty() ? 0 : encrypted[0].size());
+
+        for (auto &batch : keySwitchingBatches(encrypted))
+        {
+            relinearizeInternal(batch, relin_keys, 2);
+        }
     }
 
     void Evaluator::modSwitchScaleToNext(
@@ -1342,6 +1563,8 @@ namespace troy
     void Evaluator::modSwitchToNext(
         const Ciphertext &encrypted, Ciphertext &destination) const
     {
+        TROY_INSTRUMENT_CIPHERTEXT(mod_switch, context_, encrypted);
+
         // Verify parameters.
         if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
         {
@@ -1429,6 +1652,8 @@ namespace troy
 
     void Evaluator::rescaleToNext(const Ciphertext &encrypted, Ciphertext &destination) const
     {
+        TROY_INSTRUMENT_CIPHERTEXT(rescale, context_, encrypted);
+
         // Verify parameters.
         if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
         {
@@ -1458,6 +1683,8 @@ namespace troy
 
     void Evaluator::rescaleToInplace(Ciphertext &encrypted, ParmsID parms_id) const
     {
+        TROY_INSTRUMENT_CIPHERTEXT(rescale, context_, encrypted);
+
         // Verify parameters.
         if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
         {
@@ -1602,6 +1829,8 @@ namespace troy
 
     void Evaluator::addPlainInplace(Ciphertext &encrypted, const Plaintext &plain) const
     {
+        TROY_INSTRUMENT_CIPHERTEXT(add_plain, context_, encrypted);
+
         // Verify parameters.
         if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
         {
@@ -1683,6 +1912,8 @@ namespace troy
 
     void Evaluator::subPlainInplace(Ciphertext &encrypted, const Plaintext &plain) const
     {        
+        TROY_INSTRUMENT_CIPHERTEXT(sub_plain, context_, encrypted);
+
         // Verify parameters.
         if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
         {
@@ -1762,8 +1993,101 @@ namespace troy
         }
     }
 
+    void Evaluator::scalePlain(const Plaintext &plain, ParmsID parms_id, ScaledPlaintext &destination) const
+    {
+        if (!isValidFor(plain, context_))
+        {
+            throw invalid_argument("plain is not valid for encryption parameters");
+        }
+        if (plain.isNttForm())
+        {
+            throw invalid_argument("plain cannot be in NTT form");
+        }
+        auto context_data_ptr = context_.getContextData(parms_id);
+        if (!context_data_ptr)
+        {
+            throw invalid_argument("parms_id is not valid for the current context");
+        }
+        auto &context_data = *context_data_ptr;
+        if (context_data.parms().scheme() != SchemeType::bfv)
+        {
+            throw invalid_argument("unsupported scheme");
+        }
+        size_t coeff_count = plain.coeffCount();
+        size_t coeff_modulus_size = context_data.parms().coeffModulus().size();
+        if (!productFitsIn(coeff_count, coeff_modulus_size))
+        {
+            throw logic_error("invalid parameters");
+        }
+
+        destination.parms_id_ = parms_id;
+        destination.coeff_count_ = coeff_count;
+        destination.data_.resize(coeff_count * coeff_modulus_size);
+        scalePlainWithScalingVariant(plain, context_data, HostPointer(destination.data_.begin()));
+    }
+
+    // Adds (or with negate set, subtracts) the residues of a scaled plaintext to c_0.
+    static void addScaledPlain(
+        const SEALContext::ContextData &context_data, size_t plain_coeff_count, ConstHostPointer<uint64_t> scaled,
+        size_t scaled_size, bool negate, HostPointer<uint64_t> destination)
+    {
+        auto &coeff_modulus = context_data.parms().coeffModulus();
+        size_t coeff_count = context_data.parms().polyModulusDegree();
+        if (scaled_size != plain_coeff_count * coeff_modulus.size() || plain_coeff_count > coeff_count)
+        {
+            throw invalid_argument("plain is not valid for encryption parameters");
+        }
+        for (size_t j = 0; j < coeff_modulus.size(); j++)
+        {
+            HostPointer<uint64_t> d = destination + j * coeff_count;
+            ConstHostPointer<uint64_t> m = scaled + j * plain_coeff_count;
+            if (negate)
+                subPolyCoeffmod(d, m, plain_coeff_count, coeff_modulus[j], d);
+            else
+                addPolyCoeffmod(d, m, plain_coeff_count, coeff_modulus[j], d);
+        }
+    }
+
+    void Evaluator::addPlainInplace(Ciphertext &encrypted, const ScaledPlaintext &plain) const
+    {
+        if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
+        {
+            throw invalid_argument("encrypted is not valid for encryption parameters");
+        }
+        if (encrypted.isNttForm())
+        {
+            throw invalid_argument("BFV encrypted cannot be in NTT form");
+        }
+        if (encrypted.parmsID() != plain.parmsID())
+        {
+            throw invalid_argument("encrypted and plain parameter mismatch");
+        }
+        auto &context_data = *context_.getContextData(encrypted.parmsID());
+        addScaledPlain(context_data, plain.coeffCount(), plain.data_.cbegin(), plain.data_.size(), false, encrypted.data(0));
+    }
+
+    void Evaluator::subPlainInplace(Ciphertext &encrypted, const ScaledPlaintext &plain) const
+    {
+        if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
+        {
+            throw invalid_argument("encrypted is not valid for encryption parameters");
+        }
+        if (encrypted.isNttForm())
+        {
+            throw invalid_argument("BFV encrypted cannot be in NTT form");
+        }
+        if (encrypted.parmsID() != plain.parmsID())
+        {
+            throw invalid_argument("encrypted and plain parameter mismatch");
+        }
+        auto &context_data = *context_.getContextData(encrypted.parmsID());
+        addScaledPlain(context_data, plain.coeffCount(), plain.data_.cbegin(), plain.data_.size(), true, encrypted.data(0));
+    }
+
     void Evaluator::multiplyPlainInplace(Ciphertext &encrypted, const Plaintext &plain) const
     {
+        TROY_INSTRUMENT_CIPHERTEXT(multiply_plain, context_, encrypted);
+
         // Verify parameters.
         if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
         {
@@ -1969,84 +2293,445 @@ namespace troy
         }
     }
 
-    void Evaluator::transformToNttInplace(Plaintext &plain, ParmsID parms_id) const
+    void Evaluator::multiplyPlainAccumulate(
+        const vector<const Ciphertext *> &encrypteds, const vector<const Plaintext *> &plains,
+        Ciphertext &destination) const
     {
         // Verify parameters.
-        if (!isValidFor(plain, context_))
+        if (encrypteds.empty())
         {
-            throw invalid_argument("plain is not valid for encryption parameters");
+            throw invalid_argument("encrypteds cannot be empty");
         }
-
-        auto context_data_ptr = context_.getContextData(parms_id);
-        if (!context_data_ptr)
+        if (encrypteds.size() != plains.size())
         {
-            throw invalid_argument("parms_id is not valid for the current context");
+            throw invalid_argument("encrypteds and plains size mismatch");
         }
-        if (plain.isNttForm())
+        const Ciphertext &first = *encrypteds[0];
+        ParmsID parms_id = first.parmsID();
+        size_t encrypted_size = first.size();
+        double scale = first.scale() * plains[0]->scale();
+        size_t count = encrypteds.size();
+        for (size_t k = 0; k < count; k++)
         {
-            throw invalid_argument("plain is already in NTT form");
+            const Ciphertext &encrypted = *encrypteds[k];
+            const Plaintext &plain = *plains[k];
+            if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
+            {
+                throw invalid_argument("encrypted is not valid for encryption parameters");
+            }
+            if (!isMetadataValidFor(plain, context_) || !isBufferValid(plain))
+            {
+                throw invalid_argument("plain is not valid for encryption parameters");
+            }
+            if (!encrypted.isNttForm() || !plain.isNttForm())
+            {
+                throw invalid_argument("operands must be in NTT form");
+            }
+            if (encrypted.parmsID() != parms_id || plain.parmsID() != parms_id)
+            {
+                throw invalid_argument("encrypted and plain parameter mismatch");
+            }
+            if (encrypted.size() != encrypted_size)
+            {
+                throw invalid_argument("encrypted size mismatch");
+            }
+            if (!areClose<double>(encrypted.scale() * plain.scale(), scale))
+            {
+                throw invalid_argument("scale mismatch");
+            }
         }
 
         // Extract encryption parameters.
-        auto &context_data = *context_data_ptr;
+        auto &context_data = *context_.getContextData(parms_id);
         auto &parms = context_data.parms();
         auto &coeff_modulus = parms.coeffModulus();
         size_t coeff_count = parms.polyModulusDegree();
         size_t coeff_modulus_size = coeff_modulus.size();
-        size_t plain_coeff_count = plain.coeffCount();
-
-        uint64_t plain_upper_half_threshold = context_data.plainUpperHalfThreshold();
-        auto plain_upper_half_increment = context_data.plainUpperHalfIncrement();
-
-        auto ntt_tables = context_data.smallNTTTables();
 
         // Size check
-        if (!productFitsIn(coeff_count, coeff_modulus_size))
+        if (!productFitsIn(encrypted_size, mul_safe(coeff_count, coeff_modulus_size)))
         {
             throw logic_error("invalid parameters");
         }
+        if (!isScaleWithinBounds(scale, context_data))
+        {
+            throw invalid_argument("scale out of bounds");
+        }
 
-        // Resize to fit the entire NTT transformed (ciphertext size) polynomial
-        // Note that the new coefficients are automatically set to 0
-        plain.resize(coeff_count * coeff_modulus_size);
-        auto plain_iter = plain.data();
+        // The destination may alias one of the operands, so accumulate into a temporary
+        Ciphertext result;
+        result.resize(context_, parms_id, encrypted_size);
+        result.isNttForm() = true;
+        result.scale() = scale;
+        result.correctionFactor() = first.correctionFactor();
 
-        if (!context_data.qualifiers().using_fast_plain_lift)
-        {
-            // Allocate temporary space for an entire RNS polynomial
-            // Slight semantic misuse of RNSIter here, but this works well
-            auto temp = allocateZeroPoly(coeff_modulus_size, coeff_count);
-            // SEAL_ALLOCATE_ZERO_GET_RNS_ITER(temp, coeff_modulus_size, coeff_count, pool);
+        // Product of two numbers is up to 60 + 60 = 120 bits, so we can sum up to 256 of them without reduction.
+        size_t lazy_reduction_summand_bound = size_t(SEAL_MULTIPLY_ACCUMULATE_USER_MOD_MAX);
 
-            for (size_t i = 0; i < plain_coeff_count; i++) {
-            // SEAL_ITERATE(iter(plain.data(), temp), plain_coeff_count, [&](auto I) {
-                auto plain_value = plain.data()[i];
-                if (plain_value >= plain_upper_half_threshold)
+        // Lazy accumulator (128-bit coefficients) for a single RNS component
+        auto t_poly_lazy = allocateUint(2 * coeff_count);
+        for (size_t i = 0; i < encrypted_size; i++)
+        {
+            for (size_t j = 0; j < coeff_modulus_size; j++)
+            {
+                const Modulus &modulus = coeff_modulus[j];
+                uint64_t *accumulator = t_poly_lazy.get();
+                setZeroUint(2 * coeff_count, accumulator);
+                size_t lazy_reduction_counter = lazy_reduction_summand_bound;
+                for (size_t k = 0; k < count; k++)
                 {
-                    addUint(plain_upper_half_increment, coeff_modulus_size, plain_value, temp.get() + i * coeff_modulus_size);
+                    const uint64_t *operand1 = encrypteds[k]->data(i) + j * coeff_count;
+                    const uint64_t *operand2 = plains[k]->data() + j * coeff_count;
+                    if (!--lazy_reduction_counter)
+                    {
+                        for (size_t l = 0; l < coeff_count; l++)
+                        {
+                            uint64_t qword[2]{ 0, 0 };
+                            multiplyUint64(operand1[l], operand2[l], qword);
+                            auto accumulator_l = accumulator + 2 * l;
+                            addUint128(qword, accumulator_l, qword);
+                            accumulator_l[0] = barrettReduce128(qword, modulus);
+                            accumulator_l[1] = 0;
+                        }
+                        lazy_reduction_counter = lazy_reduction_summand_bound;
+                    }
+                    else
+                    {
+                        for (size_t l = 0; l < coeff_count; l++)
+                        {
+                            uint64_t qword[2]{ 0, 0 };
+                            multiplyUint64(operand1[l], operand2[l], qword);
+                            auto accumulator_l = accumulator + 2 * l;
+                            addUint128(qword, accumulator_l, accumulator_l);
+                        }
+                    }
                 }
-                else
+
+                // Final modular reduction
+                uint64_t *result_iter = result.data(i) + j * coeff_count;
+                for (size_t l = 0; l < coeff_count; l++)
                 {
-                    temp[i * coeff_modulus_size] = plain_value;
+                    result_iter[l] = barrettReduce128(accumulator + 2 * l, modulus);
                 }
             }
+        }
 
-            context_data.rnsTool()->baseq()->decomposeArray(temp.get(), coeff_count);
+        destination = std::move(result);
+    }
 
-            // Copy data back to plain
-            setPoly(temp.get(), coeff_count, coeff_modulus_size, plain.data());
+    void Evaluator::extendToBehzNtt(const Ciphertext &encrypted, BehzCiphertext &destination) const
+    {
+        // Verify parameters.
+        if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
+        {
+            throw invalid_argument("encrypted is not valid for encryption parameters");
         }
-        else
+        if (context_.firstContextData()->parms().scheme() != SchemeType::bfv)
         {
-            // Note that in this case plain_upper_half_increment holds its value in RNS form modulo the coeff_modulus
-            // primes.
+            throw invalid_argument("unsupported scheme");
+        }
+        if (encrypted.isNttForm())
+        {
+            throw invalid_argument("encrypted cannot be in NTT form");
+        }
 
-            // Create a "reversed" helper iterator that iterates in the reverse order both plain RNS components and
-            // the plain_upper_half_increment values.
-            // auto helper_iter = reverse_iter(plain_iter, plain_upper_half_increment);
-            // advance(helper_iter, -safe_cast<ptrdiff_t>(coeff_modulus_size - 1));
+        // Extract encryption parameters.
+        auto &context_data = *context_.getContextData(encrypted.parmsID());
+        auto &parms = context_data.parms();
+        size_t coeff_count = parms.polyModulusDegree();
+        size_t base_q_size = parms.coeffModulus().size();
+        size_t encrypted_size = encrypted.size();
 
-            // SEAL_ITERATE(helper_iter, coeff_modulus_size, [&](auto I) {
+        auto rns_tool = context_data.rnsTool();
+        size_t base_Bsk_size = rns_tool->baseBsk()->size();
+        size_t base_Bsk_m_tilde_size = rns_tool->baseBskmTilde()->size();
+        size_t poly_uint64_count = mul_safe(coeff_count, base_q_size + base_Bsk_size);
+
+        auto base_q_ntt_tables = context_data.smallNTTTables();
+        auto base_Bsk_ntt_tables = rns_tool->baseBskNttTables();
+
+        destination.parms_id_ = encrypted.parmsID();
+        destination.size_ = encrypted_size;
+        destination.data_.resize(mul_safe(encrypted_size, poly_uint64_count));
+
+        // BEHZ steps (1)-(3) of bfvMultiply. The NTT outputs are fully reduced so that
+        // multiplyAccumulate can sum many 120-bit products before reducing.
+        auto temp = allocatePoly(coeff_count, base_Bsk_m_tilde_size);
+        for (size_t i = 0; i < encrypted_size; i++)
+        {
+            HostPointer<uint64_t> poly_q(destination.data_.begin() + i * poly_uint64_count);
+            HostPointer<uint64_t> poly_Bsk = poly_q + coeff_count * base_q_size;
+
+            setPoly(encrypted.data(i), coeff_count, base_q_size, poly_q.get());
+            nttNegacyclicHarvey(poly_q, base_q_size, base_q_ntt_tables);
+
+            // (1) Convert from base q to base Bsk U {m_tilde}
+            rns_tool->fastbconvmTilde(encrypted.data(i), temp.asPointer());
+
+            // (2) Reduce q-overflows in with Montgomery reduction, switching base to Bsk
+            rns_tool->smMrq(temp.asPointer(), poly_Bsk);
+
+            // (3) Transform to NTT form in base Bsk
+            nttNegacyclicHarvey(poly_Bsk, base_Bsk_size, base_Bsk_ntt_tables);
+        }
+    }
+
+    void Evaluator::multiplyAccumulate(
+        const vector<const BehzCiphertext *> &encrypteds1, const vector<const BehzCiphertext *> &encrypteds2,
+        Ciphertext &destination) const
+    {
+        // Verify parameters.
+        if (encrypteds1.empty())
+        {
+            throw invalid_argument("encrypteds1 cannot be empty");
+        }
+        if (encrypteds1.size() != encrypteds2.size())
+        {
+            throw invalid_argument("encrypteds1 and encrypteds2 size mismatch");
+        }
+        ParmsID parms_id = encrypteds1[0]->parmsID();
+        size_t encrypted1_size = encrypteds1[0]->size();
+        size_t encrypted2_size = encrypteds2[0]->size();
+        size_t count = encrypteds1.size();
+        for (size_t k = 0; k < count; k++)
+        {
+            if (encrypteds1[k]->parmsID() != parms_id || encrypteds2[k]->parmsID() != parms_id)
+            {
+                throw invalid_argument("encrypted parameter mismatch");
+            }
+            if (encrypteds1[k]->size() != encrypted1_size || encrypteds2[k]->size() != encrypted2_size)
+            {
+                throw invalid_argument("encrypted size mismatch");
+            }
+        }
+        auto context_data_ptr = context_.getContextData(parms_id);
+        if (!context_data_ptr || encrypted1_size < 2 || encrypted2_size < 2)
+        {
+            throw invalid_argument("encrypted is not valid for encryption parameters");
+        }
+
+        // Sums of more products than base Bsk has headroom for are floored chunk by chunk.
+        auto &context_data = *context_data_ptr;
+        size_t chunk_size = behzAccumulateBound(context_data, encrypted1_size, encrypted2_size);
+        if (multiply_accumulate_chunk_size_)
+        {
+            chunk_size = min(chunk_size, multiply_accumulate_chunk_size_);
+        }
+        if (count > chunk_size)
+        {
+            Ciphertext sum, partial;
+            for (size_t begin = 0; begin < count; begin += chunk_size)
+            {
+                size_t end = min(count, begin + chunk_size);
+                vector<const BehzCiphertext *> chunk1(encrypteds1.begin() + begin, encrypteds1.begin() + end);
+                vector<const BehzCiphertext *> chunk2(encrypteds2.begin() + begin, encrypteds2.begin() + end);
+                multiplyAccumulate(chunk1, chunk2, begin ? partial : sum);
+                if (begin)
+                {
+                    addInplace(sum, partial);
+                }
+            }
+            destination = std::move(sum);
+            return;
+        }
+
+        // Extract encryption parameters.
+        auto &parms = context_data.parms();
+        size_t coeff_count = parms.polyModulusDegree();
+        size_t base_q_size = parms.coeffModulus().size();
+        uint64_t plain_modulus = parms.plainModulus().value();
+
+        auto rns_tool = context_data.rnsTool();
+        size_t base_Bsk_size = rns_tool->baseBsk()->size();
+        size_t base_size = base_q_size + base_Bsk_size;
+        size_t poly_uint64_count = mul_safe(coeff_count, base_size);
+        size_t dest_size = sub_safe(add_safe(encrypted1_size, encrypted2_size), size_t(1));
+
+        // Size check
+        if (!productFitsIn(dest_size, poly_uint64_count))
+        {
+            throw logic_error("invalid parameters");
+        }
+
+        auto base_q = parms.coeffModulus().data();
+        auto base_Bsk = rns_tool->baseBsk()->base();
+        auto base_q_ntt_tables = context_data.smallNTTTables();
+        auto base_Bsk_ntt_tables = rns_tool->baseBskNttTables();
+
+        // BEHZ step (4) for every pair, summed in the extended NTT domain. Products of reduced operands
+        // are up to 120 bits in base q, so SEAL_MULTIPLY_ACCUMULATE_USER_MOD_MAX of them fit in 128 bits, but
+        // up to 122 bits in base Bsk, whose primes have 61 bits, where only SEAL_MULTIPLY_ACCUMULATE_MOD_MAX fit.
+        auto temp_dest_q = allocatePolyArray(dest_size, coeff_count, base_q_size);
+        auto temp_dest_Bsk = allocatePolyArray(dest_size, coeff_count, base_Bsk_size);
+        auto t_poly_lazy = allocateUint(2 * coeff_count);
+        for (size_t i = 0; i < dest_size; i++)
+        {
+            size_t curr_encrypted1_last = min<size_t>(i, encrypted1_size - 1);
+            size_t curr_encrypted2_first = min<size_t>(i, encrypted2_size - 1);
+            size_t curr_encrypted1_first = i - curr_encrypted2_first;
+            size_t steps = curr_encrypted1_last - curr_encrypted1_first + 1;
+
+            for (size_t j = 0; j < base_size; j++)
+            {
+                bool in_q = j < base_q_size;
+                const Modulus &modulus = in_q ? base_q[j] : base_Bsk[j - base_q_size];
+                size_t lazy_reduction_summand_bound = in_q ? size_t(SEAL_MULTIPLY_ACCUMULATE_USER_MOD_MAX)
+                                                           : size_t(SEAL_MULTIPLY_ACCUMULATE_MOD_MAX);
+                uint64_t *accumulator = t_poly_lazy.get();
+                setZeroUint(2 * coeff_count, accumulator);
+                size_t lazy_reduction_counter = lazy_reduction_summand_bound;
+                for (size_t k = 0; k < count; k++)
+                {
+                    for (size_t step = 0; step < steps; step++)
+                    {
+                        const uint64_t *operand1 = encrypteds1[k]->data_.cbegin() +
+                                                   (curr_encrypted1_first + step) * poly_uint64_count + j * coeff_count;
+                        const uint64_t *operand2 = encrypteds2[k]->data_.cbegin() +
+                                                   (curr_encrypted2_first - step) * poly_uint64_count + j * coeff_count;
+                        if (!--lazy_reduction_counter)
+                        {
+                            for (size_t l = 0; l < coeff_count; l++)
+                            {
+                                uint64_t qword[2]{ 0, 0 };
+                                multiplyUint64(operand1[l], operand2[l], qword);
+                                auto accumulator_l = accumulator + 2 * l;
+                                addUint128(qword, accumulator_l, qword);
+                                accumulator_l[0] = barrettReduce128(qword, modulus);
+                                accumulator_l[1] = 0;
+                            }
+                            lazy_reduction_counter = lazy_reduction_summand_bound;
+                        }
+                        else
+                        {
+                            for (size_t l = 0; l < coeff_count; l++)
+                            {
+                                uint64_t qword[2]{ 0, 0 };
+                                multiplyUint64(operand1[l], operand2[l], qword);
+                                auto accumulator_l = accumulator + 2 * l;
+                                addUint128(qword, accumulator_l, accumulator_l);
+                            }
+                        }
+                    }
+                }
+
+                // Final modular reduction
+                uint64_t *result_iter = in_q ? temp_dest_q.get() + (i * base_q_size + j) * coeff_count
+                                             : temp_dest_Bsk.get() + (i * base_Bsk_size + j - base_q_size) * coeff_count;
+                for (size_t l = 0; l < coeff_count; l++)
+                {
+                    result_iter[l] = barrettReduce128(accumulator + 2 * l, modulus);
+                }
+            }
+        }
+
+        // BEHZ step (5): transform data from NTT form
+        inverseNttNegacyclicHarveyLazy(temp_dest_q.asPointer(), dest_size, base_q_size, base_q_ntt_tables);
+        inverseNttNegacyclicHarveyLazy(temp_dest_Bsk.asPointer(), dest_size, base_Bsk_size, base_Bsk_ntt_tables);
+
+        // BEHZ steps (6)-(8), once for the whole sum
+        Ciphertext result;
+        result.resize(context_, parms_id, dest_size);
+        result.isNttForm() = false;
+        auto temp_q_Bsk = allocatePoly(coeff_count, base_size);
+        auto temp_Bsk = allocatePoly(coeff_count, base_Bsk_size);
+        for (size_t i = 0; i < dest_size; i++)
+        {
+            // Step (6): multiply base q components by t (plain_modulus)
+            multiplyPolyScalarCoeffmod(
+                temp_dest_q + i * coeff_count * base_q_size, base_q_size, coeff_count, plain_modulus, base_q,
+                temp_q_Bsk.asPointer());
+            multiplyPolyScalarCoeffmod(
+                temp_dest_Bsk + i * coeff_count * base_Bsk_size, base_Bsk_size, coeff_count, plain_modulus, base_Bsk,
+                temp_q_Bsk + base_q_size * coeff_count);
+
+            // Step (7): divide by q and floor, producing a result in base Bsk
+            rns_tool->fastFloor(temp_q_Bsk.asPointer(), temp_Bsk.asPointer());
+
+            // Step (8): use Shenoy-Kumaresan method to convert the result to base q
+            rns_tool->fastbconvSk(temp_Bsk.asPointer(), result.data(i));
+        }
+
+        destination = std::move(result);
+    }
+
+    void Evaluator::transformToNttInplace(Plaintext &plain, ParmsID parms_id) const
+    {
+        // Verify parameters.
+        if (!isValidFor(plain, context_))
+        {
+            throw invalid_argument("plain is not valid for encryption parameters");
+        }
+
+        auto context_data_ptr = context_.getContextData(parms_id);
+        if (!context_data_ptr)
+        {
+            throw invalid_argument("parms_id is not valid for the current context");
+        }
+        if (plain.isNttForm())
+        {
+            throw invalid_argument("plain is already in NTT form");
+        }
+
+        // Extract encryption parameters.
+        auto &context_data = *context_data_ptr;
+        auto &parms = context_data.parms();
+        auto &coeff_modulus = parms.coeffModulus();
+        size_t coeff_count = parms.polyModulusDegree();
+        size_t coeff_modulus_size = coeff_modulus.size();
+        size_t plain_coeff_count = plain.coeffCount();
+
+        uint64_t plain_upper_half_threshold = context_data.plainUpperHalfThreshold();
+        auto plain_upper_half_increment = context_data.plainUpperHalfIncrement();
+
+        auto ntt_tables = context_data.smallNTTTables();
+
+        // Size check
+        if (!productFitsIn(coeff_count, coeff_modulus_size))
+        {
+            throw logic_error("invalid parameters");
+        }
+
+        // Resize to fit the entire NTT transformed (ciphertext size) polynomial
+        // Note that the new coefficients are automatically set to 0
+        plain.resize(coeff_count * coeff_modulus_size);
+        auto plain_iter = plain.data();
+
+        if (!context_data.qualifiers().using_fast_plain_lift)
+        {
+            // Allocate temporary space for an entire RNS polynomial
+            // Slight semantic misuse of RNSIter here, but this works well
+            auto temp = allocateZeroPoly(coeff_modulus_size, coeff_count);
+            // SEAL_ALLOCATE_ZERO_GET_RNS_ITER(temp, coeff_modulus_size, coeff_count, pool);
+
+            for (size_t i = 0; i < plain_coeff_count; i++) {
+            // SEAL_ITERATE(iter(plain.data(), temp), plain_coeff_count, [&](auto I) {
+                auto plain_value = plain.data()[i];
+                if (plain_value >= plain_upper_half_threshold)
+                {
+                    addUint(plain_upper_half_increment, coeff_modulus_size, plain_value, temp.get() + i * coeff_modulus_size);
+                }
+                else
+                {
+                    temp[i * coeff_modulus_size] = plain_value;
+                }
+            }
+
+            context_data.rnsTool()->baseq()->decomposeArray(temp.get(), coeff_count);
+
+            // Copy data back to plain
+            setPoly(temp.get(), coeff_count, coeff_modulus_size, plain.data());
+        }
+        else
+        {
+            // Note that in this case plain_upper_half_increment holds its value in RNS form modulo the coeff_modulus
+            // primes.
+
+            // Create a "reversed" helper iterator that iterates in the reverse order both plain RNS components and
+            // the plain_upper_half_increment values.
+            // auto helper_iter = reverse_iter(plain_iter, plain_upper_half_increment);
+            // advance(helper_iter, -safe_cast<ptrdiff_t>(coeff_modulus_size - 1));
+
+            // SEAL_ITERATE(helper_iter, coeff_modulus_size, [&](auto I) {
             //     SEAL_ITERATE(iter(*plain_iter, get<0>(I)), plain_coeff_count, [&](auto J) {
             //         get<1>(J) =
             //             SEAL_COND_SELECT(get<0>(J) >= plain_upper_half_threshold, get<0>(J) + get<1>(I), get<0>(J));
@@ -2071,6 +2756,8 @@ namespace troy
 
     void Evaluator::transformToNttInplace(Ciphertext &encrypted) const
     {
+        TROY_INSTRUMENT_CIPHERTEXT(transform_to_ntt, context_, encrypted);
+
         // Verify parameters.
         if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
         {
@@ -2110,148 +2797,614 @@ namespace troy
         encrypted.isNttForm() = true;
     }
 
-    void Evaluator::transformFromNttInplace(Ciphertext &encrypted_ntt) const
+    void Evaluator::transformFromNttInplace(Ciphertext &encrypted_ntt) const
+    {
+        TROY_INSTRUMENT_CIPHERTEXT(transform_from_ntt, context_, encrypted_ntt);
+
+        // Verify parameters.
+        if (!isMetadataValidFor(encrypted_ntt, context_) || !isBufferValid(encrypted_ntt))
+        {
+            throw invalid_argument("encrypted is not valid for encryption parameters");
+        }
+
+        auto context_data_ptr = context_.getContextData(encrypted_ntt.parmsID());
+        if (!context_data_ptr)
+        {
+            throw invalid_argument("encrypted_ntt is not valid for encryption parameters");
+        }
+        if (!encrypted_ntt.isNttForm())
+        {
+            throw invalid_argument("encrypted_ntt is not in NTT form");
+        }
+
+        // Extract encryption parameters.
+        auto &context_data = *context_data_ptr;
+        auto &parms = context_data.parms();
+        size_t coeff_count = parms.polyModulusDegree();
+        size_t coeff_modulus_size = parms.coeffModulus().size();
+        size_t encrypted_ntt_size = encrypted_ntt.size();
+
+        auto ntt_tables = context_data.smallNTTTables();
+
+        // Size check
+        if (!productFitsIn(coeff_count, coeff_modulus_size))
+        {
+            throw logic_error("invalid parameters");
+        }
+
+        // Transform each polynomial from NTT domain
+        inverseNttNegacyclicHarvey(encrypted_ntt.data(), encrypted_ntt_size, coeff_modulus_size, ntt_tables);
+
+        // Finally change the is_ntt_transformed flag
+        encrypted_ntt.isNttForm() = false;
+    }
+
+    void Evaluator::applyGaloisInternal(
+        const vector<Ciphertext *> &encrypted_batch, uint32_t galois_elt, const GaloisKeys &galois_keys) const
+    {
+        if (encrypted_batch.empty())
+        {
+            return;
+        }
+
+        // Verify parameters.
+        for (auto encrypted : encrypted_batch)
+        {
+            if (!isMetadataValidFor(*encrypted, context_) || !isBufferValid(*encrypted))
+            {
+                throw invalid_argument("encrypted is not valid for encryption parameters");
+            }
+            if (encrypted->parmsID() != encrypted_batch[0]->parmsID())
+            {
+                throw invalid_argument("encrypted_batch must share parms_id");
+            }
+            if (encrypted->size() > 2)
+            {
+                throw invalid_argument("encrypted size must be 2");
+            }
+        }
+
+        // Don't validate all of galois_keys but just check the parms_id.
+        if (galois_keys.parmsID() != context_.keyParmsID())
+        {
+            throw invalid_argument("galois_keys is not valid for encryption parameters");
+        }
+
+        auto &context_data = *context_.getContextData(encrypted_batch[0]->parmsID());
+        auto &parms = context_data.parms();
+        auto &coeff_modulus = parms.coeffModulus();
+        size_t coeff_count = parms.polyModulusDegree();
+        size_t coeff_modulus_size = coeff_modulus.size();
+        size_t batch_size = encrypted_batch.size();
+        // Use key_context_data where permutation tables exist since previous runs.
+        auto galois_tool = context_.keyContextData()->galoisTool();
+
+        // Size check
+        if (!productFitsIn(coeff_count, mul_safe(coeff_modulus_size, batch_size)))
+        {
+            throw logic_error("invalid parameters");
+        }
+
+        // Check if Galois key is generated or not.
+        if (!galois_keys.hasKey(galois_elt))
+        {
+            throw invalid_argument("Galois key not present");
+        }
+
+        uint64_t m = mul_safe(static_cast<uint64_t>(coeff_count), uint64_t(2));
+
+        // Verify parameters
+        if (!(galois_elt & 1) || galois_elt >= m)
+        {
+            throw invalid_argument("Galois element is not valid");
+        }
+
+        // One temp per ciphertext, since all of them are key switched together at the end.
+        size_t poly_uint64_count = coeff_count * coeff_modulus_size;
+        auto temp_batch = allocateUint(batch_size * poly_uint64_count);
+        vector<const uint64_t *> temp_iters(batch_size);
+
+        for (size_t b = 0; b < batch_size; b++)
+        {
+            Ciphertext &encrypted = *encrypted_batch[b];
+            auto temp = temp_batch + b * poly_uint64_count;
+            temp_iters[b] = temp.get();
+
+            // DO NOT CHANGE EXECUTION ORDER OF FOLLOWING SECTION
+            // BEGIN: Apply Galois for each ciphertext
+            // Execution order is sensitive, since apply_galois is not inplace!
+            if (parms.scheme() == SchemeType::bfv || parms.scheme() == SchemeType::bgv)
+            {
+                // !!! DO NOT CHANGE EXECUTION ORDER!!!
+
+                // First transform encrypted.data(0)
+                galois_tool->applyGalois(encrypted.data(0), coeff_modulus_size, galois_elt, coeff_modulus.data(), temp);
+
+                // Copy result to encrypted.data(0)
+                setPoly(temp.get(), coeff_count, coeff_modulus_size, encrypted.data(0));
+
+                // Next transform encrypted.data(1)
+                galois_tool->applyGalois(encrypted.data(1), coeff_modulus_size, galois_elt, coeff_modulus.data(), temp);
+            }
+            else if (parms.scheme() == SchemeType::ckks)
+            {
+                // !!! DO NOT CHANGE EXECUTION ORDER!!!
+
+                // First transform encrypted.data(0)
+                galois_tool->applyGaloisNtt(encrypted.data(0), coeff_modulus_size, galois_elt, temp);
+
+                // Copy result to encrypted.data(0)
+                setPoly(temp.get(), coeff_count, coeff_modulus_size, encrypted.data(0));
+
+                // Next transform encrypted.data(1)
+                galois_tool->applyGaloisNtt(encrypted.data(1), coeff_modulus_size, galois_elt, temp);
+            }
+            else
+            {
+                throw logic_error("scheme not implemented");
+            }
+
+            // Wipe encrypted.data(1)
+            setZeroPoly(coeff_count, coeff_modulus_size, encrypted.data(1));
+
+            // END: Apply Galois for each ciphertext
+            // REORDERING IS SAFE NOW
+        }
+
+        // Calculate (temp * galois_key[0], temp * galois_key[1]) + (ct[0], 0)
+        switchKeyInplace(
+            encrypted_batch, temp_iters, static_cast<const KSwitchKeys &>(galois_keys),
+            GaloisKeys::getIndex(galois_elt));
+    }
+
+    void Evaluator::negacyclicShift(const Ciphertext &encrypted, size_t shift, Ciphertext &destination) const
+    {
+        // Verify parameters.
+        if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
+        {
+            throw invalid_argument("encrypted is not valid for encryption parameters");
+        }
+        if (encrypted.isNttForm())
+        {
+            throw invalid_argument("encrypted cannot be in NTT form");
+        }
+
+        auto &context_data = *context_.getContextData(encrypted.parmsID());
+        auto &parms = context_data.parms();
+        auto &coeff_modulus = parms.coeffModulus();
+        size_t coeff_count = parms.polyModulusDegree();
+        if (shift >= mul_safe(coeff_count, size_t(2)))
+        {
+            throw invalid_argument("shift is out of range");
+        }
+
+        // The shift cannot be done in place, so never alias the destination.
+        if (&destination == &encrypted)
+        {
+            Ciphertext temp = encrypted;
+            negacyclicShift(temp, shift, destination);
+            return;
+        }
+        destination = encrypted;
+        negacyclicShiftPolyCoeffmod(
+            encrypted.data(), encrypted.size(), coeff_modulus.size(), coeff_count, shift, &coeff_modulus[0],
+            destination.data());
+    }
+
+    void Evaluator::divideByPolyModulusDegreeInplace(Ciphertext &encrypted, uint64_t mul) const
+    {
+        // Verify parameters.
+        if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
+        {
+            throw invalid_argument("encrypted is not valid for encryption parameters");
+        }
+
+        auto &context_data = *context_.getContextData(encrypted.parmsID());
+        auto &parms = context_data.parms();
+        auto &coeff_modulus = parms.coeffModulus();
+        size_t coeff_count = parms.polyModulusDegree();
+        size_t coeff_modulus_size = coeff_modulus.size();
+        auto ntt_tables = context_data.smallNTTTables();
+
+        // Fold N^{-1} and mul into a single scalar per prime.
+        for (size_t j = 0; j < coeff_modulus_size; j++)
+        {
+            MultiplyUIntModOperand scalar;
+            scalar.set(
+                multiplyUintMod(
+                    ntt_tables[j].invDegreeModulo().operand, barrettReduce64(mul, coeff_modulus[j]), coeff_modulus[j]),
+                coeff_modulus[j]);
+            for (size_t i = 0; i < encrypted.size(); i++)
+            {
+                auto poly = encrypted.data(i) + j * coeff_count;
+                multiplyPolyScalarCoeffmod(poly, coeff_count, scalar, coeff_modulus[j], poly);
+            }
+        }
+    }
+
+    void Evaluator::fieldTraceInplace(Ciphertext &encrypted, const GaloisKeys &automorphism_keys, size_t logn) const
+    {
+        size_t poly_degree = encrypted.polyModulusDegree();
+        Ciphertext temp;
+        while (poly_degree > (size_t(1) << logn))
+        {
+            uint32_t galois_element = static_cast<uint32_t>(poly_degree + 1);
+            applyGalois(encrypted, galois_element, automorphism_keys, temp);
+            addInplace(encrypted, temp);
+            poly_degree >>= 1;
+        }
+    }
+
+    void Evaluator::extractLWE(
+        const Ciphertext &encrypted, const vector<size_t> &indices, vector<LWECiphertext> &destination) const
+    {
+        // Verify parameters.
+        if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
+        {
+            throw invalid_argument("encrypted is not valid for encryption parameters");
+        }
+        if (encrypted.size() != 2)
+        {
+            throw invalid_argument("encrypted size must be 2");
+        }
+
+        auto &context_data = *context_.getContextData(encrypted.parmsID());
+        auto &coeff_modulus = context_data.parms().coeffModulus();
+        size_t coeff_count = context_data.parms().polyModulusDegree();
+        size_t coeff_modulus_size = coeff_modulus.size();
+        for (size_t index : indices)
+        {
+            if (index >= coeff_count)
+            {
+                throw invalid_argument("index is out of range");
+            }
+        }
+
+        Ciphertext coefficients;
+        const Ciphertext *source = &encrypted;
+        if (encrypted.isNttForm())
+        {
+            transformFromNtt(encrypted, coefficients);
+            source = &coefficients;
+        }
+
+        // Coefficient index of c_0 + c_1 * s is the constant coefficient of c_0[index] + (c_1 * X^(-index)) * s.
+        destination.resize(indices.size());
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            size_t index = indices[i];
+            LWECiphertext &sample = destination[i];
+            sample.resize(context_, encrypted.parmsID());
+            sample.scale() = encrypted.scale();
+            sample.correctionFactor() = encrypted.correctionFactor();
+            for (size_t j = 0; j < coeff_modulus_size; j++)
+            {
+                sample.c0()[j] = source->data(0)[j * coeff_count + index];
+            }
+            negacyclicShiftPolyCoeffmod(
+                ConstHostPointer<uint64_t>(source->data(1)), coeff_modulus_size, coeff_count,
+                (2 * coeff_count - index) % (2 * coeff_count), &coeff_modulus[0], HostPointer<uint64_t>(sample.c1()));
+        }
+    }
+
+    void Evaluator::modSwitchToNextInplace(LWECiphertext &encrypted) const
+    {
+        // Verify parameters.
+        auto context_data_ptr = context_.getContextData(encrypted.parmsID());
+        if (!context_data_ptr)
+        {
+            throw invalid_argument("encrypted is not valid for encryption parameters");
+        }
+        if (context_.lastParmsID() == encrypted.parmsID())
+        {
+            throw invalid_argument("end of modulus switching chain reached");
+        }
+
+        auto &next_context_data = *context_data_ptr->nextContextData();
+        size_t coeff_count = next_context_data.parms().polyModulusDegree();
+        size_t next_coeff_modulus_size = next_context_data.parms().coeffModulus().size();
+        LWECiphertext switched;
+        switched.resize(context_, next_context_data.parmsID());
+        switched.scale() = encrypted.scale();
+        switched.correctionFactor() = encrypted.correctionFactor();
+
+        if (context_data_ptr->parms().scheme() == SchemeType::ckks)
+        {
+            // Drop the last prime, keeping the scale.
+            copy_n(encrypted.c0(), next_coeff_modulus_size, switched.c0());
+            copy_n(encrypted.c1(), coeff_count * next_coeff_modulus_size, switched.c1());
+        }
+        else
+        {
+            // Reuse the RLWE modulus switching on the assembled sample; the divide-and-round is coefficient-wise,
+            // so the constant coefficient of c_0 comes out right.
+            Ciphertext assembled, scaled;
+            encrypted.assemble(context_, assembled);
+            modSwitchScaleToNext(assembled, scaled);
+            for (size_t j = 0; j < next_coeff_modulus_size; j++)
+            {
+                switched.c0()[j] = scaled.data(0)[j * coeff_count];
+            }
+            copy_n(scaled.data(1), coeff_count * next_coeff_modulus_size, switched.c1());
+            switched.correctionFactor() = scaled.correctionFactor();
+        }
+        encrypted = std::move(switched);
+    }
+
+    void Evaluator::modSwitchToInplace(LWECiphertext &encrypted, ParmsID parms_id) const
     {
         // Verify parameters.
-        if (!isMetadataValidFor(encrypted_ntt, context_) || !isBufferValid(encrypted_ntt))
+        auto context_data_ptr = context_.getContextData(encrypted.parmsID());
+        auto target_context_data_ptr = context_.getContextData(parms_id);
+        if (!context_data_ptr)
         {
             throw invalid_argument("encrypted is not valid for encryption parameters");
         }
-
-        auto context_data_ptr = context_.getContextData(encrypted_ntt.parmsID());
-        if (!context_data_ptr)
+        if (!target_context_data_ptr)
         {
-            throw invalid_argument("encrypted_ntt is not valid for encryption parameters");
+            throw invalid_argument("parms_id is not valid for encryption parameters");
         }
-        if (!encrypted_ntt.isNttForm())
+        if (context_data_ptr->chainIndex() < target_context_data_ptr->chainIndex())
         {
-            throw invalid_argument("encrypted_ntt is not in NTT form");
+            throw invalid_argument("cannot switch to higher level modulus");
         }
 
-        // Extract encryption parameters.
-        auto &context_data = *context_data_ptr;
-        auto &parms = context_data.parms();
-        size_t coeff_count = parms.polyModulusDegree();
-        size_t coeff_modulus_size = parms.coeffModulus().size();
-        size_t encrypted_ntt_size = encrypted_ntt.size();
-
-        auto ntt_tables = context_data.smallNTTTables();
-
-        // Size check
-        if (!productFitsIn(coeff_count, coeff_modulus_size))
+        while (encrypted.parmsID() != parms_id)
         {
-            throw logic_error("invalid parameters");
+            modSwitchToNextInplace(encrypted);
         }
-
-        // Transform each polynomial from NTT domain
-        inverseNttNegacyclicHarvey(encrypted_ntt.data(), encrypted_ntt_size, coeff_modulus_size, ntt_tables);
-
-        // Finally change the is_ntt_transformed flag
-        encrypted_ntt.isNttForm() = false;
     }
 
-    void Evaluator::applyGaloisInplace(
-        Ciphertext &encrypted, uint32_t galois_elt, const GaloisKeys &galois_keys) const
+    void Evaluator::packCiphertextGroupsInplace(
+        vector<Ciphertext> &encrypteds, size_t group_size, size_t spacing, const GaloisKeys &automorphism_keys) const
     {
         // Verify parameters.
-        if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
+        if (encrypteds.empty())
         {
-            throw invalid_argument("encrypted is not valid for encryption parameters");
+            throw invalid_argument("encrypteds is empty");
         }
-
-        // Don't validate all of galois_keys but just check the parms_id.
-        if (galois_keys.parmsID() != context_.keyParmsID())
+        auto context_data_ptr = context_.getContextData(encrypteds[0].parmsID());
+        if (!context_data_ptr)
         {
-            throw invalid_argument("galois_keys is not valid for encryption parameters");
+            throw invalid_argument("encrypteds is not valid for encryption parameters");
+        }
+        size_t coeff_count = context_data_ptr->parms().polyModulusDegree();
+        auto is_power_of_two = [](size_t value) { return value && !(value & (value - 1)); };
+        if (!is_power_of_two(group_size) || !is_power_of_two(spacing) || group_size > coeff_count / spacing)
+        {
+            throw invalid_argument("group_size and spacing must be powers of two with a product of at most N");
         }
+        bool ntt_form = context_data_ptr->parms().scheme() == SchemeType::ckks;
+        for (auto &encrypted : encrypteds)
+        {
+            if (encrypted.parmsID() != encrypteds[0].parmsID())
+            {
+                throw invalid_argument("encrypteds must be at the same level");
+            }
+            if (encrypted.isNttForm() != ntt_form)
+            {
+                throw invalid_argument("encrypteds must be in the default NTT form of the scheme");
+            }
+        }
+        size_t count = encrypteds.size();
+        size_t groups = (count + group_size - 1) / group_size;
 
-        auto &context_data = *context_.getContextData(encrypted.parmsID());
-        auto &parms = context_data.parms();
-        auto &coeff_modulus = parms.coeffModulus();
-        size_t coeff_count = parms.polyModulusDegree();
-        size_t coeff_modulus_size = coeff_modulus.size();
-        size_t encrypted_size = encrypted.size();
-        // Use key_context_data where permutation tables exist since previous runs.
-        auto galois_tool = context_.keyContextData()->galoisTool();
+        // The tree multiplies the coefficients it keeps by group_size. Divide it out up front, before any key
+        // switching noise is added that the factor group_size^-1 would blow up.
+        parallelForRange(count, threads_, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+            {
+                divideByPolyModulusDegreeInplace(encrypteds[i], coeff_count / group_size);
+            }
+        });
+
+        // The level with shift h merges a and b = a + h / spacing of every group: they become (a + X^h b) + tau(a - X^h b)
+        // with tau: X -> X^(N / h + 1), which negates X^h and fixes the multiples of 2h that earlier levels shifted
+        // by. A member without a partner becomes a + tau(a). All automorphisms of a level share a key and are switched
+        // as one batch.
+        vector<size_t> members;
+        vector<Ciphertext> images;
+        for (size_t half = group_size / 2; half >= 1; half /= 2)
+        {
+            size_t shift = half * spacing;
+            members.clear();
+            for (size_t g = 0; g < groups; g++)
+            {
+                for (size_t t = 0; t < half && g * group_size + t < count; t++)
+                {
+                    members.push_back(g * group_size + t);
+                }
+            }
+            images.assign(members.size(), Ciphertext());
+            parallelForRange(members.size(), threads_, [&](size_t begin, size_t end) {
+                Ciphertext shifted;
+                for (size_t i = begin; i < end; i++)
+                {
+                    size_t a = members[i];
+                    size_t b = a + half;
+                    images[i] = encrypteds[a];
+                    if (b >= count)
+                    {
+                        continue;
+                    }
+                    if (ntt_form)
+                    {
+                        transformFromNttInplace(encrypteds[b]);
+                    }
+                    negacyclicShift(encrypteds[b], shift, shifted);
+                    if (ntt_form)
+                    {
+                        transformToNttInplace(shifted);
+                    }
+                    subInplace(images[i], shifted);
+                    addInplace(encrypteds[a], shifted);
+                    encrypteds[b].release();
+                }
+            });
+            vector<Ciphertext *> batch;
+            for (auto &image : images)
+            {
+                batch.push_back(&image);
+            }
+            applyGaloisInternal(batch, static_cast<uint32_t>(coeff_count / shift + 1), automorphism_keys);
+            parallelForRange(members.size(), threads_, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                {
+                    addInplace(encrypteds[members[i]], images[i]);
+                }
+            });
+        }
 
-        // Size check
-        if (!productFitsIn(coeff_count, coeff_modulus_size))
+        for (size_t g = 1; g < groups; g++)
         {
-            throw logic_error("invalid parameters");
+            encrypteds[g] = std::move(encrypteds[g * group_size]);
         }
+        encrypteds.resize(groups);
+    }
 
-        // Check if Galois key is generated or not.
-        if (!galois_keys.hasKey(galois_elt))
+    void Evaluator::packLWECiphertexts(
+        const vector<LWECiphertext> &lwes, const GaloisKeys &automorphism_keys, Ciphertext &destination) const
+    {
+        // Verify parameters.
+        if (lwes.empty())
         {
-            throw invalid_argument("Galois key not present");
+            throw invalid_argument("lwes is empty");
         }
-
-        uint64_t m = mul_safe(static_cast<uint64_t>(coeff_count), uint64_t(2));
-
-        // Verify parameters
-        if (!(galois_elt & 1) || galois_elt >= m)
+        auto context_data_ptr = context_.getContextData(lwes[0].parmsID());
+        if (!context_data_ptr)
         {
-            throw invalid_argument("Galois element is not valid");
+            throw invalid_argument("lwes is not valid for encryption parameters");
         }
-        if (encrypted_size > 2)
+        size_t coeff_count = context_data_ptr->parms().polyModulusDegree();
+        if (lwes.size() > coeff_count)
         {
-            throw invalid_argument("encrypted size must be 2");
+            throw invalid_argument("lwes has more elements than the polynomial modulus degree");
         }
-
-        // SEAL_ALLOCATE_GET_RNS_ITER(temp, coeff_count, coeff_modulus_size, pool);
-        auto temp = allocatePoly(coeff_count, coeff_modulus_size);
-
-        // DO NOT CHANGE EXECUTION ORDER OF FOLLOWING SECTION
-        // BEGIN: Apply Galois for each ciphertext
-        // Execution order is sensitive, since apply_galois is not inplace!
-        if (parms.scheme() == SchemeType::bfv || parms.scheme() == SchemeType::bgv)
+        for (auto &lwe : lwes)
+        {
+            if (lwe.parmsID() != lwes[0].parmsID())
+            {
+                throw invalid_argument("lwes must be at the same level");
+            }
+        }
+        bool ntt_form = context_data_ptr->parms().scheme() == SchemeType::ckks;
+        size_t count = lwes.size();
+        size_t log_count = 0;
+        while ((size_t(1) << log_count) < count)
         {
-            // !!! DO NOT CHANGE EXECUTION ORDER!!!
+            log_count++;
+        }
 
-            // First transform encrypted.data(0)
-            // auto encrypted_iter = iter(encrypted);
-            galois_tool->applyGalois(encrypted.data(0), coeff_modulus_size, galois_elt, coeff_modulus.data(), temp.asPointer());
+        // The trace multiplies every sample by N / 2^l, and the merge by 2^l, which it divides out itself. Divide
+        // the former out up front too, before any key switching noise is added.
+        vector<Ciphertext> packed(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            lwes[i].assemble(context_, packed[i]);
+            divideByPolyModulusDegreeInplace(packed[i], uint64_t(1) << log_count);
+            if (ntt_form)
+            {
+                transformToNttInplace(packed[i]);
+            }
+        }
 
-            // Copy result to encrypted.data(0)
-            setPoly(temp.get(), coeff_count, coeff_modulus_size, encrypted.data(0));
+        // Sample j moves to X^(j N / 2^l); the trace then zeroes every coefficient at any other index.
+        packCiphertextGroupsInplace(packed, size_t(1) << log_count, coeff_count >> log_count, automorphism_keys);
+        fieldTraceInplace(packed[0], automorphism_keys, log_count);
+        destination = std::move(packed[0]);
+    }
 
-            // Next transform encrypted.data(1)
-            galois_tool->applyGalois(encrypted.data(1), coeff_modulus_size, galois_elt, coeff_modulus.data(), temp.asPointer());
+    void Evaluator::expandQuery(
+        const Ciphertext &encrypted, size_t count, const GaloisKeys &galois_keys, vector<Ciphertext> &destination) const
+    {
+        // Verify parameters.
+        if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
+        {
+            throw invalid_argument("encrypted is not valid for encryption parameters");
         }
-        else if (parms.scheme() == SchemeType::ckks)
+        if (encrypted.size() != 2)
         {
-            // !!! DO NOT CHANGE EXECUTION ORDER!!!
-
-            // First transform encrypted.data(0)
-            // auto encrypted_iter = iter(encrypted);
-            galois_tool->applyGaloisNtt(encrypted.data(0), coeff_modulus_size, galois_elt, temp.asPointer());
-
-            // Copy result to encrypted.data(0)
-            setPoly(temp.get(), coeff_count, coeff_modulus_size, encrypted.data(0));
+            throw invalid_argument("encrypted size must be 2");
+        }
 
-            // Next transform encrypted.data(1)
-            galois_tool->applyGaloisNtt(encrypted.data(1), coeff_modulus_size, galois_elt, temp.asPointer());
+        auto &context_data = *context_.getContextData(encrypted.parmsID());
+        auto &coeff_modulus = context_data.parms().coeffModulus();
+        size_t coeff_count = context_data.parms().polyModulusDegree();
+        size_t coeff_modulus_size = coeff_modulus.size();
+        if (count == 0 || count > coeff_count)
+        {
+            throw invalid_argument("count is out of range");
         }
-        else
+        size_t log_count = 0;
+        while ((size_t(1) << log_count) < count)
         {
-            throw logic_error("scheme not implemented");
+            log_count++;
         }
+        bool ntt_form = encrypted.isNttForm();
 
-        // Wipe encrypted.data(1)
-        setZeroPoly(coeff_count, coeff_modulus_size, encrypted.data(1));
+        // Every level doubles the coefficients it keeps. Divide by 2^l while the query carries no key switching noise
+        // yet, so that the factor 2^-l mod q does not blow it up.
+        vector<Ciphertext> expanded(count);
+        expanded[0] = encrypted;
+        divideByPolyModulusDegreeInplace(expanded[0], coeff_count >> log_count);
 
-        // END: Apply Galois for each ciphertext
-        // REORDERING IS SAFE NOW
+        // Ciphertext a of level j holds the query coefficients congruent to a modulo 2^j, moved to the multiples of
+        // 2^j; tau negates the odd multiples and fixes the even ones. Children past count are never needed.
+        vector<Ciphertext> images;
+        for (size_t j = 0; j < log_count; j++)
+        {
+            size_t half = size_t(1) << j;
+            images.assign(expanded.begin(), expanded.begin() + half);
+            vector<Ciphertext *> batch;
+            for (auto &image : images)
+            {
+                batch.push_back(&image);
+            }
+            applyGaloisInternal(batch, static_cast<uint32_t>(coeff_count / half + 1), galois_keys);
 
-        // Calculate (temp * galois_key[0], temp * galois_key[1]) + (ct[0], 0)
-        switchKeyInplace(
-            encrypted, temp.get(), static_cast<const KSwitchKeys &>(galois_keys), GaloisKeys::getIndex(galois_elt));
+            parallelForRange(half, threads_, [&](size_t begin, size_t end) {
+                for (size_t a = begin; a < end; a++)
+                {
+                    size_t b = a + half;
+                    if (b < count)
+                    {
+                        // X^(-2^j) (c - tau(c)) goes into the buffer of tau(c), which is swapped into place.
+                        expanded[b] = expanded[a];
+                        subInplace(expanded[b], images[a]);
+                        addInplace(expanded[a], images[a]);
+                        if (ntt_form)
+                        {
+                            transformFromNttInplace(expanded[b]);
+                        }
+                        negacyclicShiftPolyCoeffmod(
+                            ConstHostPointer<uint64_t>(expanded[b].data()), expanded[b].size(), coeff_modulus_size,
+                            coeff_count, 2 * coeff_count - half, &coeff_modulus[0],
+                            HostPointer<uint64_t>(images[a].data()));
+                        images[a].isNttForm() = false;
+                        swap(expanded[b], images[a]);
+                        if (ntt_form)
+                        {
+                            transformToNttInplace(expanded[b]);
+                        }
+                    }
+                    else
+                    {
+                        addInplace(expanded[a], images[a]);
+                    }
+                }
+            });
+        }
+        destination = std::move(expanded);
     }
 
     void Evaluator::rotateInternal(
-        Ciphertext &encrypted, int steps, const GaloisKeys &galois_keys) const
+        const vector<Ciphertext *> &encrypted_batch, int steps, const GaloisKeys &galois_keys) const
     {
-        auto context_data_ptr = context_.getContextData(encrypted.parmsID());
+        if (encrypted_batch.empty())
+        {
+            return;
+        }
+        auto context_data_ptr = context_.getContextData(encrypted_batch[0]->parmsID());
         if (!context_data_ptr)
         {
             throw invalid_argument("encrypted is not valid for encryption parameters");
@@ -2278,7 +3431,7 @@ namespace troy
         if (galois_keys.hasKey(galois_tool->getEltFromStep(steps)))
         {
             // Perform rotation and key switching
-            applyGaloisInplace(encrypted, galois_tool->getEltFromStep(steps), galois_keys);
+            applyGaloisInternal(encrypted_batch, galois_tool->getEltFromStep(steps), galois_keys);
         }
         else
         {
@@ -2294,23 +3447,41 @@ namespace troy
             }
 
             for (size_t i = 0; i < naf_steps.size(); i++) {
-            // SEAL_ITERATE(naf_steps.cbegin(), naf_steps.size(), [&](auto step) {
                 // We might have a NAF-term of size coeff_count / 2; this corresponds
                 // to no rotation so we skip it. Otherwise call rotate_internal.
                 if (safe_cast<size_t>(abs(naf_steps[i])) != (coeff_count >> 1))
                 {
                     // Apply rotation for this step
-                    this->rotateInternal(encrypted, naf_steps[i], galois_keys);
+                    this->rotateInternal(encrypted_batch, naf_steps[i], galois_keys);
                 }
             }
         }
     }
 
-    // target_iter is rnsiter
+    void Evaluator::rotateManyInternal(vector<Ciphertext> &encrypted, int steps, const GaloisKeys &galois_keys) const
+    {
+        TROY_INSTRUMENT_SCOPE(
+            rotate, context_, encrypted.empty() ? parmsIDZero : encrypted[0].parmsID(), encrypted.size(),
+            encrypted.empty() ? 0 : encrypted[0].size());
+        TROY_INSTRUMENT_ROTATION(steps, encrypted.size());
+
+        for (auto &batch : keySwitchingBatches(encrypted))
+        {
+            rotateInternal(batch, steps, galois_keys);
+        }
+    }
+
+    // Every target is an rns iter over the decomposition moduli; all ciphertexts share parms_id.
     void Evaluator::switchKeyInplace(
-        Ciphertext &encrypted, ConstHostPointer<uint64_t> target_iter, const KSwitchKeys &kswitch_keys, size_t kswitch_keys_index) const
+        const vector<Ciphertext *> &encrypted_batch, const vector<const uint64_t *> &target_batch,
+        const KSwitchKeys &kswitch_keys, size_t kswitch_keys_index) const
     {
-        auto parms_id = encrypted.parmsID();
+        if (encrypted_batch.empty() || encrypted_batch.size() != target_batch.size())
+        {
+            throw invalid_argument("encrypted_batch and target_batch must be non-empty and of the same size");
+        }
+        size_t batch_size = encrypted_batch.size();
+        auto parms_id = encrypted_batch[0]->parmsID();
         auto &context_data = *context_.getContextData(parms_id);
         auto &parms = context_data.parms();
         auto &key_context_data = *context_.keyContextData();
@@ -2318,13 +3489,33 @@ namespace troy
         auto scheme = parms.scheme();
 
         // Verify parameters.
-        if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
+        for (size_t b = 0; b < batch_size; b++)
         {
-            throw invalid_argument("encrypted is not valid for encryption parameters");
-        }
-        if (target_iter.isNull())
-        {
-            throw invalid_argument("target_iter");
+            const Ciphertext &encrypted = *encrypted_batch[b];
+            if (!isMetadataValidFor(encrypted, context_) || !isBufferValid(encrypted))
+            {
+                throw invalid_argument("encrypted is not valid for encryption parameters");
+            }
+            if (encrypted.parmsID() != parms_id)
+            {
+                throw invalid_argument("encrypted_batch must share parms_id");
+            }
+            if (!target_batch[b])
+            {
+                throw invalid_argument("target_iter");
+            }
+            if (scheme == SchemeType::bfv && encrypted.isNttForm())
+            {
+                throw invalid_argument("BFV encrypted cannot be in NTT form");
+            }
+            if (scheme == SchemeType::ckks && !encrypted.isNttForm())
+            {
+                throw invalid_argument("CKKS encrypted must be in NTT form");
+            }
+            if (scheme == SchemeType::bgv && encrypted.isNttForm())
+            {
+                throw invalid_argument("BGV encrypted cannot be in NTT form");
+            }
         }
         if (!context_.using_keyswitching())
         {
@@ -2341,18 +3532,6 @@ namespace troy
         {
             throw out_of_range("kswitch_keys_index");
         }
-        if (scheme == SchemeType::bfv && encrypted.isNttForm())
-        {
-            throw invalid_argument("BFV encrypted cannot be in NTT form");
-        }
-        if (scheme == SchemeType::ckks && !encrypted.isNttForm())
-        {
-            throw invalid_argument("CKKS encrypted must be in NTT form");
-        }
-        if (scheme == SchemeType::bgv && encrypted.isNttForm())
-        {
-            throw invalid_argument("BGV encrypted cannot be in NTT form");
-        }
 
         // Extract encryption parameters.
         size_t coeff_count = parms.polyModulusDegree();
@@ -2364,7 +3543,7 @@ namespace troy
         auto modswitch_factors = key_context_data.rnsTool()->invqLastModq();
 
         // Size check
-        if (!productFitsIn(coeff_count, mul_safe(rns_modulus_size, size_t(2))))
+        if (!productFitsIn(coeff_count, mul_safe(mul_safe(rns_modulus_size, size_t(2)), batch_size)))
         {
             throw logic_error("invalid parameters");
         }
@@ -2382,273 +3561,306 @@ namespace troy
             }
         }
 
-        // Create a copy of target_iter
-        // SEAL_ALLOCATE_GET_RNS_ITER(t_target, coeff_count, decomp_modulus_size, pool);
-        auto t_target = allocatePoly(coeff_count, decomp_modulus_size);
-        setUint(target_iter.get(), decomp_modulus_size * coeff_count, t_target.get());
-
-        // std::cout << "t_target: "; printArray(t_target);
+        // A key that fits in the last-level cache (or under setBatchKeySwitchingThreshold) gains nothing from
+        // batching; switch one ciphertext at a time to keep the intermediates of each in L2.
+        size_t key_bytes = mul_safe(
+            mul_safe(rns_modulus_size, decomp_modulus_size), mul_safe(key_component_count, coeff_count * sizeof(uint64_t)));
+        if (batch_size > 1 && key_bytes <= (batch_key_bytes_ ? batch_key_bytes_ : lastLevelCacheSize()))
+        {
+            for (size_t b = 0; b < batch_size; b++)
+            {
+                switchKeyInplace(
+                    vector<Ciphertext *>{ encrypted_batch[b] }, vector<const uint64_t *>{ target_batch[b] }, kswitch_keys,
+                    kswitch_keys_index);
+            }
+            return;
+        }
+        TROY_INSTRUMENT_SCOPE(key_switch, context_, parms_id, batch_size, batch_size);
+        TROY_INSTRUMENT_COUNT(key_switch, batch_size);
 
-        // In CKKS t_target is in NTT form; switch back to normal form
-        if (scheme == SchemeType::ckks)
+        // Create a copy of every target; in CKKS the targets are in NTT form so switch back to normal form
+        size_t target_uint64_count = decomp_modulus_size * coeff_count;
+        auto t_target = allocateUint(mul_safe(batch_size, target_uint64_count));
+        for (size_t b = 0; b < batch_size; b++)
         {
-            inverseNttNegacyclicHarvey(t_target.asPointer(), decomp_modulus_size, key_ntt_tables);
+            setUint(target_batch[b], target_uint64_count, t_target.get() + b * target_uint64_count);
+            if (scheme == SchemeType::ckks)
+            {
+                inverseNttNegacyclicHarvey(t_target + b * target_uint64_count, decomp_modulus_size, key_ntt_tables);
+            }
         }
 
-        // Temporary result
-        auto t_poly_prod = allocateZeroPolyArray(key_component_count, coeff_count, rns_modulus_size);
+        // Temporary result, one [component][limb][coeff] block per ciphertext
+        auto t_poly_prod_batch = allocateZeroPolyArray(batch_size * key_component_count, coeff_count, rns_modulus_size);
 
-        for (size_t i = 0; i < rns_modulus_size; i++) {
-            
-            // std::cout << "i = " << i << std::endl;
-            size_t key_index = (i == decomp_modulus_size ? key_modulus_size - 1 : i);
+        // Resolve the key polynomials once; the inner loop then reads key_bases[j * key_component_count + k]
+        // offset by the limb instead of going through key_vector[j].data().data(k). A packed key (see
+        // KSwitchKeys::pack) instead keeps all digits and components of one limb adjacent in one buffer.
+        std::vector<const uint64_t *> key_bases(decomp_modulus_size * key_component_count);
+        for (size_t j = 0; j < decomp_modulus_size; j++)
+        {
+            for (size_t k = 0; k < key_component_count; k++)
+            {
+                key_bases[j * key_component_count + k] = key_vector[j].data().data(k);
+            }
+        }
+        const uint64_t *packed_key = kswitch_keys.packedData(kswitch_keys_index);
+        size_t key_limb_stride = mul_safe(mul_safe(key_vector.size(), key_component_count), coeff_count);
 
-            // Product of two numbers is up to 60 + 60 = 120 bits, so we can sum up to 256 of them without reduction.
-            size_t lazy_reduction_summand_bound = size_t(SEAL_MULTIPLY_ACCUMULATE_USER_MOD_MAX);
-            size_t lazy_reduction_counter = lazy_reduction_summand_bound;
+        // Product of two numbers is up to 60 + 60 = 120 bits, so we can sum up to 256 of them without reduction.
+        size_t lazy_reduction_summand_bound = size_t(SEAL_MULTIPLY_ACCUMULATE_USER_MOD_MAX);
 
-            // Allocate memory for a lazy accumulator (128-bit coefficients)
-            auto t_poly_lazy = allocateZeroPolyArray(key_component_count, coeff_count, 2);
+        // The coefficients are processed in tiles so that the key tile of one limb (all digits and
+        // components) stays in cache while it is applied to every ciphertext of the batch, and the
+        // accumulators of one tile stay in L1.
+        size_t tile_size = std::min(coeff_count, switch_key_tile_size);
 
-            // Semantic misuse of PolyIter; this is really pointing to the data for a single RNS factor
-            size_t poly_coeff_count = 2 * coeff_count;
-            // PolyIter accumulator_iter(t_poly_lazy.get(), 2, coeff_count);
+        // The targets of one limb are brought to NTT form a few ciphertexts at a time, so that their operands
+        // stay in L2 while the key limb is applied to them; each further ciphertext then reuses the key limb
+        // from cache instead of streaming it from memory again.
+        size_t operand_batch_size = std::max(
+            size_t(1), std::min(batch_size, switch_key_operand_budget / (target_uint64_count * sizeof(uint64_t))));
 
-            // Multiply with keys and perform lazy reduction on product's coefficients
-            for (size_t j = 0; j < decomp_modulus_size; j++) {
-                auto t_ntt = allocateUint(coeff_count);
-                // SEAL_ALLOCATE_GET_COEFF_ITER(t_ntt, coeff_count, pool);
-                ConstHostPointer<uint64_t> t_operand;
+        // Output limbs are independent, so each worker takes a contiguous range of them and allocates its
+        // scratch (the NTT operands and the 128-bit lazy accumulators of one tile) only once.
+        parallelForRange(rns_modulus_size, threads_, [&](size_t limb_begin, size_t limb_end) {
+            auto t_ntt = allocateUint(mul_safe(operand_batch_size, target_uint64_count));
+            std::vector<const uint64_t *> t_operands(operand_batch_size * decomp_modulus_size);
+            auto t_poly_lazy = HostArray<uint128_t>(key_component_count * tile_size);
 
-                // RNS-NTT form exists in input
-                if ((scheme == SchemeType::ckks) && (i == j))
-                {
-                    t_operand = target_iter + j * coeff_count;
-                }
-                // Perform RNS-NTT conversion
-                else
-                {
-                    // No need to perform RNS conversion (modular reduction)
-                    if (key_modulus[j] <= key_modulus[key_index])
-                    {
-                        // printf("branch a - ");
-                        setUint(t_target.get() + j * coeff_count, coeff_count, t_ntt.get());
-                    }
-                    // Perform RNS conversion (modular reduction)
-                    else
-                    {
-                        // printf("branch b - ");
-                        moduloPolyCoeffs(t_target.get() + j * coeff_count, coeff_count, key_modulus[key_index], t_ntt.get());
-                    }
-                    // printArray(t_ntt.get(), coeff_count);
-                    // NTT conversion lazy outputs in [0, 4q)
-                    nttNegacyclicHarveyLazy(t_ntt.get(), key_ntt_tables[key_index]);
-                    t_operand = t_ntt.get();
-                }
+            for (size_t i = limb_begin; i < limb_end; i++)
+            {
+                size_t key_index = (i == decomp_modulus_size ? key_modulus_size - 1 : i);
+                const Modulus &key_modulus_i = key_modulus[key_index];
+                const uint64_t *limb_key = packed_key ? packed_key + key_index * key_limb_stride : nullptr;
 
-                // std::cout << "  j = " << j << std::endl;
-                // std::cout << "  t_operand: "; printArray(t_operand.get(), coeff_count);
+                for (size_t b_begin = 0; b_begin < batch_size; b_begin += operand_batch_size)
+                {
+                    size_t b_end = std::min(batch_size, b_begin + operand_batch_size);
 
-                // Multiply with keys and modular accumulate products in a lazy fashion
-                for (size_t k = 0; k < key_component_count; k++) {
-                // SEAL_ITERATE(iter(key_vector[J].data(), accumulator_iter), key_component_count, [&](auto K) {
-                    HostPointer<uint64_t> accumulator = t_poly_lazy + k * poly_coeff_count;
-                    if (!lazy_reduction_counter)
+                    // Bring every digit of these targets to this limb, in NTT form
+                    for (size_t b = b_begin; b < b_end; b++)
                     {
-                        for (size_t l = 0; l < coeff_count; l++) {
-                        // SEAL_ITERATE(iter(t_operand, get<0>(K)[key_index], get<1>(K)), coeff_count, [&](auto L) {
-                            uint64_t qword[2]{ 0, 0 };
-                            multiplyUint64(t_operand[l], key_vector[j].data().data(k)[key_index * coeff_count + l], qword);
-
-                            // Accumulate product of t_operand and t_key_acc to t_poly_lazy and reduce
-                            auto accumulator_l = accumulator.get() + 2 * l;
-                            addUint128(qword, accumulator_l, qword);
-                            accumulator_l[0] = barrettReduce128(qword, key_modulus[key_index]);
-                            accumulator_l[1] = 0;
+                        for (size_t j = 0; j < decomp_modulus_size; j++)
+                        {
+                            size_t operand_index = (b - b_begin) * decomp_modulus_size + j;
+                            // RNS-NTT form exists in input
+                            if ((scheme == SchemeType::ckks) && (i == j))
+                            {
+                                t_operands[operand_index] = target_batch[b] + j * coeff_count;
+                                continue;
+                            }
+                            // Perform RNS-NTT conversion
+                            const uint64_t *source = t_target.get() + b * target_uint64_count + j * coeff_count;
+                            uint64_t *operand = t_ntt.get() + operand_index * coeff_count;
+                            // No need to perform RNS conversion (modular reduction)
+                            if (key_modulus[j] <= key_modulus_i)
+                            {
+                                setUint(source, coeff_count, operand);
+                            }
+                            // Perform RNS conversion (modular reduction)
+                            else
+                            {
+                                moduloPolyCoeffs(source, coeff_count, key_modulus_i, operand);
+                            }
+                            // NTT conversion lazy outputs in [0, 4q)
+                            nttNegacyclicHarveyLazy(HostPointer<uint64_t>(operand), key_ntt_tables[key_index]);
+                            t_operands[operand_index] = operand;
                         }
                     }
-                    else
+
+                    for (size_t tile = 0; tile < coeff_count; tile += tile_size)
                     {
-                        for (size_t l = 0; l < coeff_count; l++) {
-                        // Same as above but no reduction
-                        // SEAL_ITERATE(iter(t_operand, get<0>(K)[key_index], get<1>(K)), coeff_count, [&](auto L) {
-                            uint64_t qword[2]{ 0, 0 };
-                            multiplyUint64(t_operand[l], key_vector[j].data().data(k)[key_index * coeff_count + l], qword);
-                            auto accumulator_l = accumulator.get() + 2 * l;
-                            addUint128(qword, accumulator_l, qword);
-                            accumulator_l[0] = qword[0];
-                            accumulator_l[1] = qword[1];
+                        size_t tile_length = std::min(tile_size, coeff_count - tile);
+                        for (size_t b = b_begin; b < b_end; b++)
+                        {
+                            size_t lazy_reduction_counter = lazy_reduction_summand_bound;
+                            std::fill_n(t_poly_lazy.get(), key_component_count * tile_size, uint128_t(0));
+
+                            // Multiply with keys and accumulate the 128-bit products without reduction
+                            for (size_t j = 0; j < decomp_modulus_size; j++)
+                            {
+                                const uint64_t *t_operand = t_operands[(b - b_begin) * decomp_modulus_size + j] + tile;
+                                for (size_t k = 0; k < key_component_count; k++)
+                                {
+                                    const uint64_t *key = limb_key
+                                        ? limb_key + (j * key_component_count + k) * coeff_count
+                                        : key_bases[j * key_component_count + k] + key_index * coeff_count;
+                                    multiplyAccumulateLazy(
+                                        t_operand, key + tile, tile_length, t_poly_lazy.get() + k * tile_size);
+                                }
+
+                                if (!--lazy_reduction_counter)
+                                {
+                                    for (size_t l = 0; l < key_component_count * tile_size; l++)
+                                    {
+                                        t_poly_lazy[l] = barrettReduce128(t_poly_lazy[l], key_modulus_i);
+                                    }
+                                    lazy_reduction_counter = lazy_reduction_summand_bound;
+                                }
+                            }
+
+                            // Final modular reduction into t_poly_prod, shifted to the appropriate modulus
+                            for (size_t k = 0; k < key_component_count; k++)
+                            {
+                                const uint128_t *accumulator = t_poly_lazy.get() + k * tile_size;
+                                uint64_t *destination =
+                                    t_poly_prod_batch.get() +
+                                    ((b * key_component_count + k) * rns_modulus_size + i) * coeff_count + tile;
+                                if (lazy_reduction_counter == lazy_reduction_summand_bound)
+                                {
+                                    for (size_t l = 0; l < tile_length; l++)
+                                    {
+                                        destination[l] = static_cast<uint64_t>(accumulator[l]);
+                                    }
+                                }
+                                else
+                                {
+                                    for (size_t l = 0; l < tile_length; l++)
+                                    {
+                                        destination[l] = barrettReduce128(accumulator[l], key_modulus_i);
+                                    }
+                                }
+                            }
                         }
                     }
                 }
-
-                if (!--lazy_reduction_counter)
-                {
-                    lazy_reduction_counter = lazy_reduction_summand_bound;
-                }
             }
+        });
 
-            // std::cout << "  t_poly_lazy: ";
-            // printArray(t_poly_lazy);
-
-            // PolyIter pointing to the destination t_poly_prod, shifted to the appropriate modulus
-            auto t_poly_prod_iter = t_poly_prod.get() + i * coeff_count;
-            // PolyIter t_poly_prod_iter(t_poly_prod.get() + (I * coeff_count), coeff_count, rns_modulus_size);
+        // Accumulated products are now stored in t_poly_prod_batch
 
-            // Final modular reduction
-            for (size_t k = 0; k < key_component_count; k++) {
-            // SEAL_ITERATE(iter(accumulator_iter, t_poly_prod_iter), key_component_count, [&](auto K) {
-                HostPointer<uint64_t> accumulator = t_poly_lazy + k * poly_coeff_count;
-                if (lazy_reduction_counter == lazy_reduction_summand_bound)
-                {
-                    for (size_t l = 0; l < coeff_count; l++) {
-                        // std::cout << "*get<0>(L): " << accumulator[l * 2] << std::endl;
-                        t_poly_prod_iter[k * coeff_count * rns_modulus_size + l] = static_cast<uint64_t>(accumulator[l * 2]);
-                    }
-                }
-                else
+        auto t_ntt = allocateUint(coeff_count);
+        for (size_t b = 0; b < batch_size; b++)
+        {
+            Ciphertext &encrypted = *encrypted_batch[b];
+            auto t_poly_prod = t_poly_prod_batch + b * key_component_count * rns_modulus_size * coeff_count;
+            // Perform modulus switching with scaling
+            // PolyIter t_poly_prod_iter(t_poly_prod.get(), coeff_count, rns_modulus_size);
+            for (size_t i = 0; i < key_component_count; i++) {
+            // SEAL_ITERATE(iter(encrypted, t_poly_prod_iter), key_component_count, [&](auto I) {
+                if (scheme == SchemeType::bgv)
                 {
-                    // Same as above except need to still do reduction
-                    for (size_t l = 0; l < coeff_count; l++) {
-                        // std::cout << "*get<0>(L): " << accumulator[l * 2] << std::endl;
-                        t_poly_prod_iter[k * coeff_count * rns_modulus_size + l] = barrettReduce128(accumulator.get() + l * 2, key_modulus[key_index]);
+                    const Modulus &plain_modulus = parms.plainModulus();
+                    // qk is the special prime
+                    uint64_t qk = key_modulus[key_modulus_size - 1].value();
+                    uint64_t qk_inv_qp = context_.keyContextData()->rnsTool()->invqLastModt();
+
+                    // Lazy reduction; this needs to be then reduced mod qi
+                    auto t_last = t_poly_prod + coeff_count * rns_modulus_size * i + decomp_modulus_size * coeff_count;
+                    // CoeffIter t_last(get<1>(I)[decomp_modulus_size]);
+                    inverseNttNegacyclicHarvey(t_last, key_ntt_tables[key_modulus_size - 1]);
+
+                    // SEAL_ALLOCATE_ZERO_GET_COEFF_ITER(k, coeff_count, pool);
+                    auto k = allocateZeroUint(coeff_count);
+                    moduloPolyCoeffs(t_last.get(), coeff_count, plain_modulus, k.get());
+                    negatePolyCoeffmod(k.get(), coeff_count, plain_modulus, k.get());
+                    if (qk_inv_qp != 1)
+                    {
+                        multiplyPolyScalarCoeffmod(k.get(), coeff_count, qk_inv_qp, plain_modulus, k.get());
                     }
-                }
-            }
-        }
-        // Accumulated products are now stored in t_poly_prod
-
-        // std::cout << "t_poly_prod: ";
-        // printArray(t_poly_prod, true);
 
-        // Perform modulus switching with scaling
-        // PolyIter t_poly_prod_iter(t_poly_prod.get(), coeff_count, rns_modulus_size);
-        for (size_t i = 0; i < key_component_count; i++) {
-        // SEAL_ITERATE(iter(encrypted, t_poly_prod_iter), key_component_count, [&](auto I) {
-            if (scheme == SchemeType::bgv)
-            {
-                const Modulus &plain_modulus = parms.plainModulus();
-                // qk is the special prime
-                uint64_t qk = key_modulus[key_modulus_size - 1].value();
-                uint64_t qk_inv_qp = context_.keyContextData()->rnsTool()->invqLastModt();
-
-                // Lazy reduction; this needs to be then reduced mod qi
-                auto t_last = t_poly_prod + coeff_count * rns_modulus_size * i + decomp_modulus_size * coeff_count;
-                // CoeffIter t_last(get<1>(I)[decomp_modulus_size]);
-                inverseNttNegacyclicHarvey(t_last, key_ntt_tables[key_modulus_size - 1]);
+                    auto delta = allocateZeroUint(coeff_count);
+                    auto c_mod_qi = allocateZeroUint(coeff_count);
+                    for (size_t j = 0; j < decomp_modulus_size; j++) {
+                    // SEAL_ITERATE(iter(I, key_modulus, modswitch_factors, key_ntt_tables), decomp_modulus_size, [&](auto J) {
+                        size_t t_poly_prod_index = i * coeff_count * rns_modulus_size + j * coeff_count;
+                        inverseNttNegacyclicHarvey(t_poly_prod + t_poly_prod_index, key_ntt_tables[j]);
+                        // delta = k mod q_i
+                        moduloPolyCoeffs(k.get(), coeff_count, key_modulus[j], delta.get());
+                        // delta = k * q_k mod q_i
+                        multiplyPolyScalarCoeffmod(delta.get(), coeff_count, qk, key_modulus[j], delta.get());
+
+                        // c mod q_i
+                        moduloPolyCoeffs(t_last.get(), coeff_count, key_modulus[j], c_mod_qi.get());
+                        // delta = c + k * q_k mod q_i
+                        // c_{i} = c_{i} - delta mod q_i
+                        const uint64_t Lqi = key_modulus[j].value() * 2;
+                        for (size_t k = 0; k < coeff_count; k++) {
+                            t_poly_prod[t_poly_prod_index + k] = t_poly_prod[t_poly_prod_index + k] + Lqi - (delta[k] + c_mod_qi[k]);
+                        }
+                        // SEAL_ITERATE(iter(delta, c_mod_qi, get<0, 1>(J)), coeff_count, [Lqi](auto K) {
+                        //     get<2>(K) = get<2>(K) + Lqi - (get<0>(K) + get<1>(K));
+                        // });
 
-                // SEAL_ALLOCATE_ZERO_GET_COEFF_ITER(k, coeff_count, pool);
-                auto k = allocateZeroUint(coeff_count);
-                moduloPolyCoeffs(t_last.get(), coeff_count, plain_modulus, k.get());
-                negatePolyCoeffmod(k.get(), coeff_count, plain_modulus, k.get());
-                if (qk_inv_qp != 1)
-                {
-                    multiplyPolyScalarCoeffmod(k.get(), coeff_count, qk_inv_qp, plain_modulus, k.get());
-                }
+                        multiplyPolyScalarCoeffmod(t_poly_prod + t_poly_prod_index, coeff_count, 
+                            modswitch_factors[j], key_modulus[j], t_poly_prod + t_poly_prod_index);
 
-                auto delta = allocateZeroUint(coeff_count);
-                auto c_mod_qi = allocateZeroUint(coeff_count);
-                for (size_t j = 0; j < decomp_modulus_size; j++) {
-                // SEAL_ITERATE(iter(I, key_modulus, modswitch_factors, key_ntt_tables), decomp_modulus_size, [&](auto J) {
-                    size_t t_poly_prod_index = i * coeff_count * rns_modulus_size + j * coeff_count;
-                    inverseNttNegacyclicHarvey(t_poly_prod + t_poly_prod_index, key_ntt_tables[j]);
-                    // delta = k mod q_i
-                    moduloPolyCoeffs(k.get(), coeff_count, key_modulus[j], delta.get());
-                    // delta = k * q_k mod q_i
-                    multiplyPolyScalarCoeffmod(delta.get(), coeff_count, qk, key_modulus[j], delta.get());
-
-                    // c mod q_i
-                    moduloPolyCoeffs(t_last.get(), coeff_count, key_modulus[j], c_mod_qi.get());
-                    // delta = c + k * q_k mod q_i
-                    // c_{i} = c_{i} - delta mod q_i
-                    const uint64_t Lqi = key_modulus[j].value() * 2;
-                    for (size_t k = 0; k < coeff_count; k++) {
-                        t_poly_prod[t_poly_prod_index + k] = t_poly_prod[t_poly_prod_index + k] + Lqi - (delta[k] + c_mod_qi[k]);
+                        addPolyCoeffmod(t_poly_prod + t_poly_prod_index, encrypted.data(i) + j * coeff_count, 
+                            coeff_count, key_modulus[j], encrypted.data(i) + j * coeff_count);
                     }
-                    // SEAL_ITERATE(iter(delta, c_mod_qi, get<0, 1>(J)), coeff_count, [Lqi](auto K) {
-                    //     get<2>(K) = get<2>(K) + Lqi - (get<0>(K) + get<1>(K));
-                    // });
-
-                    multiplyPolyScalarCoeffmod(t_poly_prod + t_poly_prod_index, coeff_count, 
-                        modswitch_factors[j], key_modulus[j], t_poly_prod + t_poly_prod_index);
-
-                    addPolyCoeffmod(t_poly_prod + t_poly_prod_index, encrypted.data(i) + j * coeff_count, 
-                        coeff_count, key_modulus[j], encrypted.data(i) + j * coeff_count);
                 }
-            }
-            else
-            {
-                // Lazy reduction; this needs to be then reduced mod qi
-                auto t_last = t_poly_prod + coeff_count * rns_modulus_size * i + decomp_modulus_size * coeff_count;
-                // std::cout << "t_last diff: " << coeff_count * rns_modulus_size * i + decomp_modulus_size * coeff_count << std::endl;
+                else
+                {
+                    // Lazy reduction; this needs to be then reduced mod qi
+                    auto t_last = t_poly_prod + coeff_count * rns_modulus_size * i + decomp_modulus_size * coeff_count;
+                    // std::cout << "t_last diff: " << coeff_count * rns_modulus_size * i + decomp_modulus_size * coeff_count << std::endl;
                 
-                // std::cout << "t_last: "; printArray(t_last.get(), coeff_count);
-                inverseNttNegacyclicHarveyLazy(t_last, key_ntt_tables[key_modulus_size - 1]);
-
-                // Add (p-1)/2 to change from flooring to rounding.
-                uint64_t qk = key_modulus[key_modulus_size - 1].value();
-                uint64_t qk_half = qk >> 1;
-                for (size_t j = 0; j < coeff_count; j++) {
-                // SEAL_ITERATE(t_last, coeff_count, [&](auto &J) {
-                    t_last[j] = barrettReduce64(t_last[j] + qk_half, key_modulus[key_modulus_size - 1]);
-                }
-
-                // std::cout << "t_last: "; printArray(t_last.get(), coeff_count);
-
-                for (size_t j = 0; j < decomp_modulus_size; j++) {
-                // SEAL_ITERATE(iter(I, key_modulus, key_ntt_tables, modswitch_factors), decomp_modulus_size, [&](auto J) {
-                    // std::cout << "  ski j = " << j << std::endl;
-                    size_t t_poly_prod_index = i * coeff_count * rns_modulus_size + j * coeff_count;
-                    auto t_poly_prod_ptr = t_poly_prod + t_poly_prod_index;
+                    // std::cout << "t_last: "; printArray(t_last.get(), coeff_count);
+                    inverseNttNegacyclicHarveyLazy(t_last, key_ntt_tables[key_modulus_size - 1]);
+
+                    // Add (p-1)/2 to change from flooring to rounding.
+                    uint64_t qk = key_modulus[key_modulus_size - 1].value();
+                    uint64_t qk_half = qk >> 1;
+                    for (size_t j = 0; j < coeff_count; j++) {
+                    // SEAL_ITERATE(t_last, coeff_count, [&](auto &J) {
+                        t_last[j] = barrettReduce64(t_last[j] + qk_half, key_modulus[key_modulus_size - 1]);
+                    }
 
-                    auto t_ntt = allocateUint(coeff_count);
-                    // SEAL_ALLOCATE_GET_COEFF_ITER(t_ntt, coeff_count, pool);
+                    // std::cout << "t_last: "; printArray(t_last.get(), coeff_count);
 
-                    // (ct mod 4qk) mod qi
-                    uint64_t qi = key_modulus[j].value();
-                    if (qk > qi)
-                    {
-                        // This cannot be spared. NTT only tolerates input that is less than 4*modulus (i.e. qk <=4*qi).
-                        moduloPolyCoeffs(t_last.get(), coeff_count, key_modulus[j], t_ntt.get());
-                    }
-                    else
-                    {
-                        setUint(t_last.get(), coeff_count, t_ntt.get());
-                    }
+                    for (size_t j = 0; j < decomp_modulus_size; j++) {
+                    // SEAL_ITERATE(iter(I, key_modulus, key_ntt_tables, modswitch_factors), decomp_modulus_size, [&](auto J) {
+                        // std::cout << "  ski j = " << j << std::endl;
+                        size_t t_poly_prod_index = i * coeff_count * rns_modulus_size + j * coeff_count;
+                        auto t_poly_prod_ptr = t_poly_prod + t_poly_prod_index;
 
-                    // Lazy substraction, results in [0, 2*qi), since fix is in [0, qi].
-                    uint64_t fix = qi - barrettReduce64(qk_half, key_modulus[j]);
-                    for (size_t k = 0; k < coeff_count; k++) t_ntt[k] += fix;
-                    // SEAL_ITERATE(t_ntt, coeff_count, [fix](auto &K) { K += fix; });
+                        // (ct mod 4qk) mod qi
+                        uint64_t qi = key_modulus[j].value();
+                        if (qk > qi)
+                        {
+                            // This cannot be spared. NTT only tolerates input that is less than 4*modulus (i.e. qk <=4*qi).
+                            moduloPolyCoeffs(t_last.get(), coeff_count, key_modulus[j], t_ntt.get());
+                        }
+                        else
+                        {
+                            setUint(t_last.get(), coeff_count, t_ntt.get());
+                        }
 
-                    uint64_t qi_lazy = qi << 1; // some multiples of qi
-                    if (scheme == SchemeType::ckks)
-                    {
-                        // This ntt_negacyclic_harvey_lazy results in [0, 4*qi).
-                        nttNegacyclicHarveyLazy(t_ntt.asPointer(), key_ntt_tables[j]);
-                        // Since SEAL uses at most 60bit moduli, 8*qi < 2^63.
-                        qi_lazy = qi << 2;
-                    }
-                    else if (scheme == SchemeType::bfv)
-                    {
-                        inverseNttNegacyclicHarveyLazy(t_poly_prod_ptr, key_ntt_tables[j]);
-                    }
+                        // Lazy substraction, results in [0, 2*qi), since fix is in [0, qi].
+                        uint64_t fix = qi - barrettReduce64(qk_half, key_modulus[j]);
+                        for (size_t k = 0; k < coeff_count; k++) t_ntt[k] += fix;
+                        // SEAL_ITERATE(t_ntt, coeff_count, [fix](auto &K) { K += fix; });
+
+                        uint64_t qi_lazy = qi << 1; // some multiples of qi
+                        if (scheme == SchemeType::ckks)
+                        {
+                            // This ntt_negacyclic_harvey_lazy results in [0, 4*qi).
+                            nttNegacyclicHarveyLazy(t_ntt.asPointer(), key_ntt_tables[j]);
+                            // Since SEAL uses at most 60bit moduli, 8*qi < 2^63.
+                            qi_lazy = qi << 2;
+                        }
+                        else if (scheme == SchemeType::bfv)
+                        {
+                            inverseNttNegacyclicHarveyLazy(t_poly_prod_ptr, key_ntt_tables[j]);
+                        }
                     
-                    // std::cout << "  t_ntt: " << j << " - "; printArray(t_ntt);
-                    // std::cout << "  t_ptr: " << j << " - "; printArray(t_poly_prod_ptr.get(), coeff_count);
+                        // std::cout << "  t_ntt: " << j << " - "; printArray(t_ntt);
+                        // std::cout << "  t_ptr: " << j << " - "; printArray(t_poly_prod_ptr.get(), coeff_count);
 
-                    // ((ct mod qi) - (ct mod qk)) mod qi with output in [0, 2 * qi_lazy)
-                    for (size_t k = 0; k < coeff_count; k++) t_poly_prod_ptr[k] += qi_lazy - t_ntt[k];
-                    // SEAL_ITERATE(
-                    //     iter(get<0, 1>(J), t_ntt), coeff_count, [&](auto K) { get<0>(K) += qi_lazy - get<1>(K); });
+                        // ((ct mod qi) - (ct mod qk)) mod qi with output in [0, 2 * qi_lazy)
+                        for (size_t k = 0; k < coeff_count; k++) t_poly_prod_ptr[k] += qi_lazy - t_ntt[k];
+                        // SEAL_ITERATE(
+                        //     iter(get<0, 1>(J), t_ntt), coeff_count, [&](auto K) { get<0>(K) += qi_lazy - get<1>(K); });
 
-                    // qk^(-1) * ((ct mod qi) - (ct mod qk)) mod qi
-                    multiplyPolyScalarCoeffmod(t_poly_prod_ptr, coeff_count, modswitch_factors[j], key_modulus[j], t_poly_prod_ptr);
-                    addPolyCoeffmod(t_poly_prod_ptr, encrypted.data(i) + j * coeff_count, coeff_count, key_modulus[j], encrypted.data(i) + j * coeff_count);
+                        // qk^(-1) * ((ct mod qi) - (ct mod qk)) mod qi
+                        multiplyPolyScalarCoeffmod(t_poly_prod_ptr, coeff_count, modswitch_factors[j], key_modulus[j], t_poly_prod_ptr);
+                        addPolyCoeffmod(t_poly_prod_ptr, encrypted.data(i) + j * coeff_count, coeff_count, key_modulus[j], encrypted.data(i) + j * coeff_count);
+                    }
                 }
-            }
             
-            // printf("enc %ld: ", i); printArray(encrypted.data(i), key_component_count * coeff_count);
+                // printf("enc %ld: ", i); printArray(encrypted.data(i), key_component_count * coeff_count);
+            }
         }
     }
 } // namespace seal
@@ -6,17 +6,57 @@
 #include "ciphertext.h"
 #include "context.h"
 #include "galoiskeys.h"
+#include "instrumentation.h"
+#include "lweciphertext.h"
 #include "modulus.h"
 #include "plaintext.h"
 #include "relinkeys.h"
 #include "secretkey.h"
 #include "valcheck.h"
+#include <functional>
 #include <map>
 #include <stdexcept>
 #include <vector>
 
 namespace troy
 {
+    /**
+    A BFV ciphertext lifted to the extended base q U Bsk used by BEHZ multiplication and transformed to NTT form in
+    both bases. Produced by Evaluator::extendToBehzNtt and consumed by Evaluator::multiplyAccumulate, so that an input
+    taking part in many ciphertext-ciphertext products is extended only once.
+    */
+    class BehzCiphertext
+    {
+        friend class Evaluator;
+
+    public:
+        BehzCiphertext() = default;
+
+        /**
+        Returns the parms_id of the ciphertext this was extended from.
+        */
+        inline const ParmsID &parmsID() const noexcept
+        {
+            return parms_id_;
+        }
+
+        /**
+        Returns the number of polynomials.
+        */
+        inline std::size_t size() const noexcept
+        {
+            return size_;
+        }
+
+    private:
+        ParmsID parms_id_ = parmsIDZero;
+
+        std::size_t size_ = 0;
+
+        // For each polynomial, its base q residues followed by its base Bsk residues.
+        util::HostDynamicArray<std::uint64_t> data_;
+    };
+
     /**
     Provides operations on ciphertexts. Due to the properties of the encryption scheme, the arithmetic operations pass
     through the encryption layer to the underlying plaintext, changing it according to the type of the operation. Since
@@ -80,6 +120,52 @@ namespace troy
         */
         Evaluator(const SEALContext &context);
 
+        /**
+        Sets how many threads a single key switching (relinearization, rotation, conjugation, Galois
+        application) may use; the RNS limbs of the key inner product are split among them. The default
+        of 1 keeps every operation on the calling thread, which is what callers that already run many
+        evaluations in parallel want. Must not be called while another thread is using this Evaluator.
+
+        @param[in] threads The number of threads; 0 is treated as 1
+        */
+        inline void setThreadCount(std::size_t threads) noexcept
+        {
+            threads_ = threads ? threads : 1;
+        }
+
+        /**
+        Returns the number of threads a single key switching may use.
+        */
+        inline std::size_t threadCount() const noexcept
+        {
+            return threads_;
+        }
+
+        /**
+        Sets the keyswitching key size, in bytes, above which relinearizeManyInplace and the rotate*ManyInplace
+        functions apply one key to several ciphertexts at once. Below it the key stays cache resident anyway and
+        the ciphertexts are key switched one at a time. The default of 0 uses the size of the last-level cache.
+        Must not be called while another thread is using this Evaluator.
+
+        @param[in] key_bytes The threshold in bytes, or 0 for the last-level cache size
+        */
+        inline void setBatchKeySwitchingThreshold(std::size_t key_bytes) noexcept
+        {
+            batch_key_bytes_ = key_bytes;
+        }
+
+        /**
+        Sets the largest number of products multiplyAccumulate sums in base q U Bsk before scaling them down to base
+        q. The default of 0, and any larger value, use the number base Bsk has headroom for; smaller chunks only add
+        a scaling pass per chunk. Must not be called while another thread is using this Evaluator.
+
+        @param[in] products The chunk size, or 0 for the base Bsk bound
+        */
+        inline void setMultiplyAccumulateChunkSize(std::size_t products) noexcept
+        {
+            multiply_accumulate_chunk_size_ = products;
+        }
+
         /**
         Negates a ciphertext.
 
@@ -141,7 +227,10 @@ namespace troy
         }
 
         /**
-        Adds together a vector of ciphertexts and stores the result in the destination parameter.
+        Adds together a vector of ciphertexts and stores the result in the destination parameter. The sum is
+        computed with CiphertextAggregator, split across setThreadCount() threads and merged as a tree. Only
+        BGV ciphertexts with differing correction factors are added one by one; unlike the stream overload, which
+        rejects them, this overload accepts such inputs because it can inspect all of them up front.
 
         @param[in] encrypteds The ciphertexts to add
         @param[out] destination The ciphertext to overwrite with the addition result
@@ -155,6 +244,23 @@ namespace troy
         */
         void addMany(const std::vector<Ciphertext> &encrypteds, Ciphertext &destination) const;
 
+        /**
+        Adds together a stream of ciphertexts and stores the result in the destination parameter. Each call to
+        next must either write the next ciphertext to its argument and return true, or return false once the
+        stream is exhausted; calls are serialized, so next need not be thread-safe. Only one ciphertext per thread
+        is resident at a time. Up to setThreadCount() threads each sum their share with a CiphertextAggregator,
+        and the partial sums are merged as a tree. If next throws or a ciphertext is rejected, the other threads
+        stop pulling from the stream and the first exception is rethrown.
+
+        @param[in] next Produces the ciphertexts to add
+        @param[out] destination The ciphertext to overwrite with the addition result
+        @throws std::invalid_argument if the stream is empty
+        @throws std::invalid_argument if the ciphertexts are not valid for the encryption parameters
+        @throws std::invalid_argument if the ciphertexts differ in parms_id, NTT form, scale or correction factor;
+        unlike the vector overload, BGV inputs with differing correction factors are not balanced
+        */
+        void addMany(const std::function<bool(Ciphertext &)> &next, Ciphertext &destination) const;
+
         /**
         Subtracts two ciphertexts. This function computes the difference of encrypted1 and encrypted2, and stores the
         result in encrypted1.
@@ -296,6 +402,7 @@ namespace troy
         inline void relinearizeInplace(
             Ciphertext &encrypted, const RelinKeys &relin_keys) const
         {
+            TROY_INSTRUMENT_CIPHERTEXT(relinearize, context_, encrypted);
             relinearizeInternal(encrypted, relin_keys, 2);
         }
 
@@ -324,6 +431,21 @@ namespace troy
             relinearizeInplace(destination, relin_keys);
         }
 
+        /**
+        Relinearizes a batch of ciphertexts, reducing the size of each down to 2. Ciphertexts with the same parms_id
+        and size are key switched together, so every limb of a relinearization key is read once per batch instead of
+        once per ciphertext while it is applied to all of them. This gives the same result as calling
+        relinearizeInplace on each ciphertext.
+
+        @param[in] encrypted The ciphertexts to relinearize
+        @param[in] relin_keys The relinearization keys
+        @throws std::invalid_argument if any ciphertext or relin_keys is not valid for the encryption parameters
+        @throws std::invalid_argument if relin_keys do not correspond to the top level parameters in the current context
+        @throws std::invalid_argument if the size of relin_keys is too small
+        @throws std::logic_error if keyswitching is not supported by the context
+        */
+        void relinearizeManyInplace(std::vector<Ciphertext> &encrypted, const RelinKeys &relin_keys) const;
+
         /**
         Given a ciphertext encrypted modulo q_1...q_k, this function switches the modulus down to q_1...q_{k-1} and
         stores the result in the destination parameter. Dynamic memory allocations in the process are allocated from the
@@ -700,6 +822,58 @@ namespace troy
             subPlainInplace(destination, plain);
         }
 
+        /**
+        Scales a BFV plaintext by q/t and reduces it modulo every prime at the given parms_id, so that later additions,
+        subtractions and encryptions of it skip the per-coefficient rounding.
+
+        @param[in] plain The plaintext to scale
+        @param[in] parms_id The level the scaled plaintext will be used at
+        @param[out] destination The scaled plaintext to overwrite
+        @throws std::invalid_argument if plain is not valid for the encryption parameters or is in NTT form
+        @throws std::invalid_argument if parms_id is not valid or the scheme is not BFV
+        */
+        void scalePlain(const Plaintext &plain, ParmsID parms_id, ScaledPlaintext &destination) const;
+
+        /**
+        Scales a BFV plaintext for use at the first (data) level. See scalePlain above.
+        */
+        inline void scalePlain(const Plaintext &plain, ScaledPlaintext &destination) const
+        {
+            scalePlain(plain, context_.firstParmsID(), destination);
+        }
+
+        /**
+        Adds a scaled plaintext to a BFV ciphertext at the same level.
+
+        @param[in] encrypted The ciphertext to add to
+        @param[in] plain The scaled plaintext to add
+        @throws std::invalid_argument if encrypted is not valid for the encryption parameters or is in NTT form
+        @throws std::invalid_argument if encrypted and plain are at different levels
+        */
+        void addPlainInplace(Ciphertext &encrypted, const ScaledPlaintext &plain) const;
+
+        inline void addPlain(const Ciphertext &encrypted, const ScaledPlaintext &plain, Ciphertext &destination) const
+        {
+            destination = encrypted;
+            addPlainInplace(destination, plain);
+        }
+
+        /**
+        Subtracts a scaled plaintext from a BFV ciphertext at the same level.
+
+        @param[in] encrypted The ciphertext to subtract from
+        @param[in] plain The scaled plaintext to subtract
+        @throws std::invalid_argument if encrypted is not valid for the encryption parameters or is in NTT form
+        @throws std::invalid_argument if encrypted and plain are at different levels
+        */
+        void subPlainInplace(Ciphertext &encrypted, const ScaledPlaintext &plain) const;
+
+        inline void subPlain(const Ciphertext &encrypted, const ScaledPlaintext &plain, Ciphertext &destination) const
+        {
+            destination = encrypted;
+            subPlainInplace(destination, plain);
+        }
+
         /**
         Multiplies a ciphertext with a plaintext. The plaintext cannot be identically 0. Dynamic memory allocations in
         the process are allocated from the memory pool pointed to by the given MemoryPoolHandle.
@@ -738,6 +912,60 @@ namespace troy
             multiplyPlainInplace(destination, plain);
         }
 
+        /**
+        Computes the inner product of a list of ciphertexts with a list of plaintexts, i.e. the sum of
+        encrypteds[k] * plains[k], and stores the result in the destination parameter. All operands must be in NTT form
+        at the same parms_id. The products are accumulated lazily in 128-bit words and each coefficient is reduced
+        only once, which is considerably faster than a sequence of multiplyPlain and addInplace calls.
+
+        @param[in] encrypteds The ciphertexts to multiply
+        @param[in] plains The plaintexts to multiply, one for each ciphertext
+        @param[out] destination The ciphertext to overwrite with the inner product
+        @throws std::invalid_argument if encrypteds is empty or its length differs from plains
+        @throws std::invalid_argument if an operand is not valid for the encryption parameters
+        @throws std::invalid_argument if an operand is not in NTT form or the operands are at different levels
+        @throws std::invalid_argument if the ciphertexts have different sizes or the products have different scales
+        @throws std::invalid_argument if the output scale is too large for the encryption parameters
+        */
+        void multiplyPlainAccumulate(
+            const std::vector<const Ciphertext *> &encrypteds, const std::vector<const Plaintext *> &plains,
+            Ciphertext &destination) const;
+
+        /**
+        Lifts a BFV ciphertext to the extended base q U Bsk and transforms it to NTT form, i.e. performs steps (1)-(3)
+        of the BEHZ multiplication once, so that the result can be reused by any number of multiplyAccumulate calls.
+
+        @param[in] encrypted The ciphertext to extend
+        @param[out] destination The extended ciphertext to overwrite
+        @throws std::invalid_argument if encrypted is not valid for the encryption parameters
+        @throws std::invalid_argument if the scheme is not BFV or encrypted is in NTT form
+        */
+        void extendToBehzNtt(const Ciphertext &encrypted, BehzCiphertext &destination) const;
+
+        /**
+        Computes the sum of encrypteds1[k] * encrypteds2[k] for BFV ciphertexts extended with extendToBehzNtt. The
+        tensor products are accumulated lazily in the extended NTT domain and the result is transformed back, scaled
+        by t/q and converted to base q only once, instead of once per product as with a sequence of multiply and
+        addInplace calls. The result has size encrypteds1[0]->size() + encrypteds2[0]->size() - 1, so it typically
+        needs a single relinearization afterwards.
+
+        Base Bsk only has headroom for a bounded number of summands: each product adds up to t N q to the scaled
+        sum, which has to stay below half the product of the Bsk primes. The bases SEALContext chooses leave room for
+        at least about 2^(29 - log2(N)) products. Longer sums are split into chunks of that many products (see
+        setMultiplyAccumulateChunkSize), each of which is scaled and converted on its own, and the chunks are added in
+        base q.
+
+        @param[in] encrypteds1 The first operands
+        @param[in] encrypteds2 The second operands, one for each first operand
+        @param[out] destination The ciphertext to overwrite with the sum of products
+        @throws std::invalid_argument if encrypteds1 is empty or its length differs from encrypteds2
+        @throws std::invalid_argument if the operands are at different levels or the operands on one side have
+        different sizes
+        */
+        void multiplyAccumulate(
+            const std::vector<const BehzCiphertext *> &encrypteds1,
+            const std::vector<const BehzCiphertext *> &encrypteds2, Ciphertext &destination) const;
+
         /**
         Transforms a plaintext to NTT domain. This functions applies the Number Theoretic Transform to a plaintext by
         first embedding integers modulo the plaintext modulus to integers modulo the coefficient modulus and then
@@ -871,8 +1099,12 @@ namespace troy
         @throws std::logic_error if keyswitching is not supported by the context
         @throws std::logic_error if result ciphertext is transparent
         */
-        void applyGaloisInplace(
-            Ciphertext &encrypted, std::uint32_t galois_elt, const GaloisKeys &galois_keys) const;
+        inline void applyGaloisInplace(
+            Ciphertext &encrypted, std::uint32_t galois_elt, const GaloisKeys &galois_keys) const
+        {
+            TROY_INSTRUMENT_CIPHERTEXT(apply_galois, context_, encrypted);
+            applyGaloisInternal(std::vector<Ciphertext *>{ &encrypted }, galois_elt, galois_keys);
+        }
 
         /**
         Applies a Galois automorphism to a ciphertext and writes the result to the destination parameter. To evaluate
@@ -947,6 +1179,30 @@ namespace troy
             rotateInternal(encrypted, steps, galois_keys);
         }
 
+        /**
+        Rotates the plaintext matrix rows of a batch of ciphertexts cyclically by the same number of steps. This gives
+        the same result as calling rotateRowsInplace on each ciphertext, but ciphertexts with the same parms_id share
+        one pass over every Galois key they need.
+
+        @param[in] encrypted The ciphertexts to rotate
+        @param[in] steps The number of steps to rotate (positive left, negative right)
+        @param[in] galois_keys The Galois keys
+        @throws std::logic_error if scheme is not SchemeType::bfv or SchemeType::bgv
+        @throws std::invalid_argument if any ciphertext or galois_keys is not valid for the encryption parameters
+        @throws std::invalid_argument if necessary Galois keys are not present
+        @throws std::logic_error if keyswitching is not supported by the context
+        */
+        inline void rotateRowsManyInplace(
+            std::vector<Ciphertext> &encrypted, int steps, const GaloisKeys &galois_keys) const
+        {
+            auto scheme = context_.keyContextData()->parms().scheme();
+            if (scheme != SchemeType::bfv && scheme != SchemeType::bgv)
+            {
+                throw std::logic_error("unsupported scheme");
+            }
+            rotateManyInternal(encrypted, steps, galois_keys);
+        }
+
         /**
         Rotates plaintext matrix rows cyclically. When batching is used with the BFV/BGV scheme, this function rotates
         the encrypted plaintext matrix rows cyclically to the left (steps > 0) or to the right (steps < 0) and writes
@@ -1079,6 +1335,29 @@ namespace troy
             rotateInternal(encrypted, steps, galois_keys);
         }
 
+        /**
+        Rotates the plaintext vectors of a batch of CKKS ciphertexts cyclically by the same number of steps. This
+        gives the same result as calling rotateVectorInplace on each ciphertext, but ciphertexts with the same
+        parms_id share one pass over every Galois key they need.
+
+        @param[in] encrypted The ciphertexts to rotate
+        @param[in] steps The number of steps to rotate (positive left, negative right)
+        @param[in] galois_keys The Galois keys
+        @throws std::logic_error if scheme is not SchemeType::ckks
+        @throws std::invalid_argument if any ciphertext or galois_keys is not valid for the encryption parameters
+        @throws std::invalid_argument if necessary Galois keys are not present
+        @throws std::logic_error if keyswitching is not supported by the context
+        */
+        inline void rotateVectorManyInplace(
+            std::vector<Ciphertext> &encrypted, int steps, const GaloisKeys &galois_keys) const
+        {
+            if (context_.keyContextData()->parms().scheme() != SchemeType::ckks)
+            {
+                throw std::logic_error("unsupported scheme");
+            }
+            rotateManyInternal(encrypted, steps, galois_keys);
+        }
+
         /**
         Rotates plaintext vector cyclically. When using the CKKS scheme, this function rotates the encrypted plaintext
         vector cyclically to the left (steps > 0) or to the right (steps < 0) and writes the result to the destination
@@ -1170,6 +1449,185 @@ namespace troy
             complexConjugateInplace(destination, galois_keys);
         }
 
+        /**
+        Multiplies every polynomial of a ciphertext by the monomial X^shift in the ring Z_q[X]/(X^N + 1), and stores
+        the result in the destination parameter. Shifts in [N, 2N) wrap around with a sign flip.
+
+        @param[in] encrypted The ciphertext to shift
+        @param[in] shift The exponent of the monomial, less than 2N
+        @param[out] destination The ciphertext to overwrite with the shifted result
+        @throws std::invalid_argument if encrypted is not valid for the encryption parameters
+        @throws std::invalid_argument if encrypted is in NTT form
+        @throws std::invalid_argument if shift is not less than 2N
+        */
+        void negacyclicShift(const Ciphertext &encrypted, std::size_t shift, Ciphertext &destination) const;
+
+        /**
+        Multiplies every polynomial of a ciphertext by the monomial X^shift in the ring Z_q[X]/(X^N + 1).
+
+        @param[in] encrypted The ciphertext to shift
+        @param[in] shift The exponent of the monomial, less than 2N
+        @throws std::invalid_argument if encrypted is not valid for the encryption parameters
+        @throws std::invalid_argument if encrypted is in NTT form
+        @throws std::invalid_argument if shift is not less than 2N
+        */
+        inline void negacyclicShiftInplace(Ciphertext &encrypted, std::size_t shift) const
+        {
+            Ciphertext x = encrypted;
+            negacyclicShift(x, shift, encrypted);
+        }
+
+        /**
+        Multiplies a ciphertext by N^{-1} * mul modulo each prime of the coefficient modulus. Used before a field
+        trace, which multiplies the coefficients it keeps by the size of the traced Galois group.
+
+        @param[in] encrypted The ciphertext to scale
+        @param[in] mul An additional scalar factor
+        @throws std::invalid_argument if encrypted is not valid for the encryption parameters
+        */
+        void divideByPolyModulusDegreeInplace(Ciphertext &encrypted, std::uint64_t mul = 1) const;
+
+        /**
+        Applies the field trace from Z[X]/(X^N + 1) to the subring generated by X^(N / 2^logn), that is, sums the
+        images of the ciphertext under the automorphisms X -> X^(k + 1) for k = N, N/2, ..., 2^(logn + 1). Every
+        coefficient whose index is a multiple of N / 2^logn is multiplied by N / 2^logn, and every other coefficient
+        is zeroed. The automorphism keys can be generated with KeyGenerator::createAutomorphismKeys.
+
+        @param[in] encrypted The ciphertext to trace
+        @param[in] automorphism_keys The Galois keys for the elements N + 1, N/2 + 1, ..., 3
+        @param[in] logn The logarithm of the degree of the target subring
+        @throws std::invalid_argument if encrypted is not valid for the encryption parameters
+        @throws std::invalid_argument if necessary Galois keys are not present
+        */
+        void fieldTraceInplace(Ciphertext &encrypted, const GaloisKeys &automorphism_keys, std::size_t logn) const;
+
+        /**
+        Extracts one coefficient of the plaintext underlying a ciphertext as an LWE ciphertext under the same secret
+        key (sample extraction). This costs no key switching and no noise: the sample is c_0[index] together with c_1
+        multiplied by X^(-index). Extract the coefficients a client needs, switch them to the lowest level with
+        modSwitchToNextInplace, and pack them back into one ciphertext with packLWECiphertexts.
+
+        @param[in] encrypted The ciphertext to extract from
+        @param[in] index The index of the plaintext coefficient
+        @param[out] destination The LWE ciphertext to overwrite with the sample
+        @throws std::invalid_argument if encrypted is not valid for the encryption parameters
+        @throws std::invalid_argument if encrypted has size other than 2
+        @throws std::invalid_argument if index is not less than the polynomial modulus degree
+        */
+        inline void extractLWE(const Ciphertext &encrypted, std::size_t index, LWECiphertext &destination) const
+        {
+            std::vector<LWECiphertext> samples;
+            extractLWE(encrypted, std::vector<std::size_t>{ index }, samples);
+            destination = std::move(samples[0]);
+        }
+
+        /**
+        Extracts several coefficients of the plaintext underlying a ciphertext as LWE ciphertexts. See extractLWE; a
+        ciphertext in NTT form is transformed only once for all of them.
+
+        @param[in] encrypted The ciphertext to extract from
+        @param[in] indices The indices of the plaintext coefficients
+        @param[out] destination The LWE ciphertexts to overwrite, one per index
+        @throws std::invalid_argument if encrypted is not valid for the encryption parameters
+        @throws std::invalid_argument if encrypted has size other than 2
+        @throws std::invalid_argument if an index is not less than the polynomial modulus degree
+        */
+        void extractLWE(
+            const Ciphertext &encrypted, const std::vector<std::size_t> &indices,
+            std::vector<LWECiphertext> &destination) const;
+
+        /**
+        Switches an LWE ciphertext to the next level down the modulus chain, as modSwitchToNext does for ciphertexts:
+        for BFV and BGV the last prime is divided out with rounding, for CKKS it is dropped and the scale is kept.
+
+        @param[in] encrypted The LWE ciphertext to switch
+        @throws std::invalid_argument if encrypted is not valid for the encryption parameters
+        @throws std::invalid_argument if encrypted is already at the last level
+        */
+        void modSwitchToNextInplace(LWECiphertext &encrypted) const;
+
+        /**
+        Switches an LWE ciphertext down the modulus chain to the given level. See modSwitchToNextInplace.
+
+        @param[in] encrypted The LWE ciphertext to switch
+        @param[in] parms_id The target parms_id
+        @throws std::invalid_argument if encrypted or parms_id is not valid for the encryption parameters
+        @throws std::invalid_argument if parms_id is above the level of encrypted
+        */
+        void modSwitchToInplace(LWECiphertext &encrypted, ParmsID parms_id) const;
+
+        /**
+        Merges every group of group_size consecutive ciphertexts into one with a tree of group_size - 1
+        automorphisms, the merge behind packLWECiphertexts. Within a group, ciphertext j is shifted by X^(j * spacing)
+        and the members are merged pairwise: the level with shift h = group_size / 2 * spacing, ..., spacing adds the
+        image of their difference under X -> X^(N / h + 1), which negates X^h and fixes the multiples of 2h. A
+        coefficient of ciphertext j whose index is a multiple of group_size * spacing therefore ends up, unscaled, at
+        that index plus j * spacing. With spacing 1 the tree sums over all its automorphisms and every other
+        coefficient cancels; with a larger spacing the others are only mixed, and the caller clears them, e.g. with
+        fieldTraceInplace. The inputs are divided by group_size up front, the automorphisms of a level are key
+        switched as one batch, and the rest of a level runs on threadCount() threads.
+
+        @param[in,out] encrypteds The ciphertexts to merge, all at the same level and in the default NTT form of the
+        scheme; on return, the merged ciphertext of every group, in order
+        @param[in] group_size The number of ciphertexts merged into one, a power of two; the last group may be short
+        @param[in] spacing The distance between the positions of consecutive members, a power of two
+        @param[in] automorphism_keys The Galois keys for the elements N / h + 1, generated with
+        KeyGenerator::createAutomorphismKeys
+        @throws std::invalid_argument if encrypteds is empty, not valid for the encryption parameters, at different
+        levels or not in the default NTT form of the scheme
+        @throws std::invalid_argument if group_size or spacing is not a power of two or their product exceeds N
+        @throws std::invalid_argument if necessary Galois keys are not present
+        */
+        void packCiphertextGroupsInplace(
+            std::vector<Ciphertext> &encrypteds, std::size_t group_size, std::size_t spacing,
+            const GaloisKeys &automorphism_keys) const;
+
+        /**
+        Packs LWE ciphertexts into one ciphertext (ring packing). With 2^l the number of samples rounded up to a power
+        of two, sample j ends up at plaintext coefficient j * N / 2^l and every other coefficient is zero. The samples
+        are merged by packCiphertextGroupsInplace with spacing N / 2^l, a tree of at most 2^l - 1 automorphisms
+        X -> X^(2^k + 1), and the result is traced down to the subring of X^(N / 2^l) with log2(N) - l more (see
+        fieldTraceInplace). Every automorphism adds key switching noise, so switching the samples to a low level first
+        makes packing both cheaper and smaller. The result is in the default NTT form of the scheme.
+
+        @param[in] lwes The LWE ciphertexts, at most N, all at the same level
+        @param[in] automorphism_keys The Galois keys for the elements N + 1, N/2 + 1, ..., 3, generated with
+        KeyGenerator::createAutomorphismKeys
+        @param[out] destination The ciphertext to overwrite with the packed samples
+        @throws std::invalid_argument if lwes is empty or has more than N elements
+        @throws std::invalid_argument if the LWE ciphertexts are not valid for the encryption parameters or are at
+        different levels
+        @throws std::invalid_argument if necessary Galois keys are not present
+        */
+        void packLWECiphertexts(
+            const std::vector<LWECiphertext> &lwes, const GaloisKeys &automorphism_keys,
+            Ciphertext &destination) const;
+
+        /**
+        Expands a query ciphertext obliviously into count ciphertexts, the i-th of which encrypts the constant
+        coefficient b_i of the query plaintext sum_i b_i X^i (as used by private information retrieval). With 2^l the
+        count rounded up to a power of two, level j of the expansion tree splits every ciphertext c of the previous
+        level into c + tau(c) and X^(-2^j) (c - tau(c)), with tau: X -> X^(N / 2^j + 1); the automorphisms of a level
+        share one Galois key and are key-switched as one batch, and the rest of the level runs on threadCount()
+        threads. The query is multiplied by 2^-l modulo q up front, so the outputs are not scaled by 2^l. Coefficients
+        i + k 2^l of the query with k > 0 end up in the non-constant coefficients of output i, so they should be zero.
+
+        Create the Galois keys with KeyGenerator::createGaloisKeys from GaloisTool::getEltsForExpansion(count) of the
+        key level.
+
+        @param[in] encrypted The query ciphertext
+        @param[in] count The number of ciphertexts to expand into, between 1 and N
+        @param[in] galois_keys The Galois keys
+        @param[out] destination The ciphertexts to overwrite with the expansion
+        @throws std::invalid_argument if encrypted or galois_keys is not valid for the encryption parameters
+        @throws std::invalid_argument if encrypted has size other than 2
+        @throws std::invalid_argument if count is out of range
+        @throws std::invalid_argument if necessary Galois keys are not present
+        */
+        void expandQuery(
+            const Ciphertext &encrypted, std::size_t count, const GaloisKeys &galois_keys,
+            std::vector<Ciphertext> &destination) const;
+
         /**
         Enables access to private members of seal::Evaluator for SEAL_C.
         */
@@ -1197,7 +1655,14 @@ namespace troy
         void bgvSquare(Ciphertext &encrypted) const;
 
         void relinearizeInternal(
-            Ciphertext &encrypted, const RelinKeys &relin_keys, std::size_t destination_size) const;
+            const std::vector<Ciphertext *> &encrypted_batch, const RelinKeys &relin_keys,
+            std::size_t destination_size) const;
+
+        inline void relinearizeInternal(
+            Ciphertext &encrypted, const RelinKeys &relin_keys, std::size_t destination_size) const
+        {
+            relinearizeInternal(std::vector<Ciphertext *>{ &encrypted }, relin_keys, destination_size);
+        }
 
         void modSwitchScaleToNext(
             const Ciphertext &encrypted, Ciphertext &destination) const;
@@ -1207,11 +1672,28 @@ namespace troy
         void modSwitchDropToNext(Plaintext &plain) const;
 
         void rotateInternal(
-            Ciphertext &encrypted, int steps, const GaloisKeys &galois_keys) const;
+            const std::vector<Ciphertext *> &encrypted_batch, int steps, const GaloisKeys &galois_keys) const;
+
+        inline void rotateInternal(
+            Ciphertext &encrypted, int steps, const GaloisKeys &galois_keys) const
+        {
+            TROY_INSTRUMENT_CIPHERTEXT(rotate, context_, encrypted);
+            TROY_INSTRUMENT_ROTATION(steps, 1);
+            rotateInternal(std::vector<Ciphertext *>{ &encrypted }, steps, galois_keys);
+        }
+
+        void rotateManyInternal(std::vector<Ciphertext> &encrypted, int steps, const GaloisKeys &galois_keys) const;
+
+        void applyGaloisInternal(
+            const std::vector<Ciphertext *> &encrypted_batch, std::uint32_t galois_elt,
+            const GaloisKeys &galois_keys) const;
 
         inline void conjugateInternal(
             Ciphertext &encrypted, const GaloisKeys &galois_keys) const
         {
+            TROY_INSTRUMENT_CIPHERTEXT(rotate, context_, encrypted);
+            TROY_INSTRUMENT_ROTATION(0, 1);
+
             // Verify parameters.
             auto context_data_ptr = context_.getContextData(encrypted.parmsID());
             if (!context_data_ptr)
@@ -1233,13 +1715,28 @@ namespace troy
         }
 
         void switchKeyInplace(
+            const std::vector<Ciphertext *> &encrypted_batch, const std::vector<const uint64_t *> &target_batch,
+            const KSwitchKeys &kswitch_keys, std::size_t key_index) const;
+
+        inline void switchKeyInplace(
             Ciphertext &encrypted, util::ConstHostPointer<uint64_t> target_iter, const KSwitchKeys &kswitch_keys,
-            std::size_t key_index) const;
+            std::size_t key_index) const
+        {
+            switchKeyInplace(
+                std::vector<Ciphertext *>{ &encrypted }, std::vector<const uint64_t *>{ target_iter.get() },
+                kswitch_keys, key_index);
+        }
 
         void multiplyPlainNormal(Ciphertext &encrypted, const Plaintext &plain) const;
 
         void multiplyPlainNtt(Ciphertext &encrypted_ntt, const Plaintext &plain_ntt) const;
 
         SEALContext context_;
+
+        std::size_t threads_ = 1;
+
+        std::size_t batch_key_bytes_ = 0;
+
+        std::size_t multiply_accumulate_chunk_size_ = 0;
     };
 } // namespace seal
@@ -0,0 +1,689 @@
+#include "instrumentation.h"
+#include "utils/common.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace troy::util;
+
+namespace troy
+{
+    namespace
+    {
+        constexpr size_t operation_count = static_cast<size_t>(Operation::operation_count);
+
+        constexpr size_t counter_count = static_cast<size_t>(Counter::counter_count);
+
+        // Levels at or above this are recorded as unknown_level; real chains are far shorter.
+        constexpr size_t max_levels = 128;
+
+        struct OperationSlot
+        {
+            atomic<uint64_t> count{ 0 };
+
+            atomic<uint64_t> total_nanoseconds{ 0 };
+
+            atomic<uint64_t> max_nanoseconds{ 0 };
+
+            atomic<uint64_t> histogram[Instrumentation::histogram_buckets] = {};
+        };
+
+        // One slot per (operation, level), the last level being unknown_level. Slots are allocated on first use
+        // and never freed, so a pointer loaded from here stays valid for the life of the program.
+        atomic<OperationSlot *> operation_slots[operation_count][max_levels + 1] = {};
+
+        mutex rotation_mutex;
+
+        map<int, uint64_t> rotation_counts;
+
+        // Returns nullptr only if a new slot could not be allocated.
+        OperationSlot *operationSlot(Operation operation, size_t level) noexcept
+        {
+            auto &entry = operation_slots[static_cast<size_t>(operation)][min(level, max_levels)];
+            OperationSlot *slot = entry.load(memory_order_acquire);
+            if (!slot)
+            {
+                OperationSlot *created = new (nothrow) OperationSlot;
+                if (!created)
+                {
+                    return nullptr;
+                }
+                if (entry.compare_exchange_strong(slot, created, memory_order_acq_rel))
+                {
+                    slot = created;
+                }
+                else
+                {
+                    delete created;
+                }
+            }
+            return slot;
+        }
+
+        struct TraceEvent
+        {
+            Operation operation;
+
+            size_t level;
+
+            size_t size;
+
+            int64_t begin_nanoseconds;
+
+            int64_t duration_nanoseconds;
+        };
+
+        // The events of one thread. Only the owning thread appends, but the exporter reads every buffer, so
+        // each has its own (practically uncontended) lock.
+        struct TraceBuffer
+        {
+            uint64_t thread_id;
+
+            mutex buffer_mutex;
+
+            vector<TraceEvent> events;
+
+            size_t dropped = 0;
+        };
+
+        // An event of a thread that has exited, kept until the next start() or clear().
+        struct RetiredTraceEvent
+        {
+            uint64_t thread_id;
+
+            TraceEvent event;
+        };
+
+        // Buffers of the threads that are alive and have recorded an event. A thread's buffer is freed when it
+        // exits and its events move to retired_trace_events, so short-lived workers do not accumulate buffers.
+        mutex trace_buffers_mutex;
+
+        vector<TraceBuffer *> trace_buffers;
+
+        vector<RetiredTraceEvent> retired_trace_events;
+
+        size_t retired_dropped = 0;
+
+        atomic<size_t> trace_capacity{ 0 };
+
+        // Events stored over all threads, live and retired, and the limit on it.
+        atomic<size_t> trace_event_count{ 0 };
+
+        atomic<size_t> trace_total_capacity{ 0 };
+
+        atomic<int64_t> trace_origin_nanoseconds{ 0 };
+
+        int64_t steadyNanoseconds(chrono::steady_clock::time_point time)
+        {
+            return chrono::duration_cast<chrono::nanoseconds>(time.time_since_epoch()).count();
+        }
+
+        uint64_t currentThreadId()
+        {
+#ifdef __linux__
+            return static_cast<uint64_t>(syscall(SYS_gettid));
+#else
+            return static_cast<uint64_t>(hash<thread::id>()(this_thread::get_id()));
+#endif
+        }
+
+        // Owns the buffer of the current thread and retires it when the thread exits.
+        class TraceBufferOwner
+        {
+        public:
+            ~TraceBufferOwner()
+            {
+                if (!buffer_)
+                {
+                    return;
+                }
+                lock_guard<mutex> lock(trace_buffers_mutex);
+                {
+                    lock_guard<mutex> buffer_lock(buffer_->buffer_mutex);
+                    try
+                    {
+                        retired_trace_events.reserve(retired_trace_events.size() + buffer_->events.size());
+                        for (auto &event : buffer_->events)
+                        {
+                            retired_trace_events.push_back(RetiredTraceEvent{ buffer_->thread_id, event });
+                        }
+                    }
+                    catch (...)
+                    {
+                        // The events of this thread are lost rather than failing the thread's exit.
+                        retired_dropped += buffer_->events.size();
+                        trace_event_count.fetch_sub(buffer_->events.size(), memory_order_relaxed);
+                    }
+                    retired_dropped += buffer_->dropped;
+                }
+                trace_buffers.erase(find(trace_buffers.begin(), trace_buffers.end(), buffer_));
+                delete buffer_;
+            }
+
+            TraceBuffer *get()
+            {
+                if (!buffer_)
+                {
+                    auto buffer = make_unique<TraceBuffer>();
+                    buffer->thread_id = currentThreadId();
+                    lock_guard<mutex> lock(trace_buffers_mutex);
+                    trace_buffers.push_back(buffer.get());
+                    buffer_ = buffer.release();
+                }
+                return buffer_;
+            }
+
+        private:
+            TraceBuffer *buffer_ = nullptr;
+        };
+
+        TraceBuffer *threadTraceBuffer()
+        {
+            thread_local TraceBufferOwner owner;
+            return owner.get();
+        }
+
+        void appendJsonString(ostringstream &out, const char *text)
+        {
+            // Names are plain identifiers, so there is nothing to escape.
+            out << '"' << text << '"';
+        }
+    } // namespace
+
+    atomic<bool> Instrumentation::enabled_{ true };
+
+    atomic<bool> Tracer::enabled_{ false };
+
+    atomic<uint64_t> Instrumentation::counters_[counter_count] = {};
+
+    const char *operationName(Operation operation)
+    {
+        switch (operation)
+        {
+        case Operation::encrypt:
+            return "encrypt";
+        case Operation::decrypt:
+            return "decrypt";
+        case Operation::encode:
+            return "encode";
+        case Operation::decode:
+            return "decode";
+        case Operation::negate:
+            return "negate";
+        case Operation::add:
+            return "add";
+        case Operation::sub:
+            return "sub";
+        case Operation::add_many:
+            return "add_many";
+        case Operation::multiply:
+            return "multiply";
+        case Operation::square:
+            return "square";
+        case Operation::relinearize:
+            return "relinearize";
+        case Operation::mod_switch:
+            return "mod_switch";
+        case Operation::rescale:
+            return "rescale";
+        case Operation::add_plain:
+            return "add_plain";
+        case Operation::sub_plain:
+            return "sub_plain";
+        case Operation::multiply_plain:
+            return "multiply_plain";
+        case Operation::transform_to_ntt:
+            return "transform_to_ntt";
+        case Operation::transform_from_ntt:
+            return "transform_from_ntt";
+        case Operation::apply_galois:
+            return "apply_galois";
+        case Operation::rotate:
+            return "rotate";
+        case Operation::key_switch:
+            return "key_switch";
+        case Operation::ntt:
+            return "ntt";
+        case Operation::inverse_ntt:
+            return "inverse_ntt";
+        case Operation::base_conversion:
+            return "base_conversion";
+        default:
+            throw invalid_argument("unknown operation");
+        }
+    }
+
+    const char *counterName(Counter counter)
+    {
+        switch (counter)
+        {
+        case Counter::ntt:
+            return "ntt";
+        case Counter::inverse_ntt:
+            return "inverse_ntt";
+        case Counter::key_switch:
+            return "key_switch";
+        case Counter::allocations:
+            return "allocations";
+        case Counter::bytes_allocated:
+            return "bytes_allocated";
+        default:
+            throw invalid_argument("unknown counter");
+        }
+    }
+
+    bool Instrumentation::compiledIn() noexcept
+    {
+#ifdef TROY_INSTRUMENTATION
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void Instrumentation::setEnabled(bool enabled) noexcept
+    {
+        enabled_.store(enabled, memory_order_relaxed);
+    }
+
+    void Instrumentation::recordOperation(
+        Operation operation, size_t level, uint64_t nanoseconds, uint64_t calls) noexcept
+    {
+        OperationSlot *slot_ptr = operationSlot(operation, level);
+        if (!slot_ptr)
+        {
+            return;
+        }
+        OperationSlot &slot = *slot_ptr;
+        slot.count.fetch_add(calls, memory_order_relaxed);
+        slot.total_nanoseconds.fetch_add(nanoseconds, memory_order_relaxed);
+        nanoseconds /= calls;
+        uint64_t max_nanoseconds = slot.max_nanoseconds.load(memory_order_relaxed);
+        while (nanoseconds > max_nanoseconds &&
+               !slot.max_nanoseconds.compare_exchange_weak(max_nanoseconds, nanoseconds, memory_order_relaxed))
+        {
+        }
+        size_t bucket = min(static_cast<size_t>(getSignificantBitCount(nanoseconds)), histogram_buckets - 1);
+        slot.histogram[bucket].fetch_add(calls, memory_order_relaxed);
+    }
+
+    void Instrumentation::recordRotation(int steps, uint64_t count)
+    {
+        if (!enabled())
+        {
+            return;
+        }
+        lock_guard<mutex> lock(rotation_mutex);
+        rotation_counts[steps] += count;
+    }
+
+    InstrumentationSnapshot Instrumentation::snapshot()
+    {
+        InstrumentationSnapshot snapshot;
+        snapshot.compiled_in = compiledIn();
+        snapshot.counters.resize(counter_count);
+        for (size_t i = 0; i < counter_count; i++)
+        {
+            snapshot.counters[i] = counters_[i].load(memory_order_relaxed);
+        }
+        for (size_t i = 0; i < operation_count; i++)
+        {
+            for (size_t level = 0; level <= max_levels; level++)
+            {
+                OperationSlot *slot = operation_slots[i][level].load(memory_order_acquire);
+                if (!slot)
+                {
+                    continue;
+                }
+                uint64_t count = slot->count.load(memory_order_relaxed);
+                if (!count)
+                {
+                    continue;
+                }
+                OperationStats stats;
+                stats.operation = static_cast<Operation>(i);
+                stats.level = level == max_levels ? OperationStats::unknown_level : level;
+                stats.count = count;
+                stats.total_nanoseconds = slot->total_nanoseconds.load(memory_order_relaxed);
+                stats.max_nanoseconds = slot->max_nanoseconds.load(memory_order_relaxed);
+                stats.histogram.resize(histogram_buckets);
+                for (size_t j = 0; j < histogram_buckets; j++)
+                {
+                    stats.histogram[j] = slot->histogram[j].load(memory_order_relaxed);
+                }
+                snapshot.operations.push_back(move(stats));
+            }
+        }
+        {
+            lock_guard<mutex> lock(rotation_mutex);
+            snapshot.rotation_steps = rotation_counts;
+        }
+        return snapshot;
+    }
+
+    void Instrumentation::reset()
+    {
+        for (auto &counter : counters_)
+        {
+            counter.store(0, memory_order_relaxed);
+        }
+        for (auto &slots : operation_slots)
+        {
+            for (auto &entry : slots)
+            {
+                OperationSlot *slot = entry.load(memory_order_acquire);
+                if (!slot)
+                {
+                    continue;
+                }
+                slot->count.store(0, memory_order_relaxed);
+                slot->total_nanoseconds.store(0, memory_order_relaxed);
+                slot->max_nanoseconds.store(0, memory_order_relaxed);
+                for (auto &bucket : slot->histogram)
+                {
+                    bucket.store(0, memory_order_relaxed);
+                }
+            }
+        }
+        lock_guard<mutex> lock(rotation_mutex);
+        rotation_counts.clear();
+    }
+
+    uint64_t InstrumentationSnapshot::counter(Counter counter) const
+    {
+        size_t index = static_cast<size_t>(counter);
+        return index < counters.size() ? counters[index] : 0;
+    }
+
+    uint64_t InstrumentationSnapshot::count(Operation operation) const
+    {
+        uint64_t total = 0;
+        for (auto &stats : operations)
+        {
+            if (stats.operation == operation)
+            {
+                total += stats.count;
+            }
+        }
+        return total;
+    }
+
+    const OperationStats *InstrumentationSnapshot::find(Operation operation, size_t level) const
+    {
+        for (auto &stats : operations)
+        {
+            if (stats.operation == operation && stats.level == level)
+            {
+                return &stats;
+            }
+        }
+        return nullptr;
+    }
+
+    string InstrumentationSnapshot::toJson() const
+    {
+        ostringstream out;
+        out << "{\"compiled_in\":" << (compiled_in ? "true" : "false") << ",\"operations\":[";
+        for (size_t i = 0; i < operations.size(); i++)
+        {
+            auto &stats = operations[i];
+            out << (i ? "," : "") << "{\"operation\":";
+            appendJsonString(out, operationName(stats.operation));
+            out << ",\"level\":";
+            if (stats.level == OperationStats::unknown_level)
+            {
+                out << "null";
+            }
+            else
+            {
+                out << stats.level;
+            }
+            out << ",\"count\":" << stats.count << ",\"total_ns\":" << stats.total_nanoseconds
+                << ",\"max_ns\":" << stats.max_nanoseconds << ",\"histogram\":[";
+            for (size_t j = 0; j < stats.histogram.size(); j++)
+            {
+                out << (j ? "," : "") << stats.histogram[j];
+            }
+            out << "]}";
+        }
+        out << "],\"counters\":{";
+        for (size_t i = 0; i < counters.size(); i++)
+        {
+            out << (i ? "," : "");
+            appendJsonString(out, counterName(static_cast<Counter>(i)));
+            out << ":" << counters[i];
+        }
+        out << "},\"rotation_steps\":{";
+        bool first = true;
+        for (auto &entry : rotation_steps)
+        {
+            out << (first ? "" : ",") << "\"" << entry.first << "\":" << entry.second;
+            first = false;
+        }
+        out << "}}";
+        return out.str();
+    }
+
+    string InstrumentationSnapshot::toPrometheus() const
+    {
+        ostringstream out;
+        out << "# HELP troy_operation_duration_seconds Latency of homomorphic operations.\n"
+            << "# TYPE troy_operation_duration_seconds histogram\n";
+        for (auto &stats : operations)
+        {
+            ostringstream labels;
+            labels << "operation=\"" << operationName(stats.operation) << "\",level=\"";
+            if (stats.level == OperationStats::unknown_level)
+            {
+                labels << "unknown";
+            }
+            else
+            {
+                labels << stats.level;
+            }
+            labels << "\"";
+            uint64_t cumulative = 0;
+            for (size_t j = 0; j + 1 < stats.histogram.size(); j++)
+            {
+                cumulative += stats.histogram[j];
+                out << "troy_operation_duration_seconds_bucket{" << labels.str() << ",le=\""
+                    << ldexp(1e-9, static_cast<int>(j)) << "\"} " << cumulative << "\n";
+            }
+            out << "troy_operation_duration_seconds_bucket{" << labels.str() << ",le=\"+Inf\"} " << stats.count
+                << "\n";
+            out << "troy_operation_duration_seconds_sum{" << labels.str() << "} "
+                << static_cast<double>(stats.total_nanoseconds) * 1e-9 << "\n";
+            out << "troy_operation_duration_seconds_count{" << labels.str() << "} " << stats.count << "\n";
+        }
+        for (size_t i = 0; i < counters.size(); i++)
+        {
+            const char *name = counterName(static_cast<Counter>(i));
+            out << "# TYPE troy_" << name << "_total counter\n"
+                << "troy_" << name << "_total " << counters[i] << "\n";
+        }
+        out << "# TYPE troy_rotations_total counter\n";
+        for (auto &entry : rotation_steps)
+        {
+            out << "troy_rotations_total{steps=\"" << entry.first << "\"} " << entry.second << "\n";
+        }
+        return out.str();
+    }
+
+    void Tracer::start(size_t max_events_per_thread, size_t max_events)
+    {
+        clear();
+        trace_capacity.store(max_events_per_thread, memory_order_relaxed);
+        trace_total_capacity.store(max_events, memory_order_relaxed);
+        trace_origin_nanoseconds.store(steadyNanoseconds(chrono::steady_clock::now()), memory_order_relaxed);
+        enabled_.store(true, memory_order_release);
+    }
+
+    void Tracer::stop() noexcept
+    {
+        enabled_.store(false, memory_order_release);
+    }
+
+    void Tracer::clear()
+    {
+        lock_guard<mutex> lock(trace_buffers_mutex);
+        for (auto buffer : trace_buffers)
+        {
+            lock_guard<mutex> buffer_lock(buffer->buffer_mutex);
+            buffer->events.clear();
+            buffer->dropped = 0;
+        }
+        retired_trace_events.clear();
+        retired_trace_events.shrink_to_fit();
+        retired_dropped = 0;
+        trace_event_count.store(0, memory_order_relaxed);
+    }
+
+    size_t Tracer::eventCount()
+    {
+        lock_guard<mutex> lock(trace_buffers_mutex);
+        size_t count = retired_trace_events.size();
+        for (auto buffer : trace_buffers)
+        {
+            lock_guard<mutex> buffer_lock(buffer->buffer_mutex);
+            count += buffer->events.size();
+        }
+        return count;
+    }
+
+    size_t Tracer::droppedEvents()
+    {
+        lock_guard<mutex> lock(trace_buffers_mutex);
+        size_t dropped = retired_dropped;
+        for (auto buffer : trace_buffers)
+        {
+            lock_guard<mutex> buffer_lock(buffer->buffer_mutex);
+            dropped += buffer->dropped;
+        }
+        return dropped;
+    }
+
+    size_t Tracer::bufferCount()
+    {
+        lock_guard<mutex> lock(trace_buffers_mutex);
+        return trace_buffers.size();
+    }
+
+    void Tracer::recordEvent(
+        Operation operation, size_t level, size_t size, chrono::steady_clock::time_point begin,
+        chrono::steady_clock::time_point end) noexcept
+    {
+        try
+        {
+            TraceBuffer *buffer = threadTraceBuffer();
+            int64_t begin_nanoseconds = steadyNanoseconds(begin);
+            lock_guard<mutex> lock(buffer->buffer_mutex);
+            if (buffer->events.size() >= trace_capacity.load(memory_order_relaxed))
+            {
+                buffer->dropped++;
+                return;
+            }
+            // Reserve a place under the global limit before storing, so the limit holds across threads.
+            if (trace_event_count.fetch_add(1, memory_order_relaxed) >= trace_total_capacity.load(memory_order_relaxed))
+            {
+                trace_event_count.fetch_sub(1, memory_order_relaxed);
+                buffer->dropped++;
+                return;
+            }
+            try
+            {
+                buffer->events.push_back(TraceEvent{ operation, level, size,
+                                                     begin_nanoseconds - trace_origin_nanoseconds.load(memory_order_relaxed),
+                                                     steadyNanoseconds(end) - begin_nanoseconds });
+            }
+            catch (...)
+            {
+                trace_event_count.fetch_sub(1, memory_order_relaxed);
+                throw;
+            }
+        }
+        catch (...)
+        {
+            // Tracing must never make an operation fail; an event that cannot be stored is lost.
+        }
+    }
+
+    namespace
+    {
+        void appendTraceEvent(ostringstream &out, uint64_t thread_id, const TraceEvent &event)
+        {
+            // Complete ("X") events carry the begin timestamp and the duration of a begin/end pair.
+            out << ",\n{\"name\":";
+            appendJsonString(out, operationName(event.operation));
+            out << ",\"cat\":\"troy\",\"ph\":\"X\",\"ts\":" << static_cast<double>(event.begin_nanoseconds) * 1e-3
+                << ",\"dur\":" << static_cast<double>(event.duration_nanoseconds) * 1e-3
+                << ",\"pid\":1,\"tid\":" << thread_id << ",\"args\":{\"level\":";
+            if (event.level == OperationStats::unknown_level)
+            {
+                out << "null";
+            }
+            else
+            {
+                out << event.level;
+            }
+            out << ",\"size\":" << event.size << "}}";
+        }
+    } // namespace
+
+    void Tracer::writeChromeTrace(ostream &stream)
+    {
+        ostringstream out;
+        out.setf(ios::fixed);
+        out.precision(3);
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        lock_guard<mutex> lock(trace_buffers_mutex);
+
+        // Name each thread once; an exited thread and a live one may share an id the OS reused.
+        set<uint64_t> thread_ids;
+        for (auto &retired : retired_trace_events)
+        {
+            thread_ids.insert(retired.thread_id);
+        }
+        for (auto buffer : trace_buffers)
+        {
+            lock_guard<mutex> buffer_lock(buffer->buffer_mutex);
+            if (!buffer->events.empty())
+            {
+                thread_ids.insert(buffer->thread_id);
+            }
+        }
+        bool first = true;
+        for (uint64_t thread_id : thread_ids)
+        {
+            out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+                << thread_id << ",\"args\":{\"name\":\"troy thread " << thread_id << "\"}}";
+            first = false;
+        }
+
+        for (auto &retired : retired_trace_events)
+        {
+            appendTraceEvent(out, retired.thread_id, retired.event);
+        }
+        for (auto buffer : trace_buffers)
+        {
+            lock_guard<mutex> buffer_lock(buffer->buffer_mutex);
+            for (auto &event : buffer->events)
+            {
+                appendTraceEvent(out, buffer->thread_id, event);
+            }
+        }
+        out << "\n]}\n";
+        stream << out.str();
+    }
+} // namespace troy
@@ -0,0 +1,399 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace troy
+{
+    /**
+    Operations whose latency is recorded by the built-in instrumentation. Every operation is recorded per
+    parameter level, i.e. per chain index of the parms_id it ran at.
+    */
+    enum class Operation : std::uint8_t
+    {
+        encrypt = 0,
+        decrypt,
+        encode,
+        decode,
+        negate,
+        add,
+        sub,
+        add_many,
+        multiply,
+        square,
+        relinearize,
+        mod_switch,
+        rescale,
+        add_plain,
+        sub_plain,
+        multiply_plain,
+        transform_to_ntt,
+        transform_from_ntt,
+        apply_galois,
+        rotate,
+        key_switch,
+        ntt,
+        inverse_ntt,
+        base_conversion,
+        operation_count
+    };
+
+    /**
+    Event counters maintained by the built-in instrumentation.
+    */
+    enum class Counter : std::uint8_t
+    {
+        // Number of single-limb forward negacyclic NTTs
+        ntt = 0,
+
+        // Number of single-limb inverse negacyclic NTTs
+        inverse_ntt,
+
+        // Number of ciphertext polynomials switched to another key
+        key_switch,
+
+        // Number of host array allocations
+        allocations,
+
+        // Number of bytes requested by host array allocations
+        bytes_allocated,
+
+        counter_count
+    };
+
+    /**
+    Latency statistics of one operation at one parameter level.
+    */
+    struct OperationStats
+    {
+        // Level reported for operations whose parms_id was not found in the context.
+        static constexpr std::size_t unknown_level = static_cast<std::size_t>(-1);
+
+        Operation operation;
+
+        // Chain index of the parameters the operation ran at, or unknown_level.
+        std::size_t level;
+
+        std::uint64_t count;
+
+        std::uint64_t total_nanoseconds;
+
+        std::uint64_t max_nanoseconds;
+
+        // histogram[i] is the number of calls that took less than 2^i but at least 2^(i-1) nanoseconds;
+        // the last bucket also holds everything slower.
+        std::vector<std::uint64_t> histogram;
+    };
+
+    /**
+    A consistent-enough copy of the instrumentation state, taken by Instrumentation::snapshot(). Counters are
+    read one at a time, so a snapshot taken while other threads are working may be off by the operations in
+    flight.
+    */
+    struct InstrumentationSnapshot
+    {
+        // Whether the library was built with TROY_INSTRUMENTATION. If not, the snapshot is always empty.
+        bool compiled_in = false;
+
+        // Statistics of every (operation, level) pair that was recorded at least once.
+        std::vector<OperationStats> operations;
+
+        // Values of the event counters, indexed by Counter.
+        std::vector<std::uint64_t> counters;
+
+        // Number of rotations per step. Row rotations are reported with their step and column rotations
+        // (and complex conjugation) as step 0.
+        std::map<int, std::uint64_t> rotation_steps;
+
+        /**
+        Returns the value of a counter.
+        */
+        std::uint64_t counter(Counter counter) const;
+
+        /**
+        Returns the number of times an operation was recorded, summed over all levels.
+        */
+        std::uint64_t count(Operation operation) const;
+
+        /**
+        Returns the statistics of an operation at a level, or nullptr if it was never recorded there.
+        */
+        const OperationStats *find(Operation operation, std::size_t level) const;
+
+        /**
+        Formats the snapshot as a JSON object.
+        */
+        std::string toJson() const;
+
+        /**
+        Formats the snapshot in the Prometheus text exposition format. Latencies are exported as histograms
+        in seconds, named troy_operation_duration_seconds and labelled by operation and level.
+        */
+        std::string toPrometheus() const;
+    };
+
+    /**
+    Returns the name of an operation as used in the JSON and Prometheus output, e.g. "relinearize".
+    */
+    const char *operationName(Operation operation);
+
+    /**
+    Returns the name of a counter as used in the JSON and Prometheus output, e.g. "bytes_allocated".
+    */
+    const char *counterName(Counter counter);
+
+    /**
+    Entry point of the built-in instrumentation. The hooks in Evaluator, Encryptor, Decryptor, the encoders,
+    the NTT, base conversion and the host allocator are only compiled when the library is built with TROY_INSTRUMENTATION
+    defined (the TROY_INSTRUMENTATION CMake option); otherwise they expand to nothing and snapshot() always
+    returns an empty snapshot. When compiled in, recording can additionally be paused at run time with
+    setEnabled(false), which reduces every hook to a relaxed atomic load.
+    */
+    class Instrumentation
+    {
+    public:
+        static constexpr std::size_t histogram_buckets = 40;
+
+        /**
+        Returns whether the library was built with TROY_INSTRUMENTATION.
+        */
+        static bool compiledIn() noexcept;
+
+        /**
+        Returns whether the hooks currently record anything.
+        */
+        static inline bool enabled() noexcept
+        {
+            return enabled_.load(std::memory_order_relaxed);
+        }
+
+        /**
+        Pauses or resumes recording. Recording is on by default when compiled in.
+        */
+        static void setEnabled(bool enabled) noexcept;
+
+        /**
+        Copies the current state.
+        */
+        static InstrumentationSnapshot snapshot();
+
+        /**
+        Zeroes all statistics and counters.
+        */
+        static void reset();
+
+        /**
+        Records calls of an operation that together took the given time; every call is accounted the mean.
+        */
+        static void recordOperation(
+            Operation operation, std::size_t level, std::uint64_t nanoseconds, std::uint64_t calls = 1) noexcept;
+
+        static inline void recordCount(Counter counter, std::uint64_t amount) noexcept
+        {
+            if (enabled())
+            {
+                counters_[static_cast<std::size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+            }
+        }
+
+        static void recordRotation(int steps, std::uint64_t count = 1);
+
+    private:
+        static std::atomic<bool> enabled_;
+
+        static std::atomic<std::uint64_t> counters_[static_cast<std::size_t>(Counter::counter_count)];
+    };
+
+    /**
+    Records a timeline of operations in the Chrome trace-event format, which chrome://tracing and Perfetto can
+    open. The tracer shares the hooks of Instrumentation, so it only sees anything when the library is built with
+    TROY_INSTRUMENTATION; every Evaluator operation, key switch, NTT batch and base conversion then becomes one
+    event with its thread, parameter level and size: the number of polynomials of the ciphertext, the number of
+    single-limb transforms of an NTT batch, or the number of coefficients of a base conversion. While tracing is
+    stopped a hook costs one relaxed atomic load.
+
+    Each thread appends to its own buffer, so tracing does not serialize the threads being traced. A thread's
+    buffer is freed when the thread exits and its events are kept with the rest of the trace, so the worker threads
+    that parallel operations start on every call do not accumulate buffers. Events carry the operating system's id
+    of the thread that recorded them.
+    */
+    class Tracer
+    {
+    public:
+        /**
+        Starts a new trace, discarding the events of the previous one. Every thread keeps at most
+        max_events_per_thread events and the trace at most max_events over all threads; later ones are dropped
+        and counted in droppedEvents().
+
+        @param[in] max_events_per_thread The capacity of each thread's buffer
+        @param[in] max_events The capacity of the whole trace
+        */
+        static void start(
+            std::size_t max_events_per_thread = std::size_t(1) << 20, std::size_t max_events = std::size_t(1) << 22);
+
+        /**
+        Stops recording. The events recorded so far are kept until the next start() or clear().
+        */
+        static void stop() noexcept;
+
+        /**
+        Returns whether events are being recorded.
+        */
+        static inline bool enabled() noexcept
+        {
+            return enabled_.load(std::memory_order_relaxed);
+        }
+
+        /**
+        Discards all recorded events.
+        */
+        static void clear();
+
+        /**
+        Returns the number of events recorded since the last start().
+        */
+        static std::size_t eventCount();
+
+        /**
+        Returns the number of events dropped because a thread's buffer or the trace was full.
+        */
+        static std::size_t droppedEvents();
+
+        /**
+        Returns the number of thread buffers currently allocated: one per live thread that recorded an event.
+        */
+        static std::size_t bufferCount();
+
+        /**
+        Writes the recorded events as a Chrome trace-event JSON object. Timestamps are in microseconds since
+        start(); each thread that recorded an event is named once in the metadata.
+
+        @param[out] stream The stream to write to
+        */
+        static void writeChromeTrace(std::ostream &stream);
+
+        static void recordEvent(
+            Operation operation, std::size_t level, std::size_t size, std::chrono::steady_clock::time_point begin,
+            std::chrono::steady_clock::time_point end) noexcept;
+
+    private:
+        static std::atomic<bool> enabled_;
+    };
+
+    /**
+    Records the latency of the enclosing scope as one call of an operation, or as several calls for a batched
+    operation, and adds it to the trace if the Tracer is running. Calls that leave the scope by an exception are
+    not recorded.
+    */
+    class OperationTimer
+    {
+    public:
+        OperationTimer(Operation operation, std::uint64_t calls = 1) noexcept
+            : operation_(operation), calls_(calls), record_(Instrumentation::enabled() && calls),
+              trace_(Tracer::enabled()), exceptions_(std::uncaught_exceptions())
+        {
+            if (record_ || trace_)
+            {
+                start_ = std::chrono::steady_clock::now();
+            }
+        }
+
+        OperationTimer(const OperationTimer &copy) = delete;
+
+        OperationTimer &operator=(const OperationTimer &assign) = delete;
+
+        ~OperationTimer()
+        {
+            if ((record_ || trace_) && std::uncaught_exceptions() == exceptions_)
+            {
+                auto end = std::chrono::steady_clock::now();
+                if (record_)
+                {
+                    Instrumentation::recordOperation(
+                        operation_, level_,
+                        static_cast<std::uint64_t>(
+                            std::chrono::duration_cast<std::chrono::nanoseconds>(end - start_).count()),
+                        calls_);
+                }
+                if (trace_)
+                {
+                    Tracer::recordEvent(operation_, level_, size_, start_, end);
+                }
+            }
+        }
+
+        inline bool active() const noexcept
+        {
+            return record_ || trace_;
+        }
+
+        inline void setLevel(std::size_t level) noexcept
+        {
+            level_ = level;
+        }
+
+        inline void setSize(std::size_t size) noexcept
+        {
+            size_ = size;
+        }
+
+    private:
+        Operation operation_;
+
+        std::uint64_t calls_;
+
+        bool record_;
+
+        bool trace_;
+
+        int exceptions_;
+
+        std::size_t level_ = OperationStats::unknown_level;
+
+        std::size_t size_ = 0;
+
+        std::chrono::steady_clock::time_point start_;
+    };
+} // namespace troy
+
+#ifdef TROY_INSTRUMENTATION
+// Times the rest of the enclosing scope as `calls` calls of Operation::op at the level of parms_id in context,
+// on operands of the given size.
+#define TROY_INSTRUMENT_SCOPE(op, context, parms_id, calls, size)                 \
+    ::troy::OperationTimer troy_operation_timer_(::troy::Operation::op, calls);   \
+    if (troy_operation_timer_.active())                                           \
+    {                                                                             \
+        auto troy_context_data_ = (context).getContextData(parms_id);             \
+        if (troy_context_data_)                                                   \
+        {                                                                         \
+            troy_operation_timer_.setLevel(troy_context_data_->chainIndex());     \
+        }                                                                         \
+        troy_operation_timer_.setSize(size);                                      \
+    }
+// Times the rest of the enclosing scope as Operation::op on data not tied to a parameter level.
+#define TROY_INSTRUMENT_KERNEL(op, size)                            \
+    ::troy::OperationTimer troy_operation_timer_(::troy::Operation::op); \
+    troy_operation_timer_.setSize(size)
+#define TROY_INSTRUMENT_OPERATIONS(op, context, parms_id, calls) TROY_INSTRUMENT_SCOPE(op, context, parms_id, calls, 0)
+#define TROY_INSTRUMENT_OPERATION(op, context, parms_id) TROY_INSTRUMENT_SCOPE(op, context, parms_id, 1, 0)
+#define TROY_INSTRUMENT_CIPHERTEXT(op, context, encrypted) \
+    TROY_INSTRUMENT_SCOPE(op, context, (encrypted).parmsID(), 1, (encrypted).size())
+#define TROY_INSTRUMENT_COUNT(counter, amount) \
+    ::troy::Instrumentation::recordCount(::troy::Counter::counter, static_cast<std::uint64_t>(amount))
+#define TROY_INSTRUMENT_ROTATION(steps, count) ::troy::Instrumentation::recordRotation(steps, count)
+#else
+#define TROY_INSTRUMENT_SCOPE(op, context, parms_id, calls, size)
+#define TROY_INSTRUMENT_KERNEL(op, size)
+#define TROY_INSTRUMENT_OPERATIONS(op, context, parms_id, calls)
+#define TROY_INSTRUMENT_OPERATION(op, context, parms_id)
+#define TROY_INSTRUMENT_CIPHERTEXT(op, context, encrypted)
+#define TROY_INSTRUMENT_COUNT(counter, amount)
+#define TROY_INSTRUMENT_ROTATION(steps, count)
+#endif
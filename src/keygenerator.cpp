@@ -33,6 +33,27 @@ namespace troy
         generateSk();
     }
 
+    KeyGenerator::KeyGenerator(const SEALContext &context, size_t secret_hamming_weight) : context_(context)
+    {
+        // Verify parameters
+        if (!context_.parametersSet())
+        {
+            throw invalid_argument("encryption parameters are not set correctly");
+        }
+        if (secret_hamming_weight == 0 ||
+            secret_hamming_weight > context_.keyContextData()->parms().polyModulusDegree())
+        {
+            throw invalid_argument("secret_hamming_weight is out of range");
+        }
+        secret_hamming_weight_ = secret_hamming_weight;
+
+        // Secret key has not been generated
+        sk_generated_ = false;
+
+        // Generate the secret and public key
+        generateSk();
+    }
+
     KeyGenerator::KeyGenerator(const SEALContext &context, const SecretKey &secret_key) : context_(context)
     {
         // Verify parameters
@@ -71,7 +92,15 @@ namespace troy
 
             // Generate secret key
             HostPointer secret_key(secret_key_.data().data());
-            samplePolyTernary(parms.randomGenerator()->create(), parms, secret_key.get());
+            if (secret_hamming_weight_)
+            {
+                samplePolyTernarySparse(
+                    parms.randomGenerator()->create(), parms, secret_hamming_weight_, secret_key.get());
+            }
+            else
+            {
+                samplePolyTernary(parms.randomGenerator()->create(), parms, secret_key.get());
+            }
 
             // Transform the secret s into NTT representation.
             auto ntt_tables = context_data.smallNTTTables();
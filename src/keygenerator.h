@@ -35,6 +35,22 @@ namespace troy
         */
         KeyGenerator(const SEALContext &context);
 
+        /**
+        Creates a KeyGenerator initialized with the specified SEALContext whose
+        secret key is sparse: exactly secret_hamming_weight of its coefficients
+        are nonzero, each 1 or -1. A sparse secret keeps the multiple of q_0 that
+        CKKS bootstrapping has to remove small (see CKKSBootstrapper), at the cost
+        of security; choose the weight together with the ring dimension and
+        modulus accordingly.
+
+        @param[in] context The SEALContext
+        @param[in] secret_hamming_weight The number of nonzero secret key coefficients
+        @throws std::invalid_argument if the encryption parameters are not valid
+        @throws std::invalid_argument if secret_hamming_weight is zero or larger
+        than the polynomial modulus degree
+        */
+        KeyGenerator(const SEALContext &context, std::size_t secret_hamming_weight);
+
         /**
         Creates an KeyGenerator instance initialized with the specified SEALContext
         and specified previously secret key. This can e.g. be used to increase
@@ -383,5 +399,8 @@ namespace troy
 
 
         bool sk_generated_ = false;
+
+        // Number of nonzero coefficients of a generated secret key, or 0 for a uniform ternary one.
+        std::size_t secret_hamming_weight_ = 0;
     };
 } // namespace seal
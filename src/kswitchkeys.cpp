@@ -2,6 +2,8 @@
 // Licensed under the MIT license.
 
 #include "kswitchkeys.h"
+#include "utils/common.h"
+#include <algorithm>
 #include <stdexcept>
 
 using namespace std;
@@ -17,8 +19,9 @@ namespace troy
             return *this;
         }
 
-        // Copy over fields
+        // Copy over fields; the packed copies are immutable and can be shared
         parms_id_ = assign.parms_id_;
+        packed_ = assign.packed_;
 
         // Then copy over keys
         keys_.clear();
@@ -39,6 +42,51 @@ namespace troy
         return *this;
     }
 
+    void KSwitchKeys::pack()
+    {
+        vector<shared_ptr<const HostArray<uint64_t>>> new_packed(keys_.size());
+        for (size_t index = 0; index < keys_.size(); index++)
+        {
+            auto &key_vector = keys_[index];
+            if (key_vector.empty())
+            {
+                continue;
+            }
+            size_t digit_count = key_vector.size();
+            auto &first = key_vector[0].data();
+            size_t component_count = first.size();
+            size_t limb_count = first.coeffModulusSize();
+            size_t coeff_count = first.polyModulusDegree();
+            for (auto &key : key_vector)
+            {
+                auto &key_data = key.data();
+                if (key_data.size() != component_count || key_data.coeffModulusSize() != limb_count ||
+                    key_data.polyModulusDegree() != coeff_count)
+                {
+                    throw invalid_argument("keyswitching keys have inconsistent shapes");
+                }
+            }
+
+            auto packed = HostArray<uint64_t>(
+                mul_safe(mul_safe(limb_count, digit_count), mul_safe(component_count, coeff_count)));
+            uint64_t *destination = packed.get();
+            for (size_t limb = 0; limb < limb_count; limb++)
+            {
+                for (size_t j = 0; j < digit_count; j++)
+                {
+                    for (size_t k = 0; k < component_count; k++)
+                    {
+                        const uint64_t *source = key_vector[j].data().data(k) + limb * coeff_count;
+                        copy_n(source, coeff_count, destination);
+                        destination += coeff_count;
+                    }
+                }
+            }
+            new_packed[index] = make_shared<const HostArray<uint64_t>>(std::move(packed));
+        }
+        packed_ = std::move(new_packed);
+    }
+
     // void KSwitchKeys::save_members(ostream &stream) const
     // {
     //     auto old_except_mask = stream.exceptions();
@@ -7,6 +7,7 @@
 #include "publickey.h"
 #include "valcheck.h"
 #include <iostream>
+#include <memory>
 #include <vector>
 
 namespace troy
@@ -83,10 +84,12 @@ namespace troy
         }
 
         /**
-        Returns a reference to the KSwitchKeys data.
+        Returns a reference to the KSwitchKeys data. Since the keys may be modified through
+        the returned reference, this drops the packed layout (see pack()).
         */
         inline auto &data() noexcept
         {
+            packed_.clear();
             return keys_;
         }
 
@@ -103,6 +106,7 @@ namespace troy
 
         @param[in] index The index of the keyswitching key
         @throws std::invalid_argument if the key at the given index does not exist
+        @see data() for how this affects the packed layout.
         */
         inline auto &data(std::size_t index)
         {
@@ -110,6 +114,7 @@ namespace troy
             {
                 throw std::invalid_argument("keyswitching key does not exist");
             }
+            packed_.clear();
             return keys_[index];
         }
 
@@ -128,6 +133,39 @@ namespace troy
             return keys_[index];
         }
 
+        /**
+        Additionally stores every keyswitching key in one contiguous buffer, ordered
+        [RNS limb][digit][component][coefficient]. This is the order in which the key switching
+        inner product reads the key, so with a packed key it streams through a single buffer
+        instead of striding across one allocation per digit. The per-digit PublicKey data is
+        kept, so packing roughly doubles the memory held by the keys. The packed copy is shared
+        between copies of this KSwitchKeys and is dropped by any non-const data() access.
+
+        @throws std::invalid_argument if the keys of one index do not all have the same shape
+        */
+        void pack();
+
+        /**
+        Returns whether the keyswitching key at a given index has a packed copy.
+
+        @param[in] index The index of the keyswitching key
+        */
+        inline bool isPacked(std::size_t index) const noexcept
+        {
+            return index < packed_.size() && packed_[index] != nullptr;
+        }
+
+        /**
+        Returns the packed copy of the keyswitching key at a given index, laid out as described
+        in pack(), or a null pointer if the key has not been packed.
+
+        @param[in] index The index of the keyswitching key
+        */
+        inline const std::uint64_t *packedData(std::size_t index) const noexcept
+        {
+            return isPacked(index) ? packed_[index]->get() : nullptr;
+        }
+
         /**
         Returns a reference to parms_id.
 
@@ -327,5 +365,10 @@ namespace troy
         The vector of keyswitching keys.
         */
         std::vector<std::vector<PublicKey>> keys_{};
+
+        /**
+        Packed copies of keys_, indexed like keys_; empty entries are unpacked.
+        */
+        std::vector<std::shared_ptr<const util::HostArray<std::uint64_t>>> packed_{};
     };
 } // namespace seal
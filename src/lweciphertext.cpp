@@ -0,0 +1,71 @@
+#include "lweciphertext.h"
+#include "serialize.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+namespace troy
+{
+    void LWECiphertext::resize(const SEALContext &context, ParmsID parms_id)
+    {
+        auto context_data_ptr = context.getContextData(parms_id);
+        if (!context_data_ptr)
+        {
+            throw invalid_argument("parms_id is not valid for encryption parameters");
+        }
+        auto &parms = context_data_ptr->parms();
+        parms_id_ = parms_id;
+        poly_modulus_degree_ = parms.polyModulusDegree();
+        coeff_modulus_size_ = parms.coeffModulus().size();
+        c0_.assign(coeff_modulus_size_, 0);
+        c1_.assign(poly_modulus_degree_ * coeff_modulus_size_, 0);
+    }
+
+    void LWECiphertext::assemble(const SEALContext &context, Ciphertext &destination) const
+    {
+        auto context_data_ptr = context.getContextData(parms_id_);
+        if (!context_data_ptr || context_data_ptr->parms().polyModulusDegree() != poly_modulus_degree_ ||
+            context_data_ptr->parms().coeffModulus().size() != coeff_modulus_size_ ||
+            c0_.size() != coeff_modulus_size_ || c1_.size() != poly_modulus_degree_ * coeff_modulus_size_)
+        {
+            throw invalid_argument("LWE ciphertext is not valid for encryption parameters");
+        }
+
+        destination.resize(context, parms_id_, 2);
+        destination.isNttForm() = false;
+        destination.scale() = scale_;
+        destination.correctionFactor() = correction_factor_;
+        uint64_t *c0 = destination.data(0);
+        fill_n(c0, poly_modulus_degree_ * coeff_modulus_size_, 0);
+        for (size_t j = 0; j < coeff_modulus_size_; j++)
+        {
+            c0[j * poly_modulus_degree_] = c0_[j];
+        }
+        copy(c1_.begin(), c1_.end(), destination.data(1));
+    }
+
+    void LWECiphertext::save(ostream &stream) const
+    {
+        savet(stream, &parms_id_);
+        savet(stream, &poly_modulus_degree_);
+        savet(stream, &coeff_modulus_size_);
+        savet(stream, &scale_);
+        savet(stream, &correction_factor_);
+        stream.write(reinterpret_cast<const char *>(c0_.data()), sizeof(uint64_t) * c0_.size());
+        stream.write(reinterpret_cast<const char *>(c1_.data()), sizeof(uint64_t) * c1_.size());
+    }
+
+    void LWECiphertext::load(istream &stream)
+    {
+        loadt(stream, &parms_id_);
+        loadt(stream, &poly_modulus_degree_);
+        loadt(stream, &coeff_modulus_size_);
+        loadt(stream, &scale_);
+        loadt(stream, &correction_factor_);
+        c0_.resize(coeff_modulus_size_);
+        c1_.resize(poly_modulus_degree_ * coeff_modulus_size_);
+        stream.read(reinterpret_cast<char *>(c0_.data()), sizeof(uint64_t) * c0_.size());
+        stream.read(reinterpret_cast<char *>(c1_.data()), sizeof(uint64_t) * c1_.size());
+    }
+} // namespace troy
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "ciphertext.h"
+#include "context.h"
+#include "encryptionparams.h"
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+namespace troy
+{
+    /**
+    Class to store an LWE ciphertext: one plaintext coefficient of an RLWE ciphertext, encrypted as (b, a) with
+    b + <a, s> equal to what that coefficient decrypts to before decoding, where s is the coefficient vector of the
+    secret key. It is kept in the form Evaluator::extractLWE produces, which is also the form ring packing consumes:
+    a is stored as a polynomial c_1 and b as a constant c_0, such that c_0 + c_1 * s has the coefficient at degree 0.
+    Both are in RNS form with respect to the coefficient modulus at parmsID(), so a sample takes (N + 1) * K words
+    for N the ring degree and K the number of primes left; switch it down the modulus chain with
+    Evaluator::modSwitchToNextInplace to shrink it.
+
+    @par Thread Safety
+    In general, reading from an LWECiphertext is thread-safe as long as no other thread is concurrently mutating it.
+    */
+    class LWECiphertext
+    {
+    public:
+        /**
+        Constructs an empty LWE ciphertext allocating no memory.
+        */
+        LWECiphertext() = default;
+
+        /**
+        Allocates a zero LWE ciphertext for the given level of the SEALContext.
+
+        @param[in] context The SEALContext
+        @param[in] parms_id The parms_id of the level
+        @throws std::invalid_argument if parms_id is not valid for the encryption parameters
+        */
+        void resize(const SEALContext &context, ParmsID parms_id);
+
+        /**
+        Writes the RLWE ciphertext (c_0, c_1) to destination, whose coefficient at degree 0 decrypts to the extracted
+        one and whose other coefficients decrypt to garbage. The result is in coefficient form; CKKS ciphertexts have to
+        be transformed to NTT form (Evaluator::transformToNttInplace) before they can be decrypted.
+
+        @param[in] context The SEALContext
+        @param[out] destination The ciphertext to overwrite
+        @throws std::invalid_argument if the LWE ciphertext is not valid for the encryption parameters
+        */
+        void assemble(const SEALContext &context, Ciphertext &destination) const;
+
+        /**
+        Returns a pointer to c_0, one word per prime.
+        */
+        inline std::uint64_t *c0() noexcept
+        {
+            return c0_.data();
+        }
+
+        /**
+        Returns a const pointer to c_0, one word per prime.
+        */
+        inline const std::uint64_t *c0() const noexcept
+        {
+            return c0_.data();
+        }
+
+        /**
+        Returns a pointer to c_1, one polynomial of polyModulusDegree() coefficients per prime.
+        */
+        inline std::uint64_t *c1() noexcept
+        {
+            return c1_.data();
+        }
+
+        /**
+        Returns a const pointer to c_1, one polynomial of polyModulusDegree() coefficients per prime.
+        */
+        inline const std::uint64_t *c1() const noexcept
+        {
+            return c1_.data();
+        }
+
+        /**
+        Returns the degree of the ring the sample was extracted from, which is its LWE dimension.
+        */
+        inline std::size_t polyModulusDegree() const noexcept
+        {
+            return poly_modulus_degree_;
+        }
+
+        /**
+        Returns the number of primes in the coefficient modulus of the sample's level.
+        */
+        inline std::size_t coeffModulusSize() const noexcept
+        {
+            return coeff_modulus_size_;
+        }
+
+        /**
+        Returns a reference to parms_id.
+        */
+        inline ParmsID &parmsID() noexcept
+        {
+            return parms_id_;
+        }
+
+        /**
+        Returns a const reference to parms_id.
+        */
+        inline const ParmsID &parmsID() const noexcept
+        {
+            return parms_id_;
+        }
+
+        /**
+        Returns a reference to the scale, inherited from the source ciphertext. Only used by CKKS.
+        */
+        inline double &scale() noexcept
+        {
+            return scale_;
+        }
+
+        /**
+        Returns a constant reference to the scale. Only used by CKKS.
+        */
+        inline const double &scale() const noexcept
+        {
+            return scale_;
+        }
+
+        /**
+        Returns a reference to the correction factor, inherited from the source ciphertext. Only used by BGV.
+        */
+        inline std::uint64_t &correctionFactor() noexcept
+        {
+            return correction_factor_;
+        }
+
+        /**
+        Returns a constant reference to the correction factor. Only used by BGV.
+        */
+        inline const std::uint64_t &correctionFactor() const noexcept
+        {
+            return correction_factor_;
+        }
+
+        void save(std::ostream &stream) const;
+
+        void load(std::istream &stream);
+
+    private:
+        ParmsID parms_id_ = parmsIDZero;
+
+        std::size_t poly_modulus_degree_ = 0;
+
+        std::size_t coeff_modulus_size_ = 0;
+
+        double scale_ = 1.0;
+
+        std::uint64_t correction_factor_ = 1;
+
+        std::vector<std::uint64_t> c0_;
+
+        std::vector<std::uint64_t> c1_;
+    };
+} // namespace troy
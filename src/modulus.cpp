@@ -13,6 +13,11 @@ using std::accumulate;
 namespace troy {
 
     void Modulus::setValue(uint64_t value) {
+        setValue(value, false);
+        if (value != 0) is_prime_ = util::isPrime(*this);
+    }
+
+    void Modulus::setValue(uint64_t value, bool is_prime) {
         if (value == 0) {            
             // Zero settings
             bit_count_ = 0;
@@ -36,8 +41,7 @@ namespace troy {
             // We store also the remainder
             const_ratio_[2] = numerator[0];
             uint64_count_ = 1;
-            // Set the primality flag
-            is_prime_ = util::isPrime(*this);
+            is_prime_ = is_prime;
         }
     }
 
@@ -25,6 +25,8 @@ namespace troy {
 
         void setValue(uint64_t value);
 
+        void setValue(uint64_t value, bool is_prime);
+
     public:
         
 
@@ -41,6 +43,23 @@ namespace troy {
             setValue(value);
         }
 
+        /**
+        Creates a Modulus whose primality is already known to the caller (e.g. a
+        prime returned by util::getPrimes or read back from a trusted table), so
+        the Miller-Rabin test the regular constructor runs is skipped. Passing a
+        wrong is_prime breaks every NTT built on the modulus.
+
+        @param[in] value The integer modulus
+        @param[in] is_prime Whether value is prime
+        @throws std::invalid_argument if value is 1 or more than 61 bits
+        */
+        static inline Modulus Trusted(std::uint64_t value, bool is_prime = true)
+        {
+            Modulus ret;
+            ret.setValue(value, is_prime);
+            return ret;
+        }
+
         /**
         Creates a new Modulus by copying a given one.
 
@@ -2,6 +2,7 @@
 // Licensed under the MIT license.
 
 #include "plaintext.h"
+#include "serialize.h"
 #include "utils/common.h"
 
 using namespace std;
@@ -201,6 +202,25 @@ namespace troy
         return *this;
     }
 
+    void Plaintext::save(std::ostream& stream) const {
+        savet(stream, &parms_id_);
+        savet(stream, &coeff_count_);
+        savet(stream, &scale_);
+        size_t dataSize = data_.size();
+        savet(stream, &dataSize);
+        stream.write(reinterpret_cast<const char*>(data_.cbegin()), sizeof(pt_coeff_type) * dataSize);
+    }
+
+    void Plaintext::load(std::istream& stream) {
+        loadt(stream, &parms_id_);
+        loadt(stream, &coeff_count_);
+        loadt(stream, &scale_);
+        size_t dataSize;
+        loadt(stream, &dataSize);
+        data_.resize(dataSize);
+        stream.read(reinterpret_cast<char*>(data_.begin()), sizeof(pt_coeff_type) * dataSize);
+    }
+
     // void Plaintext::save_members(ostream &stream) const
     // {
     //     auto old_except_mask = stream.exceptions();
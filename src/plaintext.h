@@ -12,6 +12,7 @@
 #include "utils/polycore.h"
 #include <algorithm>
 #include <functional>
+#include <iostream>
 #include <stdexcept>
 #include <string>
 
@@ -701,6 +702,9 @@ namespace troy
         */
         struct PlaintextPrivateHelper;
 
+        void save(std::ostream& stream) const;
+        void load(std::istream& stream);
+
     private:
         // void save_members(std::ostream &stream) const;
 
@@ -717,4 +721,42 @@ namespace troy
         // SecretKey needs access to save_members/load_members
         friend class SecretKey;
     };
+
+    /**
+    A BFV plaintext m already scaled to round(q/t * m) and reduced modulo every prime of the coefficient modulus at
+    some parms_id. Produced by Evaluator::scalePlain. Adding it to a ciphertext or encrypting it is then a plain
+    coefficient-wise modular addition, which pays off when the same plaintext (e.g. a bias) is added many times.
+    */
+    class ScaledPlaintext
+    {
+        friend class Evaluator;
+        friend class Encryptor;
+
+    public:
+        ScaledPlaintext() = default;
+
+        /**
+        Returns the parms_id at which the plaintext was scaled.
+        */
+        inline const ParmsID &parmsID() const noexcept
+        {
+            return parms_id_;
+        }
+
+        /**
+        Returns the number of coefficients of the source plaintext.
+        */
+        inline std::size_t coeffCount() const noexcept
+        {
+            return coeff_count_;
+        }
+
+    private:
+        ParmsID parms_id_ = parmsIDZero;
+
+        std::size_t coeff_count_ = 0;
+
+        // coeff_count_ residues for each prime of the coefficient modulus at parms_id_.
+        util::HostDynamicArray<std::uint64_t> data_;
+    };
 } // namespace seal
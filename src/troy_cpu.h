@@ -1,13 +1,17 @@
 #pragma once
 
+#include "aggregator.h"
 #include "batchencoder.h"
+#include "bootstrapper.h"
 #include "ckks.h"
 #include "context.h"
 #include "decryptor.h"
 #include "encryptor.h"
 #include "evaluator.h"
 #include "galoiskeys.h"
+#include "instrumentation.h"
 #include "keygenerator.h"
+#include "lweciphertext.h"
 #include "modulus.h"
 #include "plaintext.h"
 #include "publickey.h"
@@ -17,13 +17,6 @@ namespace troy
 
         void GaloisTool::generateTableNtt(uint32_t galois_elt, HostArray<uint32_t> &result) const
         {
-            // ReaderLock reader_lock(permutation_tables_locker_.acquire_read());
-            // if (result)
-            // {
-            //     return;
-            // }
-            // reader_lock.unlock();
-
             auto temp = HostArray<uint32_t>(coeff_count_);
             auto temp_ptr = temp.get();
 
@@ -36,12 +29,6 @@ namespace troy
                 *temp_ptr++ = reverseBits(static_cast<uint32_t>(index_raw), coeff_count_power_);
             }
 
-            // WriterLock writer_lock(permutation_tables_locker_.acquire_write());
-            // if (result)
-            // {
-            //     return;
-            // }
-            // result.acquire(move(temp));
             result = move(temp);
         }
 
@@ -125,6 +112,20 @@ namespace troy
             return galois_elts;
         }
 
+        vector<uint32_t> GaloisTool::getEltsForExpansion(size_t count) const
+        {
+            if (count == 0 || count > coeff_count_)
+            {
+                throw invalid_argument("count is out of range");
+            }
+            vector<uint32_t> galois_elts{};
+            for (size_t half = 1; half < count; half <<= 1)
+            {
+                galois_elts.push_back(static_cast<uint32_t>(coeff_count_ / half + 1));
+            }
+            return galois_elts;
+        }
+
         void GaloisTool::initialize(int coeff_count_power)
         {
             if ((coeff_count_power < getPowerOfTwo(SEAL_POLY_MOD_DEGREE_MIN)) ||
@@ -140,37 +141,79 @@ namespace troy
             permutation_tables_ = HostArray<HostArray<uint32_t>>(coeff_count_);
         }
 
+        const uint32_t *GaloisTool::permutationTableNtt(uint32_t galois_elt) const
+        {
+            auto index = GetIndexFromElt(galois_elt);
+            lock_guard<mutex> lock(permutation_tables_mutex_);
+            if (!permutation_tables_[index].size())
+            {
+                generateTableNtt(galois_elt, permutation_tables_[index]);
+            }
+            // Tables are never replaced once generated, so the pointer stays valid without the lock.
+            return permutation_tables_[index].get();
+        }
+
         void GaloisTool::applyGalois(
             ConstHostPointer<uint64_t> operand, uint32_t galois_elt, const Modulus &modulus, HostPointer<uint64_t> result) const
         {
             const uint64_t modulus_value = modulus.value();
             const uint64_t coeff_count_minus_one = coeff_count_ - 1;
+            // Consecutive coefficients are stored galois_elt apart, which defeats the hardware prefetcher on
+            // the destination; request the line a few coefficients ahead instead.
+            const uint64_t prefetch_distance = uint64_t(16) * galois_elt;
+            const uint64_t *source = operand.get();
+            uint64_t *destination = result.get();
             uint64_t index_raw = 0;
-            for (uint64_t i = 0; i <= coeff_count_minus_one; i++, ++operand, index_raw += galois_elt)
+            for (uint64_t i = 0; i <= coeff_count_minus_one; i++, index_raw += galois_elt)
             {
-                uint64_t index = index_raw & coeff_count_minus_one;
-                uint64_t result_value = *operand;
-                if ((index_raw >> coeff_count_power_) & 1)
-                {
-                    // Explicit inline
-                    // result[index] = negate_uint_mod(result[index], modulus);
-                    int64_t non_zero = (result_value != 0);
-                    result_value = (modulus_value - result_value) & static_cast<uint64_t>(-non_zero);
-                }
-                result[index] = result_value;
+                __builtin_prefetch(destination + ((index_raw + prefetch_distance) & coeff_count_minus_one), 1);
+                uint64_t result_value = source[i];
+                // Negate when X^i wraps around to -X^index, without a branch: x ^ ((x ^ -x) & mask).
+                uint64_t sign_mask = static_cast<uint64_t>(-static_cast<int64_t>((index_raw >> coeff_count_power_) & 1));
+                uint64_t negated = (modulus_value - result_value) & static_cast<uint64_t>(-static_cast<int64_t>(result_value != 0));
+                destination[index_raw & coeff_count_minus_one] = result_value ^ ((result_value ^ negated) & sign_mask);
             }
         }
 
-        void GaloisTool::applyGaloisNtt(ConstHostPointer<uint64_t> operand, uint32_t galois_elt, HostPointer<uint64_t> result) const
+        void GaloisTool::applyGalois(
+            ConstHostPointer<uint64_t> operand, size_t coeff_modulus_size, uint32_t galois_elt, const Modulus *modulus,
+            HostPointer<uint64_t> result) const
         {
-            auto index = GetIndexFromElt(galois_elt);
-            generateTableNtt(galois_elt, permutation_tables_[index]);
-
-            HostArray<uint32_t>& table = permutation_tables_[index];
+            // Limb by limb: a limb of 2^16 coefficients stays in L2 while it is scattered, interleaving the limbs
+            // per coefficient does not.
+            for (size_t i = 0; i < coeff_modulus_size; i++)
+            {
+                applyGalois(operand + i * coeff_count_, galois_elt, modulus[i], result + i * coeff_count_);
+            }
+        }
 
-            // Perform permutation.
-            for (size_t i = 0; i < coeff_count_; i++) {
-                result[i] = operand[table[i]];
+        void GaloisTool::applyGaloisNtt(
+            ConstHostPointer<uint64_t> operand, size_t coeff_modulus_size, uint32_t galois_elt, HostPointer<uint64_t> result) const
+        {
+            const uint32_t *table = permutationTableNtt(galois_elt);
+            const size_t coeff_count_minus_one = coeff_count_ - 1;
+            constexpr size_t block = 8;
+            constexpr size_t prefetch_distance = 8 * block;
+            for (size_t j = 0; j < coeff_modulus_size; j++)
+            {
+                const uint64_t *source = operand.get() + j * coeff_count_;
+                uint64_t *destination = result.get() + j * coeff_count_;
+                if (coeff_count_ < block)
+                {
+                    for (size_t i = 0; i < coeff_count_; i++)
+                    {
+                        destination[i] = source[table[i]];
+                    }
+                    continue;
+                }
+                for (size_t i = 0; i < coeff_count_; i += block)
+                {
+                    __builtin_prefetch(source + table[(i + prefetch_distance) & coeff_count_minus_one]);
+                    for (size_t k = 0; k < block; k++)
+                    {
+                        destination[i + k] = source[table[i + k]];
+                    }
+                }
             }
         }
     } // namespace util
@@ -7,6 +7,7 @@
 #include "defines.h"
 #include <cstddef>
 #include <cstdint>
+#include <mutex>
 #include <stdexcept>
 
 namespace troy
@@ -24,14 +25,12 @@ namespace troy
             void applyGalois(
                 ConstHostPointer<uint64_t> operand, std::uint32_t galois_elt, const Modulus &modulus, HostPointer<uint64_t> result) const;
 
-            inline void applyGalois(
+            /**
+            Applies the automorphism to coeff_modulus_size consecutive limbs, one modulus per limb.
+            */
+            void applyGalois(
                 ConstHostPointer<uint64_t> operand, std::size_t coeff_modulus_size, std::uint32_t galois_elt,
-                const Modulus* modulus, HostPointer<uint64_t> result) const
-            {
-                for (size_t i = 0; i < coeff_modulus_size; i++) {
-                    this->applyGalois(operand + i * coeff_count_, galois_elt, modulus[i], result + i * coeff_count_);
-                }
-            }
+                const Modulus* modulus, HostPointer<uint64_t> result) const;
 
             void applyGalois(
                 ConstHostPointer<uint64_t> operand, std::size_t poly_size, std::size_t coeff_modulus_size, std::uint32_t galois_elt, const Modulus* modulus,
@@ -43,23 +42,24 @@ namespace troy
                 }
             }
 
-            void applyGaloisNtt(ConstHostPointer<uint64_t> operand, std::uint32_t galois_elt, HostPointer<uint64_t> result) const;
-
-            void applyGaloisNtt(
-                ConstHostPointer<uint64_t> operand, std::size_t coeff_modulus_size, std::uint32_t galois_elt, HostPointer<uint64_t> result) const
+            void applyGaloisNtt(ConstHostPointer<uint64_t> operand, std::uint32_t galois_elt, HostPointer<uint64_t> result) const
             {
-                for (size_t i = 0; i < coeff_modulus_size; i++) {
-                    this->applyGaloisNtt(operand + i * coeff_count_, galois_elt, result + i * coeff_count_);
-                }
+                applyGaloisNtt(operand, 1, galois_elt, result);
             }
 
+            /**
+            Permutes coeff_modulus_size consecutive limbs in NTT form. The permutation does not depend on the modulus,
+            so all limbs share one table, which is generated on first use of galois_elt and cached. In bit-reversed
+            order the automorphism maps every aligned block of 8 outputs to an aligned block of 8 inputs (the low
+            bits of the index only permute within the block), so one prefetch per block covers the gathers.
+            */
+            void applyGaloisNtt(
+                ConstHostPointer<uint64_t> operand, std::size_t coeff_modulus_size, std::uint32_t galois_elt, HostPointer<uint64_t> result) const;
+
             void applyGaloisNtt(
                 ConstHostPointer<uint64_t> operand, std::size_t poly_size, std::size_t coeff_modulus_size, std::uint32_t galois_elt, HostPointer<uint64_t> result) const
             {
-                size_t d = coeff_modulus_size * coeff_count_;
-                for (size_t i = 0; i < poly_size; i++) {
-                    this->applyGaloisNtt(operand + i * d, coeff_modulus_size, galois_elt, result + i * d);
-                }
+                applyGaloisNtt(operand, poly_size * coeff_modulus_size, galois_elt, result);
             }
 
             /**
@@ -77,6 +77,12 @@ namespace troy
             */
             std::vector<std::uint32_t> getEltsAll() const noexcept;
 
+            /**
+            Compute the Galois elements X -> X^(N / 2^j + 1), for 2^j less than count, that expanding a query into
+            count ciphertexts needs (see Evaluator::expandQuery).
+            */
+            std::vector<std::uint32_t> getEltsForExpansion(std::size_t count) const;
+
             /**
             Compute the index in the range of 0 to (coeff_count_ - 1) of a given Galois element.
             */
@@ -104,6 +110,8 @@ namespace troy
 
             void generateTableNtt(std::uint32_t galois_elt, HostArray<std::uint32_t> &result) const;
 
+            const std::uint32_t *permutationTableNtt(std::uint32_t galois_elt) const;
+
             int coeff_count_power_ = 0;
 
             std::size_t coeff_count_ = 0;
@@ -112,7 +120,7 @@ namespace troy
 
             mutable HostArray<HostArray<std::uint32_t>> permutation_tables_;
 
-            // mutable util::ReaderWriterLocker permutation_tables_locker_;
+            mutable std::mutex permutation_tables_mutex_;
         };
     } // namespace util
 } // namespace seal
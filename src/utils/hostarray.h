@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../instrumentation.h"
 #include <vector>
 #include <exception>
 #include <cstring>
@@ -99,6 +100,8 @@ public:
         if (cnt > 0) {
             data = new T[cnt];
             memset(data, 0, sizeof(T) * cnt);
+            TROY_INSTRUMENT_COUNT(allocations, 1);
+            TROY_INSTRUMENT_COUNT(bytes_allocated, sizeof(T) * cnt);
         }
         else data = nullptr;
         len = cnt;
@@ -112,12 +115,16 @@ public:
         data = new T[cnt];
         for (std::size_t i=0; i<cnt; i++) data[i] = copyfrom[i];
         len = cnt;
+        TROY_INSTRUMENT_COUNT(allocations, 1);
+        TROY_INSTRUMENT_COUNT(bytes_allocated, sizeof(T) * cnt);
     }
 
     HostArray(const std::vector<T>& a) {
         len = a.size();
         data = new T[len];
         for (std::size_t i=0; i<len; i++) data[i] = a[i];
+        TROY_INSTRUMENT_COUNT(allocations, 1);
+        TROY_INSTRUMENT_COUNT(bytes_allocated, sizeof(T) * len);
     }
     HostArray(HostArray&& arr) {
         data = arr.data; 
@@ -204,6 +211,7 @@ public:
     HostDynamicArray(HostDynamicArray<T>&& move) {
         size_ = move.size();
         internal = std::move(move.internal);
+        move.size_ = 0;
     }
 
     HostDynamicArray& operator = (const HostDynamicArray& copy) {
@@ -219,6 +227,7 @@ public:
     HostDynamicArray& operator = (HostDynamicArray<T>&& move) {
         size_ = move.size();
         internal = std::move(move.internal);
+        move.size_ = 0;
         return *this;
     }
     
@@ -1,14 +1,41 @@
 
 #include "ntt.h"
+#include "../instrumentation.h"
+#include "nttkernels.h"
 #include "uintarith.h"
 #include "uintarithsmallmod.h"
+#include "../serialize.h"
 #include <algorithm>
 
 using std::invalid_argument;
 
 namespace troy {
     namespace util {
-        
+
+        namespace
+        {
+            struct NTTKernelEntry
+            {
+                NTTTables::ForwardKernel forward;
+
+                NTTTables::InverseKernel inverse;
+            };
+
+            // Specialized kernels for the ring dimensions used in practice, indexed by
+            // coeff_count_power - ntt_kernel_min_power.
+            constexpr int ntt_kernel_min_power = 12;
+
+            constexpr NTTKernelEntry ntt_kernel_table[] = {
+                { &nttkernels::forwardLazy<12>, &nttkernels::inverseLazy<12> },
+                { &nttkernels::forwardLazy<13>, &nttkernels::inverseLazy<13> },
+                { &nttkernels::forwardLazy<14>, &nttkernels::inverseLazy<14> },
+                { &nttkernels::forwardLazy<15>, &nttkernels::inverseLazy<15> },
+                { &nttkernels::forwardLazy<16>, &nttkernels::inverseLazy<16> },
+            };
+
+            constexpr int ntt_kernel_count = static_cast<int>(sizeof(ntt_kernel_table) / sizeof(NTTKernelEntry));
+        } // namespace
+
         NTTTables::NTTTables(int coeff_count_power, const Modulus &modulus)
         {
             initialize(coeff_count_power, modulus);
@@ -31,27 +58,29 @@ namespace troy {
 
             // Populate tables with powers of root in specific orders.
             // FIXME: allocate related action
-            root_powers_ = std::move(HostArray<MultiplyUIntModOperand>(coeff_count_));
+            HostArray<MultiplyUIntModOperand> root_powers(coeff_count_);
             MultiplyUIntModOperand root;
             root.set(root_, modulus_);
             uint64_t power = root_;
             for (size_t i = 1; i < coeff_count_; i++)
             {
-                root_powers_[reverseBits(i, coeff_count_power_)].set(power, modulus_);
+                root_powers[reverseBits(i, coeff_count_power_)].set(power, modulus_);
                 power = multiplyUintMod(power, root, modulus_);
             }
-            root_powers_[0].set(static_cast<uint64_t>(1), modulus_);
+            root_powers[0].set(static_cast<uint64_t>(1), modulus_);
+            root_powers_ = std::make_shared<const HostArray<MultiplyUIntModOperand>>(std::move(root_powers));
 
             // FIXME: allocate related action
-            inv_root_powers_ = std::move(HostArray<MultiplyUIntModOperand>(coeff_count_));
+            HostArray<MultiplyUIntModOperand> inv_root_powers(coeff_count_);
             root.set(inv_root_, modulus_);
             power = inv_root_;
             for (size_t i = 1; i < coeff_count_; i++)
             {
-                inv_root_powers_[reverseBits(i - 1, coeff_count_power_) + 1].set(power, modulus_);
+                inv_root_powers[reverseBits(i - 1, coeff_count_power_) + 1].set(power, modulus_);
                 power = multiplyUintMod(power, root, modulus_);
             }
-            inv_root_powers_[0].set(static_cast<uint64_t>(1), modulus_);
+            inv_root_powers[0].set(static_cast<uint64_t>(1), modulus_);
+            inv_root_powers_ = std::make_shared<const HostArray<MultiplyUIntModOperand>>(std::move(inv_root_powers));
 
             // Compute n^(-1) modulo q.
             uint64_t degree_uint = static_cast<uint64_t>(coeff_count_);
@@ -63,6 +92,22 @@ namespace troy {
 
             mod_arith_lazy_ = ModArithLazy(modulus_);
             ntt_handler_ = NTTHandler(mod_arith_lazy_);
+            selectKernels();
+        }
+
+        void NTTTables::selectKernels() noexcept
+        {
+            int index = coeff_count_power_ - ntt_kernel_min_power;
+            if (index >= 0 && index < ntt_kernel_count)
+            {
+                forward_kernel_ = ntt_kernel_table[index].forward;
+                inverse_kernel_ = ntt_kernel_table[index].inverse;
+            }
+            else
+            {
+                forward_kernel_ = nullptr;
+                inverse_kernel_ = nullptr;
+            }
         }
 
         // class NTTTablesCreateIter
@@ -139,8 +184,97 @@ namespace troy {
         //     vector<Modulus> modulus_;
         // };
 
+        void NTTTables::save(std::ostream &stream) const
+        {
+            uint64_t modulus = modulus_.value();
+            savet(stream, &coeff_count_power_);
+            savet(stream, &modulus);
+            savet(stream, &root_);
+            savet(stream, &inv_root_);
+            savet(stream, &inv_degree_modulo_);
+            stream.write(reinterpret_cast<const char*>(root_powers_->get()), sizeof(MultiplyUIntModOperand) * coeff_count_);
+            stream.write(reinterpret_cast<const char*>(inv_root_powers_->get()), sizeof(MultiplyUIntModOperand) * coeff_count_);
+        }
+
+        void NTTTables::load(std::istream &stream)
+        {
+            uint64_t value = 0;
+            loadt(stream, &coeff_count_power_);
+            loadt(stream, &value);
+            if (!stream || coeff_count_power_ < getPowerOfTwo(SEAL_POLY_MOD_DEGREE_MIN) ||
+                coeff_count_power_ > getPowerOfTwo(SEAL_POLY_MOD_DEGREE_MAX) || value < 2 ||
+                getSignificantBitCount(value) > SEAL_MOD_BIT_COUNT_MAX)
+            {
+                throw invalid_argument("invalid ntt tables");
+            }
+            coeff_count_ = size_t(1) << coeff_count_power_;
+            modulus_ = Modulus::Trusted(value);
+            loadt(stream, &root_);
+            loadt(stream, &inv_root_);
+            loadt(stream, &inv_degree_modulo_);
+            HostArray<MultiplyUIntModOperand> root_powers(coeff_count_), inv_root_powers(coeff_count_);
+            stream.read(reinterpret_cast<char*>(root_powers.get()), sizeof(MultiplyUIntModOperand) * coeff_count_);
+            stream.read(reinterpret_cast<char*>(inv_root_powers.get()), sizeof(MultiplyUIntModOperand) * coeff_count_);
+            if (!stream)
+            {
+                throw invalid_argument("invalid ntt tables");
+            }
+            root_powers_ = std::make_shared<const HostArray<MultiplyUIntModOperand>>(std::move(root_powers));
+            inv_root_powers_ = std::make_shared<const HostArray<MultiplyUIntModOperand>>(std::move(inv_root_powers));
+            mod_arith_lazy_ = ModArithLazy(modulus_);
+            ntt_handler_ = NTTHandler(mod_arith_lazy_);
+            selectKernels();
+        }
+
+        const NTTTables &NTTTablesStore::get(int coeff_count_power, const Modulus &modulus)
+        {
+            auto key = std::make_pair(coeff_count_power, modulus.value());
+            auto it = tables_.find(key);
+            if (it == tables_.end())
+            {
+                it = tables_.emplace(key, NTTTables(coeff_count_power, modulus)).first;
+            }
+            return it->second;
+        }
+
+        void NTTTablesStore::add(const NTTTables &tables)
+        {
+            auto key = std::make_pair(tables.coeffCountPower(), tables.modulus().value());
+            if (tables_.find(key) == tables_.end())
+            {
+                tables_.emplace(key, tables);
+            }
+        }
+
+        void NTTTablesStore::save(std::ostream &stream) const
+        {
+            size_t count = tables_.size();
+            savet(stream, &count);
+            for (auto &entry : tables_)
+            {
+                entry.second.save(stream);
+            }
+        }
+
+        void NTTTablesStore::load(std::istream &stream)
+        {
+            size_t count = 0;
+            loadt(stream, &count);
+            if (!stream)
+            {
+                throw invalid_argument("invalid ntt tables");
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                NTTTables tables;
+                tables.load(stream);
+                auto key = std::make_pair(tables.coeffCountPower(), tables.modulus().value());
+                tables_.insert_or_assign(key, std::move(tables));
+            }
+        }
+
         HostArray<NTTTables> CreateNTTTables(
-            int coeff_count_power, const std::vector<Modulus> &modulus)
+            int coeff_count_power, const std::vector<Modulus> &modulus, NTTTablesStore *store)
         {
             if (!modulus.size())
             {
@@ -150,13 +284,26 @@ namespace troy {
             // FIXME: allocate related action
             HostArray<NTTTables> ret(modulus.size());
             for (size_t i = 0; i < modulus.size(); i++) {
-                ret[i] = std::move(NTTTables(coeff_count_power, modulus[i]));
+                if (store)
+                {
+                    ret[i] = NTTTables(store->get(coeff_count_power, modulus[i]));
+                }
+                else
+                {
+                    ret[i] = std::move(NTTTables(coeff_count_power, modulus[i]));
+                }
             }
             return ret;
         }
 
         void nttNegacyclicHarveyLazy(HostPointer<uint64_t> operand, const NTTTables &tables)
         {
+            TROY_INSTRUMENT_COUNT(ntt, 1);
+            if (auto kernel = tables.forwardKernel())
+            {
+                kernel(operand.get(), tables.getFromRootPowers(), tables.modulus());
+                return;
+            }
             tables.nttHandler().transformToRev(
                 operand.get(), tables.coeffCountPower(), tables.getFromRootPowers());
         }
@@ -188,7 +335,13 @@ namespace troy {
 
         void inverseNttNegacyclicHarveyLazy(HostPointer<uint64_t> operand, const NTTTables &tables)
         {
+            TROY_INSTRUMENT_COUNT(inverse_ntt, 1);
             MultiplyUIntModOperand inv_degree_modulo = tables.invDegreeModulo();
+            if (auto kernel = tables.inverseKernel())
+            {
+                kernel(operand.get(), tables.getFromInvRootPowers(), inv_degree_modulo, tables.modulus());
+                return;
+            }
             tables.nttHandler().transformFromRev(
                 operand.get(), tables.coeffCountPower(), tables.getFromInvRootPowers(), &inv_degree_modulo);
         }
@@ -1,12 +1,15 @@
 
 #pragma once
 
+#include "../instrumentation.h"
 #include "../modulus.h"
 #include "defines.h"
 #include "dwthandler.h"
 #include "uintarithsmallmod.h"
 #include "uintcore.h"
 #include "hostarray.h"
+#include <map>
+#include <memory>
 #include <stdexcept>
 #include <iostream>
 
@@ -65,6 +68,14 @@ namespace troy
 
         class NTTTables
         {
+        public:
+            // Kernels specialized for one coeff_count_power; see nttkernels.h.
+            using ForwardKernel = void (*)(std::uint64_t *, const MultiplyUIntModOperand *, const Modulus &);
+
+            using InverseKernel = void (*)(
+                std::uint64_t *, const MultiplyUIntModOperand *, const MultiplyUIntModOperand &, const Modulus &);
+
+        private:
             using ModArithLazy = Arithmetic<uint64_t, MultiplyUIntModOperand, MultiplyUIntModOperand>;
             using NTTHandler = DWTHandler<std::uint64_t, MultiplyUIntModOperand, MultiplyUIntModOperand>;
             friend class NTTTablesCuda;
@@ -74,18 +85,8 @@ namespace troy
 
             NTTTables(NTTTables &&source) = default;
 
-            NTTTables(NTTTables &copy)
-                : root_(copy.root_), coeff_count_power_(copy.coeff_count_power_),
-                  coeff_count_(copy.coeff_count_), modulus_(copy.modulus_), inv_degree_modulo_(copy.inv_degree_modulo_),
-                  root_powers_(copy.coeff_count_), inv_root_powers_(copy.coeff_count_)
-            {
-                // FIXME: allocate related action
-                // root_powers_ = allocate<MultiplyUIntModOperand>(coeff_count_, pool_);
-                // inv_root_powers_ = allocate<MultiplyUIntModOperand>(coeff_count_, pool_);
-
-                std::copy_n(copy.root_powers_.get(), coeff_count_, root_powers_.get());
-                std::copy_n(copy.inv_root_powers_.get(), coeff_count_, inv_root_powers_.get());
-            }
+            // Copies share the (immutable) power tables.
+            NTTTables(const NTTTables &copy) = default;
 
             NTTTables(int coeff_count_power, const Modulus &modulus);
 
@@ -96,22 +97,22 @@ namespace troy
 
             inline const MultiplyUIntModOperand *getFromRootPowers() const
             {
-                return root_powers_.get();
+                return root_powers_->get();
             }
 
             inline const MultiplyUIntModOperand *getFromInvRootPowers() const
             {
-                return inv_root_powers_.get();
+                return inv_root_powers_->get();
             }
 
             inline MultiplyUIntModOperand getFromRootPowers(std::size_t index) const
             {
-                return root_powers_[index];
+                return (*root_powers_)[index];
             }
 
             inline MultiplyUIntModOperand getFromInvRootPowers(std::size_t index) const
             {
-                return inv_root_powers_[index];
+                return (*inv_root_powers_)[index];
             }
 
             inline const MultiplyUIntModOperand &invDegreeModulo() const
@@ -139,13 +140,46 @@ namespace troy
                 return ntt_handler_;
             }
 
+            /**
+            Returns the forward kernel specialized for coeffCountPower(), or nullptr if there is none and the
+            generic nttHandler() is used.
+            */
+            inline ForwardKernel forwardKernel() const noexcept
+            {
+                return forward_kernel_;
+            }
+
+            /**
+            Returns the inverse kernel specialized for coeffCountPower(), or nullptr if there is none and the
+            generic nttHandler() is used.
+            */
+            inline InverseKernel inverseKernel() const noexcept
+            {
+                return inverse_kernel_;
+            }
+
             NTTTables &operator=(NTTTables &&assign) = default;
 
+            /**
+            Writes the tables, excluding the modulus object, to a stream.
+            */
+            void save(std::ostream &stream) const;
+
+            /**
+            Reads tables written by save without recomputing any root. The modulus is rebuilt with Modulus::Trusted,
+            since its primality was established when the tables were computed.
+
+            @throws std::invalid_argument if the stream does not hold valid tables
+            */
+            void load(std::istream &stream);
+
         private:
             NTTTables &operator=(const NTTTables &assign) = delete;
 
             void initialize(int coeff_count_power, const Modulus &modulus);
 
+            void selectKernels() noexcept;
+
             std::uint64_t root_ = 0;
 
             std::uint64_t inv_root_ = 0;
@@ -160,29 +194,72 @@ namespace troy
             MultiplyUIntModOperand inv_degree_modulo_;
 
             // Holds 1~(n-1)-th powers of root_ in bit-reversed order, the 0-th power is left unset.
-            HostArray<MultiplyUIntModOperand> root_powers_;
+            // Shared between copies, so that a prime used by several levels of a context is stored once.
+            std::shared_ptr<const HostArray<MultiplyUIntModOperand>> root_powers_;
 
             // Holds 1~(n-1)-th powers of inv_root_ in scrambled order, the 0-th power is left unset.
-            HostArray<MultiplyUIntModOperand> inv_root_powers_;
+            std::shared_ptr<const HostArray<MultiplyUIntModOperand>> inv_root_powers_;
 
             ModArithLazy mod_arith_lazy_;
 
             NTTHandler ntt_handler_;
+
+            ForwardKernel forward_kernel_ = nullptr;
+
+            InverseKernel inverse_kernel_ = nullptr;
+        };
+
+        /**
+        NTT tables keyed by (coeff_count_power, modulus value). SEALContext threads one through the construction of
+        its modulus switching chain, so that a prime shared by several levels (and by their BEHZ bases) has its roots
+        computed once, and saves or loads it as a precomputation snapshot.
+        */
+        class NTTTablesStore
+        {
+        public:
+            /**
+            Returns the stored tables for (coeff_count_power, modulus), computing and storing them on first use.
+
+            @throws std::invalid_argument if modulus does not support NTT or coeff_count_power is invalid
+            */
+            const NTTTables &get(int coeff_count_power, const Modulus &modulus);
+
+            /**
+            Stores a copy of the given tables unless tables for the same key are already present.
+            */
+            void add(const NTTTables &tables);
+
+            inline std::size_t size() const noexcept
+            {
+                return tables_.size();
+            }
+
+            void save(std::ostream &stream) const;
+
+            /**
+            Adds the tables written by save to the store.
+            */
+            void load(std::istream &stream);
+
+        private:
+            std::map<std::pair<int, std::uint64_t>, NTTTables> tables_;
         };
 
         /**
-        Allocate and construct an array of NTTTables each with different a modulus.
+        Allocate and construct an array of NTTTables each with different a modulus. If store is given the tables are
+        copied from it, and computed into it when missing.
 
         @throws std::invalid_argument if modulus is empty, modulus does not support NTT, coeff_count_power is invalid,
         or pool is uninitialized.
         */
         HostArray<NTTTables> CreateNTTTables(
-            int coeff_count_power, const std::vector<Modulus> &modulus);
+            int coeff_count_power, const std::vector<Modulus> &modulus, NTTTablesStore *store = nullptr);
 
         void nttNegacyclicHarveyLazy(HostPointer<uint64_t> operand, const NTTTables &tables);
 
         inline void nttNegacyclicHarveyLazy(HostPointer<uint64_t> operand, std::size_t coeff_modulus_size, const NTTTables* tables)
         {
+            TROY_INSTRUMENT_KERNEL(ntt, coeff_modulus_size);
             std::size_t d = (1 << tables[0].coeffCountPower());
             for (std::size_t i = 0; i < coeff_modulus_size; i++) {
                 nttNegacyclicHarveyLazy(operand + d * i, tables[i]);
@@ -192,10 +269,13 @@ namespace troy
         inline void nttNegacyclicHarveyLazy(HostPointer<uint64_t> operand, std::size_t poly_size, std::size_t coeff_modulus_size, const NTTTables* tables)
         {
             if (poly_size == 0) return;
+            TROY_INSTRUMENT_KERNEL(ntt, poly_size * coeff_modulus_size);
             // assert(tables.length() > 0);
-            std::size_t d = (1 << tables[0].coeffCountPower()) * coeff_modulus_size;
+            std::size_t n = std::size_t(1) << tables[0].coeffCountPower();
             for (std::size_t i = 0; i < poly_size; i++) {
-                nttNegacyclicHarveyLazy(operand + d * i, coeff_modulus_size, tables);
+                for (std::size_t j = 0; j < coeff_modulus_size; j++) {
+                    nttNegacyclicHarveyLazy(operand + n * (i * coeff_modulus_size + j), tables[j]);
+                }
             }
         }
 
@@ -203,6 +283,7 @@ namespace troy
 
         inline void nttNegacyclicHarvey(HostPointer<uint64_t> operand, std::size_t coeff_modulus_size, const NTTTables* tables)
         {
+            TROY_INSTRUMENT_KERNEL(ntt, coeff_modulus_size);
             std::size_t d = (1 << tables[0].coeffCountPower());
             for (std::size_t i = 0; i < coeff_modulus_size; i++) {
                 nttNegacyclicHarvey(operand + d * i, tables[i]);
@@ -212,10 +293,13 @@ namespace troy
         inline void nttNegacyclicHarvey(HostPointer<uint64_t> operand, std::size_t poly_size, std::size_t coeff_modulus_size, const NTTTables* tables)
         {
             if (poly_size == 0) return;
+            TROY_INSTRUMENT_KERNEL(ntt, poly_size * coeff_modulus_size);
             // assert(tables.length() > 0);
-            std::size_t d = (1 << tables[0].coeffCountPower()) * coeff_modulus_size;
+            std::size_t n = std::size_t(1) << tables[0].coeffCountPower();
             for (std::size_t i = 0; i < poly_size; i++) {
-                nttNegacyclicHarvey(operand + d * i, coeff_modulus_size, tables);
+                for (std::size_t j = 0; j < coeff_modulus_size; j++) {
+                    nttNegacyclicHarvey(operand + n * (i * coeff_modulus_size + j), tables[j]);
+                }
             }
         }
 
@@ -224,6 +308,7 @@ namespace troy
         inline void inverseNttNegacyclicHarveyLazy(
             HostPointer<uint64_t> operand, std::size_t coeff_modulus_size, const NTTTables* tables)
         {
+            TROY_INSTRUMENT_KERNEL(inverse_ntt, coeff_modulus_size);
             // assert(tables.length() > 0);
             std::size_t d = (1 << tables[0].coeffCountPower());
             for (std::size_t i = 0; i < coeff_modulus_size; i++) {
@@ -236,10 +321,13 @@ namespace troy
         inline void inverseNttNegacyclicHarveyLazy(HostPointer<uint64_t> operand, std::size_t poly_size, std::size_t coeff_modulus_size, const NTTTables* tables)
         {
             if (poly_size == 0) return;
+            TROY_INSTRUMENT_KERNEL(inverse_ntt, poly_size * coeff_modulus_size);
             // assert(tables.length() > 0);
-            std::size_t d = (1 << tables[0].coeffCountPower()) * coeff_modulus_size;
+            std::size_t n = std::size_t(1) << tables[0].coeffCountPower();
             for (std::size_t i = 0; i < poly_size; i++) {
-                inverseNttNegacyclicHarveyLazy(operand + d * i, coeff_modulus_size, tables);
+                for (std::size_t j = 0; j < coeff_modulus_size; j++) {
+                    inverseNttNegacyclicHarveyLazy(operand + n * (i * coeff_modulus_size + j), tables[j]);
+                }
             }
         }
 
@@ -248,6 +336,7 @@ namespace troy
         inline void inverseNttNegacyclicHarvey(
             HostPointer<uint64_t> operand, std::size_t coeff_modulus_size, const NTTTables* tables)
         {
+            TROY_INSTRUMENT_KERNEL(inverse_ntt, coeff_modulus_size);
             // assert(tables.length() > 0);
             std::size_t d = (1 << tables[0].coeffCountPower());
             for (std::size_t i = 0; i < coeff_modulus_size; i++) {
@@ -258,10 +347,13 @@ namespace troy
         inline void inverseNttNegacyclicHarvey(HostPointer<uint64_t> operand, std::size_t poly_size, std::size_t coeff_modulus_size, const NTTTables* tables)
         {
             if (poly_size == 0) return;
+            TROY_INSTRUMENT_KERNEL(inverse_ntt, poly_size * coeff_modulus_size);
             // assert(tables.length() > 0);
-            std::size_t d = (1 << tables[0].coeffCountPower()) * coeff_modulus_size;
+            std::size_t n = std::size_t(1) << tables[0].coeffCountPower();
             for (std::size_t i = 0; i < poly_size; i++) {
-                inverseNttNegacyclicHarvey(operand + d * i, coeff_modulus_size, tables);
+                for (std::size_t j = 0; j < coeff_modulus_size; j++) {
+                    inverseNttNegacyclicHarvey(operand + n * (i * coeff_modulus_size + j), tables[j]);
+                }
             }
         }
     } // namespace util
@@ -24,7 +24,7 @@ namespace troy
             NTTTablesCuda(const NTTTables &copy)
                 : root_(copy.root_), coeff_count_power_(copy.coeff_count_power_),
                   coeff_count_(copy.coeff_count_), modulus_(copy.modulus_), inv_degree_modulo_(copy.inv_degree_modulo_),
-                  root_powers_(copy.root_powers_), inv_root_powers_(copy.inv_root_powers_)
+                  root_powers_(*copy.root_powers_), inv_root_powers_(*copy.inv_root_powers_)
             {
             }
 
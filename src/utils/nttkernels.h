@@ -0,0 +1,252 @@
+#pragma once
+
+#include "../modulus.h"
+#include "uintarith.h"
+#include "uintarithsmallmod.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace troy
+{
+    namespace util
+    {
+        /**
+        Negacyclic NTT kernels specialized for one ring dimension. They compute exactly what DWTHandler computes with
+        the lazy modular arithmetic of NTTTables (same butterflies, same [0, 4q) output range), but the transform size
+        is a compile-time constant and two consecutive layers are fused into one radix-4 pass, which halves the number
+        of sweeps over the polynomial. The stage on adjacent coefficients (the last forward layers, the first inverse
+        layers) works on blocks of four and has no inner loop. NTTTables selects them by coeff_count_power.
+        */
+        namespace nttkernels
+        {
+            inline std::uint64_t mulRootLazy(
+                std::uint64_t x, const MultiplyUIntModOperand &r, std::uint64_t modulus)
+            {
+                std::uint64_t hw64;
+                multiplyUint64HW64(x, r.quotient, &hw64);
+                return r.operand * x - hw64 * modulus;
+            }
+
+            // Reduces [0, 4q) to [0, 2q). If a < 2q the subtraction wraps around to a larger value, so the minimum
+            // picks the right one; this compiles to a conditional move, where the comparison on uniformly distributed
+            // coefficients would be an unpredictable branch.
+            inline std::uint64_t guard(std::uint64_t a, std::uint64_t two_times_modulus)
+            {
+                std::uint64_t b = a - two_times_modulus;
+                return (b < a) ? b : a;
+            }
+
+            // Cooley-Tukey butterfly of transformToRev.
+            inline void forwardButterfly(
+                std::uint64_t &x, std::uint64_t &y, const MultiplyUIntModOperand &r, std::uint64_t modulus,
+                std::uint64_t two_times_modulus)
+            {
+                std::uint64_t u = guard(x, two_times_modulus);
+                std::uint64_t v = mulRootLazy(y, r, modulus);
+                x = u + v;
+                y = u + two_times_modulus - v;
+            }
+
+            // Gentleman-Sande butterfly of transformFromRev.
+            inline void inverseButterfly(
+                std::uint64_t &x, std::uint64_t &y, const MultiplyUIntModOperand &r, std::uint64_t modulus,
+                std::uint64_t two_times_modulus)
+            {
+                std::uint64_t u = x;
+                std::uint64_t v = y;
+                x = guard(u + v, two_times_modulus);
+                y = mulRootLazy(u + two_times_modulus - v, r, modulus);
+            }
+
+            // Last butterfly of transformFromRev, which also multiplies both outputs by a scalar; scaled_r is the
+            // root multiplied by the scalar.
+            inline void inverseScaledButterfly(
+                std::uint64_t &x, std::uint64_t &y, const MultiplyUIntModOperand &scalar,
+                const MultiplyUIntModOperand &scaled_r, std::uint64_t modulus, std::uint64_t two_times_modulus)
+            {
+                std::uint64_t u = guard(x, two_times_modulus);
+                std::uint64_t v = y;
+                x = mulRootLazy(guard(u + v, two_times_modulus), scalar, modulus);
+                y = mulRootLazy(u + two_times_modulus - v, scaled_r, modulus);
+            }
+
+            /**
+            Forward transform of 2^LogN coefficients, inputs in normal order and outputs in bit-reversed order, in
+            [0, 4q). roots holds the powers of the root in bit-reversed order, as in NTTTables.
+            */
+            template <int LogN>
+            void forwardLazy(std::uint64_t *values, const MultiplyUIntModOperand *roots, const Modulus &modulus)
+            {
+                static_assert(LogN >= 3, "transform too small for radix-4 stages");
+                constexpr std::size_t n = std::size_t(1) << LogN;
+                const std::uint64_t q = modulus.value();
+                const std::uint64_t two_q = q << 1;
+
+                // Layer l has m = 2^l groups with gap n / 2m and uses roots[m .. 2m). An odd layer count leaves
+                // the first layer unpaired.
+                std::size_t m = 1;
+                std::size_t gap = n >> 1;
+                if constexpr (LogN % 2 == 1)
+                {
+                    const MultiplyUIntModOperand r = roots[1];
+                    for (std::size_t j = 0; j < gap; j++)
+                    {
+                        forwardButterfly(values[j], values[j + gap], r, q, two_q);
+                    }
+                    m = 2;
+                    gap >>= 1;
+                }
+
+                // Layers (m, gap) and (2m, gap / 2) at once, until only the last two layers are left.
+                for (; gap > 2; m <<= 2, gap >>= 2)
+                {
+                    const std::size_t quarter = gap >> 1;
+                    for (std::size_t i = 0; i < m; i++)
+                    {
+                        const MultiplyUIntModOperand r = roots[m + i];
+                        const MultiplyUIntModOperand r0 = roots[2 * m + 2 * i];
+                        const MultiplyUIntModOperand r1 = roots[2 * m + 2 * i + 1];
+                        std::uint64_t *x = values + 2 * gap * i;
+                        for (std::size_t j = 0; j < quarter; j++)
+                        {
+                            std::uint64_t x0 = x[j];
+                            std::uint64_t x1 = x[j + quarter];
+                            std::uint64_t x2 = x[j + gap];
+                            std::uint64_t x3 = x[j + gap + quarter];
+                            forwardButterfly(x0, x2, r, q, two_q);
+                            forwardButterfly(x1, x3, r, q, two_q);
+                            forwardButterfly(x0, x1, r0, q, two_q);
+                            forwardButterfly(x2, x3, r1, q, two_q);
+                            x[j] = x0;
+                            x[j + quarter] = x1;
+                            x[j + gap] = x2;
+                            x[j + gap + quarter] = x3;
+                        }
+                    }
+                }
+
+                // The last two layers (gaps 2 and 1) on blocks of four adjacent coefficients.
+                constexpr std::size_t last_m = n >> 2;
+                const MultiplyUIntModOperand *r = roots + last_m;
+                const MultiplyUIntModOperand *r01 = roots + 2 * last_m;
+                for (std::size_t i = 0; i < last_m; i++, values += 4)
+                {
+                    std::uint64_t x0 = values[0];
+                    std::uint64_t x1 = values[1];
+                    std::uint64_t x2 = values[2];
+                    std::uint64_t x3 = values[3];
+                    forwardButterfly(x0, x2, r[i], q, two_q);
+                    forwardButterfly(x1, x3, r[i], q, two_q);
+                    forwardButterfly(x0, x1, r01[2 * i], q, two_q);
+                    forwardButterfly(x2, x3, r01[2 * i + 1], q, two_q);
+                    values[0] = x0;
+                    values[1] = x1;
+                    values[2] = x2;
+                    values[3] = x3;
+                }
+            }
+
+            /**
+            Inverse transform of 2^LogN coefficients, inputs in bit-reversed order and outputs in normal order,
+            multiplied by scalar and in [0, 2q). roots holds the powers of the inverse root in scrambled order, as in
+            NTTTables.
+            */
+            template <int LogN>
+            void inverseLazy(
+                std::uint64_t *values, const MultiplyUIntModOperand *roots, const MultiplyUIntModOperand &scalar,
+                const Modulus &modulus)
+            {
+                static_assert(LogN >= 3, "transform too small for radix-4 stages");
+                constexpr std::size_t n = std::size_t(1) << LogN;
+                const std::uint64_t q = modulus.value();
+                const std::uint64_t two_q = q << 1;
+
+                // Layers run from m = n / 2 groups down to 1; each consumes the next m roots. The first two layers
+                // (gaps 1 and 2) work on blocks of four adjacent coefficients.
+                const MultiplyUIntModOperand *r01 = roots + 1;
+                const MultiplyUIntModOperand *r = roots + 1 + (n >> 1);
+                std::uint64_t *x = values;
+                for (std::size_t i = 0; i < (n >> 2); i++, x += 4)
+                {
+                    std::uint64_t x0 = x[0];
+                    std::uint64_t x1 = x[1];
+                    std::uint64_t x2 = x[2];
+                    std::uint64_t x3 = x[3];
+                    inverseButterfly(x0, x1, r01[2 * i], q, two_q);
+                    inverseButterfly(x2, x3, r01[2 * i + 1], q, two_q);
+                    inverseButterfly(x0, x2, r[i], q, two_q);
+                    inverseButterfly(x1, x3, r[i], q, two_q);
+                    x[0] = x0;
+                    x[1] = x1;
+                    x[2] = x2;
+                    x[3] = x3;
+                }
+                std::size_t base = 1 + (n >> 1) + (n >> 2);
+                std::size_t m = n >> 3;
+                std::size_t gap = 4;
+
+                // Layers (m, gap) and (m / 2, 2 gap) at once, down to m = 2 or m = 1.
+                for (; m >= 4; base += m + (m >> 1), m >>= 2, gap <<= 2)
+                {
+                    for (std::size_t i = 0; i < (m >> 1); i++)
+                    {
+                        const MultiplyUIntModOperand r0 = roots[base + 2 * i];
+                        const MultiplyUIntModOperand r1 = roots[base + 2 * i + 1];
+                        const MultiplyUIntModOperand r2 = roots[base + m + i];
+                        x = values + 4 * gap * i;
+                        for (std::size_t j = 0; j < gap; j++)
+                        {
+                            std::uint64_t x0 = x[j];
+                            std::uint64_t x1 = x[j + gap];
+                            std::uint64_t x2 = x[j + 2 * gap];
+                            std::uint64_t x3 = x[j + 3 * gap];
+                            inverseButterfly(x0, x1, r0, q, two_q);
+                            inverseButterfly(x2, x3, r1, q, two_q);
+                            inverseButterfly(x0, x2, r2, q, two_q);
+                            inverseButterfly(x1, x3, r2, q, two_q);
+                            x[j] = x0;
+                            x[j + gap] = x1;
+                            x[j + 2 * gap] = x2;
+                            x[j + 3 * gap] = x3;
+                        }
+                    }
+                }
+                // The last layer also multiplies by the scalar. With an even layer count it is fused with the
+                // layer before (m = 2), otherwise it runs alone.
+                const MultiplyUIntModOperand s = scalar;
+                if constexpr (LogN % 2 == 0)
+                {
+                    const MultiplyUIntModOperand r0 = roots[base];
+                    const MultiplyUIntModOperand r1 = roots[base + 1];
+                    MultiplyUIntModOperand scaled_r;
+                    scaled_r.set(multiplyUintMod(roots[base + 2].operand, s, modulus), modulus);
+                    for (std::size_t j = 0; j < gap; j++)
+                    {
+                        std::uint64_t x0 = values[j];
+                        std::uint64_t x1 = values[j + gap];
+                        std::uint64_t x2 = values[j + 2 * gap];
+                        std::uint64_t x3 = values[j + 3 * gap];
+                        inverseButterfly(x0, x1, r0, q, two_q);
+                        inverseButterfly(x2, x3, r1, q, two_q);
+                        inverseScaledButterfly(x0, x2, s, scaled_r, q, two_q);
+                        inverseScaledButterfly(x1, x3, s, scaled_r, q, two_q);
+                        values[j] = x0;
+                        values[j + gap] = x1;
+                        values[j + 2 * gap] = x2;
+                        values[j + 3 * gap] = x3;
+                    }
+                }
+                else
+                {
+                    MultiplyUIntModOperand scaled_r;
+                    scaled_r.set(multiplyUintMod(roots[base].operand, s, modulus), modulus);
+                    std::uint64_t *y = values + gap;
+                    for (std::size_t j = 0; j < gap; j++)
+                    {
+                        inverseScaledButterfly(values[j], y[j], s, scaled_r, q, two_q);
+                    }
+                }
+            }
+        } // namespace nttkernels
+    } // namespace util
+} // namespace troy
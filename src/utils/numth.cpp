@@ -1,5 +1,8 @@
 #include "numth.h"
 #include "uintarithsmallmod.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
 
 using std::pair;
 using std::vector;
@@ -231,14 +234,18 @@ namespace troy {
                 return false;
             }
 
-            // 1) Pick a = 2, check a^(value - 1).
-            // 2) Pick a randomly from [3, value - 1], check a^(value - 1).
-            // 3) Repeat 2) for another num_rounds - 2 times.
-            random_device rand;
-            uniform_int_distribution<unsigned long long> dist(3, value - 1);
+            // Miller-Rabin with the first twelve primes as bases is exact for every value below
+            // 3.3 * 10^24, which covers all 64-bit moduli. Rounds beyond twelve add nothing, and
+            // fixed bases avoid opening a random_device per test.
+            static constexpr uint64_t bases[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+            num_rounds = std::min(num_rounds, sizeof(bases) / sizeof(bases[0]));
             for (size_t i = 0; i < num_rounds; i++)
             {
-                uint64_t a = i ? dist(rand) : 2;
+                uint64_t a = bases[i] % value;
+                if (a == 0)
+                {
+                    continue;
+                }
                 uint64_t x = exponentiateUintMod(a, d, modulus);
                 if (x == 1 || x == value - 1)
                 {
@@ -258,28 +265,96 @@ namespace troy {
             return true;
         }
 
-        vector<Modulus> getPrimes(uint64_t factor, int bit_size, size_t count)
+        namespace
         {
-            vector<Modulus> destination;
+            // Odd primes used to strike out candidates before any Miller-Rabin test.
+            constexpr uint64_t sieve_primes[] = {
+                3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97,
+                101, 103, 107, 109, 113, 127, 131, 137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193,
+                197, 199, 211, 223, 227, 229, 233, 239, 241, 251
+            };
+
+            constexpr size_t sieve_window = 1024;
+
+            // Progress of the downward search for primes = 1 mod factor with a given bit size.
+            struct PrimeSearch
+            {
+                vector<uint64_t> primes;
+                uint64_t next = 0;
+                bool started = false;
+            };
+
+            // Appends the primes among next, next - factor, ..., next - (window - 1) * factor
+            // (in that order) to primes, stopping once primes has `wanted` entries.
+            void sieveWindow(uint64_t factor, size_t window, size_t wanted, PrimeSearch &search)
+            {
+                bool composite[sieve_window] = {};
+                uint64_t next = search.next;
+                for (uint64_t p : sieve_primes)
+                {
+                    uint64_t step = factor % p;
+                    if (step == 0)
+                    {
+                        // Every candidate is 1 mod p.
+                        continue;
+                    }
+                    // First i with next - i * factor = 0 mod p, i.e. i = next / factor mod p.
+                    uint64_t inv = 0;
+                    tryInvertUintMod(step, p, inv);
+                    uint64_t i = (next % p) * inv % p;
+                    for (; i < window; i += p)
+                    {
+                        if (next - i * factor != p)
+                        {
+                            composite[i] = true;
+                        }
+                    }
+                }
+                for (size_t i = 0; i < window && search.primes.size() < wanted; i++)
+                {
+                    uint64_t value = next - i * factor;
+                    search.next = value > factor ? value - factor : 0;
+                    if (!composite[i] && isPrime(Modulus::Trusted(value, false)))
+                    {
+                        search.primes.push_back(value);
+                    }
+                }
+            }
+        } // namespace
 
-            // Start with (2^bit_size - 1) / factor * factor + 1
-            uint64_t value = ((uint64_t(0x1) << bit_size) - 1) / factor * factor + 1;
+        vector<Modulus> getPrimes(uint64_t factor, int bit_size, size_t count)
+        {
+            // Searches are remembered per (factor, bit_size) for the lifetime of the process, so
+            // later contexts (and the BEHZ base) with the same degree reuse the primes found so far.
+            static std::mutex cache_mutex;
+            static std::map<pair<uint64_t, int>, PrimeSearch> cache;
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            PrimeSearch &search = cache[{ factor, bit_size }];
+            if (!search.started)
+            {
+                // Start with (2^bit_size - 1) / factor * factor + 1
+                search.next = ((uint64_t(0x1) << bit_size) - 1) / factor * factor + 1;
+                search.started = true;
+            }
 
             uint64_t lower_bound = uint64_t(0x1) << (bit_size - 1);
-            while (count > 0 && value > lower_bound)
+            while (search.primes.size() < count && search.next > lower_bound)
             {
-                Modulus new_mod(value);
-                if (new_mod.isPrime())
-                {
-                    destination.emplace_back(std::move(new_mod));
-                    count--;
-                }
-                value -= factor;
+                uint64_t remaining = (search.next - lower_bound - 1) / factor + 1;
+                size_t window = static_cast<size_t>(std::min<uint64_t>(remaining, sieve_window));
+                sieveWindow(factor, window, count, search);
             }
-            if (count > 0)
+            if (search.primes.size() < count)
             {
                 throw logic_error("failed to find enough qualifying primes");
             }
+
+            vector<Modulus> destination;
+            destination.reserve(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                destination.emplace_back(Modulus::Trusted(search.primes[i]));
+            }
             return destination;
         }
 
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace troy
+{
+    namespace util
+    {
+        /**
+        Splits [0, count) into at most `threads` contiguous ranges and runs task(begin, end) on each,
+        one range per thread. The calling thread runs the first range itself. Since every worker
+        receives one range, per-worker scratch can be allocated once at the top of the task.
+        The first exception thrown by a task is rethrown to the caller.
+        */
+        template <typename F>
+        inline void parallelForRange(std::size_t count, std::size_t threads, F &&task)
+        {
+            if (threads > count)
+            {
+                threads = count;
+            }
+            if (threads <= 1)
+            {
+                if (count)
+                {
+                    task(std::size_t(0), count);
+                }
+                return;
+            }
+            std::exception_ptr error = nullptr;
+            std::mutex error_mutex;
+            auto worker = [&](std::size_t t) {
+                std::size_t begin = count * t / threads;
+                std::size_t end = count * (t + 1) / threads;
+                try
+                {
+                    task(begin, end);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!error)
+                    {
+                        error = std::current_exception();
+                    }
+                }
+            };
+            std::vector<std::thread> pool;
+            pool.reserve(threads - 1);
+            for (std::size_t t = 1; t < threads; t++)
+            {
+                pool.emplace_back(worker, t);
+            }
+            worker(0);
+            for (auto &thread : pool)
+            {
+                thread.join();
+            }
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+    } // namespace util
+} // namespace troy
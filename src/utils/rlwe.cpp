@@ -40,6 +40,41 @@ namespace troy
             }
         }
 
+        void samplePolyTernarySparse(
+            shared_ptr<UniformRandomGenerator> prng, const EncryptionParameters &parms, size_t hamming_weight,
+            uint64_t *destination)
+        {
+            auto coeff_modulus = parms.coeffModulus();
+            size_t coeff_modulus_size = coeff_modulus.size();
+            size_t coeff_count = parms.polyModulusDegree();
+            if (hamming_weight > coeff_count)
+            {
+                throw invalid_argument("hamming_weight is too large");
+            }
+
+            RandomToStandardAdapter engine(prng);
+            uniform_int_distribution<uint64_t> sign(0, 1);
+            setZeroPoly(coeff_count, coeff_modulus_size, destination);
+
+            // A partial Fisher-Yates shuffle: after step i, positions[0..i] is a uniform random subset.
+            vector<size_t> positions(coeff_count);
+            for (size_t i = 0; i < coeff_count; i++)
+            {
+                positions[i] = i;
+            }
+            for (size_t i = 0; i < hamming_weight; i++)
+            {
+                uniform_int_distribution<size_t> pick(i, coeff_count - 1);
+                swap(positions[i], positions[pick(engine)]);
+                uint64_t flag = static_cast<uint64_t>(-static_cast<int64_t>(sign(engine)));
+                for (size_t j = 0; j < coeff_modulus_size; j++)
+                {
+                    // 1, or q - 1 for -1.
+                    destination[positions[i] + j * coeff_count] = 1 + (flag & (coeff_modulus[j].value() - 2));
+                }
+            }
+        }
+
         void samplePolyNormal(
             shared_ptr<UniformRandomGenerator> prng, const EncryptionParameters &parms, uint64_t *destination)
         {
@@ -26,6 +26,20 @@ namespace troy
             std::shared_ptr<UniformRandomGenerator> prng, const EncryptionParameters &parms,
             std::uint64_t *destination);
 
+        /**
+        Generate a ternary polynomial with exactly hamming_weight nonzero coefficients, each 1 or -1 with equal
+        probability, at uniformly random positions, and store in RNS representation.
+
+        @param[in] prng A uniform random generator
+        @param[in] parms EncryptionParameters used to parameterize an RNS polynomial
+        @param[in] hamming_weight The number of nonzero coefficients
+        @param[out] destination Allocated space to store a random polynomial
+        @throws std::invalid_argument if hamming_weight is larger than the polynomial degree
+        */
+        void samplePolyTernarySparse(
+            std::shared_ptr<UniformRandomGenerator> prng, const EncryptionParameters &parms,
+            std::size_t hamming_weight, std::uint64_t *destination);
+
         /**
         Generate a polynomial from a normal distribution and store in RNS representation.
 
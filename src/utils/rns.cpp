@@ -1,6 +1,7 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT license.
 
+#include "../instrumentation.h"
 #include "common.h"
 #include "numth.h"
 #include "polyarithsmallmod.h"
@@ -414,6 +415,7 @@ namespace troy
 
         void BaseConverter::fastConvertArray(ConstHostPointer<uint64_t> in, HostPointer<uint64_t> out, size_t count) const
         {
+            TROY_INSTRUMENT_KERNEL(base_conversion, count);
 #ifdef SEAL_DEBUG
             if (in.poly_modulus_degree() != out.poly_modulus_degree())
             {
@@ -461,6 +463,7 @@ namespace troy
         // See "An Improved RNS Variant of the BFV Homomorphic Encryption Scheme" (CT-RSA 2019) for details
         void BaseConverter::exactConvertArray(ConstHostPointer<uint64_t> in, HostPointer<uint64_t> out, size_t in_count) const
         {
+            TROY_INSTRUMENT_KERNEL(base_conversion, in_count);
             size_t ibase_size = ibase_.size();
             size_t obase_size = obase_.size();
             size_t count = in_count;
@@ -573,12 +576,13 @@ namespace troy
         }
 
         RNSTool::RNSTool(
-            size_t poly_modulus_degree, const RNSBase &coeff_modulus, const Modulus &plain_modulus)
+            size_t poly_modulus_degree, const RNSBase &coeff_modulus, const Modulus &plain_modulus,
+            NTTTablesStore *ntt_store)
         {
-            initialize(poly_modulus_degree, coeff_modulus, plain_modulus);
+            initialize(poly_modulus_degree, coeff_modulus, plain_modulus, ntt_store);
         }
 
-        void RNSTool::initialize(size_t poly_modulus_degree, const RNSBase &q, const Modulus &t)
+        void RNSTool::initialize(size_t poly_modulus_degree, const RNSBase &q, const Modulus &t, NTTTablesStore *ntt_store)
         {
             // Return if q is out of bounds
             if (q.size() < SEAL_COEFF_MOD_COUNT_MIN || q.size() > SEAL_COEFF_MOD_COUNT_MAX)
@@ -656,7 +660,7 @@ namespace troy
             try
             {
                 base_Bsk_ntt_tables_ = CreateNTTTables(
-                    coeff_count_power, vector<Modulus>(base_Bsk_->base(), base_Bsk_->base() + base_Bsk_size));
+                    coeff_count_power, vector<Modulus>(base_Bsk_->base(), base_Bsk_->base() + base_Bsk_size), ntt_store);
             }
             catch (const logic_error &)
             {
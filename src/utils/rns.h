@@ -177,7 +177,8 @@ namespace troy
             @throws std::logic_error if coeff_modulus and extended bases do not support NTT or are not coprime.
             */
             RNSTool(
-                std::size_t poly_modulus_degree, const RNSBase &coeff_modulus, const Modulus &plain_modulus);
+                std::size_t poly_modulus_degree, const RNSBase &coeff_modulus, const Modulus &plain_modulus,
+                NTTTablesStore *ntt_store = nullptr);
 
             /**
             @param[in] input Must be in RNS form, i.e. coefficient must be less than the associated modulus.
@@ -300,7 +301,7 @@ namespace troy
             /**
             Generates the pre-computations for the given parameters.
             */
-            void initialize(std::size_t poly_modulus_degree, const RNSBase &q, const Modulus &t);
+            void initialize(std::size_t poly_modulus_degree, const RNSBase &q, const Modulus &t, NTTTablesStore *ntt_store);
 
             std::size_t coeff_count_ = 0;
 
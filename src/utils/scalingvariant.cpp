@@ -16,13 +16,18 @@ namespace troy
     {
         void addPlainWithoutScalingVariant(
             const Plaintext &plain, const SEALContext::ContextData &context_data, HostPointer<uint64_t> destination)
+        {
+            addPlainWithoutScalingVariant(plain.data(), plain.coeffCount(), context_data, destination);
+        }
+
+        void addPlainWithoutScalingVariant(
+            ConstHostPointer<uint64_t> plain_data, size_t plain_coeff_count, const SEALContext::ContextData &context_data,
+            HostPointer<uint64_t> destination)
         {
             auto &parms = context_data.parms();
             auto &coeff_modulus = parms.coeffModulus();
-            const size_t plain_coeff_count = plain.coeffCount();
             size_t coeff_count = parms.polyModulusDegree();
             const size_t coeff_modulus_size = coeff_modulus.size();
-            auto plain_data = plain.data();
             for (size_t i = 0; i < coeff_modulus_size; i++) {
             // SEAL_ITERATE(iter(destination, coeff_modulus), coeff_modulus_size, [&](auto I) {
                 for (size_t j = 0; j < plain_coeff_count; j++) {
@@ -52,9 +57,15 @@ namespace troy
 
         void multiplyAddPlainWithScalingVariant(
             const Plaintext &plain, const SEALContext::ContextData &context_data, HostPointer<uint64_t> destination)
+        {
+            multiplyAddPlainWithScalingVariant(plain.data(), plain.coeffCount(), context_data, destination);
+        }
+
+        void multiplyAddPlainWithScalingVariant(
+            ConstHostPointer<uint64_t> plain_data, size_t plain_coeff_count, const SEALContext::ContextData &context_data,
+            HostPointer<uint64_t> destination)
         {
             auto &parms = context_data.parms();
-            size_t plain_coeff_count = plain.coeffCount();
             size_t coeff_count = parms.polyModulusDegree();
             auto &coeff_modulus = parms.coeffModulus();
             size_t coeff_modulus_size = coeff_modulus.size();
@@ -65,7 +76,6 @@ namespace troy
             // Coefficients of plain m multiplied by coeff_modulus q, divided by plain_modulus t,
             // and rounded to the nearest integer (rounded up in case of a tie). Equivalent to
             // floor((q * m + floor((t+1) / 2)) / t).
-            auto plain_data = plain.data();
             for (size_t i = 0; i < plain_coeff_count; i++) {
             // SEAL_ITERATE(iter(plain.data(), size_t(0)), plain_coeff_count, [&](auto I) {
                 // Compute numerator = (q mod t) * m[i] + (t+1)/2
@@ -128,5 +138,34 @@ namespace troy
                 }
             }
         }
+
+        void scalePlainWithScalingVariant(
+            const Plaintext &plain, const SEALContext::ContextData &context_data, HostPointer<uint64_t> destination)
+        {
+            auto &parms = context_data.parms();
+            size_t plain_coeff_count = plain.coeffCount();
+            auto &coeff_modulus = parms.coeffModulus();
+            size_t coeff_modulus_size = coeff_modulus.size();
+            auto plain_modulus = context_data.parms().plainModulus();
+            auto coeff_div_plain_modulus = context_data.coeffDivPlainModulus();
+            uint64_t plain_upper_half_threshold = context_data.plainUpperHalfThreshold();
+            uint64_t q_mod_t = context_data.coeffModulusModPlainModulus();
+            // Same rounding as multiplyAddPlainWithScalingVariant.
+            auto plain_data = plain.data();
+            for (size_t i = 0; i < plain_coeff_count; i++) {
+                uint64_t prod[2]{ 0, 0 };
+                uint64_t numerator[2]{ 0, 0 };
+                multiplyUint64(plain_data[i], q_mod_t, prod);
+                unsigned char carry = addUint64(*prod, plain_upper_half_threshold, numerator);
+                numerator[1] = static_cast<uint64_t>(prod[1]) + static_cast<uint64_t>(carry);
+
+                uint64_t fix[2] = { 0, 0 };
+                divideUint128Inplace(numerator, plain_modulus.value(), fix);
+
+                for (size_t j = 0; j < coeff_modulus_size; j++) {
+                    destination[j * plain_coeff_count + i] = multiplyAddUintMod(plain_data[i], coeff_div_plain_modulus[j], fix[0], coeff_modulus[j]);
+                }
+            }
+        }
     } // namespace util
 } // namespace seal
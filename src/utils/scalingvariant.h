@@ -14,13 +14,25 @@ namespace troy
         void addPlainWithoutScalingVariant(
             const Plaintext &plain, const SEALContext::ContextData &context_data, HostPointer<uint64_t> destination);
 
+        void addPlainWithoutScalingVariant(
+            ConstHostPointer<uint64_t> plain_data, std::size_t plain_coeff_count,
+            const SEALContext::ContextData &context_data, HostPointer<uint64_t> destination);
+
         void subPlainWithoutScalingVariant(
             const Plaintext &plain, const SEALContext::ContextData &context_data, HostPointer<uint64_t> destination);
 
         void multiplyAddPlainWithScalingVariant(
             const Plaintext &plain, const SEALContext::ContextData &context_data, HostPointer<uint64_t> destination);
 
+        void multiplyAddPlainWithScalingVariant(
+            ConstHostPointer<uint64_t> plain_data, std::size_t plain_coeff_count,
+            const SEALContext::ContextData &context_data, HostPointer<uint64_t> destination);
+
         void multiplySubPlainWithScalingVariant(
             const Plaintext &plain, const SEALContext::ContextData &context_data, HostPointer<uint64_t> destination);
+
+        // Writes round(q/t * m) modulo each prime q_j to destination[j * plain.coeffCount() + i].
+        void scalePlainWithScalingVariant(
+            const Plaintext &plain, const SEALContext::ContextData &context_data, HostPointer<uint64_t> destination);
     } // namespace util
 } // namespace seal
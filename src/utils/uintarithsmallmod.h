@@ -121,6 +121,16 @@ namespace troy {
             return (tmp3 >= modulus.value()) ? (tmp3 - modulus.value()): (tmp3);
         }
 
+        /**
+        Returns input mod modulus for a native 128-bit input, e.g. a lazy multiply-accumulate sum.
+        Correctness: modulus must be at most 63-bit.
+        */
+        inline std::uint64_t barrettReduce128(uint128_t input, const Modulus &modulus)
+        {
+            uint64_t words[2]{ static_cast<uint64_t>(input), static_cast<uint64_t>(input >> 64) };
+            return barrettReduce128(words, modulus);
+        }
+
         /**
         Returns input mod modulus. This is not standard Barrett reduction.
         Correctness: modulus must be at most 63-bit.
@@ -0,0 +1,344 @@
+#include "../../app/LinearHelperCPU.h"
+#include "timer.h"
+#include <iomanip>
+#include <map>
+
+using namespace troy;
+using namespace std;
+
+class LinearTest {
+
+    Encryptor* encryptor;
+    Decryptor* decryptor;
+    Evaluator* evaluator;
+    SEALContext* context;
+    RelinKeys rlk;
+    PublicKey pk;
+    GaloisKeys autok;
+    KeyGenerator* keygen;
+    EncryptionParameters parms;
+
+    vector<ParmsID> parmIDs;
+
+    BatchEncoder* encoder;
+    size_t slotCount;
+    int dataBound;
+    double delta;
+    uint64_t modulus;
+
+public:
+
+    void printVector(const vector<uint64_t>& r, size_t terms) {
+        std::cout << "[";
+        for (size_t i = 0; i < std::min(r.size(), terms); i++) {
+            if (i!=0) std::cout << ", ";
+            std::cout << r[i];
+        }
+        std::cout << "]" << std::endl;
+    }
+
+    vector<uint64_t> randomVector(size_t count = 0, uint64_t data_bound = 0) {
+        if (count == 0) count = slotCount;
+        if (data_bound == 0) data_bound = dataBound;
+        vector<uint64_t> input(count, 0.0);
+        for (size_t i = 0; i < count; i++)
+        {
+            input[i] = ((((uint64_t)(rand())) << 32) + ((uint64_t)(rand()))) % data_bound;
+        }
+        return input;
+    }
+
+    void printTimer(std::map<std::string, double> r) {
+        for (auto& p: r) {
+            std::cout << std::setw(25) << std::right << p.first << ":";
+            std::cout << std::setw(10) << std::right << std::fixed << std::setprecision(3)
+                << p.second << std::endl;
+        }
+    }
+
+    LinearTest(size_t polyModulusDegree, vector<int> qs, int dataBound, uint64_t plainModulus, uint64_t scale) {
+        slotCount = polyModulusDegree;
+        this->dataBound = dataBound;
+        this->delta = scale;
+        parms = EncryptionParameters(SchemeType::bfv);
+        parms.setPolyModulusDegree(polyModulusDegree);
+        parms.setPlainModulus(plainModulus);
+        modulus = plainModulus;
+        parms.setCoeffModulus(CoeffModulus::Create(polyModulusDegree, qs));
+        context = new SEALContext(parms, true, SecurityLevel::none);
+        keygen = new KeyGenerator(*context);
+        keygen->createPublicKey(pk);
+        keygen->createRelinKeys(rlk);
+        autok = keygen->createAutomorphismKeys();
+        encoder = new BatchEncoder(*context);
+        encryptor = new Encryptor(*context, pk);
+        encryptor->setSecretKey(keygen->secretKey());
+        decryptor = new Decryptor(*context, keygen->secretKey());
+        evaluator = new Evaluator(*context);
+        evaluator->setThreadCount(LinearHelperCPU::defaultThreadCount());
+
+        parmIDs.clear();
+        std::shared_ptr<const SEALContext::ContextData> cd = context->firstContextData();
+        while (cd) {
+            parmIDs.push_back(cd->parmsID());
+            cd = cd->nextContextData();
+        }
+    }
+
+    ~LinearTest() {
+        delete evaluator;
+        delete decryptor;
+        delete encryptor;
+        delete encoder;
+        delete keygen;
+        delete context;
+    }
+
+    void testMatmulInts(size_t batchSize, size_t inputDims, size_t outputDims, bool packLwes) {
+        
+        auto mod = parms.plainModulus().value();
+        auto w = randomVector(inputDims * outputDims, mod);
+        auto x = randomVector(inputDims * batchSize, mod);
+        auto s = randomVector(batchSize * outputDims, mod);
+
+        // initialize helper
+        LinearHelperCPU::MatmulHelper helper(batchSize, inputDims, outputDims, slotCount, 0, packLwes);
+
+        auto wEncoded = helper.encodeWeights(*encoder, *evaluator, w.data(), context->firstParmsID());
+        
+        // interaction
+        auto timer = Timer();
+        auto t = timer.registerTimer("Matmul"); timer.tick(t);
+        auto xEncoded = helper.encodeInputs(*encoder, x.data());
+        auto xEnc = xEncoded.encrypt(*encryptor);
+
+        { // serialize as a chunked stream
+            ostringstream sout;
+            LinearHelperCPU::StreamWriter writer(sout, LinearHelperCPU::StreamKind::cipher, xEnc.data.size(), xEnc[0].size());
+            writer.writeAll(xEnc.data, 4);
+            writer.finish();
+            auto p = sout.str(); std::cout << "xEnc length = " << p.size() << std::endl;
+            istringstream sin(p); xEnc = LinearHelperCPU::Cipher2d();
+            LinearHelperCPU::StreamReader reader(sin, context);
+            reader.readAll(xEnc.data);
+        }
+
+        auto yEnc = helper.matmul(*evaluator, xEnc, wEncoded);  
+
+        yEnc.modSwitchToNext(*evaluator); 
+
+        if (packLwes) {
+            yEnc = helper.packOutputs(*evaluator, autok, yEnc);
+        }
+        
+        auto sEncoded = helper.encodeOutputs(*encoder, s.data());
+        yEnc.addPlainInplace(*evaluator, sEncoded);
+        
+        { // serialize as a compact stream, one chunk per output row
+            ostringstream sout;
+            auto writer = helper.outputStreamWriter(*evaluator, sout);
+            for (size_t i = 0; i < yEnc.data.size(); i++) writer.write(i, 0, yEnc[i]);
+            writer.finish();
+            auto p = sout.str(); std::cout << "yEnc length = " << p.size() << std::endl;
+            istringstream sin(p);
+            auto reader = helper.outputStreamReader(*evaluator, sin);
+            size_t chunks = 0;
+            reader.readAll(yEnc.data, [&](size_t, size_t, size_t) {chunks++;});
+            std::cout << "yEnc chunks = " << chunks << std::endl;
+        }
+
+        auto yDec = helper.decryptOutputs(*encoder, *decryptor, yEnc);
+        timer.tock(t);
+        printTimer(timer.gather());
+        
+        // plaintext computation
+        vector<uint64_t> y(batchSize * outputDims, 0);
+        for (size_t i = 0; i < batchSize; i++) {
+            for (size_t k = 0; k < outputDims; k++) {
+                for (size_t j = 0; j < inputDims; j++) {
+                    y[i * outputDims + k] += x[i * inputDims + j] * w[j * outputDims + k];
+                    y[i * outputDims + k] %= mod;
+                }
+                y[i * outputDims + k] += s[i * outputDims + k];
+                y[i * outputDims + k] %= mod;
+            }
+        }
+
+        // comparison
+        uint64_t diff = 0;
+        for (size_t i = 0; i < batchSize * outputDims; i++) {
+            uint64_t d = std::abs<long long>(y[i] - yDec[i]);
+            if (d > diff) diff = d;
+        }
+        std::cout << "Difference = " << diff << std::endl;
+        
+    }
+
+    void testMatmulCipherInts(size_t batchSize, size_t inputDims, size_t outputDims) {
+        
+        auto mod = parms.plainModulus().value();
+        auto w = randomVector(inputDims * outputDims, mod);
+        auto x = randomVector(inputDims * batchSize, mod);
+        auto s = randomVector(batchSize * outputDims, mod);
+
+        // initialize helper
+        LinearHelperCPU::MatmulHelper helper(batchSize, inputDims, outputDims, slotCount);
+
+        auto wEncoded = helper.encodeWeights(*encoder, w.data());
+        auto wEnc = wEncoded.encrypt(*encryptor);
+        
+        // interaction
+        auto timer = Timer();
+        auto t = timer.registerTimer("Matmul"); timer.tick(t);
+        auto xEncoded = helper.encodeInputs(*encoder, x.data());
+        auto xEnc = xEncoded.encrypt(*encryptor);
+
+        auto yEnc = helper.matmulCipher(*evaluator, xEnc, wEnc, rlk);
+
+        yEnc.modSwitchToNext(*evaluator); 
+        
+        auto sEncoded = helper.encodeOutputs(*encoder, s.data());
+        yEnc.addPlainInplace(*evaluator, sEncoded);
+
+        auto yDec = helper.decryptOutputs(*encoder, *decryptor, yEnc);
+        timer.tock(t);
+        printTimer(timer.gather());
+        
+        // plaintext computation
+        vector<uint64_t> y(batchSize * outputDims, 0);
+        for (size_t i = 0; i < batchSize; i++) {
+            for (size_t k = 0; k < outputDims; k++) {
+                for (size_t j = 0; j < inputDims; j++) {
+                    y[i * outputDims + k] += x[i * inputDims + j] * w[j * outputDims + k];
+                    y[i * outputDims + k] %= mod;
+                }
+                y[i * outputDims + k] += s[i * outputDims + k];
+                y[i * outputDims + k] %= mod;
+            }
+        }
+
+        // comparison
+        uint64_t diff = 0;
+        for (size_t i = 0; i < batchSize * outputDims; i++) {
+            uint64_t d = std::abs<long long>(y[i] - yDec[i]);
+            if (d > diff) diff = d;
+        }
+        std::cout << "Difference = " << diff << std::endl;
+        
+    }
+
+    void testConv2dInt(size_t batchSize, size_t inputChannels, size_t outputChannels, size_t imageHeight, size_t imageWidth, size_t kernelHeight, size_t kernelWidth, bool packLwes) {
+        
+        // generate data
+        auto weights = randomVector(inputChannels * outputChannels * kernelHeight * kernelWidth);
+        auto x = randomVector(batchSize * inputChannels * imageHeight * imageWidth);
+        size_t yh = imageHeight - kernelHeight + 1, yw = imageWidth - kernelWidth + 1;
+        vector<uint64_t> s = randomVector(batchSize * outputChannels * yh * yw);
+        auto mod = parms.plainModulus().value();
+
+        // initialize helper
+        LinearHelperCPU::Conv2dHelper helper(batchSize, imageHeight, imageWidth, kernelHeight, kernelWidth, inputChannels, outputChannels, slotCount, 0, packLwes);
+        auto encodedWeights = helper.encodeWeights(*encoder, *evaluator, weights, context->firstParmsID());
+
+        auto tim = Timer();
+        tim.registerTimer("total");
+        tim.tick();
+        auto timEnc = tim.registerTimer("x encrypt");
+        tim.tick(timEnc);
+        // interaction
+        auto xEnc = helper.encryptInputs(*encryptor, *encoder, x);
+        tim.tock(timEnc);
+
+        auto timSer = tim.registerTimer("x serde");
+        tim.tick(timSer);
+        { // serialize
+            ostringstream sout; xEnc.save(sout);
+            auto p = sout.str(); std::cout << "xEnc length = " << p.size() << std::endl;
+            istringstream sin(p); xEnc = LinearHelperCPU::Cipher2d();
+            xEnc.load(sin, *context);
+        }
+        tim.tock(timSer);
+
+        auto timMul = tim.registerTimer("conv");
+        tim.tick(timMul);
+        auto yEnc = helper.conv2d(*evaluator, xEnc, encodedWeights);
+        tim.tock(timMul);
+
+        if (packLwes) {
+            auto timPack = tim.registerTimer("y pack");
+            tim.tick(timPack);
+            yEnc = helper.packOutputs(*evaluator, autok, yEnc);
+            tim.tock(timPack);
+        }
+
+        auto timEncS = tim.registerTimer("s encode");
+        tim.tick(timEncS);
+        auto sEncoded = helper.encodeOutputs(*encoder, s);
+        tim.tock(timEncS);
+        auto timAdd = tim.registerTimer("s add");
+        tim.tick(timAdd);
+        yEnc.addPlainInplace(*evaluator, sEncoded);
+        tim.tock(timAdd);
+        
+        auto timSerY = tim.registerTimer("y serde");
+        tim.tick(timSerY);
+        { // serialize
+            ostringstream sout; helper.serializeOutputs(*evaluator, yEnc, sout);
+            auto p = sout.str(); std::cout << "yEnc length = " << p.size() << std::endl;
+            istringstream sin(p); 
+            yEnc = helper.deserializeOutputs(*evaluator, sin);
+        }
+        tim.tock(timSerY);
+
+        // dec
+        auto timDec = tim.registerTimer("y decrypt");
+        tim.tick(timDec);
+        auto yDec = helper.decryptOutputs(*encoder, *decryptor, yEnc);
+        tim.tock(timDec);
+        tim.tock();
+
+        printTimer(tim.gather());
+        
+        // plaintext computation
+        vector<uint64_t> y(batchSize * outputChannels * yh * yw, 0);
+        for (size_t b = 0; b < batchSize; b++) {
+            for (size_t oc = 0; oc < outputChannels; oc++) {
+                for (size_t yi = 0; yi < yh; yi++) {
+                    for (size_t yj = 0; yj < yw; yj++) {
+                        uint64_t element = s[((b * outputChannels + oc) * yh + yi) * yw + yj];
+                        for (size_t ic = 0; ic < inputChannels; ic++) {
+                            for (size_t xi = yi; xi < yi + kernelHeight; xi++) {
+                                for (size_t xj = yj; xj < yj + kernelWidth; xj++) {
+                                    size_t xIndex = ((b * inputChannels + ic) * imageHeight + xi) * imageWidth + xj;
+                                    size_t wIndex = ((oc * inputChannels + ic) * kernelHeight + (xi - yi)) * kernelWidth + (xj - yj);
+                                    element += (x[xIndex] * weights[wIndex]) % mod;
+                                }
+                            }
+                        }
+                        y[((b * outputChannels + oc) * yh + yi) * yw + yj] = element % mod;
+                    }
+                }
+            }
+        }
+        // comparison
+        uint64_t diff = 0;
+        for (size_t i = 0; i < y.size(); i++) {
+            uint64_t d = std::abs<long long>(y[i] - yDec[i]);
+            if (d > diff) diff = d;
+        }
+        std::cout << "Difference = " << diff << std::endl;
+        
+    }
+
+};
+
+int main() {
+    srand(0);
+    LinearTest test(8192, {60, 60, 60}, 16, 1ul<<41, 1ul<<12);
+    printf("Setup\n");
+    // test.testMatmulCipherInts(4, 6, 8);
+    test.testMatmulInts(1, 2048, 1001, true);
+    // Enough input channels that the packing factor is capped at defaultMaxPackFactor.
+    test.testConv2dInt(1, 64, 8, 8, 8, 3, 3, true);
+    // test.testConv2dInt(1, 64, 256, 56, 56, 3, 3, true);
+}
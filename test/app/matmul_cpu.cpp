@@ -0,0 +1,176 @@
+#include "../../app/LinearHelperCPU.h"
+#include "timer.h"
+#include <algorithm>
+#include <iomanip>
+#include <map>
+
+using namespace troy;
+using namespace std;
+
+class MatmulTest {
+
+    Encryptor* encryptor;
+    Decryptor* decryptor;
+    Evaluator* evaluator;
+    SEALContext* context;
+    PublicKey pk;
+    KeyGenerator* keygen;
+    EncryptionParameters parms;
+    BatchEncoder* encoder;
+    size_t slotCount;
+
+public:
+
+    MatmulTest(size_t polyModulusDegree, vector<int> qs, uint64_t plainModulus) {
+        slotCount = polyModulusDegree;
+        parms = EncryptionParameters(SchemeType::bfv);
+        parms.setPolyModulusDegree(polyModulusDegree);
+        parms.setPlainModulus(plainModulus);
+        parms.setCoeffModulus(CoeffModulus::Create(polyModulusDegree, qs));
+        context = new SEALContext(parms, true, SecurityLevel::none);
+        keygen = new KeyGenerator(*context);
+        keygen->createPublicKey(pk);
+        encoder = new BatchEncoder(*context);
+        encryptor = new Encryptor(*context, pk);
+        encryptor->setSecretKey(keygen->secretKey());
+        decryptor = new Decryptor(*context, keygen->secretKey());
+        evaluator = new Evaluator(*context);
+    }
+
+    ~MatmulTest() {
+        delete evaluator;
+        delete decryptor;
+        delete encryptor;
+        delete encoder;
+        delete keygen;
+        delete context;
+    }
+
+    vector<uint64_t> randomVector(size_t count, uint64_t data_bound) {
+        vector<uint64_t> input(count, 0);
+        for (size_t i = 0; i < count; i++)
+        {
+            input[i] = ((((uint64_t)(rand())) << 32) + ((uint64_t)(rand()))) % data_bound;
+        }
+        return input;
+    }
+
+    // The evaluation order of LinearHelperSEAL::MatmulHelper::matmul:
+    // one multiplyPlain (with its own NTT round trip) and one addInplace per block.
+    LinearHelperCPU::Cipher2d matmulReference(const LinearHelperCPU::Cipher2d& a, const LinearHelperCPU::Plain2d& w) {
+        LinearHelperCPU::Cipher2d ret;
+        for (size_t b = 0; b < a.data.size(); b++) {
+            std::vector<Ciphertext> outVecs(w[0].size());
+            for (size_t i = 0; i < w.data.size(); i++) {
+                for (size_t j = 0; j < w[i].size(); j++) {
+                    Ciphertext prod;
+                    evaluator->multiplyPlain(a[b][i], w[i][j], prod);
+                    if (i==0) outVecs[j] = std::move(prod);
+                    else evaluator->addInplace(outVecs[j], prod);
+                }
+            }
+            ret.data.push_back(std::move(outVecs));
+        }
+        return ret;
+    }
+
+    uint64_t difference(const vector<uint64_t>& y, const vector<uint64_t>& yDec) {
+        uint64_t diff = 0;
+        for (size_t i = 0; i < y.size(); i++) {
+            uint64_t d = std::abs<long long>(y[i] - yDec[i]);
+            if (d > diff) diff = d;
+        }
+        return diff;
+    }
+
+    void testMatmul(size_t batchSize, size_t inputDims, size_t outputDims) {
+
+        auto mod = parms.plainModulus().value();
+        auto w = randomVector(inputDims * outputDims, mod);
+        auto x = randomVector(inputDims * batchSize, mod);
+
+        vector<uint64_t> y(batchSize * outputDims, 0);
+        for (size_t i = 0; i < batchSize; i++) {
+            for (size_t k = 0; k < outputDims; k++) {
+                for (size_t j = 0; j < inputDims; j++) {
+                    y[i * outputDims + k] += x[i * inputDims + j] * w[j * outputDims + k];
+                    y[i * outputDims + k] %= mod;
+                }
+            }
+        }
+
+        LinearHelperCPU::MatmulHelper helper(batchSize, inputDims, outputDims, slotCount);
+        auto wPlain = helper.encodeWeights(*encoder, w.data());
+        auto xEnc = helper.encryptInputs(*encryptor, *encoder, x.data());
+        size_t threads = LinearHelperCPU::defaultThreadCount();
+
+        Timer timer;
+        auto tPrepare = timer.registerTimer("prepare weights");
+        auto tCache = timer.registerTimer("load cached weights");
+        auto tRef = timer.registerTimer("reference");
+        auto tSingle = timer.registerTimer("fused, 1 thread");
+        auto tMulti = timer.registerTimer("fused, " + std::to_string(threads) + " threads");
+
+        timer.tick(tRef);
+        auto yRef = matmulReference(xEnc, wPlain);
+        double ref = timer.tock(tRef);
+        std::cout << "reference difference = " << difference(y, helper.decryptOutputs(*encoder, *decryptor, yRef)) << std::endl;
+
+        timer.tick(tPrepare);
+        auto wNtt = helper.encodeWeights(*encoder, *evaluator, w.data(), context->firstParmsID());
+        timer.tock(tPrepare);
+
+        // The first call writes the cache, the second maps it instead of encoding.
+        std::string cachePath = "matmul_cpu_weights.cache";
+        uint64_t layerKey = 0;
+        std::remove(cachePath.c_str());
+        helper.encodeWeights(*encoder, *evaluator, w.data(), context->firstParmsID(), cachePath, layerKey);
+        timer.tick(tCache);
+        auto wCached = helper.encodeWeights(*encoder, *evaluator, w.data(), context->firstParmsID(), cachePath, layerKey);
+        timer.tock(tCache);
+        // Changed weights under the same layer key must not pick up the stale encoding.
+        auto wChanged = w; wChanged[0] = (wChanged[0] + 1) % mod;
+        auto wReencoded = helper.encodeWeights(*encoder, *evaluator, wChanged.data(), context->firstParmsID(), cachePath, layerKey);
+        const Plaintext& stale = wCached[0][0];
+        const Plaintext& fresh = wReencoded[0][0];
+        std::cout << "changed weights re-encoded = "
+            << !std::equal(stale.data(), stale.data() + stale.coeffCount(), fresh.data()) << std::endl;
+        std::remove(cachePath.c_str());
+
+        helper.setThreadCount(1);
+        timer.tick(tSingle);
+        auto ySingle = helper.matmul(*evaluator, xEnc, wNtt);
+        double single = timer.tock(tSingle);
+        std::cout << "fused difference = " << difference(y, helper.decryptOutputs(*encoder, *decryptor, ySingle)) << std::endl;
+
+        helper.setThreadCount(threads);
+        timer.tick(tMulti);
+        auto yMulti = helper.matmul(*evaluator, xEnc, wCached);
+        double multi = timer.tock(tMulti);
+        std::cout << "parallel difference = " << difference(y, helper.decryptOutputs(*encoder, *decryptor, yMulti)) << std::endl;
+
+        std::cout << std::setw(25) << std::right << "speedup (1 thread)" << ":"
+            << std::setw(10) << std::right << std::fixed << std::setprecision(3) << ref / single << std::endl;
+        std::cout << std::setw(25) << std::right << "speedup (all threads)" << ":"
+            << std::setw(10) << std::right << std::fixed << std::setprecision(3) << ref / multi << std::endl;
+        for (auto& p: timer.gather()) {
+            std::cout << std::setw(25) << std::right << p.first << ":";
+            std::cout << std::setw(10) << std::right << std::fixed << std::setprecision(3)
+                << p.second << std::endl;
+        }
+    }
+
+};
+
+int main(int argc, char** argv) {
+    srand(0);
+    // Same shape and parameters as test/app/linear_seal.cpp.
+    size_t batchSize = 1, inputDims = 2048, outputDims = 1001;
+    if (argc == 4) {
+        batchSize = std::stoul(argv[1]);
+        inputDims = std::stoul(argv[2]);
+        outputDims = std::stoul(argv[3]);
+    }
+    MatmulTest test(8192, {60, 60, 60}, 1ul<<41);
+    test.testMatmul(batchSize, inputDims, outputDims);
+}
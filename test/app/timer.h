@@ -0,0 +1,53 @@
+#pragma once
+
+// Named wall-clock accumulators shared by the CPU linear-helper benchmarks (linear_cpu.cpp,
+// matmul_cpu.cpp, tune_cpu.cpp).
+
+#include "sys/time.h"
+#include <cassert>
+#include <map>
+#include <string>
+#include <vector>
+
+class Timer {
+public:
+    std::vector<timeval> times;
+    std::vector<double> accumulated; // ms
+    std::vector<std::string> names;
+    Timer() {}
+    size_t registerTimer(std::string name = "") {
+        times.push_back(timeval());
+        accumulated.push_back(0);
+        size_t ret = times.size() - 1;
+        names.push_back(name);
+        return ret;
+    }
+    void tick(size_t i = 0) {
+        if (times.size() < 1) registerTimer();
+        assert(i < times.size());
+        gettimeofday(&times[i], 0);
+    }
+    double tock(size_t i = 0) {
+        assert(i < times.size());
+        timeval s; gettimeofday(&s, 0);
+        auto timeElapsed = (s.tv_sec - times[i].tv_sec) * 1000.0;
+        timeElapsed += (s.tv_usec - times[i].tv_usec) / 1000.0;
+        accumulated[i] += timeElapsed;
+        return accumulated[i];
+    }
+
+    void clear() {
+        times.clear();
+        accumulated.clear();
+        names.clear();
+    }
+
+    std::map<std::string, double> gather(double divisor = 1) {
+        std::map<std::string, double> p;
+        for (size_t i=0; i<times.size(); i++) {
+            p[names[i]] = accumulated[i] / divisor;
+        }
+        clear();
+        return p;
+    }
+};
@@ -0,0 +1,145 @@
+#include "../../app/LinearHelperCPU.h"
+#include "timer.h"
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+using namespace troy;
+using namespace std;
+using LinearHelperCPU::CostModel;
+using LinearHelperCPU::TuneOptions;
+using LinearHelperCPU::TuneTarget;
+
+// Compares the ciphertext-count heuristic of MatmulHelper with the cost-model tuner:
+// modelled and measured end-to-end time (client encryption, server matmul and packing,
+// client decryption) and bytes on the wire.
+class TuneTest {
+
+    Encryptor* encryptor;
+    Decryptor* decryptor;
+    Evaluator* evaluator;
+    SEALContext* context;
+    KeyGenerator* keygen;
+    EncryptionParameters parms;
+    BatchEncoder* encoder;
+    GaloisKeys autok;
+    size_t slotCount;
+    CostModel model;
+
+public:
+
+    TuneTest(size_t polyModulusDegree, vector<int> qs, uint64_t plainModulus) {
+        slotCount = polyModulusDegree;
+        parms = EncryptionParameters(SchemeType::bfv);
+        parms.setPolyModulusDegree(polyModulusDegree);
+        parms.setPlainModulus(plainModulus);
+        parms.setCoeffModulus(CoeffModulus::Create(polyModulusDegree, qs));
+        context = new SEALContext(parms, true, SecurityLevel::none);
+        keygen = new KeyGenerator(*context);
+        autok = keygen->createAutomorphismKeys();
+        encoder = new BatchEncoder(*context);
+        encryptor = new Encryptor(*context, keygen->secretKey());
+        decryptor = new Decryptor(*context, keygen->secretKey());
+        evaluator = new Evaluator(*context);
+        evaluator->setThreadCount(LinearHelperCPU::defaultThreadCount());
+
+        Timer timer; auto t = timer.registerTimer("calibrate");
+        timer.tick(t);
+        model = CostModel::calibrate(*context);
+        double ms = timer.tock(t);
+        std::cout << "calibrated in " << ms << " ms:"
+            << " encrypt " << model.encrypt << ", decrypt " << model.decrypt
+            << ", ntt " << model.nttCiphertext << ", intt " << model.inttCiphertext
+            << ", mac term " << model.multiplyAccumulateTerm << ", automorphism " << model.automorphism
+            << ", threads " << model.threads << std::endl;
+    }
+
+    ~TuneTest() {
+        delete evaluator;
+        delete decryptor;
+        delete encryptor;
+        delete encoder;
+        delete keygen;
+        delete context;
+    }
+
+    vector<uint64_t> randomVector(size_t count, uint64_t data_bound) {
+        vector<uint64_t> input(count, 0);
+        for (size_t i = 0; i < count; i++)
+        {
+            input[i] = ((((uint64_t)(rand())) << 32) + ((uint64_t)(rand()))) % data_bound;
+        }
+        return input;
+    }
+
+    void run(const char* name, LinearHelperCPU::MatmulHelper& helper, size_t batchSize, size_t inputDims, size_t outputDims) {
+        auto mod = parms.plainModulus().value();
+        auto w = randomVector(inputDims * outputDims, mod);
+        auto x = randomVector(inputDims * batchSize, mod);
+        auto wNtt = helper.encodeWeights(*encoder, *evaluator, w.data(), context->firstParmsID());
+
+        Timer timer;
+        auto t = timer.registerTimer("total");
+        timer.tick(t);
+        auto xEnc = helper.encryptInputs(*encryptor, *encoder, x.data());
+        ostringstream up; xEnc.save(up);
+        auto yEnc = helper.matmul(*evaluator, xEnc, wNtt);
+        yEnc.modSwitchToNext(*evaluator);
+        if (helper.getPackLwe()) yEnc = helper.packOutputs(*evaluator, autok, yEnc);
+        ostringstream down; helper.serializeOutputs(*evaluator, yEnc, down);
+        auto yDec = helper.decryptOutputs(*encoder, *decryptor, yEnc);
+        double ms = timer.tock(t);
+
+        bool correct = true;
+        for (size_t i = 0; i < batchSize && correct; i++) {
+            for (size_t k = 0; k < outputDims; k++) {
+                uint64_t y = 0;
+                for (size_t j = 0; j < inputDims; j++) {
+                    y = (y + x[i * inputDims + j] * w[j * outputDims + k]) % mod;
+                }
+                if (y != yDec[i * outputDims + k]) {correct = false; break;}
+            }
+        }
+        auto cost = helper.estimate(model);
+        double bytes = up.str().size() + down.str().size();
+        std::cout << std::setw(10) << name
+            << " pack " << helper.getPackLwe()
+            << " | model " << std::fixed << std::setprecision(1) << cost.clientTime + cost.serverTime << " ms, "
+            << (cost.bytesSent + cost.bytesReceived) / 1e6 << " MB"
+            << " | measured " << ms << " ms, " << bytes / 1e6 << " MB"
+            << " | latency @" << model.bandwidth / 1e3 << " MB/s " << ms + bytes / model.bandwidth << " ms"
+            << (correct ? "" : " | WRONG RESULT") << std::endl;
+    }
+
+    void compare(size_t batchSize, size_t inputDims, size_t outputDims) {
+        std::cout << "shape " << batchSize << " x " << inputDims << " x " << outputDims << std::endl;
+        LinearHelperCPU::MatmulHelper heuristic(batchSize, inputDims, outputDims, slotCount);
+        run("heuristic", heuristic, batchSize, inputDims, outputDims);
+        TuneOptions latency;
+        LinearHelperCPU::MatmulHelper tuned(batchSize, inputDims, outputDims, model, latency);
+        run("latency", tuned, batchSize, inputDims, outputDims);
+        TuneOptions bytes; bytes.target = TuneTarget::bytes;
+        LinearHelperCPU::MatmulHelper small(batchSize, inputDims, outputDims, model, bytes);
+        run("bytes", small, batchSize, inputDims, outputDims);
+
+        // 4096 cannot hold the 180-bit modulus securely and is skipped.
+        TuneOptions degrees; degrees.slotCounts = {4096, 8192, 16384};
+        LinearHelperCPU::MatmulHelper any(batchSize, inputDims, outputDims, model, degrees);
+        std::cout << std::setw(10) << "any degree" << " -> N = " << any.getSlotCount()
+            << ", pack " << any.getPackLwe() << ", modelled latency "
+            << any.estimate(model).latency(model.scaledTo(any.getSlotCount())) << " ms" << std::endl;
+    }
+
+};
+
+int main(int argc, char** argv) {
+    srand(0);
+    TuneTest test(8192, {60, 60, 60}, 1ul<<41);
+    if (argc == 4) {
+        test.compare(std::stoul(argv[1]), std::stoul(argv[2]), std::stoul(argv[3]));
+        return 0;
+    }
+    test.compare(1, 2048, 1001);
+    test.compare(16, 512, 256);
+    test.compare(64, 128, 128);
+}
@@ -0,0 +1,314 @@
+#pragma once
+
+// Harness shared by workloads_cpu.cpp (troy) and workloads_seal.cpp (Microsoft SEAL): option
+// parsing, concurrent request driver, latency percentiles, peak RSS and the report table. It
+// knows nothing about either library, so both binaries report the same columns for the same
+// workload definitions.
+
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace workloads {
+
+    // Every workload runs `iterations` requests on `concurrency` client threads sharing one set
+    // of keys and one evaluator. `innerThreads` is the parallelism allowed inside one request
+    // (helper / evaluator thread count); SEAL ignores it.
+    struct Options {
+        std::vector<std::string> selected;
+        size_t concurrency = 1;
+        size_t iterations = 8;
+        size_t warmup = 1;
+        size_t innerThreads = 1;
+        size_t aggregateCount = 100000;
+        bool small = false;
+
+        bool runs(const std::string& name) const {
+            return selected.empty() || std::find(selected.begin(), selected.end(), name) != selected.end();
+        }
+    };
+
+    inline void printUsage(const char* program, const std::vector<std::string>& names) {
+        std::cout << "usage: " << program << " [options] [workload ...]\n"
+            << "  workloads:";
+        for (auto& name: names) std::cout << " " << name;
+        std::cout << "\n"
+            << "  --concurrency N   client threads issuing requests (default 1)\n"
+            << "  --iterations N    measured requests per workload (default 8)\n"
+            << "  --warmup N        unmeasured requests per client thread (default 1)\n"
+            << "  --inner-threads N threads used inside one request (default 1)\n"
+            << "  --aggregate N     ciphertexts summed by the aggregate workload (default 100000)\n"
+            << "  --small           scaled-down shapes (and 2000 aggregated ciphertexts) for a quick run\n";
+    }
+
+    inline Options parseOptions(int argc, char** argv, const std::vector<std::string>& names) {
+        Options options;
+        bool aggregateSet = false;
+        auto number = [&](int& i) -> size_t {
+            if (i + 1 >= argc) throw std::invalid_argument(std::string("missing value for ") + argv[i]);
+            size_t value = std::stoul(argv[++i]);
+            return value;
+        };
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--concurrency") options.concurrency = std::max<size_t>(1, number(i));
+            else if (arg == "--iterations") options.iterations = std::max<size_t>(1, number(i));
+            else if (arg == "--warmup") options.warmup = number(i);
+            else if (arg == "--inner-threads") options.innerThreads = std::max<size_t>(1, number(i));
+            else if (arg == "--aggregate") {
+                options.aggregateCount = std::max<size_t>(1, number(i));
+                aggregateSet = true;
+            }
+            else if (arg == "--small") options.small = true;
+            else if (arg == "--help" || arg == "-h") {
+                printUsage(argv[0], names);
+                std::exit(0);
+            } else if (std::find(names.begin(), names.end(), arg) != names.end()) {
+                options.selected.push_back(arg);
+            } else {
+                printUsage(argv[0], names);
+                throw std::invalid_argument("unknown argument " + arg);
+            }
+        }
+        if (options.small && !aggregateSet) options.aggregateCount = 2000;
+        return options;
+    }
+
+    // Peak resident set size in KiB. resetPeakRss() asks Linux to restart the high-water mark so
+    // that every workload reports its own peak; where that is not allowed the peak is cumulative.
+    inline void resetPeakRss() {
+#ifdef __GLIBC__
+        malloc_trim(0);
+#endif
+        std::ofstream clear("/proc/self/clear_refs");
+        if (clear) clear << "5";
+    }
+
+    inline size_t peakRssKiB() {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.compare(0, 6, "VmHWM:") == 0) return std::stoul(line.substr(6));
+        }
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<size_t>(usage.ru_maxrss);
+    }
+
+    struct Result {
+        std::string name;
+        size_t requests = 0;
+        double seconds = 0;
+        double p50 = 0, p99 = 0, max = 0; // ms
+        size_t peakRss = 0; // KiB
+        std::string check;
+    };
+
+    // Nearest-rank percentile of sorted latencies.
+    inline double percentile(const std::vector<double>& sorted, double p) {
+        if (sorted.empty()) return 0;
+        size_t rank = static_cast<size_t>(p / 100.0 * sorted.size() + 0.999999);
+        if (rank < 1) rank = 1;
+        if (rank > sorted.size()) rank = sorted.size();
+        return sorted[rank - 1];
+    }
+
+    // Runs `request` options.iterations times spread over options.concurrency threads, after
+    // options.warmup unmeasured requests per thread. request(thread) may keep per-thread state
+    // indexed by thread.
+    inline Result run(const std::string& name, const Options& options, const std::function<void(size_t)>& request) {
+        size_t threads = std::min(options.concurrency, options.iterations);
+        std::vector<std::vector<double>> latencies(threads);
+        std::atomic<size_t> next(0);
+        std::exception_ptr error = nullptr;
+        std::mutex errorMutex;
+        resetPeakRss();
+
+        auto worker = [&](size_t t) {
+            try {
+                for (size_t i = 0; i < options.warmup; i++) request(t);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error) error = std::current_exception();
+            }
+        };
+        std::vector<std::thread> pool;
+        for (size_t t = 1; t < threads; t++) pool.emplace_back(worker, t);
+        worker(0);
+        for (auto& th: pool) th.join();
+        pool.clear();
+        if (error) std::rethrow_exception(error);
+
+        auto measured = [&](size_t t) {
+            while (true) {
+                size_t k = next.fetch_add(1);
+                if (k >= options.iterations) return;
+                try {
+                    auto begin = std::chrono::steady_clock::now();
+                    request(t);
+                    auto end = std::chrono::steady_clock::now();
+                    latencies[t].push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error) error = std::current_exception();
+                    next.store(options.iterations);
+                }
+            }
+        };
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t t = 1; t < threads; t++) pool.emplace_back(measured, t);
+        measured(0);
+        for (auto& th: pool) th.join();
+        auto end = std::chrono::steady_clock::now();
+        if (error) std::rethrow_exception(error);
+
+        std::vector<double> all;
+        for (auto& l: latencies) all.insert(all.end(), l.begin(), l.end());
+        std::sort(all.begin(), all.end());
+        Result result;
+        result.name = name;
+        result.requests = all.size();
+        result.seconds = std::chrono::duration<double>(end - begin).count();
+        result.p50 = percentile(all, 50);
+        result.p99 = percentile(all, 99);
+        result.max = all.empty() ? 0 : all.back();
+        result.peakRss = peakRssKiB();
+        return result;
+    }
+
+    inline void printHeader(const std::string& library, const Options& options) {
+        std::cout << library << " workloads: concurrency " << options.concurrency
+            << ", iterations " << options.iterations << ", inner threads " << options.innerThreads
+            << (options.small ? ", small shapes" : "") << "\n";
+        std::cout << std::left << std::setw(12) << "workload" << std::right
+            << std::setw(10) << "requests" << std::setw(12) << "req/s"
+            << std::setw(12) << "p50 ms" << std::setw(12) << "p99 ms" << std::setw(12) << "max ms"
+            << std::setw(14) << "peak RSS MiB" << "  check\n";
+    }
+
+    inline void printResult(const Result& r) {
+        std::cout << std::left << std::setw(12) << r.name << std::right << std::fixed
+            << std::setw(10) << r.requests
+            << std::setw(12) << std::setprecision(3) << (r.seconds > 0 ? r.requests / r.seconds : 0)
+            << std::setw(12) << std::setprecision(2) << r.p50
+            << std::setw(12) << r.p99
+            << std::setw(12) << r.max
+            << std::setw(14) << std::setprecision(1) << r.peakRss / 1024.0
+            << "  " << r.check << std::endl;
+    }
+
+    // Deterministic per-workload data so that both libraries see the same inputs.
+    class Random {
+        uint64_t state;
+    public:
+        explicit Random(uint64_t seed): state(seed * 0x9e3779b97f4a7c15ULL + 1) {}
+        uint64_t next() {
+            state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+            return state;
+        }
+        uint64_t below(uint64_t bound) {return next() % bound;}
+        double uniform(double low, double high) {
+            return low + (high - low) * (static_cast<double>(next() >> 11) / static_cast<double>(1ULL << 53));
+        }
+    };
+
+    inline std::vector<uint64_t> randomVector(Random& random, size_t count, uint64_t bound) {
+        std::vector<uint64_t> v(count);
+        for (auto& x: v) x = random.below(bound);
+        return v;
+    }
+
+    inline uint64_t mulAddMod(uint64_t acc, uint64_t a, uint64_t b, uint64_t mod) {
+        return static_cast<uint64_t>((acc + static_cast<unsigned __int128>(a) * b) % mod);
+    }
+
+    // y[batch, outputDims] = x[batch, inputDims] * w[inputDims, outputDims] mod `mod`.
+    inline std::vector<uint64_t> matmulReference(
+        const std::vector<uint64_t>& x, const std::vector<uint64_t>& w,
+        size_t batchSize, size_t inputDims, size_t outputDims, uint64_t mod
+    ) {
+        std::vector<uint64_t> y(batchSize * outputDims, 0);
+        for (size_t i = 0; i < batchSize; i++)
+            for (size_t j = 0; j < inputDims; j++)
+                for (size_t k = 0; k < outputDims; k++)
+                    y[i * outputDims + k] = mulAddMod(y[i * outputDims + k], x[i * inputDims + j], w[j * outputDims + k], mod);
+        return y;
+    }
+
+    // Valid cross-correlation of x[batch, ic, h, w] with w[oc, ic, kh, kw] mod `mod`.
+    inline std::vector<uint64_t> conv2dReference(
+        const std::vector<uint64_t>& x, const std::vector<uint64_t>& w,
+        size_t batchSize, size_t imageHeight, size_t imageWidth, size_t kernelHeight, size_t kernelWidth,
+        size_t inputChannels, size_t outputChannels, uint64_t mod
+    ) {
+        size_t yh = imageHeight - kernelHeight + 1, yw = imageWidth - kernelWidth + 1;
+        std::vector<uint64_t> y(batchSize * outputChannels * yh * yw, 0);
+        for (size_t b = 0; b < batchSize; b++)
+            for (size_t oc = 0; oc < outputChannels; oc++)
+                for (size_t ic = 0; ic < inputChannels; ic++)
+                    for (size_t ki = 0; ki < kernelHeight; ki++)
+                        for (size_t kj = 0; kj < kernelWidth; kj++) {
+                            uint64_t wv = w[((oc * inputChannels + ic) * kernelHeight + ki) * kernelWidth + kj];
+                            for (size_t i = 0; i < yh; i++)
+                                for (size_t j = 0; j < yw; j++) {
+                                    uint64_t& out = y[((b * outputChannels + oc) * yh + i) * yw + j];
+                                    out = mulAddMod(out, x[((b * inputChannels + ic) * imageHeight + i + ki) * imageWidth + j + kj], wv, mod);
+                                }
+                        }
+        return y;
+    }
+
+    inline std::string mismatches(const std::vector<uint64_t>& expected, const std::vector<uint64_t>& actual) {
+        size_t wrong = 0;
+        for (size_t i = 0; i < expected.size(); i++) if (i >= actual.size() || expected[i] != actual[i]) wrong++;
+        return wrong ? "FAILED " + std::to_string(wrong) + " wrong" : "exact";
+    }
+
+    inline std::string maxError(const std::vector<double>& expected, const std::vector<double>& actual) {
+        double error = 0;
+        for (size_t i = 0; i < expected.size(); i++) error = std::max(error, std::abs(expected[i] - actual[i]));
+        std::ostringstream s; s << "max error " << std::scientific << std::setprecision(2) << error;
+        if (!(error < 1e-3)) s << " FAILED";
+        return s.str();
+    }
+
+    // The activation workload evaluates this odd cubic (a least-squares fit of the sigmoid on
+    // [-8, 8] used by several CKKS inference papers) at every slot.
+    constexpr double sigmoidC0 = 0.5, sigmoidC1 = 0.197, sigmoidC3 = -0.004;
+
+    inline double sigmoidCubic(double x) {
+        return sigmoidC0 + sigmoidC1 * x + sigmoidC3 * x * x * x;
+    }
+
+    // The bsgs workload multiplies a d x d matrix, d = n1 * n2, with a length-d vector
+    // replicated over all slots. Diagonal k = n1 * j + i is returned pre-rotated right by
+    // n1 * j, so that the giant-step rotation by n1 * j can be applied after the inner sum
+    // over the n1 baby steps.
+    inline std::vector<double> bsgsDiagonal(const std::vector<double>& matrix, size_t n1, size_t n2, size_t k, size_t slots) {
+        size_t d = n1 * n2, shift = k / n1 * n1;
+        std::vector<double> diagonal(slots);
+        for (size_t t = 0; t < slots; t++) {
+            size_t row = (t + d - shift) % d;
+            diagonal[t] = matrix[row * d + (row + k) % d];
+        }
+        return diagonal;
+    }
+
+}
@@ -0,0 +1,325 @@
+#include "../../app/LinearHelperCPU.h"
+#include "workloads.h"
+#include <cmath>
+#include <complex>
+
+// Application-level benchmarks: each workload sets up its own keys once and then times
+// the server-side evaluation of one request, issued by --concurrency client threads
+// sharing the evaluator and keys. Every workload checks one result against a plaintext
+// reference before it is timed; the check column reports that comparison.
+//
+//   dense      BFV fully connected layer, the MatmulHelper shape of linear_seal
+//   conv       BFV 3x3 convolution with Conv2dHelper
+//   activation CKKS cubic sigmoid approximation on every slot
+//   aggregate  BFV sum of --aggregate ciphertexts streamed through addMany
+//   bsgs       CKKS baby-step giant-step matrix-vector product (rotation bound)
+//
+// workloads_seal.cpp runs the same workloads with Microsoft SEAL; it is not built yet.
+
+using namespace troy;
+using namespace std;
+using workloads::Options;
+using workloads::Result;
+
+static const vector<string> workloadNames = {"dense", "conv", "activation", "aggregate", "bsgs"};
+
+class BFVSetup {
+public:
+    SEALContext* context;
+    KeyGenerator* keygen;
+    PublicKey pk;
+    BatchEncoder* encoder;
+    Encryptor* encryptor;
+    Decryptor* decryptor;
+    Evaluator* evaluator;
+
+    BFVSetup(size_t polyModulusDegree, vector<int> qs, uint64_t plainModulus, size_t innerThreads) {
+        EncryptionParameters parms(SchemeType::bfv);
+        parms.setPolyModulusDegree(polyModulusDegree);
+        parms.setPlainModulus(plainModulus);
+        parms.setCoeffModulus(CoeffModulus::Create(polyModulusDegree, qs));
+        context = new SEALContext(parms, true, SecurityLevel::none);
+        keygen = new KeyGenerator(*context);
+        keygen->createPublicKey(pk);
+        encoder = new BatchEncoder(*context);
+        encryptor = new Encryptor(*context, pk);
+        encryptor->setSecretKey(keygen->secretKey());
+        decryptor = new Decryptor(*context, keygen->secretKey());
+        evaluator = new Evaluator(*context);
+        evaluator->setThreadCount(innerThreads);
+    }
+
+    ~BFVSetup() {
+        delete evaluator;
+        delete decryptor;
+        delete encryptor;
+        delete encoder;
+        delete keygen;
+        delete context;
+    }
+
+    uint64_t plainModulus() const {
+        return context->firstContextData()->parms().plainModulus().value();
+    }
+};
+
+class CKKSSetup {
+public:
+    SEALContext* context;
+    KeyGenerator* keygen;
+    PublicKey pk;
+    RelinKeys rlk;
+    GaloisKeys gk;
+    CKKSEncoder* encoder;
+    Encryptor* encryptor;
+    Decryptor* decryptor;
+    Evaluator* evaluator;
+    double scale;
+
+    CKKSSetup(size_t polyModulusDegree, vector<int> qs, double scale, const vector<int>& rotationSteps, size_t innerThreads):
+        scale(scale)
+    {
+        EncryptionParameters parms(SchemeType::ckks);
+        parms.setPolyModulusDegree(polyModulusDegree);
+        parms.setCoeffModulus(CoeffModulus::Create(polyModulusDegree, qs));
+        context = new SEALContext(parms, true, SecurityLevel::none);
+        keygen = new KeyGenerator(*context);
+        keygen->createPublicKey(pk);
+        keygen->createRelinKeys(rlk);
+        if (!rotationSteps.empty()) keygen->createGaloisKeys(rotationSteps, gk);
+        encoder = new CKKSEncoder(*context);
+        encryptor = new Encryptor(*context, pk);
+        decryptor = new Decryptor(*context, keygen->secretKey());
+        evaluator = new Evaluator(*context);
+        evaluator->setThreadCount(innerThreads);
+    }
+
+    ~CKKSSetup() {
+        delete evaluator;
+        delete decryptor;
+        delete encryptor;
+        delete encoder;
+        delete keygen;
+        delete context;
+    }
+
+    Plaintext encode(const vector<double>& values, ParmsID parmsID, double s) {
+        vector<complex<double>> c(values.begin(), values.end());
+        Plaintext p; encoder->encode(c, parmsID, s, p);
+        return p;
+    }
+
+    vector<double> decrypt(const Ciphertext& c) {
+        Plaintext p; decryptor->decrypt(c, p);
+        vector<complex<double>> v; encoder->decode(p, v);
+        vector<double> ret(v.size());
+        for (size_t i = 0; i < v.size(); i++) ret[i] = v[i].real();
+        return ret;
+    }
+};
+
+Result runDense(const Options& options) {
+    size_t batchSize = 1, inputDims = options.small ? 256 : 2048, outputDims = options.small ? 100 : 1001;
+    BFVSetup s(8192, {60, 60, 60}, 1ul << 41, options.innerThreads);
+    uint64_t mod = s.plainModulus();
+    workloads::Random random(1);
+    auto w = workloads::randomVector(random, inputDims * outputDims, mod);
+    auto x = workloads::randomVector(random, batchSize * inputDims, mod);
+    auto y = workloads::matmulReference(x, w, batchSize, inputDims, outputDims, mod);
+
+    LinearHelperCPU::MatmulHelper helper(batchSize, inputDims, outputDims, 8192, 0, false, options.innerThreads);
+    auto wNtt = helper.encodeWeights(*s.encoder, *s.evaluator, w.data(), s.context->firstParmsID());
+    auto xEnc = helper.encryptInputs(*s.encryptor, *s.encoder, x.data());
+    string check = workloads::mismatches(y, helper.decryptOutputs(*s.encoder, *s.decryptor, helper.matmul(*s.evaluator, xEnc, wNtt)));
+
+    vector<LinearHelperCPU::MatmulHelper> helpers(options.concurrency, helper);
+    Result r = workloads::run("dense", options, [&](size_t t) {
+        auto yEnc = helpers[t].matmul(*s.evaluator, xEnc, wNtt);
+    });
+    r.check = check;
+    return r;
+}
+
+Result runConv(const Options& options) {
+    size_t batchSize = 1, imageHeight = options.small ? 16 : 56, imageWidth = imageHeight;
+    size_t inputChannels = options.small ? 8 : 64, outputChannels = options.small ? 16 : 256;
+    size_t kernelHeight = 3, kernelWidth = 3;
+    BFVSetup s(8192, {60, 60, 60}, 1ul << 41, options.innerThreads);
+    uint64_t mod = s.plainModulus();
+    workloads::Random random(2);
+    auto w = workloads::randomVector(random, outputChannels * inputChannels * kernelHeight * kernelWidth, mod);
+    auto x = workloads::randomVector(random, batchSize * inputChannels * imageHeight * imageWidth, mod);
+    auto y = workloads::conv2dReference(x, w, batchSize, imageHeight, imageWidth, kernelHeight, kernelWidth,
+        inputChannels, outputChannels, mod);
+
+    LinearHelperCPU::Conv2dHelper helper(batchSize, imageHeight, imageWidth, kernelHeight, kernelWidth,
+        inputChannels, outputChannels, 8192, 0, false, options.innerThreads);
+    auto wNtt = helper.encodeWeights(*s.encoder, *s.evaluator, w, s.context->firstParmsID());
+    auto xEnc = helper.encryptInputs(*s.encryptor, *s.encoder, x);
+    string check = workloads::mismatches(y, helper.decryptOutputs(*s.encoder, *s.decryptor, helper.conv2d(*s.evaluator, xEnc, wNtt)));
+
+    vector<LinearHelperCPU::Conv2dHelper> helpers(options.concurrency, helper);
+    Result r = workloads::run("conv", options, [&](size_t t) {
+        auto yEnc = helpers[t].conv2d(*s.evaluator, xEnc, wNtt);
+    });
+    r.check = check;
+    return r;
+}
+
+Result runActivation(const Options& options) {
+    CKKSSetup s(8192, {60, 40, 40, 60}, std::pow(2.0, 40), {}, options.innerThreads);
+    size_t slots = 4096;
+    workloads::Random random(3);
+    vector<double> x(slots), y(slots);
+    for (size_t i = 0; i < slots; i++) {
+        x[i] = random.uniform(-8, 8);
+        y[i] = workloads::sigmoidCubic(x[i]);
+    }
+    auto first = s.context->firstContextData();
+    ParmsID level0 = first->parmsID();
+    ParmsID level2 = first->nextContextData()->nextContextData()->parmsID();
+    Plaintext c1 = s.encode(vector<double>(slots, workloads::sigmoidC1), level0, s.scale);
+    Plaintext c3 = s.encode(vector<double>(slots, workloads::sigmoidC3), level0, s.scale);
+    Plaintext c0 = s.encode(vector<double>(slots, workloads::sigmoidC0), level2, s.scale);
+    Ciphertext xEnc;
+    s.encryptor->encrypt(s.encode(x, level0, s.scale), xEnc);
+
+    // c0 + x * (c1 + c3 x^2) at depth 2: (c3 x) * x^2 and c1 x both end at level 2.
+    auto evaluate = [&](Ciphertext& result) {
+        const Evaluator& evaluator = *s.evaluator;
+        Ciphertext square, cubic;
+        evaluator.square(xEnc, square);
+        evaluator.relinearizeInplace(square, s.rlk);
+        evaluator.rescaleToNextInplace(square);
+        evaluator.multiplyPlain(xEnc, c3, cubic);
+        evaluator.rescaleToNextInplace(cubic);
+        evaluator.multiplyInplace(cubic, square);
+        evaluator.relinearizeInplace(cubic, s.rlk);
+        evaluator.rescaleToNextInplace(cubic);
+        evaluator.multiplyPlain(xEnc, c1, result);
+        evaluator.rescaleToNextInplace(result);
+        evaluator.modSwitchToInplace(result, level2);
+        cubic.scale() = s.scale;
+        result.scale() = s.scale;
+        evaluator.addInplace(result, cubic);
+        evaluator.addPlainInplace(result, c0);
+    };
+    Ciphertext result;
+    evaluate(result);
+    string check = workloads::maxError(y, s.decrypt(result));
+
+    Result r = workloads::run("activation", options, [&](size_t) {
+        Ciphertext out;
+        evaluate(out);
+    });
+    r.check = check;
+    return r;
+}
+
+Result runAggregate(const Options& options) {
+    BFVSetup s(4096, {36, 36, 37}, 65537, options.innerThreads);
+    uint64_t mod = s.plainModulus();
+    size_t count = options.aggregateCount, slots = 4096, poolSize = 16;
+    workloads::Random random(4);
+
+    // The stream cycles through a few distinct ciphertexts so that memory stays bounded
+    // however many are summed; every one is still copied out as if read from storage.
+    vector<Ciphertext> pool(poolSize);
+    vector<uint64_t> expected(slots, 0);
+    for (size_t i = 0; i < poolSize; i++) {
+        auto v = workloads::randomVector(random, slots, mod);
+        size_t occurrences = count / poolSize + (i < count % poolSize ? 1 : 0);
+        for (size_t j = 0; j < slots; j++) expected[j] = (expected[j] + v[j] * (occurrences % mod)) % mod;
+        Plaintext p; s.encoder->encode(v, p);
+        s.encryptor->encryptSymmetric(p, pool[i]);
+    }
+
+    auto evaluate = [&](Ciphertext& sum) {
+        size_t next = 0;
+        s.evaluator->addMany([&](Ciphertext& out) {
+            if (next == count) return false;
+            out = pool[next++ % poolSize];
+            return true;
+        }, sum);
+    };
+    Ciphertext sum;
+    evaluate(sum);
+    Plaintext p; s.decryptor->decrypt(sum, p);
+    vector<uint64_t> actual; s.encoder->decode(p, actual);
+    string check = workloads::mismatches(expected, actual);
+
+    Result r = workloads::run("aggregate", options, [&](size_t) {
+        Ciphertext out;
+        evaluate(out);
+    });
+    r.check = check + ", " + to_string(count) + " ciphertexts";
+    return r;
+}
+
+Result runBsgs(const Options& options) {
+    // d x d matrix times a vector replicated over all slots, with d = n1 * n2 diagonals:
+    // n1 - 1 baby-step rotations shared by all giant steps and n2 - 1 giant-step rotations.
+    size_t n1 = options.small ? 8 : 16, n2 = n1, d = n1 * n2, slots = 4096;
+    vector<int> steps;
+    for (size_t i = 1; i < n1; i++) steps.push_back(static_cast<int>(i));
+    for (size_t j = 1; j < n2; j++) steps.push_back(static_cast<int>(j * n1));
+    CKKSSetup s(8192, {60, 40, 60}, std::pow(2.0, 40), steps, options.innerThreads);
+    workloads::Random random(5);
+    vector<double> matrix(d * d), x(d), y(d, 0);
+    for (auto& m: matrix) m = random.uniform(-1, 1);
+    for (auto& v: x) v = random.uniform(-1, 1);
+    for (size_t i = 0; i < d; i++)
+        for (size_t j = 0; j < d; j++) y[i] += matrix[i * d + j] * x[j];
+
+    ParmsID parmsID = s.context->firstParmsID();
+    vector<Plaintext> diagonals(d);
+    for (size_t k = 0; k < d; k++) {
+        diagonals[k] = s.encode(workloads::bsgsDiagonal(matrix, n1, n2, k, slots), parmsID, s.scale);
+    }
+    vector<double> replicated(slots);
+    for (size_t t = 0; t < slots; t++) replicated[t] = x[t % d];
+    Ciphertext xEnc;
+    s.encryptor->encrypt(s.encode(replicated, parmsID, s.scale), xEnc);
+
+    auto evaluate = [&](Ciphertext& result) {
+        const Evaluator& evaluator = *s.evaluator;
+        vector<Ciphertext> baby(n1);
+        baby[0] = xEnc;
+        for (size_t i = 1; i < n1; i++) evaluator.rotateVector(xEnc, static_cast<int>(i), s.gk, baby[i]);
+        for (size_t j = 0; j < n2; j++) {
+            Ciphertext inner, term;
+            for (size_t i = 0; i < n1; i++) {
+                evaluator.multiplyPlain(baby[i], diagonals[n1 * j + i], term);
+                if (i == 0) inner = term;
+                else evaluator.addInplace(inner, term);
+            }
+            if (j > 0) evaluator.rotateVectorInplace(inner, static_cast<int>(n1 * j), s.gk);
+            if (j == 0) result = inner;
+            else evaluator.addInplace(result, inner);
+        }
+        evaluator.rescaleToNextInplace(result);
+    };
+    Ciphertext result;
+    evaluate(result);
+    auto decrypted = s.decrypt(result);
+    decrypted.resize(d);
+    string check = workloads::maxError(y, decrypted);
+
+    Result r = workloads::run("bsgs", options, [&](size_t) {
+        Ciphertext out;
+        evaluate(out);
+    });
+    r.check = check + ", " + to_string(n1 + n2 - 2) + " rotations";
+    return r;
+}
+
+int main(int argc, char** argv) {
+    Options options = workloads::parseOptions(argc, argv, workloadNames);
+    workloads::printHeader("troy", options);
+    if (options.runs("dense")) workloads::printResult(runDense(options));
+    if (options.runs("conv")) workloads::printResult(runConv(options));
+    if (options.runs("activation")) workloads::printResult(runActivation(options));
+    if (options.runs("aggregate")) workloads::printResult(runAggregate(options));
+    if (options.runs("bsgs")) workloads::printResult(runBsgs(options));
+    return 0;
+}
@@ -0,0 +1,311 @@
+#include "../../app/LinearHelperSEAL.h"
+#include "workloads.h"
+#include <cmath>
+
+// The workloads of workloads_cpu.cpp, run with Microsoft SEAL on the same parameters,
+// inputs and request definitions for comparison. SEAL has no intra-request parallelism,
+// so --inner-threads has no effect, and the aggregate workload adds the stream one
+// ciphertext at a time.
+//
+// Not part of the build yet: this file has not been compiled against SEAL 4.0. Add it to
+// test/CMakeLists.txt under TROY_COMPARE_SEAL (linked with SEAL::seal and Threads::Threads)
+// once it has been built and run.
+
+using namespace seal;
+using namespace std;
+using workloads::Options;
+using workloads::Result;
+
+static const vector<string> workloadNames = {"dense", "conv", "activation", "aggregate", "bsgs"};
+
+class BFVSetup {
+public:
+    SEALContext* context;
+    KeyGenerator* keygen;
+    PublicKey pk;
+    BatchEncoder* encoder;
+    Encryptor* encryptor;
+    Decryptor* decryptor;
+    Evaluator* evaluator;
+
+    BFVSetup(size_t polyModulusDegree, vector<int> qs, uint64_t plainModulus, bool batching) {
+        EncryptionParameters parms(scheme_type::bfv);
+        parms.set_poly_modulus_degree(polyModulusDegree);
+        parms.set_plain_modulus(plainModulus);
+        parms.set_coeff_modulus(CoeffModulus::Create(polyModulusDegree, qs));
+        context = new SEALContext(parms);
+        keygen = new KeyGenerator(*context);
+        keygen->create_public_key(pk);
+        encoder = batching ? new BatchEncoder(*context) : nullptr;
+        encryptor = new Encryptor(*context, pk);
+        encryptor->set_secret_key(keygen->secret_key());
+        decryptor = new Decryptor(*context, keygen->secret_key());
+        evaluator = new Evaluator(*context);
+    }
+
+    ~BFVSetup() {
+        delete evaluator;
+        delete decryptor;
+        delete encryptor;
+        delete encoder;
+        delete keygen;
+        delete context;
+    }
+
+    uint64_t plainModulus() const {
+        return context->first_context_data()->parms().plain_modulus().value();
+    }
+};
+
+class CKKSSetup {
+public:
+    SEALContext* context;
+    KeyGenerator* keygen;
+    PublicKey pk;
+    RelinKeys rlk;
+    GaloisKeys gk;
+    CKKSEncoder* encoder;
+    Encryptor* encryptor;
+    Decryptor* decryptor;
+    Evaluator* evaluator;
+    double scale;
+
+    CKKSSetup(size_t polyModulusDegree, vector<int> qs, double scale, const vector<int>& rotationSteps):
+        scale(scale)
+    {
+        EncryptionParameters parms(scheme_type::ckks);
+        parms.set_poly_modulus_degree(polyModulusDegree);
+        parms.set_coeff_modulus(CoeffModulus::Create(polyModulusDegree, qs));
+        context = new SEALContext(parms);
+        keygen = new KeyGenerator(*context);
+        keygen->create_public_key(pk);
+        keygen->create_relin_keys(rlk);
+        if (!rotationSteps.empty()) keygen->create_galois_keys(rotationSteps, gk);
+        encoder = new CKKSEncoder(*context);
+        encryptor = new Encryptor(*context, pk);
+        decryptor = new Decryptor(*context, keygen->secret_key());
+        evaluator = new Evaluator(*context);
+    }
+
+    ~CKKSSetup() {
+        delete evaluator;
+        delete decryptor;
+        delete encryptor;
+        delete encoder;
+        delete keygen;
+        delete context;
+    }
+
+    Plaintext encode(const vector<double>& values, parms_id_type parmsID, double s) {
+        Plaintext p; encoder->encode(values, parmsID, s, p);
+        return p;
+    }
+
+    vector<double> decrypt(const Ciphertext& c) {
+        Plaintext p; decryptor->decrypt(c, p);
+        vector<double> v; encoder->decode(p, v);
+        return v;
+    }
+};
+
+Result runDense(const Options& options) {
+    size_t batchSize = 1, inputDims = options.small ? 256 : 2048, outputDims = options.small ? 100 : 1001;
+    BFVSetup s(8192, {60, 60, 60}, 1ul << 41, false);
+    uint64_t mod = s.plainModulus();
+    workloads::Random random(1);
+    auto w = workloads::randomVector(random, inputDims * outputDims, mod);
+    auto x = workloads::randomVector(random, batchSize * inputDims, mod);
+    auto y = workloads::matmulReference(x, w, batchSize, inputDims, outputDims, mod);
+
+    LinearHelperSEAL::MatmulHelper helper(batchSize, inputDims, outputDims, 8192);
+    auto wEncoded = helper.encodeWeights(w);
+    auto xEnc = helper.encryptInputs(*s.encryptor, x);
+    string check = workloads::mismatches(y, helper.decryptOutputs(*s.decryptor, helper.matmul(*s.evaluator, xEnc, wEncoded)));
+
+    vector<LinearHelperSEAL::MatmulHelper> helpers(options.concurrency, helper);
+    Result r = workloads::run("dense", options, [&](size_t t) {
+        auto yEnc = helpers[t].matmul(*s.evaluator, xEnc, wEncoded);
+    });
+    r.check = check;
+    return r;
+}
+
+Result runConv(const Options& options) {
+    size_t batchSize = 1, imageHeight = options.small ? 16 : 56, imageWidth = imageHeight;
+    size_t inputChannels = options.small ? 8 : 64, outputChannels = options.small ? 16 : 256;
+    size_t kernelHeight = 3, kernelWidth = 3;
+    BFVSetup s(8192, {60, 60, 60}, 1ul << 41, false);
+    uint64_t mod = s.plainModulus();
+    workloads::Random random(2);
+    auto w = workloads::randomVector(random, outputChannels * inputChannels * kernelHeight * kernelWidth, mod);
+    auto x = workloads::randomVector(random, batchSize * inputChannels * imageHeight * imageWidth, mod);
+    auto y = workloads::conv2dReference(x, w, batchSize, imageHeight, imageWidth, kernelHeight, kernelWidth,
+        inputChannels, outputChannels, mod);
+
+    LinearHelperSEAL::Conv2dHelper helper(batchSize, imageHeight, imageWidth, kernelHeight, kernelWidth,
+        inputChannels, outputChannels, 8192);
+    auto wEncoded = helper.encodeWeights(w);
+    auto xEnc = helper.encryptInputs(*s.encryptor, x);
+    string check = workloads::mismatches(y, helper.decryptOutputs(*s.decryptor, helper.conv2d(*s.evaluator, xEnc, wEncoded)));
+
+    vector<LinearHelperSEAL::Conv2dHelper> helpers(options.concurrency, helper);
+    Result r = workloads::run("conv", options, [&](size_t t) {
+        auto yEnc = helpers[t].conv2d(*s.evaluator, xEnc, wEncoded);
+    });
+    r.check = check;
+    return r;
+}
+
+Result runActivation(const Options& options) {
+    CKKSSetup s(8192, {60, 40, 40, 60}, std::pow(2.0, 40), {});
+    size_t slots = 4096;
+    workloads::Random random(3);
+    vector<double> x(slots), y(slots);
+    for (size_t i = 0; i < slots; i++) {
+        x[i] = random.uniform(-8, 8);
+        y[i] = workloads::sigmoidCubic(x[i]);
+    }
+    auto first = s.context->first_context_data();
+    parms_id_type level0 = first->parms_id();
+    parms_id_type level2 = first->next_context_data()->next_context_data()->parms_id();
+    Plaintext c1 = s.encode(vector<double>(slots, workloads::sigmoidC1), level0, s.scale);
+    Plaintext c3 = s.encode(vector<double>(slots, workloads::sigmoidC3), level0, s.scale);
+    Plaintext c0 = s.encode(vector<double>(slots, workloads::sigmoidC0), level2, s.scale);
+    Ciphertext xEnc;
+    s.encryptor->encrypt(s.encode(x, level0, s.scale), xEnc);
+
+    // The same evaluation order as workloads_cpu.cpp.
+    auto evaluate = [&](Ciphertext& result) {
+        const Evaluator& evaluator = *s.evaluator;
+        Ciphertext square, cubic;
+        evaluator.square(xEnc, square);
+        evaluator.relinearize_inplace(square, s.rlk);
+        evaluator.rescale_to_next_inplace(square);
+        evaluator.multiply_plain(xEnc, c3, cubic);
+        evaluator.rescale_to_next_inplace(cubic);
+        evaluator.multiply_inplace(cubic, square);
+        evaluator.relinearize_inplace(cubic, s.rlk);
+        evaluator.rescale_to_next_inplace(cubic);
+        evaluator.multiply_plain(xEnc, c1, result);
+        evaluator.rescale_to_next_inplace(result);
+        evaluator.mod_switch_to_inplace(result, level2);
+        cubic.scale() = s.scale;
+        result.scale() = s.scale;
+        evaluator.add_inplace(result, cubic);
+        evaluator.add_plain_inplace(result, c0);
+    };
+    Ciphertext result;
+    evaluate(result);
+    string check = workloads::maxError(y, s.decrypt(result));
+
+    Result r = workloads::run("activation", options, [&](size_t) {
+        Ciphertext out;
+        evaluate(out);
+    });
+    r.check = check;
+    return r;
+}
+
+Result runAggregate(const Options& options) {
+    BFVSetup s(4096, {36, 36, 37}, 65537, true);
+    uint64_t mod = s.plainModulus();
+    size_t count = options.aggregateCount, slots = 4096, poolSize = 16;
+    workloads::Random random(4);
+
+    vector<Ciphertext> pool(poolSize);
+    vector<uint64_t> expected(slots, 0);
+    for (size_t i = 0; i < poolSize; i++) {
+        auto v = workloads::randomVector(random, slots, mod);
+        size_t occurrences = count / poolSize + (i < count % poolSize ? 1 : 0);
+        for (size_t j = 0; j < slots; j++) expected[j] = (expected[j] + v[j] * (occurrences % mod)) % mod;
+        Plaintext p; s.encoder->encode(v, p);
+        s.encryptor->encrypt_symmetric(p, pool[i]);
+    }
+
+    auto evaluate = [&](Ciphertext& sum) {
+        sum = pool[0];
+        Ciphertext next;
+        for (size_t k = 1; k < count; k++) {
+            next = pool[k % poolSize];
+            s.evaluator->add_inplace(sum, next);
+        }
+    };
+    Ciphertext sum;
+    evaluate(sum);
+    Plaintext p; s.decryptor->decrypt(sum, p);
+    vector<uint64_t> actual; s.encoder->decode(p, actual);
+    string check = workloads::mismatches(expected, actual);
+
+    Result r = workloads::run("aggregate", options, [&](size_t) {
+        Ciphertext out;
+        evaluate(out);
+    });
+    r.check = check + ", " + to_string(count) + " ciphertexts";
+    return r;
+}
+
+Result runBsgs(const Options& options) {
+    size_t n1 = options.small ? 8 : 16, n2 = n1, d = n1 * n2, slots = 4096;
+    vector<int> steps;
+    for (size_t i = 1; i < n1; i++) steps.push_back(static_cast<int>(i));
+    for (size_t j = 1; j < n2; j++) steps.push_back(static_cast<int>(j * n1));
+    CKKSSetup s(8192, {60, 40, 60}, std::pow(2.0, 40), steps);
+    workloads::Random random(5);
+    vector<double> matrix(d * d), x(d), y(d, 0);
+    for (auto& m: matrix) m = random.uniform(-1, 1);
+    for (auto& v: x) v = random.uniform(-1, 1);
+    for (size_t i = 0; i < d; i++)
+        for (size_t j = 0; j < d; j++) y[i] += matrix[i * d + j] * x[j];
+
+    parms_id_type parmsID = s.context->first_parms_id();
+    vector<Plaintext> diagonals(d);
+    for (size_t k = 0; k < d; k++) {
+        diagonals[k] = s.encode(workloads::bsgsDiagonal(matrix, n1, n2, k, slots), parmsID, s.scale);
+    }
+    vector<double> replicated(slots);
+    for (size_t t = 0; t < slots; t++) replicated[t] = x[t % d];
+    Ciphertext xEnc;
+    s.encryptor->encrypt(s.encode(replicated, parmsID, s.scale), xEnc);
+
+    auto evaluate = [&](Ciphertext& result) {
+        const Evaluator& evaluator = *s.evaluator;
+        vector<Ciphertext> baby(n1);
+        baby[0] = xEnc;
+        for (size_t i = 1; i < n1; i++) evaluator.rotate_vector(xEnc, static_cast<int>(i), s.gk, baby[i]);
+        for (size_t j = 0; j < n2; j++) {
+            Ciphertext inner, term;
+            for (size_t i = 0; i < n1; i++) {
+                evaluator.multiply_plain(baby[i], diagonals[n1 * j + i], term);
+                if (i == 0) inner = term;
+                else evaluator.add_inplace(inner, term);
+            }
+            if (j > 0) evaluator.rotate_vector_inplace(inner, static_cast<int>(n1 * j), s.gk);
+            if (j == 0) result = inner;
+            else evaluator.add_inplace(result, inner);
+        }
+        evaluator.rescale_to_next_inplace(result);
+    };
+    Ciphertext result;
+    evaluate(result);
+    auto decrypted = s.decrypt(result);
+    decrypted.resize(d);
+    string check = workloads::maxError(y, decrypted);
+
+    Result r = workloads::run("bsgs", options, [&](size_t) {
+        Ciphertext out;
+        evaluate(out);
+    });
+    r.check = check + ", " + to_string(n1 + n2 - 2) + " rotations";
+    return r;
+}
+
+int main(int argc, char** argv) {
+    Options options = workloads::parseOptions(argc, argv, workloadNames);
+    workloads::printHeader("SEAL", options);
+    if (options.runs("dense")) workloads::printResult(runDense(options));
+    if (options.runs("conv")) workloads::printResult(runConv(options));
+    if (options.runs("activation")) workloads::printResult(runActivation(options));
+    if (options.runs("aggregate")) workloads::printResult(runAggregate(options));
+    if (options.runs("bsgs")) workloads::printResult(runBsgs(options));
+    return 0;
+}
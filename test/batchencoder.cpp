@@ -119,4 +119,34 @@ namespace troytest
             ASSERT_EQ(0ULL, short_plain_vec2[i]);
         }
     }
+
+    TEST(BatchEncoderTest, EncodeDecodePolynomial)
+    {
+        EncryptionParameters parms(SchemeType::bfv);
+        parms.setPolyModulusDegree(64);
+        parms.setCoeffModulus(CoeffModulus::Create(64, { 60 }));
+        parms.setPlainModulus(257);
+
+        SEALContext context(parms, false, SecurityLevel::none);
+        BatchEncoder batch_encoder(context);
+
+        Plaintext plain;
+        vector<uint64_t> values{ 1, 2, 300, 256 };
+        batch_encoder.encodePolynomial(values, plain);
+        ASSERT_EQ(4ULL, plain.coeffCount());
+        ASSERT_TRUE(plain.to_string() == "100x^3 + 2Bx^2 + 2x^1 + 1");
+        vector<uint64_t> values2;
+        batch_encoder.decodePolynomial(plain, values2);
+        ASSERT_EQ((vector<uint64_t>{ 1, 2, 43, 256 }), values2);
+
+        vector<int64_t> signed_values{ -1, 5, -300 };
+        batch_encoder.encodePolynomial(signed_values, plain);
+        ASSERT_EQ(3ULL, plain.coeffCount());
+        vector<int64_t> signed_values2;
+        batch_encoder.decodePolynomial(plain, signed_values2);
+        ASSERT_EQ((vector<int64_t>{ -1, 5, -43 }), signed_values2);
+        ASSERT_THROW(batch_encoder.encodePolynomial(vector<int64_t>(65, 0), plain), invalid_argument);
+
+        ASSERT_THROW(batch_encoder.encodePolynomial(vector<uint64_t>(65, 0), plain), invalid_argument);
+    }
 } // namespace sealtest
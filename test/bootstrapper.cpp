@@ -0,0 +1,92 @@
+#include "../src/bootstrapper.h"
+#include "../src/ckks.h"
+#include "../src/context.h"
+#include "../src/decryptor.h"
+#include "../src/encryptor.h"
+#include "../src/keygenerator.h"
+#include "../src/modulus.h"
+#include <cmath>
+#include <complex>
+#include <random>
+#include <vector>
+#include "gtest/gtest.h"
+
+using namespace troy;
+using namespace std;
+
+namespace troytest
+{
+    TEST(CKKSBootstrapperTest, Bootstrap)
+    {
+        // q_0, two primes for the computation, the bootstrapping primes and the special prime.
+        EncryptionParameters parms(SchemeType::ckks);
+        size_t coeff_count = 1024;
+        parms.setPolyModulusDegree(coeff_count);
+        CKKSBootstrapParameters bootstrap_parms;
+        vector<int> bit_sizes{ 55, 40, 40 };
+        bit_sizes.insert(bit_sizes.end(), 3 + 9 + 3, 50);
+        bit_sizes.push_back(60);
+        parms.setCoeffModulus(CoeffModulus::Create(coeff_count, bit_sizes));
+        SEALContext context(parms, true, SecurityLevel::none);
+
+        CKKSBootstrapper bootstrapper(context, bootstrap_parms);
+        ASSERT_EQ(15, bootstrapper.depth());
+
+        KeyGenerator keygen(context, 32);
+        PublicKey pk;
+        keygen.createPublicKey(pk);
+        RelinKeys rlk;
+        keygen.createRelinKeys(rlk);
+        GaloisKeys glk;
+        keygen.createGaloisKeys(bootstrapper.galoisElements(), glk);
+        Encryptor encryptor(context, pk);
+        Decryptor decryptor(context, keygen.secretKey());
+        CKKSEncoder encoder(context);
+
+        mt19937 engine(7);
+        uniform_real_distribution<double> distribution(-1, 1);
+        vector<complex<double>> values(encoder.slotCount());
+        for (auto &value : values)
+        {
+            value = complex<double>(distribution(engine), distribution(engine));
+        }
+
+        // Start from the bottom of the chain, as a ciphertext that has used up its levels.
+        double scale = pow(2.0, 40);
+        Plaintext plain;
+        encoder.encode(values, context.lastParmsID(), scale, plain);
+        Ciphertext encrypted;
+        encryptor.encrypt(plain, encrypted);
+
+        Ciphertext refreshed;
+        bootstrapper.bootstrap(encrypted, rlk, glk, refreshed);
+        ASSERT_EQ(scale, refreshed.scale());
+        ASSERT_EQ(
+            context.firstContextData()->chainIndex() - bootstrapper.depth(),
+            context.getContextData(refreshed.parmsID())->chainIndex());
+
+        vector<complex<double>> result;
+        decryptor.decrypt(refreshed, plain);
+        encoder.decode(plain, result);
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            ASSERT_LT(abs(values[i] - result[i]), 1e-3);
+        }
+
+        // The refreshed ciphertext has levels left for computation.
+        bootstrapper.bootstrapInplace(refreshed, rlk, glk);
+        decryptor.decrypt(refreshed, plain);
+        encoder.decode(plain, result);
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            ASSERT_LT(abs(values[i] - result[i]), 1e-3);
+        }
+
+        CKKSBootstrapParameters bad_parms;
+        bad_parms.coeff_to_slot_levels = 0;
+        ASSERT_THROW(CKKSBootstrapper(context, bad_parms), invalid_argument);
+        bad_parms = CKKSBootstrapParameters();
+        bad_parms.double_angle_count = 10;
+        ASSERT_THROW(CKKSBootstrapper(context, bad_parms), invalid_argument);
+    }
+} // namespace troytest
@@ -246,6 +246,35 @@ namespace troytest
         }
     }
 
+    TEST(CKKSEncoderTest, CKKSEncoderDecodeAcrossLiftBoundary)
+    {
+        // Decoding lifts coefficients from the first two primes (about 2^60 here) and composes the ones that do not
+        // fit. Scales 2^53 and 2^55 give plaintexts where both paths are taken, the others only one of them.
+        EncryptionParameters parms(SchemeType::ckks);
+        size_t slots = 64;
+        parms.setPolyModulusDegree(slots << 1);
+        parms.setCoeffModulus(CoeffModulus::Create(slots << 1, { 30, 30, 30, 30, 30 }));
+        SEALContext context(parms, false, SecurityLevel::none);
+        CKKSEncoder encoder(context);
+
+        vector<complex<double>> values(slots);
+        for (size_t i = 0; i < slots; i++)
+        {
+            values[i] = complex<double>(static_cast<double>((i * 37) % 1024) - 512, static_cast<double>(i % 5));
+        }
+        for (int log_scale : { 20, 50, 53, 55, 70, 100 })
+        {
+            Plaintext plain;
+            encoder.encode(values, context.firstParmsID(), pow(2.0, log_scale), plain);
+            vector<complex<double>> result;
+            encoder.decode(plain, result);
+            for (size_t i = 0; i < slots; ++i)
+            {
+                ASSERT_LT(abs(values[i] - result[i]), 1e-3);
+            }
+        }
+    }
+
     TEST(CKKSEncoderTest, CKKSEncoderEncodeSingleDecodeTest)
     {
         EncryptionParameters parms(SchemeType::ckks);
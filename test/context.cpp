@@ -3,6 +3,9 @@
 
 #include "../src/context.h"
 #include "../src/modulus.h"
+#include "../src/utils/ntt.h"
+#include "../src/utils/rns.h"
+#include <sstream>
 #include "gtest/gtest.h"
 
 using namespace troy;
@@ -414,6 +417,80 @@ namespace troytest
         }
     }
 
+    TEST(ContextTest, PrecomputationSnapshot)
+    {
+        EncryptionParameters parms(SchemeType::bfv);
+        parms.setPolyModulusDegree(4096);
+        parms.setCoeffModulus(CoeffModulus::Create(4096, { 40, 40, 40 }));
+        parms.setPlainModulus(PlainModulus::Batching(4096, 20));
+        SEALContext context(parms, true, SecurityLevel::none);
+
+        stringstream stream;
+        context.savePrecomputation(stream);
+        SEALContext loaded(parms, stream, true, SecurityLevel::none);
+
+        auto sameTables = [](const util::NTTTables &a, const util::NTTTables &b) {
+            ASSERT_EQ(a.modulus().value(), b.modulus().value());
+            ASSERT_EQ(a.coeffCountPower(), b.coeffCountPower());
+            ASSERT_EQ(a.getRoot(), b.getRoot());
+            ASSERT_EQ(a.invDegreeModulo().operand, b.invDegreeModulo().operand);
+            ASSERT_EQ(a.invDegreeModulo().quotient, b.invDegreeModulo().quotient);
+            for (size_t i = 0; i < a.coeffCount(); i++)
+            {
+                ASSERT_EQ(a.getFromRootPowers(i).operand, b.getFromRootPowers(i).operand);
+                ASSERT_EQ(a.getFromRootPowers(i).quotient, b.getFromRootPowers(i).quotient);
+                ASSERT_EQ(a.getFromInvRootPowers(i).operand, b.getFromInvRootPowers(i).operand);
+                ASSERT_EQ(a.getFromInvRootPowers(i).quotient, b.getFromInvRootPowers(i).quotient);
+            }
+        };
+
+        ASSERT_EQ(context.keyParmsID(), loaded.keyParmsID());
+        ASSERT_EQ(context.firstParmsID(), loaded.firstParmsID());
+        ASSERT_EQ(context.lastParmsID(), loaded.lastParmsID());
+        auto a = context.keyContextData();
+        auto b = loaded.keyContextData();
+        while (a)
+        {
+            ASSERT_TRUE(!!b);
+            ASSERT_EQ(a->parmsID(), b->parmsID());
+            ASSERT_EQ(a->chainIndex(), b->chainIndex());
+            ASSERT_TRUE(b->qualifiers().using_batching);
+            for (size_t i = 0; i < a->parms().coeffModulus().size(); i++)
+                sameTables(a->smallNTTTables()[i], b->smallNTTTables()[i]);
+            sameTables(*a->plainNTTTables(), *b->plainNTTTables());
+            for (size_t i = 0; i < a->rnsTool()->baseBsk()->size(); i++)
+                sameTables(a->rnsTool()->baseBskNttTables()[i], b->rnsTool()->baseBskNttTables()[i]);
+            a = a->nextContextData();
+            b = b->nextContextData();
+        }
+        ASSERT_FALSE(!!b);
+
+        // The snapshot only loads for the parameters it was written for.
+        EncryptionParameters other = parms;
+        other.setCoeffModulus(CoeffModulus::Create(4096, { 40, 40 }));
+        stream.clear();
+        stream.seekg(0);
+        ASSERT_THROW(SEALContext(other, stream, true, SecurityLevel::none), invalid_argument);
+        stringstream garbage("not a snapshot");
+        ASSERT_THROW(SEALContext(parms, garbage, true, SecurityLevel::none), invalid_argument);
+
+        // A valid header does not vouch for the tables: a flipped bit in the body, a truncated body or a damaged
+        // checksum is rejected.
+        string snapshot = stream.str();
+        string flipped = snapshot;
+        flipped[flipped.size() / 2] ^= 1;
+        stringstream flipped_stream(flipped);
+        ASSERT_THROW(SEALContext(parms, flipped_stream, true, SecurityLevel::none), invalid_argument);
+        stringstream truncated(snapshot.substr(0, snapshot.size() - 1000));
+        ASSERT_THROW(SEALContext(parms, truncated, true, SecurityLevel::none), invalid_argument);
+        string bad_checksum = snapshot;
+        bad_checksum.back() ^= 1;
+        stringstream bad_checksum_stream(bad_checksum);
+        ASSERT_THROW(SEALContext(parms, bad_checksum_stream, true, SecurityLevel::none), invalid_argument);
+        stringstream intact(snapshot);
+        ASSERT_NO_THROW(SEALContext(parms, intact, true, SecurityLevel::none));
+    }
+
     TEST(EncryptionParameterQualifiersTest, BFVParameterError)
     {
         auto scheme = SchemeType::bfv;
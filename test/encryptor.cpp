@@ -1052,4 +1052,122 @@ namespace troytest
             // ASSERT_TRUE(pt.isZero());
         }
     }
+
+    TEST(EncryptorTest, BFVBGVEncryptDecryptValues)
+    {
+        for (SchemeType scheme : { SchemeType::bfv, SchemeType::bgv })
+        {
+            EncryptionParameters parms(scheme);
+            parms.setPolyModulusDegree(64);
+            parms.setPlainModulus(PlainModulus::Batching(64, 20));
+            parms.setCoeffModulus(CoeffModulus::Create(64, { 30, 30, 30 }));
+            SEALContext context(parms, true, SecurityLevel::none);
+            KeyGenerator keygen(context);
+            PublicKey pk;
+            keygen.createPublicKey(pk);
+
+            BatchEncoder encoder(context);
+            Encryptor encryptor(context, pk, keygen.secretKey());
+            Decryptor decryptor(context, keygen.secretKey());
+            uint64_t t = parms.plainModulus().value();
+
+            vector<uint64_t> values(encoder.slotCount());
+            vector<int64_t> signed_values(encoder.slotCount() / 2);
+            for (size_t i = 0; i < values.size(); i++)
+            {
+                values[i] = (i * 7919 + 13) % t;
+            }
+            for (size_t i = 0; i < signed_values.size(); i++)
+            {
+                signed_values[i] = static_cast<int64_t>(i * 31) - 500;
+            }
+
+            Ciphertext encrypted;
+            Plaintext plain;
+            vector<uint64_t> result;
+            vector<int64_t> signed_result;
+
+            // Fused both ways, and each fused half against its unfused counterpart.
+            encryptor.encryptValues(encoder, values, encrypted);
+            ASSERT_EQ(context.firstParmsID(), encrypted.parmsID());
+            decryptor.decryptValues(encoder, encrypted, result);
+            ASSERT_EQ(values, result);
+            decryptor.decrypt(encrypted, plain);
+            encoder.decode(plain, result);
+            ASSERT_EQ(values, result);
+
+            encoder.encode(values, plain);
+            encryptor.encrypt(plain, encrypted);
+            decryptor.decryptValues(encoder, encrypted, result);
+            ASSERT_EQ(values, result);
+
+            // Short inputs are padded with zeros, as in encode.
+            encryptor.encryptValuesSymmetric(encoder, signed_values, encrypted);
+            decryptor.decryptValues(encoder, encrypted, signed_result);
+            ASSERT_EQ(encoder.slotCount(), signed_result.size());
+            for (size_t i = 0; i < signed_result.size(); i++)
+            {
+                ASSERT_EQ(i < signed_values.size() ? signed_values[i] : 0, signed_result[i]);
+            }
+
+            values.push_back(0);
+            ASSERT_THROW(encryptor.encryptValues(encoder, values, encrypted), invalid_argument);
+        }
+    }
+
+    TEST(EncryptorTest, CKKSEncryptDecryptValues)
+    {
+        EncryptionParameters parms(SchemeType::ckks);
+        size_t slot_size = 32;
+        parms.setPolyModulusDegree(2 * slot_size);
+        parms.setCoeffModulus(CoeffModulus::Create(2 * slot_size, { 60, 40, 40, 60 }));
+        SEALContext context(parms, true, SecurityLevel::none);
+        KeyGenerator keygen(context);
+        PublicKey pk;
+        keygen.createPublicKey(pk);
+
+        CKKSEncoder encoder(context);
+        Encryptor encryptor(context, pk, keygen.secretKey());
+        Decryptor decryptor(context, keygen.secretKey());
+        const double delta = pow(2.0, 40);
+
+        vector<complex<double>> input(slot_size);
+        for (size_t i = 0; i < slot_size; i++)
+        {
+            input[i] = complex<double>(static_cast<double>(i) / 3 - 5, 1.0 / (i + 1));
+        }
+
+        Ciphertext encrypted;
+        Plaintext plain;
+        vector<complex<double>> output;
+        auto check = [&]() {
+            ASSERT_EQ(slot_size, output.size());
+            for (size_t i = 0; i < slot_size; i++)
+            {
+                ASSERT_LT(abs(input[i] - output[i]), 1e-5);
+            }
+        };
+
+        encryptor.encryptValues(encoder, input, delta, encrypted);
+        ASSERT_EQ(context.firstParmsID(), encrypted.parmsID());
+        ASSERT_DOUBLE_EQ(delta, encrypted.scale());
+        decryptor.decryptValues(encoder, encrypted, output);
+        check();
+        decryptor.decrypt(encrypted, plain);
+        encoder.decode(plain, output);
+        check();
+
+        auto next_parms_id = context.firstContextData()->nextContextData()->parmsID();
+        encoder.encode(input, next_parms_id, delta, plain);
+        encryptor.encrypt(plain, encrypted);
+        decryptor.decryptValues(encoder, encrypted, output);
+        check();
+
+        encryptor.encryptValuesSymmetric(encoder, input, next_parms_id, delta, encrypted);
+        ASSERT_EQ(next_parms_id, encrypted.parmsID());
+        decryptor.decryptValues(encoder, encrypted, output);
+        check();
+
+        ASSERT_THROW(encryptor.encryptValues(encoder, input, 0.0, encrypted), invalid_argument);
+    }
 } // namespace sealtest
@@ -1,6 +1,7 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT license.
 
+#include "../src/aggregator.h"
 #include "../src/batchencoder.h"
 #include "../src/ckks.h"
 #include "../src/context.h"
@@ -12,6 +13,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <ctime>
+#include <functional>
 #include <string>
 #include "gtest/gtest.h"
 
@@ -1096,6 +1098,71 @@ namespace troytest
         ASSERT_TRUE(encrypted1.parmsID() == context.firstParmsID());
     }
 
+    TEST(EvaluatorTest, BFVEncryptAddSubScaledPlainDecrypt)
+    {
+        EncryptionParameters parms(SchemeType::bfv);
+        Modulus plain_modulus(1 << 6);
+        parms.setPolyModulusDegree(64);
+        parms.setPlainModulus(plain_modulus);
+        parms.setCoeffModulus(CoeffModulus::Create(64, { 40, 40, 40 }));
+
+        SEALContext context(parms, true, SecurityLevel::none);
+        KeyGenerator keygen(context);
+        PublicKey pk;
+        keygen.createPublicKey(pk);
+
+        Encryptor encryptor(context, pk);
+        encryptor.setSecretKey(keygen.secretKey());
+        Evaluator evaluator(context);
+        Decryptor decryptor(context, keygen.secretKey());
+
+        Ciphertext encrypted, expected;
+        Plaintext plain, plain1, plain2;
+        ScaledPlaintext scaled;
+
+        plain1 = "1x^28 + 1x^25 + 1x^21 + 1x^20 + 1x^18 + 1x^14 + 1x^12 + 1x^10 + 1x^9 + 1x^6 + 1x^5 + 1x^4 + 1x^3";
+        plain2 = "3Fx^18 + 1x^16 + 1x^14 + 1x^9 + 1x^8 + 1x^5 + 1";
+        evaluator.scalePlain(plain2, scaled);
+        ASSERT_TRUE(scaled.parmsID() == context.firstParmsID());
+
+        // Same ciphertext bits as the unscaled path.
+        encryptor.encrypt(plain1, encrypted);
+        evaluator.addPlain(encrypted, plain2, expected);
+        evaluator.addPlainInplace(encrypted, scaled);
+        ASSERT_EQ(encrypted.dynArray().size(), expected.dynArray().size());
+        for (size_t i = 0; i < encrypted.dynArray().size(); i++)
+            ASSERT_EQ(encrypted.data()[i], expected.data()[i]);
+        decryptor.decrypt(encrypted, plain);
+        ASSERT_EQ(
+            plain.to_string(), "1x^28 + 1x^25 + 1x^21 + 1x^20 + 1x^16 + 2x^14 + 1x^12 + 1x^10 + 2x^9 + 1x^8 + "
+                               "1x^6 + 2x^5 + 1x^4 + 1x^3 + 1");
+
+        evaluator.subPlainInplace(encrypted, scaled);
+        decryptor.decrypt(encrypted, plain);
+        ASSERT_EQ(plain.to_string(), plain1.to_string());
+
+        // Encryption of a scaled plaintext, symmetric and asymmetric.
+        encryptor.encrypt(scaled, encrypted);
+        decryptor.decrypt(encrypted, plain);
+        ASSERT_EQ(plain.to_string(), plain2.to_string());
+        encryptor.encryptSymmetric(scaled, encrypted);
+        decryptor.decrypt(encrypted, plain);
+        ASSERT_EQ(plain.to_string(), plain2.to_string());
+
+        // Scaling at a lower level.
+        auto next_parms_id = context.firstContextData()->nextContextData()->parmsID();
+        evaluator.scalePlain(plain2, next_parms_id, scaled);
+        encryptor.encrypt(plain1, encrypted);
+        ASSERT_THROW(evaluator.addPlainInplace(encrypted, scaled), std::invalid_argument);
+        evaluator.modSwitchToNextInplace(encrypted);
+        evaluator.addPlainInplace(encrypted, scaled);
+        ASSERT_TRUE(encrypted.parmsID() == next_parms_id);
+        decryptor.decrypt(encrypted, plain);
+        ASSERT_EQ(
+            plain.to_string(), "1x^28 + 1x^25 + 1x^21 + 1x^20 + 1x^16 + 2x^14 + 1x^12 + 1x^10 + 2x^9 + 1x^8 + "
+                               "1x^6 + 2x^5 + 1x^4 + 1x^3 + 1");
+    }
+
     TEST(EvaluatorTest, BFVEncryptMultiplyPlainDecrypt)
     {
         {
@@ -2500,6 +2567,218 @@ namespace troytest
         ASSERT_TRUE(plain2.to_string() == "1x^40 + 8x^30 + 18x^20 + 20x^10 + 10");
     }
 
+    TEST(EvaluatorTest, KeySwitchThreadCount)
+    {
+        EncryptionParameters parms(SchemeType::ckks);
+        parms.setPolyModulusDegree(64);
+        parms.setCoeffModulus(CoeffModulus::Create(64, { 40, 40, 40, 40, 40 }));
+
+        SEALContext context(parms, true, SecurityLevel::none);
+        KeyGenerator keygen(context);
+        PublicKey pk;
+        keygen.createPublicKey(pk);
+        RelinKeys rlk;
+        keygen.createRelinKeys(rlk);
+        GaloisKeys glk;
+        keygen.createGaloisKeys(glk);
+
+        Encryptor encryptor(context, pk);
+        Evaluator serial(context);
+        Evaluator threaded(context);
+        threaded.setThreadCount(3);
+        ASSERT_EQ(1, serial.threadCount());
+        ASSERT_EQ(3, threaded.threadCount());
+        CKKSEncoder encoder(context);
+
+        vector<complex<double>> input(encoder.slotCount(), complex<double>(1.5, -0.5));
+        Plaintext plain;
+        encoder.encode(input, context.firstParmsID(), static_cast<double>(1ULL << 20), plain);
+        Ciphertext encrypted;
+        encryptor.encrypt(plain, encrypted);
+
+        // Splitting the RNS limbs among threads must not change a single coefficient.
+        auto check = [&](const function<void(const Evaluator &, Ciphertext &)> &op) {
+            Ciphertext expected = encrypted;
+            Ciphertext actual = encrypted;
+            op(serial, expected);
+            op(threaded, actual);
+            ASSERT_EQ(expected.dynArray().size(), actual.dynArray().size());
+            for (size_t i = 0; i < expected.dynArray().size(); i++)
+            {
+                ASSERT_EQ(expected.dynArray()[i], actual.dynArray()[i]);
+            }
+        };
+        check([&](const Evaluator &evaluator, Ciphertext &c) {
+            evaluator.squareInplace(c);
+            evaluator.relinearizeInplace(c, rlk);
+        });
+        check([&](const Evaluator &evaluator, Ciphertext &c) { evaluator.rotateVectorInplace(c, 3, glk); });
+        check([&](const Evaluator &evaluator, Ciphertext &c) { evaluator.complexConjugateInplace(c, glk); });
+    }
+
+    TEST(EvaluatorTest, KeySwitchPackedKeys)
+    {
+        EncryptionParameters parms(SchemeType::ckks);
+        parms.setPolyModulusDegree(64);
+        parms.setCoeffModulus(CoeffModulus::Create(64, { 40, 40, 40, 40, 40 }));
+
+        SEALContext context(parms, true, SecurityLevel::none);
+        KeyGenerator keygen(context);
+        PublicKey pk;
+        keygen.createPublicKey(pk);
+        RelinKeys rlk;
+        keygen.createRelinKeys(rlk);
+        GaloisKeys glk;
+        keygen.createGaloisKeys(glk);
+
+        RelinKeys packed_rlk = rlk;
+        packed_rlk.pack();
+        GaloisKeys packed_glk = glk;
+        packed_glk.pack();
+        ASSERT_FALSE(rlk.isPacked(RelinKeys::getIndex(2)));
+        ASSERT_TRUE(packed_rlk.isPacked(RelinKeys::getIndex(2)));
+        ASSERT_TRUE(packed_glk.isPacked(GaloisKeys::getIndex(127)));
+
+        // Copies share the packed buffer; mutable access drops it.
+        GaloisKeys copied_glk = packed_glk;
+        ASSERT_EQ(packed_glk.packedData(GaloisKeys::getIndex(127)), copied_glk.packedData(GaloisKeys::getIndex(127)));
+        copied_glk.data();
+        ASSERT_FALSE(copied_glk.isPacked(GaloisKeys::getIndex(127)));
+
+        Encryptor encryptor(context, pk);
+        Evaluator evaluator(context);
+        CKKSEncoder encoder(context);
+
+        vector<complex<double>> input(encoder.slotCount(), complex<double>(0.5, 2.5));
+        Plaintext plain;
+        encoder.encode(input, context.firstParmsID(), static_cast<double>(1ULL << 20), plain);
+        Ciphertext encrypted;
+        encryptor.encrypt(plain, encrypted);
+
+        auto check = [&](const function<void(const RelinKeys &, const GaloisKeys &, Ciphertext &)> &op) {
+            Ciphertext expected = encrypted;
+            Ciphertext actual = encrypted;
+            op(rlk, glk, expected);
+            op(packed_rlk, packed_glk, actual);
+            ASSERT_EQ(expected.dynArray().size(), actual.dynArray().size());
+            for (size_t i = 0; i < expected.dynArray().size(); i++)
+            {
+                ASSERT_EQ(expected.dynArray()[i], actual.dynArray()[i]);
+            }
+        };
+        check([&](const RelinKeys &relin_keys, const GaloisKeys &, Ciphertext &c) {
+            evaluator.squareInplace(c);
+            evaluator.relinearizeInplace(c, relin_keys);
+        });
+        check([&](const RelinKeys &, const GaloisKeys &galois_keys, Ciphertext &c) {
+            evaluator.rescaleToNextInplace(c);
+            evaluator.rotateVectorInplace(c, 5, galois_keys);
+        });
+    }
+
+    TEST(EvaluatorTest, RelinearizeRotateMany)
+    {
+        auto assert_same = [](const Ciphertext &expected, const Ciphertext &actual) {
+            ASSERT_EQ(expected.parmsID(), actual.parmsID());
+            ASSERT_EQ(expected.dynArray().size(), actual.dynArray().size());
+            for (size_t i = 0; i < expected.dynArray().size(); i++)
+            {
+                ASSERT_EQ(expected.dynArray()[i], actual.dynArray()[i]);
+            }
+        };
+        {
+            EncryptionParameters parms(SchemeType::bfv);
+            parms.setPolyModulusDegree(64);
+            parms.setPlainModulus(PlainModulus::Batching(64, 20));
+            parms.setCoeffModulus(CoeffModulus::Create(64, { 40, 40, 40, 40 }));
+
+            SEALContext context(parms, true, SecurityLevel::none);
+            KeyGenerator keygen(context);
+            PublicKey pk;
+            keygen.createPublicKey(pk);
+            RelinKeys rlk;
+            keygen.createRelinKeys(rlk);
+            GaloisKeys glk;
+            keygen.createGaloisKeys(glk);
+
+            Encryptor encryptor(context, pk);
+            Evaluator evaluator(context);
+            // The keys here are tiny; force the batched path.
+            evaluator.setBatchKeySwitchingThreshold(1);
+            BatchEncoder encoder(context);
+
+            // More ciphertexts than fit one batch, at two different levels.
+            vector<Ciphertext> batch(11);
+            for (size_t i = 0; i < batch.size(); i++)
+            {
+                vector<uint64_t> values(encoder.slotCount(), i + 1);
+                Plaintext plain;
+                encoder.encode(values, plain);
+                encryptor.encrypt(plain, batch[i]);
+                evaluator.squareInplace(batch[i]);
+                if (i % 3 == 0)
+                {
+                    evaluator.modSwitchToNextInplace(batch[i]);
+                }
+            }
+            vector<Ciphertext> expected = batch;
+            for (auto &c : expected)
+            {
+                evaluator.relinearizeInplace(c, rlk);
+                evaluator.rotateRowsInplace(c, 5, glk);
+            }
+            evaluator.relinearizeManyInplace(batch, rlk);
+            evaluator.rotateRowsManyInplace(batch, 5, glk);
+            for (size_t i = 0; i < batch.size(); i++)
+            {
+                assert_same(expected[i], batch[i]);
+            }
+            ASSERT_THROW(evaluator.rotateVectorManyInplace(batch, 1, glk), logic_error);
+        }
+        {
+            EncryptionParameters parms(SchemeType::ckks);
+            parms.setPolyModulusDegree(64);
+            parms.setCoeffModulus(CoeffModulus::Create(64, { 40, 40, 40, 40 }));
+
+            SEALContext context(parms, true, SecurityLevel::none);
+            KeyGenerator keygen(context);
+            PublicKey pk;
+            keygen.createPublicKey(pk);
+            RelinKeys rlk;
+            keygen.createRelinKeys(rlk);
+            GaloisKeys glk;
+            keygen.createGaloisKeys(glk);
+
+            Encryptor encryptor(context, pk);
+            Evaluator evaluator(context);
+            // The keys here are tiny; force the batched path.
+            evaluator.setBatchKeySwitchingThreshold(1);
+            CKKSEncoder encoder(context);
+
+            vector<Ciphertext> batch(4);
+            for (size_t i = 0; i < batch.size(); i++)
+            {
+                vector<complex<double>> values(encoder.slotCount(), complex<double>(double(i), 1.0));
+                Plaintext plain;
+                encoder.encode(values, context.firstParmsID(), static_cast<double>(1ULL << 20), plain);
+                encryptor.encrypt(plain, batch[i]);
+                evaluator.squareInplace(batch[i]);
+            }
+            vector<Ciphertext> expected = batch;
+            for (auto &c : expected)
+            {
+                evaluator.relinearizeInplace(c, rlk);
+                evaluator.rotateVectorInplace(c, -3, glk);
+            }
+            evaluator.relinearizeManyInplace(batch, rlk);
+            evaluator.rotateVectorManyInplace(batch, -3, glk);
+            for (size_t i = 0; i < batch.size(); i++)
+            {
+                assert_same(expected[i], batch[i]);
+            }
+        }
+    }
+
     TEST(EvaluatorTest, BGVRelinearize)
     {
         EncryptionParameters parms(SchemeType::bgv);
@@ -4789,6 +5068,126 @@ namespace troytest
         ASSERT_TRUE(sum.parmsID() == context.firstParmsID());
     }
 
+    TEST(EvaluatorTest, BFVAddManyLazyAggregation)
+    {
+        EncryptionParameters parms(SchemeType::bfv);
+        Modulus plain_modulus(1 << 6);
+        parms.setPolyModulusDegree(64);
+        parms.setPlainModulus(plain_modulus);
+        // 60-bit primes leave headroom for only 16 unreduced additions, so 100 inputs reduce several times.
+        parms.setCoeffModulus(CoeffModulus::Create(64, { 60, 60, 30 }));
+
+        SEALContext context(parms, false, SecurityLevel::none);
+        KeyGenerator keygen(context);
+        PublicKey pk;
+        keygen.createPublicKey(pk);
+
+        Encryptor encryptor(context, pk);
+        Evaluator evaluator(context);
+        Decryptor decryptor(context, keygen.secretKey());
+
+        vector<Ciphertext> encrypteds(100);
+        Plaintext plain("1x^3 + 2");
+        for (size_t i = 0; i < encrypteds.size(); i++)
+        {
+            encryptor.encrypt(plain, encrypteds[i]);
+        }
+        // A size-3 input in the middle of the set.
+        evaluator.squareInplace(encrypteds[37]);
+
+        Ciphertext expected = encrypteds[0];
+        for (size_t i = 1; i < encrypteds.size(); i++)
+        {
+            evaluator.addInplace(expected, encrypteds[i]);
+        }
+        auto assert_same = [&](const Ciphertext &actual) {
+            ASSERT_EQ(expected.size(), actual.size());
+            ASSERT_EQ(expected.dynArray().size(), actual.dynArray().size());
+            for (size_t i = 0; i < expected.dynArray().size(); i++)
+            {
+                ASSERT_EQ(expected.dynArray()[i], actual.dynArray()[i]);
+            }
+        };
+
+        Ciphertext sum;
+        for (size_t threads : { 1, 3, 8 })
+        {
+            evaluator.setThreadCount(threads);
+            evaluator.addMany(encrypteds, sum);
+            assert_same(sum);
+
+            size_t index = 0;
+            evaluator.addMany(
+                [&](Ciphertext &next) {
+                    if (index == encrypteds.size())
+                    {
+                        return false;
+                    }
+                    next = encrypteds[index++];
+                    return true;
+                },
+                sum);
+            assert_same(sum);
+        }
+        ASSERT_THROW(evaluator.addMany([](Ciphertext &) { return false; }, sum), invalid_argument);
+
+        // A failure near the start of a long stream stops every worker instead of draining the stream.
+        Ciphertext ntt_form = encrypteds[1];
+        evaluator.transformToNttInplace(ntt_form);
+        evaluator.setThreadCount(4);
+        for (bool producer_fails : { true, false })
+        {
+            size_t calls = 0;
+            auto next = [&](Ciphertext &next) {
+                calls++;
+                if (calls >= 10000)
+                {
+                    return false;
+                }
+                if (calls == 5)
+                {
+                    if (producer_fails)
+                    {
+                        throw runtime_error("producer failed");
+                    }
+                    next = ntt_form;
+                    return true;
+                }
+                next = encrypteds[calls % encrypteds.size()];
+                return true;
+            };
+            if (producer_fails)
+            {
+                ASSERT_THROW(evaluator.addMany(next, sum), runtime_error);
+            }
+            else
+            {
+                ASSERT_THROW(evaluator.addMany(next, sum), invalid_argument);
+            }
+            ASSERT_LT(calls, 5 + 2 * evaluator.threadCount());
+        }
+
+        CiphertextAggregator first(context), second(context);
+        for (size_t i = 0; i < encrypteds.size(); i++)
+        {
+            (i % 2 ? first : second).add(encrypteds[i]);
+        }
+        first.merge(second);
+        ASSERT_EQ(encrypteds.size(), first.count());
+        first.result(sum);
+        assert_same(sum);
+        decryptor.decrypt(sum, plain);
+        ASSERT_EQ(plain.to_string(), "1x^6 + 27x^3 + A");
+
+        first.clear();
+        ASSERT_EQ(0, first.count());
+        ASSERT_THROW(first.result(sum), logic_error);
+        Ciphertext scaled = encrypteds[0];
+        scaled.correctionFactor() = 2;
+        first.add(encrypteds[0]);
+        ASSERT_THROW(first.add(scaled), invalid_argument);
+    }
+
     TEST(EvaluatorTest, BGVEncryptSquareDecrypt)
     {
         EncryptionParameters parms(SchemeType::bgv);
@@ -6149,4 +6548,513 @@ namespace troytest
         ASSERT_TRUE(encrypted.parmsID() == parms_id);
         ASSERT_TRUE(plain.to_string() == "5x^64 + Ax^5");
     }
+
+    TEST(EvaluatorTest, BFVEncryptMultiplyPlainAccumulateDecrypt)
+    {
+        EncryptionParameters parms(SchemeType::bfv);
+        Modulus plain_modulus(1 << 6);
+        parms.setPolyModulusDegree(64);
+        parms.setPlainModulus(plain_modulus);
+        parms.setCoeffModulus(CoeffModulus::Create(64, { 40, 40 }));
+
+        SEALContext context(parms, false, SecurityLevel::none);
+        KeyGenerator keygen(context);
+        PublicKey pk;
+        keygen.createPublicKey(pk);
+
+        Encryptor encryptor(context, pk);
+        Evaluator evaluator(context);
+        Decryptor decryptor(context, keygen.secretKey());
+
+        vector<string> xs{ "1x^2 + 3", "2x^1", "Fx^63 + 1", "5" };
+        vector<string> ws{ "2", "3x^1 + 1", "1x^1", "1x^3 + 3Fx^2" };
+        vector<Ciphertext> encrypteds(xs.size());
+        vector<Plaintext> plains(ws.size());
+        vector<const Ciphertext *> encrypted_ptrs;
+        vector<const Plaintext *> plain_ptrs;
+        Ciphertext expected;
+        for (size_t i = 0; i < xs.size(); i++)
+        {
+            encryptor.encrypt(Plaintext(xs[i]), encrypteds[i]);
+            plains[i] = ws[i];
+            Ciphertext product;
+            evaluator.multiplyPlain(encrypteds[i], plains[i], product);
+            if (i == 0)
+                expected = product;
+            else
+                evaluator.addInplace(expected, product);
+
+            evaluator.transformToNttInplace(encrypteds[i]);
+            evaluator.transformToNttInplace(plains[i], context.firstParmsID());
+            encrypted_ptrs.push_back(&encrypteds[i]);
+            plain_ptrs.push_back(&plains[i]);
+        }
+
+        Ciphertext encrypted;
+        evaluator.multiplyPlainAccumulate(encrypted_ptrs, plain_ptrs, encrypted);
+        ASSERT_TRUE(encrypted.isNttForm());
+        ASSERT_TRUE(encrypted.parmsID() == context.firstParmsID());
+        evaluator.transformFromNttInplace(encrypted);
+
+        Plaintext plain, plain_expected;
+        decryptor.decrypt(encrypted, plain);
+        decryptor.decrypt(expected, plain_expected);
+        ASSERT_EQ(plain_expected.to_string(), plain.to_string());
+
+        // The destination may alias one of the operands.
+        Ciphertext &aliased = encrypteds[0];
+        evaluator.multiplyPlainAccumulate(encrypted_ptrs, plain_ptrs, aliased);
+        evaluator.transformFromNttInplace(aliased);
+        decryptor.decrypt(aliased, plain);
+        ASSERT_EQ(plain_expected.to_string(), plain.to_string());
+
+        plain_ptrs.pop_back();
+        ASSERT_THROW(evaluator.multiplyPlainAccumulate(encrypted_ptrs, plain_ptrs, encrypted), invalid_argument);
+    }
+
+    TEST(EvaluatorTest, BFVEncryptMultiplyAccumulateDecrypt)
+    {
+        EncryptionParameters parms(SchemeType::bfv);
+        Modulus plain_modulus(1 << 6);
+        parms.setPolyModulusDegree(64);
+        parms.setPlainModulus(plain_modulus);
+        parms.setCoeffModulus(CoeffModulus::Create(64, { 40, 40 }));
+
+        SEALContext context(parms, false, SecurityLevel::none);
+        KeyGenerator keygen(context);
+        PublicKey pk;
+        keygen.createPublicKey(pk);
+
+        Encryptor encryptor(context, pk);
+        Evaluator evaluator(context);
+        Decryptor decryptor(context, keygen.secretKey());
+
+        vector<string> xs{ "1x^2 + 3", "2x^1", "Fx^63 + 1", "5" };
+        vector<string> ys{ "2", "3x^1 + 1", "1x^1", "1x^3 + 3Fx^2" };
+        vector<BehzCiphertext> extended1(xs.size()), extended2(ys.size());
+        vector<const BehzCiphertext *> ptrs1, ptrs2;
+        Ciphertext expected;
+        for (size_t i = 0; i < xs.size(); i++)
+        {
+            Ciphertext x, y, product;
+            encryptor.encrypt(Plaintext(xs[i]), x);
+            encryptor.encrypt(Plaintext(ys[i]), y);
+            evaluator.multiply(x, y, product);
+            if (i == 0)
+                expected = product;
+            else
+                evaluator.addInplace(expected, product);
+
+            evaluator.extendToBehzNtt(x, extended1[i]);
+            evaluator.extendToBehzNtt(y, extended2[i]);
+            ASSERT_EQ(2ULL, extended1[i].size());
+            ASSERT_TRUE(extended1[i].parmsID() == context.firstParmsID());
+            ptrs1.push_back(&extended1[i]);
+            ptrs2.push_back(&extended2[i]);
+        }
+
+        Ciphertext encrypted;
+        evaluator.multiplyAccumulate(ptrs1, ptrs2, encrypted);
+        ASSERT_EQ(3ULL, encrypted.size());
+        ASSERT_FALSE(encrypted.isNttForm());
+
+        Plaintext plain, plain_expected;
+        decryptor.decrypt(encrypted, plain);
+        decryptor.decrypt(expected, plain_expected);
+        ASSERT_EQ(plain_expected.to_string(), plain.to_string());
+
+        ptrs2.pop_back();
+        ASSERT_THROW(evaluator.multiplyAccumulate(ptrs1, ptrs2, encrypted), invalid_argument);
+        Ciphertext ntt;
+        encryptor.encrypt(Plaintext("1"), ntt);
+        evaluator.transformToNttInplace(ntt);
+        ASSERT_THROW(evaluator.extendToBehzNtt(ntt, extended1[0]), invalid_argument);
+    }
+
+    TEST(EvaluatorTest, BFVMultiplyAccumulateManyProducts)
+    {
+        EncryptionParameters parms(SchemeType::bfv);
+        size_t coeff_count = 1024;
+        parms.setPolyModulusDegree(coeff_count);
+        parms.setPlainModulus(Modulus(uint64_t(1) << 50));
+        parms.setCoeffModulus(CoeffModulus::Create(coeff_count, { 60, 60, 60, 60 }));
+
+        SEALContext context(parms, false, SecurityLevel::none);
+        KeyGenerator keygen(context);
+        PublicKey pk;
+        keygen.createPublicKey(pk);
+
+        Encryptor encryptor(context, pk);
+        Evaluator evaluator(context);
+        Decryptor decryptor(context, keygen.secretKey());
+
+        // Worst case: every coefficient is (q - 1) / 2, so that every product is as large as it gets. 64 products of
+        // size 2 ciphertexts are 128 summands of up to 122 bits per coefficient modulo each prime of base Bsk.
+        auto &coeff_modulus = context.firstContextData()->parms().coeffModulus();
+        size_t coeff_modulus_size = coeff_modulus.size();
+        Ciphertext extreme;
+        extreme.resize(context, context.firstParmsID(), 2);
+        for (size_t p = 0; p < 2; p++)
+        {
+            for (size_t j = 0; j < coeff_modulus_size; j++)
+            {
+                // (q - 1) / 2 is -1/2 modulo each prime.
+                fill_n(extreme.data(p) + j * coeff_count, coeff_count, (coeff_modulus[j].value() - 1) / 2);
+            }
+        }
+        BehzCiphertext extended;
+        evaluator.extendToBehzNtt(extreme, extended);
+        size_t count = 64;
+        vector<const BehzCiphertext *> ptrs(count, &extended);
+        Ciphertext product, expected;
+        evaluator.multiply(extreme, extreme, product);
+        expected = product;
+        for (size_t k = 1; k < count; k++)
+        {
+            evaluator.addInplace(expected, product);
+        }
+        // Scaling the sum instead of each product moves each coefficient by at most 2 per product; an overflow
+        // would be off by about q.
+        auto check_close = [&](const Ciphertext &sum) {
+            for (size_t p = 0; p < 3; p++)
+            {
+                for (size_t j = 0; j < coeff_modulus_size; j++)
+                {
+                    uint64_t q = coeff_modulus[j].value();
+                    for (size_t i = 0; i < coeff_count; i++)
+                    {
+                        uint64_t diff =
+                            (sum.data(p)[j * coeff_count + i] + q - expected.data(p)[j * coeff_count + i]) % q;
+                        ASSERT_LE(min(diff, q - diff), 2 * count);
+                    }
+                }
+            }
+        };
+        Ciphertext sum;
+        evaluator.multiplyAccumulate(ptrs, ptrs, sum);
+        check_close(sum);
+
+        // Sums longer than the chunk size are scaled chunk by chunk.
+        evaluator.setMultiplyAccumulateChunkSize(5);
+        evaluator.multiplyAccumulate(ptrs, ptrs, sum);
+        check_close(sum);
+
+        count = 20;
+        vector<BehzCiphertext> extended1(count), extended2(count);
+        vector<const BehzCiphertext *> ptrs1, ptrs2;
+        for (size_t k = 0; k < count; k++)
+        {
+            Ciphertext x, y;
+            encryptor.encrypt(Plaintext("1x^" + to_string(k + 1) + " + " + to_string(k + 1)), x);
+            encryptor.encrypt(Plaintext("3x^1 + 2"), y);
+            evaluator.multiply(x, y, product);
+            if (k == 0)
+                expected = product;
+            else
+                evaluator.addInplace(expected, product);
+            evaluator.extendToBehzNtt(x, extended1[k]);
+            evaluator.extendToBehzNtt(y, extended2[k]);
+            ptrs1.push_back(&extended1[k]);
+            ptrs2.push_back(&extended2[k]);
+        }
+        evaluator.multiplyAccumulate(ptrs1, ptrs2, sum);
+        ASSERT_EQ(3ULL, sum.size());
+        Plaintext plain, plain_expected;
+        decryptor.decrypt(sum, plain);
+        decryptor.decrypt(expected, plain_expected);
+        ASSERT_EQ(plain_expected.to_string(), plain.to_string());
+    }
+
+    TEST(EvaluatorTest, BFVEncryptNegacyclicShiftFieldTraceDecrypt)
+    {
+        EncryptionParameters parms(SchemeType::bfv);
+        Modulus plain_modulus(1 << 6);
+        parms.setPolyModulusDegree(64);
+        parms.setPlainModulus(plain_modulus);
+        parms.setCoeffModulus(CoeffModulus::Create(64, { 40, 40, 40 }));
+
+        SEALContext context(parms, false, SecurityLevel::none);
+        KeyGenerator keygen(context);
+        PublicKey pk;
+        keygen.createPublicKey(pk);
+        GaloisKeys autok = keygen.createAutomorphismKeys();
+
+        Encryptor encryptor(context, pk);
+        Evaluator evaluator(context);
+        Decryptor decryptor(context, keygen.secretKey());
+
+        Ciphertext encrypted, shifted;
+        Plaintext plain;
+        encryptor.encrypt(Plaintext("1x^3 + 2x^1 + 5"), encrypted);
+        evaluator.negacyclicShift(encrypted, 2, shifted);
+        decryptor.decrypt(shifted, plain);
+        ASSERT_EQ(plain.to_string(), "1x^5 + 2x^3 + 5x^2");
+        evaluator.negacyclicShift(encrypted, 62, shifted);
+        decryptor.decrypt(shifted, plain);
+        ASSERT_EQ(plain.to_string(), "2x^63 + 5x^62 + 3Fx^1");
+        evaluator.negacyclicShiftInplace(encrypted, 128 - 3);
+        decryptor.decrypt(encrypted, plain);
+        ASSERT_EQ(plain.to_string(), "3Ex^62 + 3Bx^61 + 1");
+        ASSERT_THROW(evaluator.negacyclicShift(encrypted, 128, shifted), invalid_argument);
+
+        // Trace to the subring generated by X^16; pre-dividing keeps the coefficients unscaled.
+        encryptor.encrypt(Plaintext("3x^32 + 2x^16 + 7x^1 + 1"), encrypted);
+        evaluator.divideByPolyModulusDegreeInplace(encrypted, 4);
+        evaluator.fieldTraceInplace(encrypted, autok, 2);
+        decryptor.decrypt(encrypted, plain);
+        ASSERT_EQ(plain.to_string(), "3x^32 + 2x^16 + 1");
+
+        evaluator.transformToNttInplace(encrypted);
+        ASSERT_THROW(evaluator.negacyclicShift(encrypted, 1, shifted), invalid_argument);
+    }
+
+    TEST(EvaluatorTest, BFVEncryptExtractPackLWEDecrypt)
+    {
+        EncryptionParameters parms(SchemeType::bfv);
+        Modulus plain_modulus(1 << 6);
+        parms.setPolyModulusDegree(64);
+        parms.setPlainModulus(plain_modulus);
+        parms.setCoeffModulus(CoeffModulus::Create(64, { 50, 40, 50 }));
+
+        SEALContext context(parms, true, SecurityLevel::none);
+        KeyGenerator keygen(context);
+        PublicKey pk;
+        keygen.createPublicKey(pk);
+        GaloisKeys autok = keygen.createAutomorphismKeys();
+
+        Encryptor encryptor(context, pk);
+        Evaluator evaluator(context);
+        Decryptor decryptor(context, keygen.secretKey());
+
+        Plaintext plain(64);
+        for (size_t i = 0; i < 64; i++)
+        {
+            plain[i] = (i * 7 + 3) % 64;
+        }
+        Ciphertext encrypted;
+        encryptor.encrypt(plain, encrypted);
+
+        // Every sample decrypts, as the constant coefficient of its assembled ciphertext, to the extracted one, also
+        // after switching to the last level.
+        vector<size_t> indices{ 0, 5, 17, 33, 63 };
+        vector<LWECiphertext> samples;
+        evaluator.extractLWE(encrypted, indices, samples);
+        ASSERT_EQ(indices.size(), samples.size());
+        Ciphertext assembled;
+        Plaintext decrypted;
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            samples[i].assemble(context, assembled);
+            decryptor.decrypt(assembled, decrypted);
+            ASSERT_EQ(plain[indices[i]], decrypted[0]);
+
+            evaluator.modSwitchToNextInplace(samples[i]);
+            ASSERT_EQ(context.lastParmsID(), samples[i].parmsID());
+            ASSERT_EQ(1, samples[i].coeffModulusSize());
+            samples[i].assemble(context, assembled);
+            decryptor.decrypt(assembled, decrypted);
+            ASSERT_EQ(plain[indices[i]], decrypted[0]);
+        }
+        ASSERT_THROW(evaluator.modSwitchToNextInplace(samples[0]), invalid_argument);
+
+        // Five samples are spread over the eight multiples of 64 / 8.
+        Ciphertext packed;
+        evaluator.packLWECiphertexts(samples, autok, packed);
+        decryptor.decrypt(packed, decrypted);
+        for (size_t i = 0; i < 64; i++)
+        {
+            uint64_t expected = (i % 8 == 0 && i / 8 < indices.size()) ? plain[indices[i / 8]] : 0;
+            ASSERT_EQ(expected, i < decrypted.coeffCount() ? decrypted[i] : 0);
+        }
+
+        // All coefficients, reversed.
+        indices.resize(64);
+        for (size_t i = 0; i < 64; i++)
+        {
+            indices[i] = 63 - i;
+        }
+        evaluator.extractLWE(encrypted, indices, samples);
+        evaluator.packLWECiphertexts(samples, autok, packed);
+        decryptor.decrypt(packed, decrypted);
+        for (size_t i = 0; i < 64; i++)
+        {
+            ASSERT_EQ(plain[63 - i], decrypted[i]);
+        }
+
+        ASSERT_THROW(evaluator.extractLWE(encrypted, 64, samples[0]), invalid_argument);
+        ASSERT_THROW(evaluator.packLWECiphertexts(vector<LWECiphertext>(), autok, packed), invalid_argument);
+        evaluator.modSwitchToNextInplace(samples[1]);
+        ASSERT_THROW(evaluator.packLWECiphertexts(samples, autok, packed), invalid_argument);
+    }
+
+    TEST(EvaluatorTest, BFVEncryptPackCiphertextGroupsDecrypt)
+    {
+        EncryptionParameters parms(SchemeType::bfv);
+        Modulus plain_modulus(1 << 6);
+        parms.setPolyModulusDegree(64);
+        parms.setPlainModulus(plain_modulus);
+        parms.setCoeffModulus(CoeffModulus::Create(64, { 50, 40, 50 }));
+
+        SEALContext context(parms, true, SecurityLevel::none);
+        KeyGenerator keygen(context);
+        PublicKey pk;
+        keygen.createPublicKey(pk);
+        GaloisKeys autok = keygen.createAutomorphismKeys();
+
+        Encryptor encryptor(context, pk);
+        Evaluator evaluator(context);
+        Decryptor decryptor(context, keygen.secretKey());
+
+        // Eleven full plaintexts in groups of four, the last one short. With spacing 1, ciphertext k of a group keeps
+        // its coefficients at the multiples of 4, moved to the indices congruent to k, and the rest cancels.
+        vector<Plaintext> plains(11, Plaintext(64));
+        vector<Ciphertext> encrypteds(plains.size());
+        for (size_t j = 0; j < plains.size(); j++)
+        {
+            for (size_t i = 0; i < 64; i++)
+            {
+                plains[j][i] = (i * 7 + j * 13 + 1) % 64;
+            }
+            encryptor.encrypt(plains[j], encrypteds[j]);
+        }
+        for (size_t threads : { 1, 3 })
+        {
+            evaluator.setThreadCount(threads);
+            vector<Ciphertext> packed = encrypteds;
+            evaluator.packCiphertextGroupsInplace(packed, 4, 1, autok);
+            ASSERT_EQ(3, packed.size());
+            for (size_t g = 0; g < packed.size(); g++)
+            {
+                Plaintext decrypted;
+                decryptor.decrypt(packed[g], decrypted);
+                for (size_t i = 0; i < 64; i++)
+                {
+                    size_t j = g * 4 + i % 4;
+                    uint64_t expected = j < plains.size() ? plains[j][i - i % 4] : 0;
+                    ASSERT_EQ(expected, i < decrypted.coeffCount() ? decrypted[i] : 0);
+                }
+            }
+        }
+
+        vector<Ciphertext> invalid = encrypteds;
+        ASSERT_THROW(evaluator.packCiphertextGroupsInplace(invalid, 3, 1, autok), invalid_argument);
+        ASSERT_THROW(evaluator.packCiphertextGroupsInplace(invalid, 16, 8, autok), invalid_argument);
+        evaluator.modSwitchToNextInplace(invalid[1]);
+        ASSERT_THROW(evaluator.packCiphertextGroupsInplace(invalid, 4, 1, autok), invalid_argument);
+        invalid.clear();
+        ASSERT_THROW(evaluator.packCiphertextGroupsInplace(invalid, 4, 1, autok), invalid_argument);
+    }
+
+    TEST(EvaluatorTest, BFVEncryptExpandQueryDecrypt)
+    {
+        EncryptionParameters parms(SchemeType::bfv);
+        Modulus plain_modulus(1 << 6);
+        parms.setPolyModulusDegree(64);
+        parms.setPlainModulus(plain_modulus);
+        parms.setCoeffModulus(CoeffModulus::Create(64, { 50, 40, 50 }));
+
+        SEALContext context(parms, true, SecurityLevel::none);
+        KeyGenerator keygen(context);
+        PublicKey pk;
+        keygen.createPublicKey(pk);
+        GaloisKeys galk;
+        keygen.createGaloisKeys(context.keyContextData()->galoisTool()->getEltsForExpansion(64), galk);
+
+        Encryptor encryptor(context, pk);
+        Evaluator evaluator(context);
+        Decryptor decryptor(context, keygen.secretKey());
+
+        for (size_t count : { 1, 20, 64 })
+        {
+            Plaintext plain(64);
+            for (size_t i = 0; i < count; i++)
+            {
+                plain[i] = (i * 5 + 1) % 64;
+            }
+            Ciphertext encrypted;
+            encryptor.encrypt(plain, encrypted);
+
+            for (size_t threads : { 1, 3 })
+            {
+                evaluator.setThreadCount(threads);
+                vector<Ciphertext> expanded;
+                evaluator.expandQuery(encrypted, count, galk, expanded);
+                ASSERT_EQ(count, expanded.size());
+                for (size_t i = 0; i < count; i++)
+                {
+                    Plaintext decrypted;
+                    decryptor.decrypt(expanded[i], decrypted);
+                    ASSERT_EQ(plain[i], decrypted.coeffCount() ? decrypted[0] : 0);
+                    for (size_t k = 1; k < decrypted.coeffCount(); k++)
+                    {
+                        ASSERT_EQ(0, decrypted[k]);
+                    }
+                }
+            }
+        }
+
+        Ciphertext encrypted;
+        encryptor.encrypt(Plaintext("1"), encrypted);
+        vector<Ciphertext> expanded;
+        ASSERT_THROW(evaluator.expandQuery(encrypted, 0, galk, expanded), invalid_argument);
+        ASSERT_THROW(evaluator.expandQuery(encrypted, 65, galk, expanded), invalid_argument);
+        GaloisKeys partial;
+        keygen.createGaloisKeys(context.keyContextData()->galoisTool()->getEltsForExpansion(16), partial);
+        ASSERT_THROW(evaluator.expandQuery(encrypted, 20, partial, expanded), invalid_argument);
+    }
+
+    TEST(EvaluatorTest, CKKSEncryptExtractPackLWEDecrypt)
+    {
+        EncryptionParameters parms(SchemeType::ckks);
+        parms.setPolyModulusDegree(64);
+        parms.setCoeffModulus(CoeffModulus::Create(64, { 60, 40, 40, 60 }));
+
+        SEALContext context(parms, true, SecurityLevel::none);
+        KeyGenerator keygen(context);
+        PublicKey pk;
+        keygen.createPublicKey(pk);
+        GaloisKeys autok = keygen.createAutomorphismKeys();
+
+        CKKSEncoder encoder(context);
+        Encryptor encryptor(context, pk);
+        Evaluator evaluator(context);
+        Decryptor decryptor(context, keygen.secretKey());
+
+        vector<complex<double>> values(encoder.slotCount());
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            values[i] = complex<double>(static_cast<double>(i) / 8, 1 - static_cast<double>(i) / 16);
+        }
+        Plaintext plain;
+        encoder.encode(values, pow(2.0, 40), plain);
+        Ciphertext encrypted;
+        encryptor.encrypt(plain, encrypted);
+
+        // Extracting every coefficient, dropping a level and packing them back in order gives the same slots.
+        vector<size_t> indices(64);
+        for (size_t i = 0; i < 64; i++)
+        {
+            indices[i] = i;
+        }
+        vector<LWECiphertext> samples;
+        evaluator.extractLWE(encrypted, indices, samples);
+        for (auto &sample : samples)
+        {
+            evaluator.modSwitchToInplace(sample, context.lastParmsID());
+        }
+        Ciphertext packed;
+        evaluator.packLWECiphertexts(samples, autok, packed);
+        ASSERT_TRUE(packed.isNttForm());
+        ASSERT_EQ(context.lastParmsID(), packed.parmsID());
+        ASSERT_EQ(encrypted.scale(), packed.scale());
+
+        vector<complex<double>> result;
+        decryptor.decrypt(packed, plain);
+        encoder.decode(plain, result);
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            ASSERT_NEAR(values[i].real(), result[i].real(), 1e-3);
+            ASSERT_NEAR(values[i].imag(), result[i].imag(), 1e-3);
+        }
+    }
 } // namespace sealtest
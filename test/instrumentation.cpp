@@ -0,0 +1,298 @@
+#include "../src/batchencoder.h"
+#include "../src/ckks.h"
+#include "../src/context.h"
+#include "../src/decryptor.h"
+#include "../src/encryptor.h"
+#include "../src/evaluator.h"
+#include "../src/instrumentation.h"
+#include "../src/keygenerator.h"
+#include "../src/modulus.h"
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "gtest/gtest.h"
+
+using namespace troy;
+using namespace std;
+
+namespace troytest
+{
+    TEST(InstrumentationTest, SnapshotFormats)
+    {
+        Instrumentation::reset();
+        auto snapshot = Instrumentation::snapshot();
+        ASSERT_EQ(Instrumentation::compiledIn(), snapshot.compiled_in);
+        ASSERT_TRUE(snapshot.operations.empty());
+        ASSERT_EQ(static_cast<size_t>(Counter::counter_count), snapshot.counters.size());
+        ASSERT_EQ(0ULL, snapshot.counter(Counter::ntt));
+        ASSERT_EQ(nullptr, snapshot.find(Operation::multiply, 0));
+
+        string json = snapshot.toJson();
+        ASSERT_EQ(0, json.find(snapshot.compiled_in ? "{\"compiled_in\":true," : "{\"compiled_in\":false,"));
+        ASSERT_NE(string::npos, json.find("\"operations\":[]"));
+        ASSERT_NE(string::npos, json.find("\"bytes_allocated\":0"));
+        ASSERT_EQ('}', json.back());
+
+        string prometheus = snapshot.toPrometheus();
+        ASSERT_NE(string::npos, prometheus.find("# TYPE troy_operation_duration_seconds histogram\n"));
+        ASSERT_NE(string::npos, prometheus.find("troy_ntt_total 0\n"));
+        ASSERT_NE(string::npos, prometheus.find("troy_key_switch_total 0\n"));
+    }
+
+    TEST(InstrumentationTest, BFVRecordsOperations)
+    {
+        if (!Instrumentation::compiledIn())
+        {
+            GTEST_SKIP() << "built without TROY_INSTRUMENTATION";
+        }
+
+        EncryptionParameters parms(SchemeType::bfv);
+        parms.setPolyModulusDegree(8);
+        parms.setPlainModulus(Modulus(257));
+        parms.setCoeffModulus(CoeffModulus::Create(8, { 40, 40, 40 }));
+
+        SEALContext context(parms, true, SecurityLevel::none);
+        KeyGenerator keygen(context);
+        PublicKey pk;
+        keygen.createPublicKey(pk);
+        RelinKeys rlk;
+        keygen.createRelinKeys(rlk);
+        GaloisKeys glk;
+        keygen.createGaloisKeys(glk);
+
+        Encryptor encryptor(context, pk);
+        Evaluator evaluator(context);
+        Decryptor decryptor(context, keygen.secretKey());
+        BatchEncoder batch_encoder(context);
+        size_t level = context.firstContextData()->chainIndex();
+
+        Instrumentation::reset();
+        Plaintext plain;
+        vector<uint64_t> plain_vec{ 1, 2, 3, 4, 5, 6, 7, 8 };
+        batch_encoder.encode(plain_vec, plain);
+        Ciphertext encrypted;
+        encryptor.encrypt(plain, encrypted);
+        evaluator.squareInplace(encrypted);
+        evaluator.relinearizeInplace(encrypted, rlk);
+        evaluator.rotateRowsInplace(encrypted, 1, glk);
+        evaluator.rotateRowsInplace(encrypted, 1, glk);
+        evaluator.rotateRowsInplace(encrypted, -1, glk);
+        evaluator.rotateColumnsInplace(encrypted, glk);
+        Ciphertext switched;
+        evaluator.modSwitchToNext(encrypted, switched);
+
+        // Failed calls are not recorded.
+        ASSERT_THROW(evaluator.addInplace(encrypted, switched), invalid_argument);
+
+        decryptor.decrypt(switched, plain);
+        batch_encoder.decode(plain, plain_vec);
+        ASSERT_TRUE((plain_vec == vector<uint64_t>{ 36, 49, 64, 25, 4, 9, 16, 1 }));
+
+        auto snapshot = Instrumentation::snapshot();
+        ASSERT_EQ(1ULL, snapshot.count(Operation::encrypt));
+        ASSERT_EQ(1ULL, snapshot.count(Operation::square));
+        ASSERT_EQ(1ULL, snapshot.count(Operation::relinearize));
+        ASSERT_EQ(4ULL, snapshot.count(Operation::rotate));
+        ASSERT_EQ(1ULL, snapshot.count(Operation::mod_switch));
+        ASSERT_EQ(0ULL, snapshot.count(Operation::add));
+        ASSERT_EQ(1ULL, snapshot.count(Operation::decrypt));
+        ASSERT_EQ(1ULL, snapshot.count(Operation::encode));
+        ASSERT_EQ(1ULL, snapshot.count(Operation::decode));
+
+        auto rotate = snapshot.find(Operation::rotate, level);
+        ASSERT_NE(nullptr, rotate);
+        ASSERT_EQ(4ULL, rotate->count);
+        ASSERT_EQ(Instrumentation::histogram_buckets, rotate->histogram.size());
+        uint64_t bucketed = 0;
+        for (auto count : rotate->histogram)
+        {
+            bucketed += count;
+        }
+        ASSERT_EQ(4ULL, bucketed);
+        ASSERT_GE(rotate->total_nanoseconds, rotate->max_nanoseconds);
+        ASSERT_NE(nullptr, snapshot.find(Operation::decrypt, level - 1));
+
+        ASSERT_EQ(2ULL, snapshot.rotation_steps[1]);
+        ASSERT_EQ(1ULL, snapshot.rotation_steps[-1]);
+        ASSERT_EQ(1ULL, snapshot.rotation_steps[0]);
+
+        // One key switch for relinearization and one per rotation.
+        ASSERT_EQ(5ULL, snapshot.counter(Counter::key_switch));
+        ASSERT_EQ(5ULL, snapshot.count(Operation::key_switch));
+        ASSERT_GT(snapshot.counter(Counter::ntt), 0ULL);
+        ASSERT_GT(snapshot.counter(Counter::inverse_ntt), 0ULL);
+        ASSERT_GT(snapshot.counter(Counter::allocations), 0ULL);
+        ASSERT_GT(snapshot.counter(Counter::bytes_allocated), 0ULL);
+
+        string json = snapshot.toJson();
+        ASSERT_NE(
+            string::npos,
+            json.find("{\"operation\":\"relinearize\",\"level\":" + to_string(level) + ",\"count\":1,"));
+        ASSERT_NE(string::npos, json.find("\"rotation_steps\":{\"-1\":1,\"0\":1,\"1\":2}"));
+        string prometheus = snapshot.toPrometheus();
+        ASSERT_NE(
+            string::npos, prometheus.find(
+                              "troy_operation_duration_seconds_count{operation=\"rotate\",level=\"" + to_string(level) +
+                              "\"} 4\n"));
+        ASSERT_NE(string::npos, prometheus.find("troy_rotations_total{steps=\"1\"} 2\n"));
+
+        // Nothing is recorded while paused.
+        Instrumentation::setEnabled(false);
+        evaluator.rotateRowsInplace(encrypted, 1, glk);
+        Instrumentation::setEnabled(true);
+        ASSERT_EQ(4ULL, Instrumentation::snapshot().count(Operation::rotate));
+
+        Instrumentation::reset();
+        ASSERT_TRUE(Instrumentation::snapshot().operations.empty());
+    }
+
+    TEST(InstrumentationTest, CKKSTracerWritesChromeTrace)
+    {
+        if (!Instrumentation::compiledIn())
+        {
+            GTEST_SKIP() << "built without TROY_INSTRUMENTATION";
+        }
+
+        EncryptionParameters parms(SchemeType::ckks);
+        parms.setPolyModulusDegree(64);
+        parms.setCoeffModulus(CoeffModulus::Create(64, { 40, 40, 40 }));
+
+        SEALContext context(parms, true, SecurityLevel::none);
+        KeyGenerator keygen(context);
+        PublicKey pk;
+        keygen.createPublicKey(pk);
+        RelinKeys rlk;
+        keygen.createRelinKeys(rlk);
+        GaloisKeys glk;
+        keygen.createGaloisKeys(glk);
+
+        Encryptor encryptor(context, pk);
+        Evaluator evaluator(context);
+        CKKSEncoder encoder(context);
+        size_t level = context.firstContextData()->chainIndex();
+
+        Plaintext plain;
+        encoder.encode(1.5, pow(2.0, 30), plain);
+        Ciphertext encrypted;
+        encryptor.encrypt(plain, encrypted);
+
+        ASSERT_FALSE(Tracer::enabled());
+        evaluator.rotateVectorInplace(encrypted, 1, glk);
+        Tracer::start();
+        ASSERT_TRUE(Tracer::enabled());
+        ASSERT_EQ(0, Tracer::eventCount());
+        Ciphertext squared;
+        thread worker([&]() {
+            evaluator.square(encrypted, squared);
+            evaluator.relinearizeInplace(squared, rlk);
+        });
+        worker.join();
+        evaluator.rotateVectorInplace(encrypted, 1, glk);
+        Tracer::stop();
+        size_t events = Tracer::eventCount();
+        ASSERT_GT(events, 0);
+        evaluator.rotateVectorInplace(encrypted, 1, glk);
+        ASSERT_EQ(events, Tracer::eventCount());
+        ASSERT_EQ(0, Tracer::droppedEvents());
+
+        stringstream stream;
+        Tracer::writeChromeTrace(stream);
+        string trace = stream.str();
+        ASSERT_EQ(0, trace.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+        ASSERT_NE(string::npos, trace.find("\"name\":\"thread_name\",\"ph\":\"M\""));
+        ASSERT_NE(string::npos, trace.find("{\"name\":\"square\",\"cat\":\"troy\",\"ph\":\"X\","));
+        ASSERT_NE(string::npos, trace.find("\"args\":{\"level\":" + to_string(level) + ",\"size\":3}"));
+        ASSERT_NE(string::npos, trace.find("{\"name\":\"relinearize\""));
+        ASSERT_NE(string::npos, trace.find("{\"name\":\"rotate\""));
+        ASSERT_NE(string::npos, trace.find("{\"name\":\"key_switch\""));
+        ASSERT_NE(string::npos, trace.find("{\"name\":\"inverse_ntt\""));
+        ASSERT_NE(string::npos, trace.find("\"args\":{\"level\":null,"));
+        ASSERT_EQ("]}\n", trace.substr(trace.size() - 3));
+
+        // The square ran on another thread than the rotation.
+        auto tid = [&](const string &name) {
+            size_t begin = trace.find("\"tid\":", trace.find("{\"name\":\"" + name + "\""));
+            return trace.substr(begin, trace.find(',', begin) - begin);
+        };
+        ASSERT_NE(tid("square"), tid("rotate"));
+
+        // Full buffers drop events instead of growing.
+        Tracer::start(2);
+        evaluator.rotateVectorInplace(encrypted, 1, glk);
+        Tracer::stop();
+        ASSERT_EQ(2, Tracer::eventCount());
+        ASSERT_GT(Tracer::droppedEvents(), 0);
+
+        Tracer::clear();
+        ASSERT_EQ(0, Tracer::eventCount());
+    }
+
+    TEST(InstrumentationTest, TracerRetiresThreadBuffers)
+    {
+        if (!Instrumentation::compiledIn())
+        {
+            GTEST_SKIP() << "built without TROY_INSTRUMENTATION";
+        }
+
+        EncryptionParameters parms(SchemeType::bfv);
+        parms.setPolyModulusDegree(64);
+        parms.setPlainModulus(1 << 6);
+        parms.setCoeffModulus(CoeffModulus::Create(64, { 50, 40, 50 }));
+
+        SEALContext context(parms, true, SecurityLevel::none);
+        KeyGenerator keygen(context);
+        PublicKey pk;
+        keygen.createPublicKey(pk);
+        GaloisKeys galk;
+        keygen.createGaloisKeys(context.keyContextData()->galoisTool()->getEltsForExpansion(64), galk);
+
+        Encryptor encryptor(context, pk);
+        Evaluator evaluator(context);
+        evaluator.setThreadCount(4);
+
+        Plaintext plain(64);
+        plain[1] = 1;
+        Ciphertext encrypted;
+        encryptor.encrypt(plain, encrypted);
+        vector<Ciphertext> expanded;
+
+        // Every expansion starts new workers; their buffers are freed when they exit, but their events stay.
+        Tracer::start();
+        evaluator.expandQuery(encrypted, 64, galk, expanded);
+        size_t events = Tracer::eventCount();
+        ASSERT_LE(Tracer::bufferCount(), 1);
+        stringstream stream;
+        Tracer::writeChromeTrace(stream);
+        string trace = stream.str();
+        size_t rows = 0;
+        for (size_t pos = trace.find("\"thread_name\""); pos != string::npos; pos = trace.find("\"thread_name\"", pos + 1))
+        {
+            rows++;
+        }
+        ASSERT_GT(rows, 1);
+        for (int i = 0; i < 20; i++)
+        {
+            evaluator.expandQuery(encrypted, 64, galk, expanded);
+            ASSERT_LE(Tracer::bufferCount(), 1);
+        }
+        Tracer::stop();
+        ASSERT_EQ(21 * events, Tracer::eventCount());
+
+        // The whole trace is capped, not only each thread's share of it.
+        Tracer::start(size_t(1) << 20, events * 3);
+        for (int i = 0; i < 20; i++)
+        {
+            evaluator.expandQuery(encrypted, 64, galk, expanded);
+        }
+        Tracer::stop();
+        ASSERT_EQ(events * 3, Tracer::eventCount());
+        ASSERT_EQ(events * 17, Tracer::droppedEvents());
+        ASSERT_LE(Tracer::bufferCount(), 1);
+
+        Tracer::clear();
+        ASSERT_EQ(0, Tracer::eventCount());
+        ASSERT_EQ(0, Tracer::droppedEvents());
+    }
+} // namespace troytest
@@ -6,6 +6,7 @@
 // #include "../src/encryptor.h"
 // #include "../src/evaluator.h"
 #include "../src/keygenerator.h"
+#include "../src/utils/ntt.h"
 #include "../src/valcheck.h"
 #include "gtest/gtest.h"
 
@@ -447,6 +448,44 @@ namespace troytest
         }
     }
 
+    TEST(KeyGeneratorTest, SparseSecretKey)
+    {
+        EncryptionParameters parms(SchemeType::ckks);
+        parms.setPolyModulusDegree(64);
+        parms.setCoeffModulus(CoeffModulus::Create(64, { 60, 40, 60 }));
+        SEALContext context(parms, false, SecurityLevel::none);
+        ASSERT_THROW(KeyGenerator(context, 0), invalid_argument);
+        ASSERT_THROW(KeyGenerator(context, 65), invalid_argument);
+
+        for (size_t weight : { 1, 8, 64 })
+        {
+            KeyGenerator keygen(context, weight);
+            auto &key_context_data = *context.keyContextData();
+            auto &coeff_modulus = key_context_data.parms().coeffModulus();
+            vector<uint64_t> secret(keygen.secretKey().data().data(), keygen.secretKey().data().data() + 64 * 3);
+            for (size_t j = 0; j < 3; j++)
+            {
+                inverseNttNegacyclicHarvey(
+                    HostPointer<uint64_t>(secret.data() + j * 64), key_context_data.smallNTTTables()[j]);
+            }
+
+            // The same ternary polynomial in every RNS limb, with exactly weight nonzero coefficients.
+            size_t nonzero = 0;
+            for (size_t i = 0; i < 64; i++)
+            {
+                uint64_t s = secret[i];
+                ASSERT_TRUE(s == 0 || s == 1 || s == coeff_modulus[0].value() - 1);
+                for (size_t j = 1; j < 3; j++)
+                {
+                    uint64_t expected = (s > 1) ? coeff_modulus[j].value() - 1 : s;
+                    ASSERT_EQ(expected, secret[i + j * 64]);
+                }
+                nonzero += (s != 0);
+            }
+            ASSERT_EQ(weight, nonzero);
+        }
+    }
+
     // TEST(KeyGeneratorTest, Constructors)
     // {
     //     auto constructors = [](SchemeType scheme) {
@@ -34,6 +34,14 @@ namespace troytest
         ASSERT_EQ(1ULL, mod.constRatio()[2]);
         ASSERT_TRUE(mod.isPrime());
 
+        Modulus trusted = Modulus::Trusted(3);
+        ASSERT_TRUE(trusted == mod);
+        ASSERT_EQ(mod.constRatio()[0], trusted.constRatio()[0]);
+        ASSERT_EQ(mod.constRatio()[2], trusted.constRatio()[2]);
+        ASSERT_TRUE(trusted.isPrime());
+        ASSERT_FALSE(Modulus::Trusted(4, false).isPrime());
+        ASSERT_THROW(Modulus::Trusted(1), std::invalid_argument);
+
         Modulus mod2(2);
         Modulus mod3(3);
         ASSERT_TRUE(mod != mod2);
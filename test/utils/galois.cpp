@@ -3,6 +3,8 @@
 
 #include "../../src/context.h"
 #include "../../src/utils/galois.h"
+#include "../../src/utils/ntt.h"
+#include <random>
 #include <stdexcept>
 #include <vector>
 #include "gtest/gtest.h"
@@ -63,6 +65,16 @@ namespace troytest
             }
         }
 
+        TEST(GaloisToolTest, EltsForExpansion)
+        {
+            GaloisTool galois_tool(4);
+            ASSERT_TRUE(galois_tool.getEltsForExpansion(1).empty());
+            ASSERT_EQ((vector<uint32_t>{ 17, 9 }), galois_tool.getEltsForExpansion(3));
+            ASSERT_EQ((vector<uint32_t>{ 17, 9, 5, 3 }), galois_tool.getEltsForExpansion(16));
+            ASSERT_THROW(galois_tool.getEltsForExpansion(0), invalid_argument);
+            ASSERT_THROW(galois_tool.getEltsForExpansion(17), invalid_argument);
+        }
+
         TEST(GaloisToolTest, IndexFromElt)
         {
             ASSERT_EQ(7, GaloisTool::GetIndexFromElt(15));
@@ -106,5 +118,57 @@ namespace troytest
                 ASSERT_EQ(out_true[i], out[i]);
             }
         }
+
+        TEST(GaloisToolTest, ApplyGaloisManyLimbs)
+        {
+            mt19937_64 engine(0);
+            for (int coeff_count_power : { 2, 12 })
+            {
+                size_t n = size_t(1) << coeff_count_power;
+                vector<Modulus> coeff_modulus = CoeffModulus::Create(n, { 30, 40, 50 });
+                size_t coeff_modulus_size = coeff_modulus.size();
+                auto ntt_tables = CreateNTTTables(coeff_count_power, coeff_modulus);
+                GaloisTool galois_tool(coeff_count_power);
+
+                vector<uint64_t> input(2 * coeff_modulus_size * n);
+                for (size_t i = 0; i < input.size(); i++)
+                {
+                    input[i] = engine() % coeff_modulus[(i / n) % coeff_modulus_size].value();
+                }
+                for (uint32_t galois_elt : galois_tool.getEltsAll())
+                {
+                    // Coefficient form against the definition X^i -> X^(i * galois_elt).
+                    vector<uint64_t> expected(input.size()), actual(input.size());
+                    for (size_t j = 0; j < 2 * coeff_modulus_size; j++)
+                    {
+                        uint64_t q = coeff_modulus[j % coeff_modulus_size].value();
+                        for (size_t i = 0; i < n; i++)
+                        {
+                            uint64_t index = (i * galois_elt) % (2 * n);
+                            uint64_t value = input[j * n + i];
+                            expected[j * n + index % n] = (index < n || value == 0) ? value : q - value;
+                        }
+                    }
+                    galois_tool.applyGalois(
+                        input.data(), 2, coeff_modulus_size, galois_elt, coeff_modulus.data(), actual.data());
+                    ASSERT_EQ(expected, actual);
+
+                    // NTT form: permuting the NTT of the input gives the NTT of the automorphism. Run twice so that
+                    // the cached table is used as well as the freshly generated one.
+                    vector<uint64_t> input_ntt = input;
+                    for (size_t j = 0; j < 2 * coeff_modulus_size; j++)
+                    {
+                        nttNegacyclicHarvey(input_ntt.data() + j * n, ntt_tables[j % coeff_modulus_size]);
+                        nttNegacyclicHarvey(expected.data() + j * n, ntt_tables[j % coeff_modulus_size]);
+                    }
+                    for (int repeat = 0; repeat < 2; repeat++)
+                    {
+                        fill(actual.begin(), actual.end(), 0);
+                        galois_tool.applyGaloisNtt(input_ntt.data(), 2, coeff_modulus_size, galois_elt, actual.data());
+                        ASSERT_EQ(expected, actual);
+                    }
+                }
+            }
+        }
     } // namespace util
 } // namespace sealtest
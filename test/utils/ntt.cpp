@@ -130,5 +130,53 @@ namespace troytest
                 ASSERT_EQ(temp[i], poly[i]);
             }
         }
+
+        TEST(NTTTablesTest, SpecializedKernelsMatchGeneric)
+        {
+            ASSERT_EQ(nullptr, NTTTables(11, getPrime(uint64_t(1) << 12, 40)).forwardKernel());
+            ASSERT_EQ(nullptr, NTTTables(17, getPrime(uint64_t(1) << 18, 40)).inverseKernel());
+
+            mt19937_64 engine(0);
+            for (int coeff_count_power = 12; coeff_count_power <= 16; coeff_count_power++)
+            {
+                size_t n = size_t(1) << coeff_count_power;
+                for (int bit_size : { 30, 50, 60 })
+                {
+                    Modulus modulus = getPrime(uint64_t(2) << coeff_count_power, bit_size);
+                    NTTTables tables(coeff_count_power, modulus);
+                    ASSERT_NE(nullptr, tables.forwardKernel());
+                    ASSERT_NE(nullptr, tables.inverseKernel());
+
+                    // Lazy forward inputs may be anywhere in [0, 4q), inverse ones in [0, 2q); the outputs must match
+                    // bit for bit, not only modulo q.
+                    vector<uint64_t> input(n), expected(n), actual(n);
+                    for (auto &x : input)
+                    {
+                        x = engine() % (modulus.value() << 2);
+                    }
+                    expected = actual = input;
+                    tables.nttHandler().transformToRev(
+                        expected.data(), coeff_count_power, tables.getFromRootPowers());
+                    nttNegacyclicHarveyLazy(HostPointer<uint64_t>(actual.data()), tables);
+                    ASSERT_EQ(expected, actual);
+
+                    for (size_t i = 0; i < n; i++)
+                    {
+                        expected[i] = actual[i] = actual[i] % (modulus.value() << 1);
+                    }
+                    MultiplyUIntModOperand inv_degree_modulo = tables.invDegreeModulo();
+                    tables.nttHandler().transformFromRev(
+                        expected.data(), coeff_count_power, tables.getFromInvRootPowers(), &inv_degree_modulo);
+                    inverseNttNegacyclicHarveyLazy(HostPointer<uint64_t>(actual.data()), tables);
+                    ASSERT_EQ(expected, actual);
+
+                    // The round trip recovers the input modulo q.
+                    for (size_t i = 0; i < n; i++)
+                    {
+                        ASSERT_EQ(input[i] % modulus.value(), actual[i] % modulus.value());
+                    }
+                }
+            }
+        }
     } // namespace util
 } // namespace sealtest
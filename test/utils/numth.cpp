@@ -6,6 +6,7 @@
 #include "../../src/utils/uintarithsmallmod.h"
 #include <cstdint>
 #include <numeric>
+#include <tuple>
 #include "gtest/gtest.h"
 
 using namespace troy;
@@ -110,6 +111,42 @@ namespace troytest
             ASSERT_FALSE(isPrime(72307ULL * 59399ULL));
             ASSERT_TRUE(isPrime(36893488147419103ULL));
             ASSERT_FALSE(isPrime(36893488147419107ULL));
+
+            // Strong pseudoprimes to the bases 2..7, 2..11, 2..13 and 2..17.
+            ASSERT_FALSE(isPrime(3215031751ULL));
+            ASSERT_FALSE(isPrime(2152302898747ULL));
+            ASSERT_FALSE(isPrime(3474749660383ULL));
+            ASSERT_FALSE(isPrime(341550071728321ULL));
+            ASSERT_TRUE(isPrime(17));
+            ASSERT_TRUE(isPrime(37));
+        }
+
+        TEST(NumberTheory, GetPrimes)
+        {
+            // Same primes, in the same order, as a plain downward scan.
+            auto scan = [](uint64_t factor, int bit_size, size_t count) {
+                vector<uint64_t> ret;
+                uint64_t value = ((uint64_t(1) << bit_size) - 1) / factor * factor + 1;
+                for (; ret.size() < count && value > (uint64_t(1) << (bit_size - 1)); value -= factor)
+                    if (isPrime(value)) ret.push_back(value);
+                return ret;
+            };
+            for (auto [factor, bit_size, count] : vector<tuple<uint64_t, int, size_t>>{
+                     { 2 * 4096, 60, 5 }, { 2 * 8192, 40, 3 }, { 2 * 64, 20, 40 }, { uint64_t(2) * 32768 * 65537, 60, 2 } })
+            {
+                // A short request followed by a longer one exercises the cached search.
+                auto first = getPrimes(factor, bit_size, 1);
+                auto primes = getPrimes(factor, bit_size, count);
+                auto expected = scan(factor, bit_size, count);
+                ASSERT_EQ(expected.size(), primes.size());
+                ASSERT_EQ(expected[0], first[0].value());
+                for (size_t i = 0; i < count; i++)
+                {
+                    ASSERT_EQ(expected[i], primes[i].value());
+                    ASSERT_TRUE(primes[i].isPrime());
+                }
+            }
+            ASSERT_THROW(getPrimes(2 * 64, 8, 10), logic_error);
         }
 
         TEST(NumberTheory, NAF)